@@ -42,9 +42,11 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AUtils.h>
 #include "include/NuCachedSource2.h"
+#include "include/StagefrightMetadataRetriever.h"
 #include <media/stagefright/AudioPlayer.h>
 #include <media/stagefright/DataSourceFactory.h>
 #include <media/stagefright/JPEGSource.h>
+#include <media/stagefright/MediaBufferGroup.h>
 #include <media/stagefright/InterfaceUtils.h>
 #include <media/stagefright/MediaCodec.h>
 #include <media/stagefright/MediaCodecList.h>
@@ -617,10 +619,14 @@ static void usage(const char *me) {
     fprintf(stderr, "       -b bug to reproduce\n");
     fprintf(stderr, "       -p(rofiles) dump decoder profiles supported\n");
     fprintf(stderr, "       -t(humbnail) extract video thumbnail or album art\n");
+    fprintf(stderr, "       -g thumbnail throughput of batch vs. per-file "
+                    "extraction (in-process)\n");
     fprintf(stderr, "       -s(oftware) prefer software codec\n");
     fprintf(stderr, "       -r(hardware) force to use hardware codec\n");
     fprintf(stderr, "       -o playback audio\n");
     fprintf(stderr, "       -w(rite) filename (write to .mp4 file)\n");
+    fprintf(stderr, "       -W filename (TS writer throughput with a synthetic "
+                    "50 Mbps source)\n");
     fprintf(stderr, "       -k seek test\n");
     fprintf(stderr, "       -N(ame) of the component\n");
     fprintf(stderr, "       -x display a histogram of decoding times/fps "
@@ -632,6 +638,183 @@ static void usage(const char *me) {
     fprintf(stderr, "       -D(ump) output_filename (decoded PCM data to a file)\n");
 }
 
+// Emits AVC access units of a fixed size at a fixed frame rate as fast as
+// they are pulled, to load a writer at a known bitrate.
+struct SyntheticVideoSource : public MediaSource {
+    SyntheticVideoSource(int32_t bitrate, int32_t frameRate, size_t numFrames)
+        : mFrameSize(bitrate / 8 / frameRate),
+          mFrameRate(frameRate),
+          mNumFrames(numFrames),
+          mNumFramesRead(0),
+          mGroup(NULL) {
+    }
+
+    virtual status_t start(MetaData * /* params */) {
+        mGroup = new MediaBufferGroup;
+        for (size_t i = 0; i < 2; ++i) {
+            MediaBuffer *buffer = new MediaBuffer(mFrameSize);
+            memset(buffer->data(), 0x55, mFrameSize);
+            memcpy(buffer->data(), "\x00\x00\x00\x01", 4);
+            mGroup->add_buffer(buffer);
+        }
+        mNumFramesRead = 0;
+        return OK;
+    }
+
+    virtual status_t stop() {
+        delete mGroup;
+        mGroup = NULL;
+        return OK;
+    }
+
+    virtual sp<MetaData> getFormat() {
+        sp<MetaData> meta = new MetaData;
+        meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+        return meta;
+    }
+
+    virtual status_t read(
+            MediaBufferBase **out, const ReadOptions * /* options */) {
+        *out = NULL;
+        if (mNumFramesRead == mNumFrames) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        MediaBufferBase *buffer;
+        status_t err = mGroup->acquire_buffer(&buffer);
+        if (err != OK) {
+            return err;
+        }
+
+        buffer->set_range(0, mFrameSize);
+        buffer->meta_data().clear();
+        buffer->meta_data().setInt64(
+                kKeyTime, mNumFramesRead * 1000000ll / mFrameRate);
+        buffer->meta_data().setInt32(
+                kKeyIsSyncFrame, (mNumFramesRead % mFrameRate) == 0);
+        ++mNumFramesRead;
+
+        *out = buffer;
+        return OK;
+    }
+
+    int64_t durationUs() const {
+        return mNumFrames * 1000000ll / mFrameRate;
+    }
+
+protected:
+    virtual ~SyntheticVideoSource() {
+        stop();
+    }
+
+private:
+    size_t mFrameSize;
+    int32_t mFrameRate;
+    size_t mNumFrames;
+    size_t mNumFramesRead;
+    MediaBufferGroup *mGroup;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SyntheticVideoSource);
+};
+
+static void benchmarkTSWriter(const char *filename) {
+    static const int32_t kBitrate = 50000000;
+    static const int32_t kFrameRate = 30;
+    static const size_t kNumFrames = 60 * kFrameRate;
+
+    int fd = open(filename, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR,
+            S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        fprintf(stderr, "unable to open '%s'\n", filename);
+        return;
+    }
+
+    sp<SyntheticVideoSource> source =
+        new SyntheticVideoSource(kBitrate, kFrameRate, kNumFrames);
+
+    sp<MPEG2TSWriter> writer = new MPEG2TSWriter(fd);
+    CHECK_EQ(writer->addSource(source), (status_t)OK);
+
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyRealTimeRecording, false);
+
+    int64_t startUs = getNowUs();
+    CHECK_EQ(writer->start(params.get()), (status_t)OK);
+    while (!writer->reachedEOS()) {
+        usleep(5000);
+    }
+    int64_t elapsedUs = getNowUs() - startUs;
+    writer->stop();
+
+    off64_t fileSize = lseek64(fd, 0, SEEK_END);
+    close(fd);
+
+    printf("wrote %.2f secs of %d Mbps video (%lld bytes) in %.2f secs\n",
+            source->durationUs() / 1E6, kBitrate / 1000000,
+            (long long)fileSize, elapsedUs / 1E6);
+    printf("%.2f Mbps TS output, %.2fx realtime\n",
+            elapsedUs > 0 ? fileSize * 8.0 / elapsedUs : 0.0,
+            elapsedUs > 0 ? (double)source->durationUs() / elapsedUs : 0.0);
+}
+
+static void benchmarkThumbnails(int argc, char **argv) {
+    std::vector<int> fds;
+    for (int k = 0; k < argc; ++k) {
+        int fd = open(argv[k], O_RDONLY | O_LARGEFILE);
+        if (fd < 0) {
+            fprintf(stderr, "unable to open '%s'\n", argv[k]);
+            continue;
+        }
+        fds.push_back(fd);
+    }
+
+    // one retriever and one decoder per file
+    int64_t startUs = getNowUs();
+    size_t numExtracted = 0;
+    for (size_t k = 0; k < fds.size(); ++k) {
+        sp<StagefrightMetadataRetriever> retriever = new StagefrightMetadataRetriever;
+        off64_t fileSize = lseek64(fds[k], 0, SEEK_END);
+        if (retriever->setDataSource(fds[k], 0, fileSize) == OK
+                && retriever->getFrameAtTime(-1,
+                        MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC,
+                        HAL_PIXEL_FORMAT_RGB_565, false /*metaOnly*/) != NULL) {
+            ++numExtracted;
+        }
+    }
+    int64_t perFileUs = getNowUs() - startUs;
+
+    printf("per-file:    %zu/%zu thumbnails in %.2f secs (%.2f thumbnails/sec)\n",
+            numExtracted, fds.size(), perFileUs / 1E6,
+            perFileUs > 0 ? numExtracted * 1E6 / perFileUs : 0.0);
+
+    // full resolution, then downscaled to a typical gallery thumbnail size
+    static const int32_t kTargetSizes[] = { 0, 256 };
+    for (size_t i = 0; i < sizeof(kTargetSizes) / sizeof(kTargetSizes[0]); ++i) {
+        startUs = getNowUs();
+        sp<StagefrightMetadataRetriever> retriever = new StagefrightMetadataRetriever;
+        std::vector<sp<IMemory> > frames;
+        retriever->getFramesAtTimeBatch(fds, -1,
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC,
+                HAL_PIXEL_FORMAT_RGB_565, kTargetSizes[i], &frames);
+        int64_t batchUs = getNowUs() - startUs;
+
+        size_t numBatchExtracted = 0;
+        for (size_t k = 0; k < frames.size(); ++k) {
+            if (frames[k] != NULL) {
+                ++numBatchExtracted;
+            }
+        }
+
+        printf("batch(%4d): %zu/%zu thumbnails in %.2f secs (%.2f thumbnails/sec)\n",
+                kTargetSizes[i], numBatchExtracted, fds.size(), batchUs / 1E6,
+                batchUs > 0 ? numBatchExtracted * 1E6 / batchUs : 0.0);
+    }
+
+    for (size_t k = 0; k < fds.size(); ++k) {
+        close(fds[k]);
+    }
+}
+
 static void dumpCodecProfiles(bool queryDecoders) {
     const char *kMimeTypes[] = {
         MEDIA_MIMETYPE_VIDEO_AVC, MEDIA_MIMETYPE_VIDEO_MPEG4,
@@ -690,6 +873,8 @@ int main(int argc, char **argv) {
     bool listComponents = false;
     bool dumpProfiles = false;
     bool extractThumbnail = false;
+    bool benchmarkThumbnail = false;
+    const char *benchmarkTSFilename = NULL;
     bool seekTest = false;
     bool useSurfaceAlloc = false;
     bool useSurfaceTexAlloc = false;
@@ -708,7 +893,7 @@ int main(int argc, char **argv) {
     sp<ALooper> looper;
 
     int res;
-    while ((res = getopt(argc, argv, "haqn:lm:b:ptsrow:kN:xSTd:D:")) >= 0) {
+    while ((res = getopt(argc, argv, "haqn:lm:b:ptgsrow:W:kN:xSTd:D:")) >= 0) {
         switch (res) {
             case 'a':
             {
@@ -778,6 +963,12 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'W':
+            {
+                benchmarkTSFilename = optarg;
+                break;
+            }
+
             case 'p':
             {
                 dumpProfiles = true;
@@ -790,6 +981,12 @@ int main(int argc, char **argv) {
                 break;
             }
 
+            case 'g':
+            {
+                benchmarkThumbnail = true;
+                break;
+            }
+
             case 's':
             {
                 gPreferSoftwareCodec = true;
@@ -851,6 +1048,16 @@ int main(int argc, char **argv) {
     argc -= optind;
     argv += optind;
 
+    if (benchmarkThumbnail) {
+        benchmarkThumbnails(argc, argv);
+        return 0;
+    }
+
+    if (benchmarkTSFilename != NULL) {
+        benchmarkTSWriter(benchmarkTSFilename);
+        return 0;
+    }
+
     if (extractThumbnail) {
         sp<IServiceManager> sm = defaultServiceManager();
         sp<IBinder> binder = sm->getService(String16("media.player"));
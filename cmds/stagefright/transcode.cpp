@@ -0,0 +1,1135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "transcode"
+#include <inttypes.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <utils/Log.h>
+
+#include <binder/ProcessState.h>
+#include <media/MediaCodecBuffer.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
+#include <media/stagefright/MediaCodec.h>
+#include <media/stagefright/MediaCodecList.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+#include <utils/Vector.h>
+#include <OMX_Audio.h>
+#include <OMX_IVCommon.h>
+
+static void usage(const char *me) {
+    fprintf(stderr, "usage: %s [-a] [-v] [-s <width>x<height>] [-b <video bitrate>]"
+                    " [-q <queue depth>] [-S] [-o <output file>]"
+                    " <input file>\n", me);
+    fprintf(stderr, "       -h help\n");
+    fprintf(stderr, "       -a transcode audio (to AAC)\n");
+    fprintf(stderr, "       -v transcode video (to AVC)\n");
+    fprintf(stderr, "       -s scale video to the given size\n");
+    fprintf(stderr, "       -b video bitrate in bits/sec. Default is 2000000\n");
+    fprintf(stderr, "       -q number of buffers queued between stages. Default is 4\n");
+    fprintf(stderr, "       -S prefer software codecs\n");
+    fprintf(stderr, "       -o output file name. Default is /sdcard/transcoded.mp4\n");
+
+    exit(1);
+}
+
+namespace android {
+
+static const int64_t kTimeoutUs = 10000ll;
+
+static const int32_t kDefaultVideoBitrate = 2000000;
+static const int32_t kAudioBitrate = 128000;
+static const int32_t kDefaultFrameRate = 30;
+
+// Buffers are passed between stages as ABuffers, with "timeUs", "flags"
+// (MediaCodec buffer flags) and "stream" in their meta. The first buffer
+// after a format change also carries the new format as "format". A buffer
+// with "eos" set ends a stream.
+static sp<ABuffer> MakeEOS() {
+    sp<ABuffer> buffer = new ABuffer(0);
+    buffer->meta()->setInt32("eos", true);
+    return buffer;
+}
+
+static bool IsEOS(const sp<ABuffer> &buffer) {
+    int32_t eos;
+    return buffer->meta()->findInt32("eos", &eos) && eos;
+}
+
+// Bounded queue connecting one stage to the next, so that a fast stage
+// cannot run arbitrarily far ahead of a slow one.
+struct StageQueue : public RefBase {
+    explicit StageQueue(size_t capacity)
+        : mCapacity(capacity) {
+    }
+
+    // Blocks while the queue is full, returns the time spent waiting.
+    int64_t push(const sp<ABuffer> &buffer) {
+        Mutex::Autolock autoLock(mLock);
+        int64_t waitUs = 0;
+        if (mBuffers.size() >= mCapacity) {
+            int64_t startUs = ALooper::GetNowUs();
+            while (mBuffers.size() >= mCapacity) {
+                mNotFullCondition.wait(mLock);
+            }
+            waitUs = ALooper::GetNowUs() - startUs;
+        }
+        mBuffers.push_back(buffer);
+        mNotEmptyCondition.signal();
+        return waitUs;
+    }
+
+    // Blocks while the queue is empty, returns the time spent waiting.
+    int64_t pop(sp<ABuffer> *buffer) {
+        Mutex::Autolock autoLock(mLock);
+        int64_t waitUs = 0;
+        if (mBuffers.empty()) {
+            int64_t startUs = ALooper::GetNowUs();
+            while (mBuffers.empty()) {
+                mNotEmptyCondition.wait(mLock);
+            }
+            waitUs = ALooper::GetNowUs() - startUs;
+        }
+        *buffer = *mBuffers.begin();
+        mBuffers.erase(mBuffers.begin());
+        mNotFullCondition.signal();
+        return waitUs;
+    }
+
+private:
+    const size_t mCapacity;
+    Mutex mLock;
+    Condition mNotEmptyCondition;
+    Condition mNotFullCondition;
+    List<sp<ABuffer> > mBuffers;
+
+    DISALLOW_EVIL_CONSTRUCTORS(StageQueue);
+};
+
+// One step of the pipeline, running on its own thread until all of its input
+// streams have ended. EOS is passed on to all outputs when the stage is done,
+// whether it succeeded or not; a failed stage keeps draining its input so
+// that the stages before it can finish.
+struct Stage : public Thread {
+    Stage(const char *name, const sp<StageQueue> &input, size_t numInputStreams = 1)
+        : Thread(false /* canCallJava */),
+          mName(name),
+          mInput(input),
+          mNumInputStreams(numInputStreams),
+          mNumInputEOS(0),
+          mNumItems(0),
+          mNumBytes(0),
+          mStarvedUs(0),
+          mBlockedUs(0),
+          mStartUs(0),
+          mEndUs(0),
+          mResult(OK) {
+    }
+
+    void addOutput(const sp<StageQueue> &output) {
+        mOutputs.push(output);
+    }
+
+    status_t start() {
+        return run(mName.c_str());
+    }
+
+    status_t result() const {
+        return mResult;
+    }
+
+    void report() const {
+        int64_t totalUs = mEndUs - mStartUs;
+        int64_t busyUs = totalUs - mStarvedUs - mBlockedUs;
+        printf("%-16s %7lld buffers %9.2f MB  busy %9.2f ms  starved %9.2f ms"
+               "  blocked %9.2f ms\n",
+               mName.c_str(),
+               (long long)mNumItems,
+               mNumBytes / 1E6,
+               busyUs / 1E3,
+               mStarvedUs / 1E3,
+               mBlockedUs / 1E3);
+    }
+
+protected:
+    // Returns the next input buffer, blocking until there is one.
+    sp<ABuffer> take() {
+        sp<ABuffer> buffer;
+        mStarvedUs += mInput->pop(&buffer);
+        if (IsEOS(buffer)) {
+            ++mNumInputEOS;
+        }
+        return buffer;
+    }
+
+    void give(const sp<ABuffer> &buffer) {
+        mBlockedUs += mOutputs[0]->push(buffer);
+        ++mNumItems;
+        mNumBytes += buffer->size();
+    }
+
+    bool inputDone() const {
+        return mNumInputEOS == mNumInputStreams;
+    }
+
+    virtual status_t process() = 0;
+
+    const AString mName;
+
+private:
+    sp<StageQueue> mInput;
+    Vector<sp<StageQueue> > mOutputs;
+    const size_t mNumInputStreams;
+    size_t mNumInputEOS;
+
+    int64_t mNumItems;
+    int64_t mNumBytes;
+    int64_t mStarvedUs;
+    int64_t mBlockedUs;
+    int64_t mStartUs;
+    int64_t mEndUs;
+    status_t mResult;
+
+    bool threadLoop() override {
+        mStartUs = ALooper::GetNowUs();
+        mResult = process();
+        if (mResult != OK) {
+            fprintf(stderr, "%s failed: %d\n", mName.c_str(), mResult);
+        }
+        for (size_t i = 0; i < mOutputs.size(); ++i) {
+            mBlockedUs += mOutputs[i]->push(MakeEOS());
+        }
+        while (mInput != NULL && !inputDone()) {
+            take();
+        }
+        mEndUs = ALooper::GetNowUs();
+        return false;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(Stage);
+};
+
+// Reads the samples of one track through its own read pointer, so that the
+// tracks are demuxed in parallel and none waits for the others.
+struct ExtractorStage : public Stage {
+    ExtractorStage(const char *name, const sp<NuMediaExtractor> &extractor,
+            size_t trackIndex)
+        : Stage(name, NULL /* input */),
+          mExtractor(extractor),
+          mTrackIndex(trackIndex) {
+    }
+
+protected:
+    status_t process() override {
+        for (;;) {
+            size_t sampleSize;
+            status_t err = mExtractor->getTrackSampleSize(mTrackIndex, &sampleSize);
+            if (err == ERROR_END_OF_STREAM) {
+                return OK;
+            } else if (err != OK) {
+                return err;
+            }
+
+            sp<ABuffer> buffer = new ABuffer(sampleSize);
+            err = mExtractor->readTrackSampleData(mTrackIndex, buffer);
+            if (err != OK) {
+                return err;
+            }
+
+            int64_t timeUs;
+            err = mExtractor->getTrackSampleTime(mTrackIndex, &timeUs);
+            if (err != OK) {
+                return err;
+            }
+            buffer->meta()->setInt64("timeUs", timeUs);
+            buffer->meta()->setInt32("flags", 0);
+
+            give(buffer);
+
+            mExtractor->advanceTrack(mTrackIndex);
+        }
+    }
+
+private:
+    sp<NuMediaExtractor> mExtractor;
+    const size_t mTrackIndex;
+
+    DISALLOW_EVIL_CONSTRUCTORS(ExtractorStage);
+};
+
+static sp<MediaCodec> createCodec(
+        const sp<ALooper> &looper, const AString &mime, bool encoder,
+        bool preferSoftware) {
+    if (!preferSoftware) {
+        return MediaCodec::CreateByType(looper, mime, encoder);
+    }
+
+    Vector<AString> matchingCodecs;
+    MediaCodecList::findMatchingCodecs(
+            mime.c_str(), encoder, MediaCodecList::kPreferSoftwareCodecs,
+            &matchingCodecs);
+    for (size_t i = 0; i < matchingCodecs.size(); ++i) {
+        sp<MediaCodec> codec =
+            MediaCodec::CreateByComponentName(looper, matchingCodecs[i]);
+        if (codec != NULL) {
+            return codec;
+        }
+    }
+    return NULL;
+}
+
+// Feeds its input into a decoder or encoder and passes the output on.
+// Decoders are configured up front from the track format, encoders on their
+// first input buffer, from the format the previous stage attached to it.
+struct CodecStage : public Stage {
+    CodecStage(const char *name, const sp<StageQueue> &input,
+            const sp<AMessage> &format, bool isEncoder, bool preferSoftware,
+            int32_t stream)
+        : Stage(name, input),
+          mFormat(format),
+          mIsEncoder(isEncoder),
+          mPreferSoftware(preferSoftware),
+          mStream(stream),
+          mPendingOffset(0),
+          mBytesPerSecond(0),
+          mSignalledInputEOS(false),
+          mSawOutputEOS(false),
+          mFormatChanged(false) {
+    }
+
+    status_t configure(const sp<AMessage> &inputFormat) {
+        sp<AMessage> format = mFormat->dup();
+        if (inputFormat != NULL) {
+            static const char *kInputKeys[] = {
+                "width", "height", "color-format", "stride", "slice-height",
+                "channel-count", "sample-rate",
+            };
+            for (size_t i = 0; i < ARRAY_SIZE(kInputKeys); ++i) {
+                int32_t value;
+                if (inputFormat->findInt32(kInputKeys[i], &value)) {
+                    format->setInt32(kInputKeys[i], value);
+                }
+            }
+        }
+
+        int32_t channelCount, sampleRate;
+        if (mIsEncoder
+                && format->findInt32("channel-count", &channelCount)
+                && format->findInt32("sample-rate", &sampleRate)) {
+            mBytesPerSecond = (int64_t)channelCount * sampleRate * sizeof(int16_t);
+        }
+
+        AString mime;
+        CHECK(format->findString("mime", &mime));
+
+        mLooper = new ALooper;
+        mLooper->setName(mName.c_str());
+        mLooper->start();
+
+        mCodec = createCodec(mLooper, mime, mIsEncoder, mPreferSoftware);
+        if (mCodec == NULL) {
+            fprintf(stderr, "unable to instantiate %s %s.\n",
+                    mime.c_str(), mIsEncoder ? "encoder" : "decoder");
+            return NAME_NOT_FOUND;
+        }
+
+        status_t err = mCodec->configure(
+                format, NULL /* surface */, NULL /* crypto */,
+                mIsEncoder ? MediaCodec::CONFIGURE_FLAG_ENCODE : 0);
+        if (err == OK) {
+            err = mCodec->start();
+        }
+        if (err == OK) {
+            err = mCodec->getOutputFormat(&mOutputFormat);
+            mFormatChanged = true;
+        }
+        return err;
+    }
+
+protected:
+    status_t process() override {
+        status_t err = OK;
+        while (err == OK && !mSawOutputEOS) {
+            if (!mSignalledInputEOS) {
+                err = feedInput();
+            }
+            if (err == OK && mCodec != NULL) {
+                err = drainOutput(mSignalledInputEOS ? kTimeoutUs : 0ll);
+            }
+        }
+
+        if (mCodec != NULL) {
+            mCodec->release();
+            mCodec.clear();
+            mLooper->stop();
+        }
+        return err;
+    }
+
+private:
+    sp<AMessage> mFormat;
+    const bool mIsEncoder;
+    const bool mPreferSoftware;
+    const int32_t mStream;
+
+    sp<ALooper> mLooper;
+    sp<MediaCodec> mCodec;
+
+    // Input that did not fit into one codec buffer (PCM only).
+    sp<ABuffer> mPending;
+    size_t mPendingOffset;
+    int64_t mBytesPerSecond;
+
+    bool mSignalledInputEOS;
+    bool mSawOutputEOS;
+
+    sp<AMessage> mOutputFormat;
+    bool mFormatChanged;
+
+    status_t feedInput() {
+        if (mPending == NULL) {
+            mPending = take();
+            mPendingOffset = 0;
+
+            if (mCodec == NULL) {
+                if (IsEOS(mPending)) {
+                    // never got any input
+                    mSignalledInputEOS = mSawOutputEOS = true;
+                    return OK;
+                }
+                sp<AMessage> inputFormat;
+                mPending->meta()->findMessage("format", &inputFormat);
+                status_t err = configure(inputFormat);
+                if (err != OK) {
+                    return err;
+                }
+            }
+        }
+
+        size_t index;
+        status_t err = mCodec->dequeueInputBuffer(&index, kTimeoutUs);
+        if (err == -EAGAIN) {
+            return OK;
+        } else if (err != OK) {
+            return err;
+        }
+
+        if (IsEOS(mPending)) {
+            mPending.clear();
+            mSignalledInputEOS = true;
+            return mCodec->queueInputBuffer(
+                    index, 0 /* offset */, 0 /* size */, 0ll /* timeUs */,
+                    MediaCodec::BUFFER_FLAG_EOS);
+        }
+
+        sp<MediaCodecBuffer> buffer;
+        err = mCodec->getInputBuffer(index, &buffer);
+        if (err != OK) {
+            return err;
+        }
+
+        size_t size = mPending->size() - mPendingOffset;
+        if (size > buffer->capacity()) {
+            if (mBytesPerSecond == 0) {
+                ALOGE("%s: %zu byte input does not fit into %zu byte buffer",
+                        mName.c_str(), size, buffer->capacity());
+                return ERROR_BUFFER_TOO_SMALL;
+            }
+            size = buffer->capacity();
+        }
+        memcpy(buffer->base(), mPending->data() + mPendingOffset, size);
+
+        int64_t timeUs;
+        int32_t flags;
+        CHECK(mPending->meta()->findInt64("timeUs", &timeUs));
+        CHECK(mPending->meta()->findInt32("flags", &flags));
+        if (mPendingOffset > 0) {
+            timeUs += mPendingOffset * 1000000ll / mBytesPerSecond;
+        }
+
+        mPendingOffset += size;
+        if (mPendingOffset == mPending->size()) {
+            mPending.clear();
+        }
+
+        return mCodec->queueInputBuffer(index, 0 /* offset */, size, timeUs,
+                flags & MediaCodec::BUFFER_FLAG_SYNCFRAME);
+    }
+
+    status_t drainOutput(int64_t timeoutUs) {
+        for (;;) {
+            size_t index;
+            size_t offset;
+            size_t size;
+            int64_t timeUs;
+            uint32_t flags;
+            status_t err = mCodec->dequeueOutputBuffer(
+                    &index, &offset, &size, &timeUs, &flags, timeoutUs);
+
+            if (err == -EAGAIN) {
+                return OK;
+            } else if (err == INFO_FORMAT_CHANGED) {
+                err = mCodec->getOutputFormat(&mOutputFormat);
+                if (err != OK) {
+                    return err;
+                }
+                ALOGV("%s: format changed to %s",
+                        mName.c_str(), mOutputFormat->debugString().c_str());
+                mFormatChanged = true;
+                continue;
+            } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
+                continue;
+            } else if (err != OK) {
+                return err;
+            }
+
+            sp<ABuffer> output;
+            if (size > 0 && !(flags & MediaCodec::BUFFER_FLAG_CODECCONFIG)) {
+                // the muxer takes codec specific data from the format
+                sp<MediaCodecBuffer> buffer;
+                err = mCodec->getOutputBuffer(index, &buffer);
+                if (err != OK) {
+                    return err;
+                }
+                output = new ABuffer(size);
+                memcpy(output->data(), buffer->base() + offset, size);
+            }
+
+            err = mCodec->releaseOutputBuffer(index);
+            if (err != OK) {
+                return err;
+            }
+
+            if (output != NULL) {
+                output->meta()->setInt64("timeUs", timeUs);
+                output->meta()->setInt32(
+                        "flags", flags & MediaCodec::BUFFER_FLAG_SYNCFRAME);
+                output->meta()->setInt32("stream", mStream);
+                if (mFormatChanged) {
+                    output->meta()->setMessage("format", mOutputFormat);
+                    mFormatChanged = false;
+                }
+                give(output);
+            }
+
+            if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                mSawOutputEOS = true;
+                return OK;
+            }
+
+            // only wait for the first one
+            timeoutUs = 0ll;
+        }
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(CodecStage);
+};
+
+// Crops decoded YUV 4:2:0 frames, planar or semi-planar, into tightly packed
+// planar frames for the encoder, scaling them (nearest neighbour) if a
+// different output size was requested.
+struct ConvertStage : public Stage {
+    ConvertStage(const sp<StageQueue> &input, int32_t width, int32_t height)
+        : Stage("video convert", input),
+          mRequestedWidth(width),
+          mRequestedHeight(height),
+          mSemiPlanar(false),
+          mStride(0),
+          mSliceHeight(0),
+          mCropLeft(0),
+          mCropTop(0),
+          mCropWidth(0),
+          mCropHeight(0),
+          mWidth(0),
+          mHeight(0) {
+    }
+
+protected:
+    status_t process() override {
+        for (;;) {
+            sp<ABuffer> buffer = take();
+            if (IsEOS(buffer)) {
+                return OK;
+            }
+
+            sp<AMessage> format;
+            if (buffer->meta()->findMessage("format", &format)) {
+                status_t err = setInputFormat(format);
+                if (err != OK) {
+                    return err;
+                }
+            }
+
+            if (mWidth == 0) {
+                ALOGE("no input format");
+                return ERROR_MALFORMED;
+            }
+
+            size_t inputSize = (size_t)mStride * mSliceHeight * 3 / 2;
+            if (buffer->size() < inputSize) {
+                ALOGE("%zu byte frame, expected %zu", buffer->size(), inputSize);
+                return ERROR_MALFORMED;
+            }
+
+            sp<ABuffer> output = new ABuffer((size_t)mWidth * mHeight * 3 / 2);
+            convert(buffer->data(), output->data());
+
+            int64_t timeUs;
+            int32_t flags;
+            CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+            CHECK(buffer->meta()->findInt32("flags", &flags));
+            output->meta()->setInt64("timeUs", timeUs);
+            output->meta()->setInt32("flags", flags);
+            if (mOutputFormat != NULL) {
+                output->meta()->setMessage("format", mOutputFormat);
+                mOutputFormat.clear();
+            }
+            give(output);
+        }
+    }
+
+private:
+    const int32_t mRequestedWidth;
+    const int32_t mRequestedHeight;
+
+    bool mSemiPlanar;
+    int32_t mStride;
+    int32_t mSliceHeight;
+    int32_t mCropLeft;
+    int32_t mCropTop;
+    int32_t mCropWidth;
+    int32_t mCropHeight;
+    int32_t mWidth;
+    int32_t mHeight;
+
+    // source column of each output luma and chroma sample
+    Vector<int32_t> mLumaColumns;
+    Vector<int32_t> mChromaColumns;
+
+    sp<AMessage> mOutputFormat;
+
+    status_t setInputFormat(const sp<AMessage> &format) {
+        int32_t width, height, colorFormat;
+        if (!format->findInt32("width", &width)
+                || !format->findInt32("height", &height)
+                || !format->findInt32("color-format", &colorFormat)) {
+            ALOGE("incomplete video format %s", format->debugString().c_str());
+            return ERROR_MALFORMED;
+        }
+
+        if (colorFormat == OMX_COLOR_FormatYUV420Planar) {
+            mSemiPlanar = false;
+        } else if (colorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
+            mSemiPlanar = true;
+        } else {
+            fprintf(stderr, "unsupported decoder color format 0x%x.\n", colorFormat);
+            return ERROR_UNSUPPORTED;
+        }
+
+        if (!format->findInt32("stride", &mStride)) {
+            mStride = width;
+        }
+        if (!format->findInt32("slice-height", &mSliceHeight)) {
+            mSliceHeight = height;
+        }
+
+        int32_t right, bottom;
+        if (format->findRect("crop", &mCropLeft, &mCropTop, &right, &bottom)) {
+            mCropWidth = right - mCropLeft + 1;
+            mCropHeight = bottom - mCropTop + 1;
+        } else {
+            mCropLeft = mCropTop = 0;
+            mCropWidth = width;
+            mCropHeight = height;
+        }
+        // keep chroma siting
+        mCropLeft &= ~1;
+        mCropTop &= ~1;
+
+        if (mCropLeft + mCropWidth > mStride || mCropTop + mCropHeight > mSliceHeight) {
+            ALOGE("crop rect outside of %dx%d frame", mStride, mSliceHeight);
+            return ERROR_MALFORMED;
+        }
+
+        int32_t outWidth = mRequestedWidth > 0 ? mRequestedWidth : mCropWidth;
+        int32_t outHeight = mRequestedHeight > 0 ? mRequestedHeight : mCropHeight;
+        outWidth &= ~1;
+        outHeight &= ~1;
+        if (outWidth <= 0 || outHeight <= 0) {
+            return ERROR_MALFORMED;
+        }
+
+        if (mOutputFormat == NULL && (outWidth != mWidth || outHeight != mHeight)) {
+            mOutputFormat = new AMessage;
+            mOutputFormat->setInt32("width", outWidth);
+            mOutputFormat->setInt32("height", outHeight);
+            mOutputFormat->setInt32("stride", outWidth);
+            mOutputFormat->setInt32("slice-height", outHeight);
+            mOutputFormat->setInt32("color-format", OMX_COLOR_FormatYUV420Planar);
+        }
+        mWidth = outWidth;
+        mHeight = outHeight;
+
+        mLumaColumns.clear();
+        for (int32_t x = 0; x < mWidth; ++x) {
+            mLumaColumns.push(mCropLeft + (int32_t)((int64_t)x * mCropWidth / mWidth));
+        }
+        mChromaColumns.clear();
+        for (int32_t x = 0; x < mWidth / 2; ++x) {
+            int32_t column = mCropLeft / 2
+                    + (int32_t)((int64_t)x * (mCropWidth / 2) / (mWidth / 2));
+            mChromaColumns.push(mSemiPlanar ? column * 2 : column);
+        }
+
+        ALOGV("converting %dx%d (crop %d,%d %dx%d) %s to %dx%d",
+                mStride, mSliceHeight, mCropLeft, mCropTop, mCropWidth, mCropHeight,
+                mSemiPlanar ? "semi-planar" : "planar", mWidth, mHeight);
+        return OK;
+    }
+
+    void convertPlane(
+            const uint8_t *src, size_t srcStride, int32_t srcTop, int32_t srcHeight,
+            const Vector<int32_t> &columns, bool sameWidth,
+            uint8_t *dst, int32_t dstWidth, int32_t dstHeight) {
+        for (int32_t y = 0; y < dstHeight; ++y) {
+            const uint8_t *srcRow = src
+                    + (srcTop + (int32_t)((int64_t)y * srcHeight / dstHeight)) * srcStride;
+            if (sameWidth) {
+                memcpy(dst, srcRow + columns[0], dstWidth);
+            } else {
+                for (int32_t x = 0; x < dstWidth; ++x) {
+                    dst[x] = srcRow[columns[x]];
+                }
+            }
+            dst += dstWidth;
+        }
+    }
+
+    void convert(const uint8_t *src, uint8_t *dst) {
+        const int32_t chromaWidth = mWidth / 2;
+        const int32_t chromaHeight = mHeight / 2;
+        const uint8_t *srcChroma = src + (size_t)mStride * mSliceHeight;
+        uint8_t *dstU = dst + (size_t)mWidth * mHeight;
+        uint8_t *dstV = dstU + (size_t)chromaWidth * chromaHeight;
+        const bool sameWidth = mWidth == mCropWidth;
+
+        convertPlane(src, mStride, mCropTop, mCropHeight, mLumaColumns, sameWidth,
+                dst, mWidth, mHeight);
+
+        if (!mSemiPlanar) {
+            const size_t srcChromaStride = mStride / 2;
+            const uint8_t *srcV =
+                srcChroma + srcChromaStride * (mSliceHeight / 2);
+            convertPlane(srcChroma, srcChromaStride, mCropTop / 2, mCropHeight / 2,
+                    mChromaColumns, sameWidth, dstU, chromaWidth, chromaHeight);
+            convertPlane(srcV, srcChromaStride, mCropTop / 2, mCropHeight / 2,
+                    mChromaColumns, sameWidth, dstV, chromaWidth, chromaHeight);
+            return;
+        }
+
+        for (int32_t y = 0; y < chromaHeight; ++y) {
+            const uint8_t *srcRow = srcChroma + (mCropTop / 2
+                    + (int32_t)((int64_t)y * (mCropHeight / 2) / chromaHeight)) * mStride;
+            for (int32_t x = 0; x < chromaWidth; ++x) {
+                const uint8_t *uv = srcRow + mChromaColumns[x];
+                dstU[x] = uv[0];
+                dstV[x] = uv[1];
+            }
+            dstU += chromaWidth;
+            dstV += chromaWidth;
+        }
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(ConvertStage);
+};
+
+// Collects the encoded streams into the output file. The muxer can only be
+// started once every stream has either produced its format or ended, so
+// samples arriving before that are held back.
+struct MuxerStage : public Stage {
+    MuxerStage(const sp<StageQueue> &input, size_t numStreams,
+            const sp<MediaMuxer> &muxer)
+        : Stage("muxer", input, numStreams),
+          mMuxer(muxer),
+          mStarted(false),
+          mMaxTimeUs(0) {
+        mTracks.insertAt(Track(), 0, numStreams);
+    }
+
+    int64_t durationUs() const {
+        return mMaxTimeUs;
+    }
+
+protected:
+    status_t process() override {
+        while (!inputDone()) {
+            sp<ABuffer> buffer = take();
+            if (IsEOS(buffer)) {
+                continue;
+            }
+
+            int32_t stream;
+            CHECK(buffer->meta()->findInt32("stream", &stream));
+            CHECK(stream >= 0 && (size_t)stream < mTracks.size());
+
+            sp<AMessage> format;
+            if (buffer->meta()->findMessage("format", &format)) {
+                if (mStarted || mTracks[stream].mIndex >= 0) {
+                    ALOGW("ignoring format change of stream %d", stream);
+                } else {
+                    ssize_t index = mMuxer->addTrack(format);
+                    if (index < 0) {
+                        return (status_t)index;
+                    }
+                    mTracks.editItemAt(stream).mIndex = index;
+                }
+            }
+
+            if (mTracks[stream].mIndex < 0) {
+                ALOGE("stream %d has no format", stream);
+                return ERROR_MALFORMED;
+            }
+
+            if (!mStarted) {
+                mPending.push_back(buffer);
+                if (!canStart()) {
+                    continue;
+                }
+                status_t err = startMuxer();
+                if (err != OK) {
+                    return err;
+                }
+                continue;
+            }
+
+            status_t err = write(buffer);
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        if (!mStarted && !mPending.empty()) {
+            status_t err = startMuxer();
+            if (err != OK) {
+                return err;
+            }
+        }
+        return mStarted ? mMuxer->stop() : OK;
+    }
+
+private:
+    struct Track {
+        Track() : mIndex(-1) {}
+        ssize_t mIndex;
+    };
+
+    sp<MediaMuxer> mMuxer;
+    Vector<Track> mTracks;
+    List<sp<ABuffer> > mPending;
+    bool mStarted;
+    int64_t mMaxTimeUs;
+
+    bool canStart() const {
+        // a stream that ends without any output holds the others back until
+        // the end, where whatever is pending gets written anyway
+        for (size_t i = 0; i < mTracks.size(); ++i) {
+            if (mTracks[i].mIndex < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    status_t startMuxer() {
+        status_t err = mMuxer->start();
+        if (err != OK) {
+            return err;
+        }
+        mStarted = true;
+        while (!mPending.empty()) {
+            err = write(*mPending.begin());
+            mPending.erase(mPending.begin());
+            if (err != OK) {
+                return err;
+            }
+        }
+        return OK;
+    }
+
+    status_t write(const sp<ABuffer> &buffer) {
+        int32_t stream;
+        int64_t timeUs;
+        int32_t flags;
+        CHECK(buffer->meta()->findInt32("stream", &stream));
+        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+        CHECK(buffer->meta()->findInt32("flags", &flags));
+        if (timeUs > mMaxTimeUs) {
+            mMaxTimeUs = timeUs;
+        }
+        // each buffer is written once, so the muxer can have it
+        return mMuxer->writeOwnedSampleData(
+                buffer, mTracks[stream].mIndex, timeUs, flags);
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(MuxerStage);
+};
+
+static int transcode(
+        const char *path,
+        bool useAudio,
+        bool useVideo,
+        int32_t width,
+        int32_t height,
+        int32_t videoBitrate,
+        size_t queueDepth,
+        bool preferSoftware,
+        const char *outputFileName) {
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    if (extractor->setDataSource(NULL /* httpService */, path) != OK) {
+        fprintf(stderr, "unable to instantiate extractor. %s\n", path);
+        return 1;
+    }
+
+    Vector<sp<Stage> > stages;
+
+    sp<StageQueue> muxerQueue = new StageQueue(queueDepth);
+    int32_t numStreams = 0;
+
+    bool haveAudio = false;
+    bool haveVideo = false;
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<AMessage> format;
+        status_t err = extractor->getTrackFormat(i, &format);
+        CHECK_EQ(err, (status_t)OK);
+
+        AString mime;
+        CHECK(format->findString("mime", &mime));
+
+        bool isAudio = !strncasecmp(mime.c_str(), "audio/", 6);
+        bool isVideo = !strncasecmp(mime.c_str(), "video/", 6);
+
+        if (useAudio && !haveAudio && isAudio) {
+            haveAudio = true;
+        } else if (useVideo && !haveVideo && isVideo) {
+            haveVideo = true;
+        } else {
+            continue;
+        }
+
+        ALOGV("selecting track %zu", i);
+
+        err = extractor->selectTrack(i);
+        CHECK_EQ(err, (status_t)OK);
+
+        sp<StageQueue> decoderQueue = new StageQueue(queueDepth);
+        sp<ExtractorStage> extractorStage = new ExtractorStage(
+                isVideo ? "video extractor" : "audio extractor", extractor, i);
+        extractorStage->addOutput(decoderQueue);
+        stages.push(extractorStage);
+
+        sp<CodecStage> decoder = new CodecStage(
+                isVideo ? "video decoder" : "audio decoder", decoderQueue, format,
+                false /* isEncoder */, preferSoftware, numStreams);
+        if (decoder->configure(NULL /* inputFormat */) != OK) {
+            fprintf(stderr, "unable to configure decoder for %s.\n", mime.c_str());
+            return 1;
+        }
+        stages.push(decoder);
+
+        sp<StageQueue> encoderQueue = new StageQueue(queueDepth);
+        sp<AMessage> encoderFormat = new AMessage;
+        if (isVideo) {
+            sp<StageQueue> convertQueue = new StageQueue(queueDepth);
+            decoder->addOutput(convertQueue);
+
+            sp<ConvertStage> convert = new ConvertStage(convertQueue, width, height);
+            convert->addOutput(encoderQueue);
+            stages.push(convert);
+
+            int32_t frameRate;
+            if (!format->findInt32("frame-rate", &frameRate) || frameRate <= 0) {
+                frameRate = kDefaultFrameRate;
+            }
+            encoderFormat->setString("mime", MEDIA_MIMETYPE_VIDEO_AVC);
+            encoderFormat->setInt32("bitrate", videoBitrate);
+            encoderFormat->setInt32("frame-rate", frameRate);
+            encoderFormat->setInt32("i-frame-interval", 1);
+        } else {
+            decoder->addOutput(encoderQueue);
+
+            encoderFormat->setString("mime", MEDIA_MIMETYPE_AUDIO_AAC);
+            encoderFormat->setInt32("bitrate", kAudioBitrate);
+            encoderFormat->setInt32("aac-profile", OMX_AUDIO_AACObjectLC);
+        }
+
+        sp<CodecStage> encoder = new CodecStage(
+                isVideo ? "video encoder" : "audio encoder", encoderQueue,
+                encoderFormat, true /* isEncoder */, preferSoftware, numStreams);
+        encoder->addOutput(muxerQueue);
+        stages.push(encoder);
+
+        ++numStreams;
+    }
+
+    if (numStreams == 0) {
+        fprintf(stderr, "no track to transcode.\n");
+        return 1;
+    }
+
+    int fd = open(outputFileName, O_CREAT | O_LARGEFILE | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        fprintf(stderr, "couldn't open file %s.\n", outputFileName);
+        return 1;
+    }
+
+    sp<MediaMuxer> muxer = new MediaMuxer(fd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    close(fd);
+
+    sp<MuxerStage> muxerStage = new MuxerStage(muxerQueue, numStreams, muxer);
+    stages.push(muxerStage);
+
+    int64_t startTimeUs = ALooper::GetNowUs();
+
+    // start from the end of the pipeline so nothing waits on a stage
+    // that is not running yet
+    for (size_t i = stages.size(); i-- > 0;) {
+        CHECK_EQ(stages[i]->start(), (status_t)OK);
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        stages[i]->join();
+        if (stages[i]->result() != OK) {
+            result = 1;
+        }
+    }
+
+    int64_t elapsedTimeUs = ALooper::GetNowUs() - startTimeUs;
+
+    for (size_t i = 0; i < stages.size(); ++i) {
+        stages[i]->report();
+    }
+
+    int64_t durationUs = muxerStage->durationUs();
+    printf("transcoded %.2f secs of media in %.2f secs, %.2fx realtime\n",
+           durationUs / 1E6, elapsedTimeUs / 1E6,
+           elapsedTimeUs > 0 ? (double)durationUs / elapsedTimeUs : 0.0);
+
+    return result;
+}
+
+}  // namespace android
+
+int main(int argc, char **argv) {
+    using namespace android;
+
+    const char *me = argv[0];
+
+    bool useAudio = false;
+    bool useVideo = false;
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t videoBitrate = kDefaultVideoBitrate;
+    size_t queueDepth = 4;
+    bool preferSoftware = false;
+    const char *outputFileName = "/sdcard/transcoded.mp4";
+
+    int res;
+    while ((res = getopt(argc, argv, "havs:b:q:So:")) >= 0) {
+        switch (res) {
+            case 'a':
+            {
+                useAudio = true;
+                break;
+            }
+            case 'v':
+            {
+                useVideo = true;
+                break;
+            }
+            case 's':
+            {
+                if (sscanf(optarg, "%dx%d", &width, &height) != 2
+                        || width <= 0 || height <= 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'b':
+            {
+                videoBitrate = atoi(optarg);
+                if (videoBitrate <= 0) {
+                    usage(me);
+                }
+                break;
+            }
+            case 'q':
+            {
+                int depth = atoi(optarg);
+                if (depth <= 0) {
+                    usage(me);
+                }
+                queueDepth = depth;
+                break;
+            }
+            case 'S':
+            {
+                preferSoftware = true;
+                break;
+            }
+            case 'o':
+            {
+                outputFileName = optarg;
+                break;
+            }
+            case '?':
+            case 'h':
+            default:
+            {
+                usage(me);
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    if (argc != 1) {
+        usage(me);
+    }
+
+    if (!useAudio && !useVideo) {
+        useAudio = useVideo = true;
+    }
+
+    ProcessState::self()->startThreadPool();
+
+    return transcode(argv[0], useAudio, useVideo, width, height, videoBitrate,
+            queueDepth, preferSoftware, outputFileName);
+}
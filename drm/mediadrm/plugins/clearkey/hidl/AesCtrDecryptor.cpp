@@ -34,45 +34,81 @@ using ::android::hardware::drm::V1_0::Status;
 
 static const size_t kBlockBitCount = kBlockSize * 8;
 
+bool AesCtrDecryptor::setKey(const std::vector<uint8_t>& key, AES_KEY* keySchedule) {
+    if (key.size() != kBlockSize || (sizeof(Iv) / sizeof(uint8_t)) != kBlockSize) {
+        return false;
+    }
+    AES_set_encrypt_key(key.data(), kBlockBitCount, keySchedule);
+    return true;
+}
+
 Status AesCtrDecryptor::decrypt(
         const std::vector<uint8_t>& key,
         const Iv iv, const uint8_t* source,
         uint8_t* destination,
-        const std::vector<SubSample> subSamples,
+        const std::vector<SubSample>& subSamples,
         size_t numSubSamples,
         size_t* bytesDecryptedOut) {
-    uint32_t blockOffset = 0;
-    uint8_t previousEncryptedCounter[kBlockSize];
-    memset(previousEncryptedCounter, 0, kBlockSize);
-
-    if (key.size() != kBlockSize || (sizeof(Iv) / sizeof(uint8_t)) != kBlockSize) {
+    AES_KEY opensslKey;
+    if (!setKey(key, &opensslKey)) {
         android_errorWriteLog(0x534e4554, "63982768");
         return Status::ERROR_DRM_DECRYPT;
     }
 
+    return decrypt(opensslKey, iv, source, destination, subSamples.data(),
+            numSubSamples, bytesDecryptedOut);
+}
+
+Status AesCtrDecryptor::decrypt(
+        const AES_KEY& keySchedule,
+        const Iv iv, const uint8_t* source,
+        uint8_t* destination,
+        const SubSample* subSamples,
+        size_t numSubSamples,
+        size_t* bytesDecryptedOut) {
+    uint32_t blockOffset = 0;
+    uint8_t previousEncryptedCounter[kBlockSize];
+    memset(previousEncryptedCounter, 0, kBlockSize);
+
     size_t offset = 0;
-    AES_KEY opensslKey;
-    AES_set_encrypt_key(key.data(), kBlockBitCount, &opensslKey);
     Iv opensslIv;
     memcpy(opensslIv, iv, sizeof(opensslIv));
 
+    // Encrypted data of consecutive subsamples without clear data in
+    // between is contiguous, and is decrypted in a single call so that
+    // BoringSSL can use its wide hardware AES (AES-NI/ARMv8 CE) CTR loop.
+    size_t encryptedOffset = 0;
+    size_t encryptedSize = 0;
     for (size_t i = 0; i < numSubSamples; ++i) {
         const SubSample& subSample = subSamples[i];
 
         if (subSample.numBytesOfClearData > 0) {
+            if (encryptedSize > 0) {
+                AES_ctr128_encrypt(source + encryptedOffset,
+                        destination + encryptedOffset, encryptedSize,
+                        &keySchedule, opensslIv, previousEncryptedCounter,
+                        &blockOffset);
+                encryptedSize = 0;
+            }
             memcpy(destination + offset, source + offset,
                     subSample.numBytesOfClearData);
             offset += subSample.numBytesOfClearData;
         }
 
         if (subSample.numBytesOfEncryptedData > 0) {
-            AES_ctr128_encrypt(source + offset, destination + offset,
-                    subSample.numBytesOfEncryptedData, &opensslKey,
-                    opensslIv, previousEncryptedCounter,
-                    &blockOffset);
+            if (encryptedSize == 0) {
+                encryptedOffset = offset;
+            }
+            encryptedSize += subSample.numBytesOfEncryptedData;
             offset += subSample.numBytesOfEncryptedData;
         }
     }
+    if (encryptedSize > 0) {
+        AES_ctr128_encrypt(source + encryptedOffset,
+                destination + encryptedOffset, encryptedSize,
+                &keySchedule, opensslIv, previousEncryptedCounter,
+                &blockOffset);
+    }
 
     *bytesDecryptedOut = offset;
     return Status::OK;
@@ -149,7 +149,8 @@ Return<void> CryptoPlugin::decrypt(
     } else if (mode == Mode::AES_CTR) {
         size_t bytesDecrypted;
         Status res = mSession->decrypt(keyId.data(), iv.data(), srcPtr,
-                static_cast<uint8_t*>(destPtr), toVector(subSamples), &bytesDecrypted);
+                static_cast<uint8_t*>(destPtr), subSamples.data(), subSamples.size(),
+                &bytesDecrypted);
         if (res == Status::OK) {
             _hidl_cb(Status::OK, static_cast<ssize_t>(bytesDecrypted), "");
             return Void();
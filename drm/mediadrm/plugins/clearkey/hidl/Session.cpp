@@ -58,8 +58,12 @@ Status Session::provideKeyResponse(const std::vector<uint8_t>& response) {
         for (auto &key : keys) {
             std::string first(key.first.begin(), key.first.end());
             std::string second(key.second.begin(), key.second.end());
-            mKeyMap.insert(std::pair<std::vector<uint8_t>,
-                    std::vector<uint8_t> >(key.first, key.second));
+            bool inserted = mKeyMap.insert(std::pair<std::vector<uint8_t>,
+                    std::vector<uint8_t> >(key.first, key.second)).second;
+            AES_KEY keySchedule;
+            if (inserted && AesCtrDecryptor::setKey(key.second, &keySchedule)) {
+                mKeySchedules[key.first] = keySchedule;
+            }
         }
         return Status::OK;
     } else {
@@ -69,23 +73,30 @@ Status Session::provideKeyResponse(const std::vector<uint8_t>& response) {
 
 Status Session::decrypt(
         const KeyId keyId, const Iv iv, const uint8_t* srcPtr,
-        uint8_t* destPtr, const std::vector<SubSample> subSamples,
-        size_t* bytesDecryptedOut) {
+        uint8_t* destPtr, const SubSample* subSamples,
+        size_t numSubSamples, size_t* bytesDecryptedOut) {
     Mutex::Autolock lock(mMapLock);
 
-    std::vector<uint8_t> keyIdVector;
-    keyIdVector.clear();
-    keyIdVector.insert(keyIdVector.end(), keyId, keyId + kBlockSize);
+    std::vector<uint8_t> keyIdVector(keyId, keyId + kBlockSize);
+    AesCtrDecryptor decryptor;
+    auto schedule = mKeySchedules.find(keyIdVector);
+    if (schedule != mKeySchedules.end()) {
+        return decryptor.decrypt(
+                schedule->second, iv, srcPtr, destPtr, subSamples,
+                numSubSamples, bytesDecryptedOut);
+    }
+
+    // no schedule, either there is no such key or it is malformed
     std::map<std::vector<uint8_t>, std::vector<uint8_t> >::iterator itr;
     itr = mKeyMap.find(keyIdVector);
     if (itr == mKeyMap.end()) {
         return Status::ERROR_DRM_NO_LICENSE;
     }
 
-    AesCtrDecryptor decryptor;
     return decryptor.decrypt(
-            itr->second /*key*/, iv, srcPtr, destPtr, subSamples,
-            subSamples.size(), bytesDecryptedOut);
+            itr->second /*key*/, iv, srcPtr, destPtr,
+            std::vector<SubSample>(subSamples, subSamples + numSubSamples),
+            numSubSamples, bytesDecryptedOut);
 }
 
 } // namespace clearkey
@@ -17,6 +17,8 @@
 #ifndef CLEARKEY_AES_CTR_DECRYPTOR_H_
 #define CLEARKEY_AES_CTR_DECRYPTOR_H_
 
+#include <openssl/aes.h>
+
 #include "ClearKeyTypes.h"
 
 namespace android {
@@ -34,9 +36,19 @@ public:
 
     Status decrypt(const std::vector<uint8_t>& key, const Iv iv,
             const uint8_t* source, uint8_t* destination,
-            const std::vector<SubSample> subSamples, size_t numSubSamples,
+            const std::vector<SubSample>& subSamples, size_t numSubSamples,
             size_t* bytesDecryptedOut);
 
+    // Same as above with a key schedule expanded by setKey(), so that it
+    // can be reused across decrypt calls.
+    Status decrypt(const AES_KEY& keySchedule, const Iv iv,
+            const uint8_t* source, uint8_t* destination,
+            const SubSample* subSamples, size_t numSubSamples,
+            size_t* bytesDecryptedOut);
+
+    // Expands key into keySchedule. Returns false if key has the wrong size.
+    static bool setKey(const std::vector<uint8_t>& key, AES_KEY* keySchedule);
+
 private:
     CLEARKEY_DISALLOW_COPY_AND_ASSIGN(AesCtrDecryptor);
 };
@@ -17,6 +17,7 @@
 #ifndef CLEARKEY_SESSION_H_
 #define CLEARKEY_SESSION_H_
 
+#include <openssl/aes.h>
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 #include <vector>
@@ -51,14 +52,16 @@ public:
 
     Status decrypt(
             const KeyId keyId, const Iv iv, const uint8_t* srcPtr,
-            uint8_t* dstPtr, const std::vector<SubSample> subSamples,
-            size_t* bytesDecryptedOut);
+            uint8_t* dstPtr, const SubSample* subSamples,
+            size_t numSubSamples, size_t* bytesDecryptedOut);
 
 private:
     CLEARKEY_DISALLOW_COPY_AND_ASSIGN(Session);
 
     const std::vector<uint8_t> mSessionId;
     KeyMap mKeyMap;
+    // expanded AES key schedules of the valid keys in mKeyMap
+    std::map<std::vector<uint8_t>, AES_KEY> mKeySchedules;
     Mutex mMapLock;
 };
 
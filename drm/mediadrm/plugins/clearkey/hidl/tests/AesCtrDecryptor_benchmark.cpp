@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// AES-CTR decrypt throughput of one 1 MiB sample. The argument is the number
+// of subsamples the sample is split into; bytes/s is reported as MB/s.
+
+#include <string.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "AesCtrDecryptor.h"
+
+namespace android {
+namespace hardware {
+namespace drm {
+namespace V1_1 {
+namespace clearkey {
+
+static const size_t kSampleSize = 1 << 20;
+// Clear header in front of each subsample, as for CENC video slices.
+static const uint32_t kClearBytes = 16;
+
+static std::vector<SubSample> makeSubSamples(size_t count, uint32_t clearBytes) {
+    std::vector<SubSample> subSamples(count);
+    const uint32_t subSampleSize = kSampleSize / count;
+    for (SubSample& subSample : subSamples) {
+        subSample.numBytesOfClearData = clearBytes;
+        subSample.numBytesOfEncryptedData = subSampleSize - clearBytes;
+    }
+    return subSamples;
+}
+
+static void runDecrypt(benchmark::State& state, uint32_t clearBytes, bool reuseKey) {
+    const std::vector<uint8_t> key(kBlockSize, 0x2a);
+    Iv iv;
+    memset(iv, 0x17, sizeof(iv));
+    const std::vector<SubSample> subSamples = makeSubSamples(state.range(0), clearBytes);
+    std::vector<uint8_t> source(kSampleSize, 0x5c);
+    std::vector<uint8_t> destination(kSampleSize);
+
+    AES_KEY keySchedule;
+    AesCtrDecryptor::setKey(key, &keySchedule);
+    AesCtrDecryptor decryptor;
+    size_t bytesDecrypted = 0;
+    while (state.KeepRunning()) {
+        Status status = reuseKey
+                ? decryptor.decrypt(keySchedule, iv, source.data(), destination.data(),
+                        subSamples.data(), subSamples.size(), &bytesDecrypted)
+                : decryptor.decrypt(key, iv, source.data(), destination.data(),
+                        subSamples, subSamples.size(), &bytesDecrypted);
+        if (status != Status::OK) {
+            state.SkipWithError("decrypt failed");
+            break;
+        }
+        benchmark::DoNotOptimize(destination.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * bytesDecrypted);
+}
+
+// Fully encrypted subsamples, decrypted with one call per sample.
+static void BM_DecryptContiguous(benchmark::State& state) {
+    runDecrypt(state, 0 /* clearBytes */, true /* reuseKey */);
+}
+BENCHMARK(BM_DecryptContiguous)->Arg(1)->Arg(64)->Arg(1024);
+
+// A clear header in each subsample splits the encrypted data into one
+// call per subsample.
+static void BM_DecryptWithClearHeaders(benchmark::State& state) {
+    runDecrypt(state, kClearBytes, true /* reuseKey */);
+}
+BENCHMARK(BM_DecryptWithClearHeaders)->Arg(1)->Arg(64)->Arg(1024);
+
+// As above, through the overload that expands the key on each call.
+static void BM_DecryptWithClearHeadersExpandKey(benchmark::State& state) {
+    runDecrypt(state, kClearBytes, false /* reuseKey */);
+}
+BENCHMARK(BM_DecryptWithClearHeadersExpandKey)->Arg(1)->Arg(64)->Arg(1024);
+
+} // namespace clearkey
+} // namespace V1_1
+} // namespace drm
+} // namespace hardware
+} // namespace android
+
+BENCHMARK_MAIN();
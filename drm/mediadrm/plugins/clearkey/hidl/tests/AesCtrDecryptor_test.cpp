@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AesCtrDecryptor.h"
+
+namespace android {
+namespace hardware {
+namespace drm {
+namespace V1_1 {
+namespace clearkey {
+
+// Decrypts one subsample at a time, carrying the counter and the offset in the
+// current key stream block across subsamples, as decrypt() did before it
+// merged contiguous encrypted ranges.
+static size_t decryptPerSubSample(const std::vector<uint8_t>& key, const Iv iv,
+        const uint8_t* source, uint8_t* destination,
+        const std::vector<SubSample>& subSamples) {
+    AES_KEY keySchedule;
+    AES_set_encrypt_key(key.data(), kBlockSize * 8, &keySchedule);
+    uint32_t blockOffset = 0;
+    uint8_t previousEncryptedCounter[kBlockSize];
+    memset(previousEncryptedCounter, 0, kBlockSize);
+    Iv counter;
+    memcpy(counter, iv, sizeof(counter));
+
+    size_t offset = 0;
+    for (const SubSample& subSample : subSamples) {
+        if (subSample.numBytesOfClearData > 0) {
+            memcpy(destination + offset, source + offset, subSample.numBytesOfClearData);
+            offset += subSample.numBytesOfClearData;
+        }
+        if (subSample.numBytesOfEncryptedData > 0) {
+            AES_ctr128_encrypt(source + offset, destination + offset,
+                    subSample.numBytesOfEncryptedData, &keySchedule, counter,
+                    previousEncryptedCounter, &blockOffset);
+            offset += subSample.numBytesOfEncryptedData;
+        }
+    }
+    return offset;
+}
+
+class AesCtrDecryptorTest : public ::testing::Test {
+protected:
+    AesCtrDecryptorTest() : mKey(kBlockSize) {
+        for (size_t i = 0; i < mKey.size(); ++i) {
+            mKey[i] = 0x10 + i * 7;
+        }
+        for (size_t i = 0; i < kBlockSize; ++i) {
+            // the low bytes wrap during the sample, so the carry is covered too
+            mIv[i] = i < kBlockSize - 1 ? 0xa0 + i : 0xfd;
+        }
+    }
+
+    // Checks that decrypt() gives the same bytes as per-subsample decryption.
+    void expectSameAsPerSubSample(const std::vector<SubSample>& subSamples) {
+        size_t size = 0;
+        for (const SubSample& subSample : subSamples) {
+            size += subSample.numBytesOfClearData + subSample.numBytesOfEncryptedData;
+        }
+        std::vector<uint8_t> source(size);
+        for (size_t i = 0; i < size; ++i) {
+            source[i] = i * 31 + 5;
+        }
+
+        std::vector<uint8_t> expected(size);
+        EXPECT_EQ(size, decryptPerSubSample(mKey, mIv, source.data(), expected.data(),
+                subSamples));
+
+        AesCtrDecryptor decryptor;
+        std::vector<uint8_t> actual(size);
+        size_t bytesDecrypted = 0;
+        ASSERT_EQ(Status::OK, decryptor.decrypt(mKey, mIv, source.data(), actual.data(),
+                subSamples, subSamples.size(), &bytesDecrypted));
+        EXPECT_EQ(size, bytesDecrypted);
+        EXPECT_EQ(expected, actual);
+
+        AES_KEY keySchedule;
+        ASSERT_TRUE(AesCtrDecryptor::setKey(mKey, &keySchedule));
+        std::vector<uint8_t> reused(size);
+        ASSERT_EQ(Status::OK, decryptor.decrypt(keySchedule, mIv, source.data(),
+                reused.data(), subSamples.data(), subSamples.size(), &bytesDecrypted));
+        EXPECT_EQ(size, bytesDecrypted);
+        EXPECT_EQ(expected, reused);
+    }
+
+    std::vector<uint8_t> mKey;
+    Iv mIv;
+};
+
+// Encrypted sizes that are not multiples of the block size, with and without clear
+// data in between, so that the partial block offset carries across subsamples both
+// inside one merged range and from one merged range to the next.
+TEST_F(AesCtrDecryptorTest, UnalignedSubSamplesMatchPerSubSample) {
+    expectSameAsPerSubSample({
+        {5, 7},
+        {0, 13},
+        {0, 1},
+        {3, 20},
+        {0, 0},
+        {17, 33},
+        {0, 16},
+        {2, 0},
+        {0, 9},
+        {1, 4095},
+        {0, 17},
+    });
+}
+
+// Only encrypted data: everything is decrypted in one call.
+TEST_F(AesCtrDecryptorTest, EncryptedOnlySubSamplesMatchPerSubSample) {
+    expectSameAsPerSubSample({
+        {0, 3},
+        {0, 29},
+        {0, 100},
+        {0, 1},
+        {0, 64},
+    });
+}
+
+// Clear data in front of every subsample: one call per subsample, as before.
+TEST_F(AesCtrDecryptorTest, ClearHeadersMatchPerSubSample) {
+    expectSameAsPerSubSample({
+        {16, 15},
+        {1, 17},
+        {40, 1},
+        {7, 250},
+        {3, 0},
+    });
+}
+
+// The merged ranges still produce the CENC key stream: the encrypted bytes of all
+// subsamples decrypted as one buffer.
+TEST_F(AesCtrDecryptorTest, MatchesContiguousKeyStream) {
+    const std::vector<SubSample> subSamples = {{4, 11}, {0, 6}, {9, 37}, {0, 2}, {12, 21}};
+    size_t size = 0;
+    std::vector<uint8_t> encryptedOnly;
+    std::vector<uint8_t> source;
+    for (const SubSample& subSample : subSamples) {
+        for (uint32_t i = 0; i < subSample.numBytesOfClearData; ++i) {
+            source.push_back(0xc0 + i);
+        }
+        for (uint32_t i = 0; i < subSample.numBytesOfEncryptedData; ++i) {
+            source.push_back(size + i);
+            encryptedOnly.push_back(size + i);
+        }
+        size += subSample.numBytesOfClearData + subSample.numBytesOfEncryptedData;
+    }
+
+    AES_KEY keySchedule;
+    ASSERT_TRUE(AesCtrDecryptor::setKey(mKey, &keySchedule));
+    std::vector<uint8_t> keyStreamed(encryptedOnly.size());
+    uint32_t blockOffset = 0;
+    uint8_t previousEncryptedCounter[kBlockSize] = {};
+    Iv counter;
+    memcpy(counter, mIv, sizeof(counter));
+    AES_ctr128_encrypt(encryptedOnly.data(), keyStreamed.data(), encryptedOnly.size(),
+            &keySchedule, counter, previousEncryptedCounter, &blockOffset);
+
+    AesCtrDecryptor decryptor;
+    std::vector<uint8_t> actual(size);
+    size_t bytesDecrypted = 0;
+    ASSERT_EQ(Status::OK, decryptor.decrypt(keySchedule, mIv, source.data(), actual.data(),
+            subSamples.data(), subSamples.size(), &bytesDecrypted));
+    ASSERT_EQ(size, bytesDecrypted);
+
+    size_t offset = 0;
+    size_t encryptedOffset = 0;
+    for (const SubSample& subSample : subSamples) {
+        EXPECT_EQ(0, memcmp(&source[offset], &actual[offset], subSample.numBytesOfClearData));
+        offset += subSample.numBytesOfClearData;
+        EXPECT_EQ(0, memcmp(&keyStreamed[encryptedOffset], &actual[offset],
+                subSample.numBytesOfEncryptedData));
+        offset += subSample.numBytesOfEncryptedData;
+        encryptedOffset += subSample.numBytesOfEncryptedData;
+    }
+}
+
+} // namespace clearkey
+} // namespace V1_1
+} // namespace drm
+} // namespace hardware
+} // namespace android
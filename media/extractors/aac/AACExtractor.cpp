@@ -19,6 +19,7 @@
 #include <utils/Log.h>
 
 #include "AACExtractor.h"
+#include "ADTSFrameIndex.h"
 #include <media/DataSourceBase.h>
 #include <media/MediaTrack.h>
 #include <media/stagefright/foundation/ABuffer.h>
@@ -36,9 +37,8 @@ namespace android {
 class AACSource : public MediaTrack {
 public:
     AACSource(
-            DataSourceBase *source,
             MetaDataBase &meta,
-            const Vector<uint64_t> &offset_vector,
+            const sp<ADTSFrameIndex> &frame_index,
             int64_t frame_duration_us);
 
     virtual status_t start(MetaDataBase *params = NULL);
@@ -54,15 +54,16 @@ protected:
 
 private:
     static const size_t kMaxFrameSize;
-    DataSourceBase *mDataSource;
     MetaDataBase mMeta;
 
     off64_t mOffset;
+    uint64_t mCurrentFrame;
     int64_t mCurrentTimeUs;
     bool mStarted;
     MediaBufferGroup *mGroup;
 
-    Vector<uint64_t> mOffsetVector;
+    // also reads the stream, see ADTSFrameIndex
+    sp<ADTSFrameIndex> mFrameIndex;
     int64_t mFrameDurationUs;
 
     AACSource(const AACSource &);
@@ -87,50 +88,8 @@ uint32_t get_sample_rate(const uint8_t sf_index)
     return 0;
 }
 
-// Returns the frame length in bytes as described in an ADTS header starting at the given offset,
-//     or 0 if the size can't be read due to an error in the header or a read failure.
-// The returned value is the AAC frame size with the ADTS header length (regardless of
-//     the presence of the CRC).
-// If headerSize is non-NULL, it will be used to return the size of the header of this ADTS frame.
-static size_t getAdtsFrameLength(DataSourceBase *source, off64_t offset, size_t* headerSize) {
-
-    const size_t kAdtsHeaderLengthNoCrc = 7;
-    const size_t kAdtsHeaderLengthWithCrc = 9;
-
-    size_t frameSize = 0;
-
-    uint8_t syncword[2];
-    if (source->readAt(offset, &syncword, 2) != 2) {
-        return 0;
-    }
-    if ((syncword[0] != 0xff) || ((syncword[1] & 0xf6) != 0xf0)) {
-        return 0;
-    }
-
-    uint8_t protectionAbsent;
-    if (source->readAt(offset + 1, &protectionAbsent, 1) < 1) {
-        return 0;
-    }
-    protectionAbsent &= 0x1;
-
-    uint8_t header[3];
-    if (source->readAt(offset + 3, &header, 3) < 3) {
-        return 0;
-    }
-
-    frameSize = (header[0] & 0x3) << 11 | header[1] << 3 | header[2] >> 5;
-
-    // protectionAbsent is 0 if there is CRC
-    size_t headSize = protectionAbsent ? kAdtsHeaderLengthNoCrc : kAdtsHeaderLengthWithCrc;
-    if (headSize > frameSize) {
-        return 0;
-    }
-    if (headerSize != NULL) {
-        *headerSize = headSize;
-    }
-
-    return frameSize;
-}
+// About six seconds at 44.1 kHz; enough to estimate the bitrate.
+static const uint64_t kDurationSampleFrames = 256;
 
 AACExtractor::AACExtractor(
         DataSourceBase *source, off64_t offset)
@@ -153,34 +112,30 @@ AACExtractor::AACExtractor(
 
     MakeAACCodecSpecificData(mMeta, profile, sf_index, channel);
 
-    off64_t streamSize, numFrames = 0;
-    size_t frameSize = 0;
-    int64_t duration = 0;
-
-    if (mDataSource->getSize(&streamSize) == OK) {
-         while (offset < streamSize) {
-            if ((frameSize = getAdtsFrameLength(source, offset, NULL)) == 0) {
-                ALOGW("prematured AAC stream (%lld vs %lld)",
-                        (long long)offset, (long long)streamSize);
-                break;
-            }
-
-            mOffsetVector.push(offset);
-
-            offset += frameSize;
-            numFrames ++;
-        }
-
-        // Round up and get the duration
-        mFrameDurationUs = (1024 * 1000000ll + (sr - 1)) / sr;
-        duration = numFrames * mFrameDurationUs;
-        mMeta.setInt64(kKeyDuration, duration);
+    // Round up and get the duration
+    mFrameDurationUs = (1024 * 1000000ll + (sr - 1)) / sr;
+
+    // Only the first few seconds are indexed up front, to estimate the duration.
+    // The rest is indexed as the stream is read or sought, and in the background
+    // for local files, where that does not cost a download.
+    mFrameIndex = new ADTSFrameIndex(mDataSource, offset);
+    mFrameIndex->sample(kDurationSampleFrames);
+    bool exact;
+    uint64_t numFrames = mFrameIndex->countFrames(&exact);
+    if (numFrames > 0) {
+        mMeta.setInt64(kKeyDuration, numFrames * mFrameDurationUs);
+    }
+    if (!exact && (mDataSource->flags() & DataSourceBase::kIsLocalFileSource)) {
+        mFrameIndex->startBackgroundScan();
     }
 
     mInitCheck = OK;
 }
 
 AACExtractor::~AACExtractor() {
+    if (mFrameIndex != NULL) {
+        mFrameIndex->stopBackgroundScan();
+    }
 }
 
 status_t AACExtractor::getMetaData(MetaDataBase &meta) {
@@ -201,7 +156,7 @@ MediaTrack *AACExtractor::getTrack(size_t index) {
         return NULL;
     }
 
-    return new AACSource(mDataSource, mMeta, mOffsetVector, mFrameDurationUs);
+    return new AACSource(mMeta, mFrameIndex, mFrameDurationUs);
 }
 
 status_t AACExtractor::getTrackMetaData(MetaDataBase &meta, size_t index, uint32_t /* flags */) {
@@ -209,6 +164,13 @@ status_t AACExtractor::getTrackMetaData(MetaDataBase &meta, size_t index, uint32
         return UNKNOWN_ERROR;
     }
 
+    // replace the estimate once the whole stream has been indexed
+    bool exact;
+    uint64_t numFrames = mFrameIndex->countFrames(&exact);
+    if (exact) {
+        mMeta.setInt64(kKeyDuration, numFrames * mFrameDurationUs);
+    }
+
     meta = mMeta;
     return OK;
 }
@@ -219,17 +181,16 @@ status_t AACExtractor::getTrackMetaData(MetaDataBase &meta, size_t index, uint32
 const size_t AACSource::kMaxFrameSize = 8192;
 
 AACSource::AACSource(
-        DataSourceBase *source,
         MetaDataBase &meta,
-        const Vector<uint64_t> &offset_vector,
+        const sp<ADTSFrameIndex> &frame_index,
         int64_t frame_duration_us)
-    : mDataSource(source),
-      mMeta(meta),
+    : mMeta(meta),
       mOffset(0),
+      mCurrentFrame(0),
       mCurrentTimeUs(0),
       mStarted(false),
       mGroup(NULL),
-      mOffsetVector(offset_vector),
+      mFrameIndex(frame_index),
       mFrameDurationUs(frame_duration_us) {
 }
 
@@ -242,12 +203,8 @@ AACSource::~AACSource() {
 status_t AACSource::start(MetaDataBase * /* params */) {
     CHECK(!mStarted);
 
-    if (mOffsetVector.empty()) {
-        mOffset = 0;
-    } else {
-        mOffset = mOffsetVector.itemAt(0);
-    }
-
+    mOffset = mFrameIndex->firstFrameOffset();
+    mCurrentFrame = 0;
     mCurrentTimeUs = 0;
     mGroup = new MediaBufferGroup;
     mGroup->add_buffer(MediaBufferBase::Create(kMaxFrameSize));
@@ -280,18 +237,28 @@ status_t AACSource::read(
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
         if (mFrameDurationUs > 0) {
             int64_t seekFrame = seekTimeUs / mFrameDurationUs;
-            if (seekFrame < 0 || seekFrame >= (int64_t)mOffsetVector.size()) {
+            off64_t seekOffset;
+            if (seekFrame < 0) {
                 android_errorWriteLog(0x534e4554, "70239507");
                 return ERROR_MALFORMED;
             }
+            if (!mFrameIndex->getFrameOffset(seekFrame, &seekOffset)) {
+                // The duration may have been an estimate; past the end is the end.
+                uint64_t numFrames;
+                mFrameIndex->getStreamEnd(&numFrames, &mOffset);
+                mCurrentFrame = numFrames;
+                mCurrentTimeUs = numFrames * mFrameDurationUs;
+                return ERROR_END_OF_STREAM;
+            }
+            mCurrentFrame = seekFrame;
             mCurrentTimeUs = seekFrame * mFrameDurationUs;
 
-            mOffset = mOffsetVector.itemAt(seekFrame);
+            mOffset = seekOffset;
         }
     }
 
     size_t frameSize, frameSizeWithoutHeader, headerSize;
-    if ((frameSize = getAdtsFrameLength(mDataSource, mOffset, &headerSize)) == 0) {
+    if ((frameSize = mFrameIndex->getFrameLength(mOffset, &headerSize)) == 0) {
         return ERROR_END_OF_STREAM;
     }
 
@@ -302,7 +269,7 @@ status_t AACSource::read(
     }
 
     frameSizeWithoutHeader = frameSize - headerSize;
-    if (mDataSource->readAt(mOffset + headerSize, buffer->data(),
+    if (mFrameIndex->readAt(mOffset + headerSize, buffer->data(),
                 frameSizeWithoutHeader) != (ssize_t)frameSizeWithoutHeader) {
         buffer->release();
         buffer = NULL;
@@ -314,7 +281,9 @@ status_t AACSource::read(
     buffer->meta_data().setInt64(kKeyTime, mCurrentTimeUs);
     buffer->meta_data().setInt32(kKeyIsSyncFrame, 1);
 
+    mFrameIndex->onFrameRead(mCurrentFrame, mOffset, frameSize);
     mOffset += frameSize;
+    mCurrentFrame++;
     mCurrentTimeUs += mFrameDurationUs;
 
     *out = buffer;
@@ -21,10 +21,9 @@
 #include <media/MediaExtractor.h>
 #include <media/stagefright/MetaDataBase.h>
 
-#include <utils/Vector.h>
-
 namespace android {
 
+class ADTSFrameIndex;
 struct AMessage;
 class String8;
 
@@ -47,7 +46,7 @@ private:
     MetaDataBase mMeta;
     status_t mInitCheck;
 
-    Vector<uint64_t> mOffsetVector;
+    sp<ADTSFrameIndex> mFrameIndex;
     int64_t mFrameDurationUs;
 
     AACExtractor(const AACExtractor &);
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ADTSFrameIndex"
+#include <utils/Log.h>
+
+#include "ADTSFrameIndex.h"
+
+#include <sched.h>
+
+#include <media/DataSourceBase.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+ADTSFrameIndex::ADTSFrameIndex(DataSourceBase *source, off64_t firstFrameOffset)
+    : mDataSource(source),
+      mFirstFrameOffset(firstFrameOffset),
+      mStreamSize(-1),
+      mScannedFrames(0),
+      mNextOffset(firstFrameOffset),
+      mScanComplete(false),
+      mLastCheckpointOffset(firstFrameOffset),
+      mThreadStarted(false),
+      mStopThread(false) {
+    off64_t streamSize;
+    if (mDataSource->getSize(&streamSize) == OK) {
+        mStreamSize = streamSize;
+    }
+}
+
+ADTSFrameIndex::~ADTSFrameIndex() {
+    stopBackgroundScan();
+}
+
+// static
+size_t ADTSFrameIndex::GetFrameLength(
+        DataSourceBase *source, off64_t offset, size_t *headerSize) {
+
+    const size_t kAdtsHeaderLengthNoCrc = 7;
+    const size_t kAdtsHeaderLengthWithCrc = 9;
+
+    // syncword, protection_absent and frame_length are all in the first 6 bytes
+    uint8_t header[6];
+    if (source->readAt(offset, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        return 0;
+    }
+    if ((header[0] != 0xff) || ((header[1] & 0xf6) != 0xf0)) {
+        return 0;
+    }
+
+    // protectionAbsent is 0 if there is CRC
+    const bool protectionAbsent = header[1] & 0x1;
+
+    size_t frameSize = (header[3] & 0x3) << 11 | header[4] << 3 | header[5] >> 5;
+
+    size_t headSize = protectionAbsent ? kAdtsHeaderLengthNoCrc : kAdtsHeaderLengthWithCrc;
+    if (headSize > frameSize) {
+        return 0;
+    }
+    if (headerSize != NULL) {
+        *headerSize = headSize;
+    }
+
+    return frameSize;
+}
+
+ssize_t ADTSFrameIndex::readAt(off64_t offset, void *data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+    return mDataSource->readAt(offset, data, size);
+}
+
+size_t ADTSFrameIndex::getFrameLength(off64_t offset, size_t *headerSize) {
+    Mutex::Autolock autoLock(mLock);
+    return GetFrameLength(mDataSource, offset, headerSize);
+}
+
+void ADTSFrameIndex::addFrame_l(off64_t frameSize) {
+    if (mScannedFrames % kFramesPerCheckpoint == 0) {
+        const size_t checkpoint = mScannedFrames / kFramesPerCheckpoint;
+        if (checkpoint % kCheckpointsPerAnchor == 0) {
+            mAnchors.push(mNextOffset);
+        }
+        // at most kFramesPerCheckpoint frames of 13 bit length apart
+        mDeltas.push((uint32_t)(mNextOffset - mLastCheckpointOffset));
+        mLastCheckpointOffset = mNextOffset;
+    }
+    mNextOffset += frameSize;
+    ++mScannedFrames;
+}
+
+bool ADTSFrameIndex::scanTo_l(uint64_t frame) {
+    while (!mScanComplete && mScannedFrames <= frame) {
+        size_t frameSize = 0;
+        if (mStreamSize < 0 || mNextOffset < mStreamSize) {
+            frameSize = GetFrameLength(mDataSource, mNextOffset, NULL);
+            if (frameSize == 0 && mStreamSize >= 0) {
+                ALOGW("prematured AAC stream (%lld vs %lld)",
+                        (long long)mNextOffset, (long long)mStreamSize);
+            }
+        }
+        if (frameSize == 0) {
+            ALOGV("scanned %llu frames", (unsigned long long)mScannedFrames);
+            mScanComplete = true;
+            break;
+        }
+        addFrame_l(frameSize);
+    }
+    return frame < mScannedFrames;
+}
+
+off64_t ADTSFrameIndex::checkpointOffset_l(size_t checkpoint) const {
+    const size_t anchor = checkpoint / kCheckpointsPerAnchor;
+    off64_t offset = mAnchors.itemAt(anchor);
+    for (size_t i = anchor * kCheckpointsPerAnchor + 1; i <= checkpoint; ++i) {
+        offset += mDeltas.itemAt(i);
+    }
+    return offset;
+}
+
+bool ADTSFrameIndex::getFrameOffset(uint64_t frame, off64_t *offset) {
+    Mutex::Autolock autoLock(mLock);
+    if (!scanTo_l(frame)) {
+        return false;
+    }
+    *offset = checkpointOffset_l(frame / kFramesPerCheckpoint);
+
+    // Walk the rest of the way; these headers have all been checked once already.
+    for (size_t i = frame % kFramesPerCheckpoint; i > 0; --i) {
+        size_t frameSize = GetFrameLength(mDataSource, *offset, NULL);
+        if (frameSize == 0) {
+            return false;
+        }
+        *offset += frameSize;
+    }
+    return true;
+}
+
+void ADTSFrameIndex::getStreamEnd(uint64_t *numFrames, off64_t *offset) {
+    Mutex::Autolock autoLock(mLock);
+    *numFrames = mScannedFrames;
+    *offset = mNextOffset;
+}
+
+void ADTSFrameIndex::onFrameRead(uint64_t frame, off64_t offset, size_t frameSize) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mScanComplete && frame == mScannedFrames && offset == mNextOffset) {
+        addFrame_l(frameSize);
+    }
+}
+
+void ADTSFrameIndex::sample(uint64_t numFrames) {
+    if (numFrames == 0) {
+        return;
+    }
+    Mutex::Autolock autoLock(mLock);
+    scanTo_l(numFrames - 1);
+}
+
+uint64_t ADTSFrameIndex::countFrames(bool *exact) {
+    Mutex::Autolock autoLock(mLock);
+    *exact = mScanComplete;
+    if (mScanComplete) {
+        return mScannedFrames;
+    }
+    if (mStreamSize < 0) {
+        return 0;
+    }
+    if (mScannedFrames == 0 || mNextOffset >= mStreamSize) {
+        return mScannedFrames;
+    }
+    // extrapolate from the bitrate seen so far
+    const off64_t bytesScanned = mNextOffset - mFirstFrameOffset;
+    const off64_t bytesLeft = mStreamSize - mNextOffset;
+    return mScannedFrames
+            + (uint64_t)(bytesLeft * (double)mScannedFrames / bytesScanned + 0.5);
+}
+
+size_t ADTSFrameIndex::tableSize() {
+    Mutex::Autolock autoLock(mLock);
+    return mAnchors.size() * sizeof(off64_t) + mDeltas.size() * sizeof(uint32_t);
+}
+
+void ADTSFrameIndex::startBackgroundScan() {
+    Mutex::Autolock autoLock(mLock);
+    if (mThreadStarted || mScanComplete) {
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    mStopThread = false;
+    mThreadStarted = pthread_create(&mThread, &attr, ThreadWrapper, this) == 0;
+    pthread_attr_destroy(&attr);
+}
+
+void ADTSFrameIndex::stopBackgroundScan() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (!mThreadStarted) {
+            return;
+        }
+        mStopThread = true;
+    }
+
+    void *dummy;
+    pthread_join(mThread, &dummy);
+
+    Mutex::Autolock autoLock(mLock);
+    mThreadStarted = false;
+}
+
+// static
+void *ADTSFrameIndex::ThreadWrapper(void *me) {
+    static_cast<ADTSFrameIndex *>(me)->backgroundScan();
+    return NULL;
+}
+
+void ADTSFrameIndex::backgroundScan() {
+    // A chunk at a time, so readers and seeks are not held off for long.
+    Mutex::Autolock autoLock(mLock);
+    while (!mStopThread && !mScanComplete) {
+        scanTo_l(mScannedFrames + kFramesPerBackgroundChunk - 1);
+        mLock.unlock();
+        sched_yield();
+        mLock.lock();
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADTS_FRAME_INDEX_H_
+
+#define ADTS_FRAME_INDEX_H_
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class DataSourceBase;
+
+// Maps ADTS frame numbers to file offsets, scanning the stream only as far
+// as it has been asked to. Frames are found by reading, by seeking, or by an
+// optional background scan, whichever gets there first.
+//
+// Only every kFramesPerCheckpoint-th offset is kept, as a 32 bit delta from
+// the previous one, with a full offset every kCheckpointsPerAnchor deltas.
+// Other frames are reached by walking the headers from the nearest checkpoint.
+//
+// Data sources are not safe to read from several threads at once (the cache
+// in the extractor process is not), so once the index has been created,
+// everything that reads the stream goes through it and is serialized with
+// the background scan.
+class ADTSFrameIndex : public RefBase {
+public:
+    ADTSFrameIndex(DataSourceBase *source, off64_t firstFrameOffset);
+
+    // Returns the frame length in bytes as described in an ADTS header starting at
+    // the given offset, or 0 if the size can't be read due to an error in the header
+    // or a read failure. The returned value is the AAC frame size with the ADTS header
+    // length (regardless of the presence of the CRC).
+    // If headerSize is non-NULL, it will be used to return the size of the header of
+    // this ADTS frame.
+    static size_t GetFrameLength(DataSourceBase *source, off64_t offset, size_t *headerSize);
+
+    off64_t firstFrameOffset() const { return mFirstFrameOffset; }
+
+    // Reads from the data source, serialized with the scans.
+    ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    // As GetFrameLength(), serialized with the scans.
+    size_t getFrameLength(off64_t offset, size_t *headerSize);
+
+    // Finds the offset of the given frame, scanning forward if needed.
+    // Returns false if the stream ends before that frame.
+    bool getFrameOffset(uint64_t frame, off64_t *offset);
+
+    // Returns the number of frames and the offset just past the last one,
+    // once getFrameOffset() has found the end of the stream.
+    void getStreamEnd(uint64_t *numFrames, off64_t *offset);
+
+    // Lets sequential reads extend the index without reading anything twice.
+    void onFrameRead(uint64_t frame, off64_t offset, size_t frameSize);
+
+    // Scans at least the first numFrames frames, as a sample for countFrames().
+    void sample(uint64_t numFrames);
+
+    // Returns the number of frames in the stream, or 0 if unknown.
+    // Until the whole stream has been scanned this is extrapolated from the
+    // average frame size seen so far, and *exact is set to false.
+    uint64_t countFrames(bool *exact);
+
+    // Scans the rest of the stream on a thread of its own.
+    void startBackgroundScan();
+    void stopBackgroundScan();
+
+    // Bytes used by the offset table.
+    size_t tableSize();
+
+protected:
+    virtual ~ADTSFrameIndex();
+
+private:
+    enum {
+        kFramesPerCheckpoint = 64,
+        kCheckpointsPerAnchor = 64,
+        kFramesPerBackgroundChunk = 256,
+    };
+
+    DataSourceBase *mDataSource;
+    const off64_t mFirstFrameOffset;
+    off64_t mStreamSize;                // -1 if unknown
+
+    Mutex mLock;
+    uint64_t mScannedFrames;            // frames with a known offset
+    off64_t mNextOffset;                // offset of frame mScannedFrames
+    bool mScanComplete;
+    off64_t mLastCheckpointOffset;
+    Vector<off64_t> mAnchors;           // offset of every kCheckpointsPerAnchor-th checkpoint
+    Vector<uint32_t> mDeltas;           // each checkpoint less the previous one
+
+    pthread_t mThread;
+    bool mThreadStarted;
+    bool mStopThread;
+
+    void addFrame_l(off64_t frameSize);
+    bool scanTo_l(uint64_t frame);
+    off64_t checkpointOffset_l(size_t checkpoint) const;
+
+    static void *ThreadWrapper(void *me);
+    void backgroundScan();
+
+    DISALLOW_EVIL_CONSTRUCTORS(ADTSFrameIndex);
+};
+
+}  // namespace android
+
+#endif  // ADTS_FRAME_INDEX_H_
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Time to open a long ADTS stream, and to index all of it as opening used to.
+// The argument is the stream length in minutes.
+
+#include <stdint.h>
+
+#include <benchmark/benchmark.h>
+
+#include <media/stagefright/MetaDataBase.h>
+
+#include "AACExtractor.h"
+#include "ADTSFrameIndex.h"
+#include "ADTSTestSource.h"
+
+namespace android {
+
+// 128 kbit/s at 44.1 kHz
+static const size_t kFrameSize = 371;
+
+static uint64_t framesForMinutes(int64_t minutes) {
+    return minutes * 60 * 1000000 / kFrameDurationUs;
+}
+
+static void BM_OpenAndGetDuration(benchmark::State &state) {
+    ADTSConstantSource source(framesForMinutes(state.range(0)), kFrameSize);
+    while (state.KeepRunning()) {
+        MediaExtractor *extractor = new AACExtractor(&source, 0);
+        MetaDataBase meta;
+        int64_t durationUs = 0;
+        extractor->getTrackMetaData(meta, 0);
+        meta.findInt64(kKeyDuration, &durationUs);
+        benchmark::DoNotOptimize(durationUs);
+        delete extractor;
+    }
+    state.counters["reads"] = source.mReads / state.iterations();
+}
+BENCHMARK(BM_OpenAndGetDuration)->Arg(1)->Arg(10)->Arg(120)->Unit(benchmark::kMicrosecond);
+
+static void BM_IndexWholeStream(benchmark::State &state) {
+    ADTSConstantSource source(framesForMinutes(state.range(0)), kFrameSize);
+    while (state.KeepRunning()) {
+        sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+        index->sample(UINT64_MAX);
+        state.counters["table_bytes"] = index->tableSize();
+    }
+    state.counters["reads"] = source.mReads / state.iterations();
+}
+BENCHMARK(BM_IndexWholeStream)->Arg(1)->Arg(10)->Arg(120)->Unit(benchmark::kMillisecond);
+
+}  // namespace android
+
+BENCHMARK_MAIN();
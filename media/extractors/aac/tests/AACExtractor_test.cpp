@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AACExtractor_test"
+#include <utils/Log.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <media/MediaTrack.h>
+#include <media/stagefright/MediaBufferBase.h>
+#include <media/stagefright/MetaDataBase.h>
+
+#include "AACExtractor.h"
+#include "ADTSTestSource.h"
+
+namespace android {
+
+class AACExtractorTest : public ::testing::Test {
+protected:
+    // Reads one frame and checks that it is the given one.
+    void expectFrame(MediaTrack *track, uint32_t frame, const MediaTrack::ReadOptions *options) {
+        MediaBufferBase *buffer = NULL;
+        ASSERT_EQ(OK, track->read(&buffer, options));
+        ASSERT_TRUE(buffer != NULL);
+        int64_t timeUs;
+        EXPECT_TRUE(buffer->meta_data().findInt64(kKeyTime, &timeUs));
+        EXPECT_EQ(frame * kFrameDurationUs, timeUs);
+        uint32_t payload;
+        ASSERT_GE(buffer->range_length(), sizeof(payload));
+        memcpy(&payload, (const uint8_t *)buffer->data() + buffer->range_offset(),
+                sizeof(payload));
+        EXPECT_EQ(frame, payload);
+        buffer->release();
+    }
+};
+
+TEST_F(AACExtractorTest, Seek) {
+    const uint32_t kNumFrames = 20000;
+    ADTSMemorySource source(kNumFrames, 11);
+    MediaExtractor *extractor = new AACExtractor(&source, 0);
+    ASSERT_EQ(1u, extractor->countTracks());
+    MediaTrack *track = extractor->getTrack(0);
+    ASSERT_TRUE(track != NULL);
+    ASSERT_EQ(OK, track->start());
+
+    expectFrame(track, 0, NULL);
+    expectFrame(track, 1, NULL);
+
+    // forward past anything indexed, back, and onto checkpoint boundaries
+    const uint32_t frames[] = { 15000, 3, 64, 4096, 4095, 19999, 8000, 0, 12345 };
+    for (uint32_t frame : frames) {
+        MediaTrack::ReadOptions options;
+        // anywhere within the frame lands on its start
+        options.setSeekTo(frame * kFrameDurationUs + kFrameDurationUs / 2);
+        expectFrame(track, frame, &options);
+        if (frame + 1 < kNumFrames) {
+            expectFrame(track, frame + 1, NULL);
+        }
+    }
+
+    // the end of the stream, not an error, and stays there
+    MediaTrack::ReadOptions options;
+    options.setSeekTo(kNumFrames * kFrameDurationUs);
+    MediaBufferBase *buffer = NULL;
+    EXPECT_EQ(ERROR_END_OF_STREAM, track->read(&buffer, &options));
+    EXPECT_EQ(ERROR_END_OF_STREAM, track->read(&buffer, NULL));
+    options.setSeekTo(2 * kNumFrames * kFrameDurationUs);
+    EXPECT_EQ(ERROR_END_OF_STREAM, track->read(&buffer, &options));
+
+    track->stop();
+    delete track;
+    delete extractor;
+}
+
+TEST_F(AACExtractorTest, DurationBecomesExact) {
+    const uint32_t kNumFrames = 3000;
+    ADTSMemorySource source(kNumFrames, 12);
+    source.mFlags = DataSourceBase::kIsLocalFileSource;
+    MediaExtractor *extractor = new AACExtractor(&source, 0);
+
+    // estimated first, from the opening frames
+    MetaDataBase meta;
+    int64_t durationUs;
+    ASSERT_EQ(OK, extractor->getTrackMetaData(meta, 0));
+    ASSERT_TRUE(meta.findInt64(kKeyDuration, &durationUs));
+    EXPECT_NEAR(kNumFrames * kFrameDurationUs, durationUs, kNumFrames * kFrameDurationUs / 10);
+
+    // then exact once the background scan is done
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_EQ(OK, extractor->getTrackMetaData(meta, 0));
+        ASSERT_TRUE(meta.findInt64(kKeyDuration, &durationUs));
+        if (durationUs == kNumFrames * kFrameDurationUs) {
+            break;
+        }
+        usleep(10000);
+    }
+    EXPECT_EQ(kNumFrames * kFrameDurationUs, durationUs);
+
+    delete extractor;
+}
+
+// Reads from the track are not interleaved with reads of the background scan.
+TEST_F(AACExtractorTest, ReadWhileScanning) {
+    const uint32_t kNumFrames = 20000;
+    ADTSMemorySource source(kNumFrames, 13);
+    source.mFlags = DataSourceBase::kIsLocalFileSource;
+    MediaExtractor *extractor = new AACExtractor(&source, 0);
+    MediaTrack *track = extractor->getTrack(0);
+    ASSERT_TRUE(track != NULL);
+    ASSERT_EQ(OK, track->start());
+
+    for (uint32_t frame = 0; frame < kNumFrames; ++frame) {
+        if (frame % 1000 == 999) {
+            MediaTrack::ReadOptions options;
+            options.setSeekTo(frame * kFrameDurationUs);
+            expectFrame(track, frame, &options);
+        } else {
+            expectFrame(track, frame, NULL);
+        }
+    }
+    MediaBufferBase *buffer = NULL;
+    EXPECT_EQ(ERROR_END_OF_STREAM, track->read(&buffer, NULL));
+    EXPECT_EQ(0u, source.mOverlappingReads);
+
+    track->stop();
+    delete track;
+    delete extractor;
+}
+
+}  // namespace android
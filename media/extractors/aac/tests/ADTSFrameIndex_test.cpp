@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ADTSFrameIndex_test"
+#include <utils/Log.h>
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "ADTSFrameIndex.h"
+#include "ADTSTestSource.h"
+
+namespace android {
+
+class ADTSFrameIndexTest : public ::testing::Test {
+};
+
+TEST_F(ADTSFrameIndexTest, FrameOffsetsMatchFullScan) {
+    ADTSMemorySource source(10000, 1);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    // around checkpoint and anchor boundaries, out of order
+    const uint64_t frames[] = {
+        4096, 0, 1, 63, 64, 65, 4095, 4097, 9999, 127, 128, 8191, 8192, 5000, 2,
+    };
+    for (uint64_t frame : frames) {
+        off64_t offset;
+        ASSERT_TRUE(index->getFrameOffset(frame, &offset)) << "frame " << frame;
+        EXPECT_EQ(source.mOffsets[frame], offset) << "frame " << frame;
+    }
+    for (uint64_t frame = 0; frame < source.mOffsets.size(); frame += 7) {
+        off64_t offset;
+        ASSERT_TRUE(index->getFrameOffset(frame, &offset));
+        EXPECT_EQ(source.mOffsets[frame], offset) << "frame " << frame;
+    }
+
+    off64_t offset;
+    EXPECT_FALSE(index->getFrameOffset(10000, &offset));
+    bool exact;
+    EXPECT_EQ(10000u, index->countFrames(&exact));
+    EXPECT_TRUE(exact);
+
+    // a full 64 bit offset per 4096 frames, 32 bits per 64 frames
+    EXPECT_LE(index->tableSize(), 10000 * sizeof(uint64_t) / 32);
+}
+
+TEST_F(ADTSFrameIndexTest, StreamNotAtStartOfFile) {
+    ADTSMemorySource source(300, 2);
+    // as if after an ID3 tag
+    const off64_t tagSize = 1000;
+    source.mData.insert(source.mData.begin(), tagSize, 0);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, tagSize);
+
+    EXPECT_EQ(tagSize, index->firstFrameOffset());
+    for (uint64_t frame = 0; frame < 300; ++frame) {
+        off64_t offset;
+        ASSERT_TRUE(index->getFrameOffset(frame, &offset));
+        EXPECT_EQ(tagSize + source.mOffsets[frame], offset);
+    }
+}
+
+TEST_F(ADTSFrameIndexTest, OpenReadsOnlySample) {
+    ADTSMemorySource source(100000, 3);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    index->sample(256);
+    EXPECT_LE(source.mReads, 256u);
+    bool exact;
+    uint64_t estimate = index->countFrames(&exact);
+    EXPECT_FALSE(exact);
+    // payload sizes are uniform, so the first 256 frames are a fair sample
+    EXPECT_NEAR(100000.0, (double)estimate, 100000 * 0.05);
+}
+
+TEST_F(ADTSFrameIndexTest, ConstantBitrateEstimateIsExact) {
+    ADTSMemorySource source(5000, 4, false /* variableSize */);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    index->sample(10);
+    bool exact;
+    EXPECT_EQ(5000u, index->countFrames(&exact));
+    EXPECT_FALSE(exact);
+}
+
+TEST_F(ADTSFrameIndexTest, SequentialReadsExtendIndex) {
+    ADTSMemorySource source(2000, 5);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    for (uint64_t frame = 0; frame < 1000; ++frame) {
+        const off64_t offset = source.mOffsets[frame];
+        index->onFrameRead(frame, offset, source.mOffsets[frame + 1] - offset);
+    }
+    // frames 0 to 999 are known, so this only walks from frame 960
+    source.mReads = 0;
+    off64_t offset;
+    ASSERT_TRUE(index->getFrameOffset(999, &offset));
+    EXPECT_EQ(source.mOffsets[999], offset);
+    EXPECT_EQ(999u % 64, source.mReads);
+
+    // frames read out of order do not confuse the index
+    index->onFrameRead(1500, source.mOffsets[1500], 100);
+    index->onFrameRead(1000, source.mOffsets[999], 100);
+    ASSERT_TRUE(index->getFrameOffset(1999, &offset));
+    EXPECT_EQ(source.mOffsets[1999], offset);
+}
+
+TEST_F(ADTSFrameIndexTest, SeekPastEnd) {
+    ADTSMemorySource source(100, 6);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    off64_t offset;
+    EXPECT_FALSE(index->getFrameOffset(100, &offset));
+    EXPECT_FALSE(index->getFrameOffset(1ull << 40, &offset));
+    ASSERT_TRUE(index->getFrameOffset(99, &offset));
+    EXPECT_EQ(source.mOffsets[99], offset);
+}
+
+TEST_F(ADTSFrameIndexTest, TruncatedStream) {
+    ADTSMemorySource source(500, 7);
+    // garbage after frame 400
+    memset(&source.mData[source.mOffsets[400]], 0x55, 16);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    bool exact;
+    index->sample(1000);
+    EXPECT_EQ(400u, index->countFrames(&exact));
+    EXPECT_TRUE(exact);
+    off64_t offset;
+    EXPECT_FALSE(index->getFrameOffset(400, &offset));
+}
+
+TEST_F(ADTSFrameIndexTest, UnknownSize) {
+    ADTSMemorySource source(500, 8);
+    source.mKnownSize = false;
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    bool exact;
+    index->sample(256);
+    EXPECT_EQ(0u, index->countFrames(&exact));
+    EXPECT_FALSE(exact);
+
+    off64_t offset;
+    ASSERT_TRUE(index->getFrameOffset(499, &offset));
+    EXPECT_EQ(source.mOffsets[499], offset);
+    EXPECT_FALSE(index->getFrameOffset(500, &offset));
+    EXPECT_EQ(500u, index->countFrames(&exact));
+    EXPECT_TRUE(exact);
+}
+
+TEST_F(ADTSFrameIndexTest, BackgroundScanCompletes) {
+    ADTSMemorySource source(50000, 9);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    index->sample(256);
+    index->startBackgroundScan();
+    // seeks while the scan runs
+    for (uint64_t frame = 49999; frame > 0; frame /= 3) {
+        off64_t offset;
+        ASSERT_TRUE(index->getFrameOffset(frame, &offset));
+        EXPECT_EQ(source.mOffsets[frame], offset);
+    }
+
+    bool exact = false;
+    uint64_t numFrames = 0;
+    for (int i = 0; i < 500 && !exact; ++i) {
+        numFrames = index->countFrames(&exact);
+        if (!exact) {
+            usleep(10000);
+        }
+    }
+    EXPECT_TRUE(exact);
+    EXPECT_EQ(50000u, numFrames);
+    index->stopBackgroundScan();
+    EXPECT_EQ(0u, source.mOverlappingReads);
+}
+
+TEST_F(ADTSFrameIndexTest, StopBackgroundScan) {
+    ADTSConstantSource source(1000000, 400);
+    sp<ADTSFrameIndex> index = new ADTSFrameIndex(&source, 0);
+
+    index->startBackgroundScan();
+    index->stopBackgroundScan();
+    // and again; an index going away stops its own scan
+    index->startBackgroundScan();
+    index.clear();
+}
+
+}  // namespace android
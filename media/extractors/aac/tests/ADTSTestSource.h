@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADTS_TEST_SOURCE_H_
+
+#define ADTS_TEST_SOURCE_H_
+
+#include <sched.h>
+#include <string.h>
+
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include <media/DataSourceBase.h>
+#include <media/stagefright/MediaErrors.h>
+
+namespace android {
+
+// AAC LC, 44.1 kHz, stereo
+static const uint8_t kSamplingFrequencyIndex = 4;
+static const int64_t kFrameDurationUs = (1024 * 1000000ll + 44099) / 44100;
+
+// Writes an ADTS header for a frame of frameSize bytes, header included.
+static inline size_t WriteAdtsHeader(uint8_t *header, size_t frameSize, bool crc) {
+    header[0] = 0xff;
+    header[1] = crc ? 0xf0 : 0xf1;
+    header[2] = (1 << 6) | (kSamplingFrequencyIndex << 2);
+    header[3] = (2 << 6) | ((frameSize >> 11) & 0x3);
+    header[4] = (frameSize >> 3) & 0xff;
+    header[5] = ((frameSize & 0x7) << 5) | 0x1f;
+    header[6] = 0xfc;
+    if (crc) {
+        header[7] = 0;
+        header[8] = 0;
+        return 9;
+    }
+    return 7;
+}
+
+// An ADTS stream held in memory. Each payload starts with its frame number.
+// Like the data sources in the extractor process, it must not be read from
+// two threads at once; reads that overlap are counted.
+class ADTSMemorySource : public DataSourceBase {
+public:
+    ADTSMemorySource(uint32_t numFrames, uint32_t seed, bool variableSize = true)
+        : mReads(0), mOverlappingReads(0), mKnownSize(true), mFlags(0), mInRead(false) {
+        std::mt19937 random(seed);
+        for (uint32_t i = 0; i < numFrames; ++i) {
+            const bool crc = variableSize && (random() % 8) == 0;
+            const size_t payloadSize = variableSize ? 16 + random() % 700 : 371;
+            const size_t offset = mData.size();
+            mOffsets.push_back(offset);
+            mData.resize(offset + 9 + payloadSize);
+            const size_t headerSize = WriteAdtsHeader(&mData[offset], 0, crc);
+            const size_t frameSize = headerSize + payloadSize;
+            WriteAdtsHeader(&mData[offset], frameSize, crc);
+            memcpy(&mData[offset + headerSize], &i, sizeof(i));
+            mData.resize(offset + frameSize);
+        }
+    }
+
+    virtual ~ADTSMemorySource() {}
+
+    virtual status_t initCheck() const { return OK; }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        ++mReads;
+        if (mInRead.exchange(true)) {
+            ++mOverlappingReads;
+        }
+        // give another reader the chance to overlap
+        sched_yield();
+        if (offset < 0 || (size_t)offset >= mData.size()) {
+            mInRead = false;
+            return 0;
+        }
+        if (size > mData.size() - offset) {
+            size = mData.size() - offset;
+        }
+        memcpy(data, &mData[offset], size);
+        mInRead = false;
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        if (!mKnownSize) {
+            return ERROR_UNSUPPORTED;
+        }
+        *size = mData.size();
+        return OK;
+    }
+
+    virtual uint32_t flags() { return mFlags; }
+
+    std::vector<uint8_t> mData;
+    std::vector<off64_t> mOffsets;    // of each frame
+    std::atomic<uint64_t> mReads;
+    std::atomic<uint64_t> mOverlappingReads;
+    bool mKnownSize;
+    uint32_t mFlags;
+
+private:
+    std::atomic<bool> mInRead;
+};
+
+// A long stream of equal frames that is never held in memory.
+class ADTSConstantSource : public DataSourceBase {
+public:
+    ADTSConstantSource(uint64_t numFrames, size_t frameSize)
+        : mReads(0), mNumFrames(numFrames), mFrameSize(frameSize) {
+        WriteAdtsHeader(mHeader, frameSize, false /* crc */);
+    }
+
+    virtual ~ADTSConstantSource() {}
+
+    virtual status_t initCheck() const { return OK; }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        ++mReads;
+        const off64_t streamSize = mNumFrames * mFrameSize;
+        if (offset < 0 || offset >= streamSize) {
+            return 0;
+        }
+        if ((off64_t)size > streamSize - offset) {
+            size = streamSize - offset;
+        }
+        uint8_t *out = static_cast<uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            const size_t inFrame = (offset + i) % mFrameSize;
+            out[i] = inFrame < sizeof(mHeader) ? mHeader[inFrame] : 0;
+        }
+        return size;
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        *size = mNumFrames * mFrameSize;
+        return OK;
+    }
+
+    std::atomic<uint64_t> mReads;
+
+private:
+    const uint64_t mNumFrames;
+    const size_t mFrameSize;
+    uint8_t mHeader[7];
+};
+
+}  // namespace android
+
+#endif  // ADTS_TEST_SOURCE_H_
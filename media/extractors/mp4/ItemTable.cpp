@@ -50,9 +50,10 @@ struct ImageItem {
         return type == FOURCC('g', 'r', 'i', 'd');
     }
 
-    status_t getNextTileItemId(uint32_t *nextTileItemId, bool reset) {
+    status_t getNextTileItemId(
+            uint32_t *nextTileItemId, bool reset, size_t tileIndex = 0) {
         if (reset) {
-            nextTileIndex = 0;
+            nextTileIndex = tileIndex;
         }
         if (nextTileIndex >= dimgRefs.size()) {
             return ERROR_END_OF_STREAM;
@@ -1609,7 +1610,7 @@ status_t ItemTable::findThumbnailItem(const uint32_t imageIndex, uint32_t *itemI
 }
 
 status_t ItemTable::getImageOffsetAndSize(
-        uint32_t *itemIndex, off64_t *offset, size_t *size) {
+        uint32_t *itemIndex, off64_t *offset, size_t *size, uint32_t tileIndex) {
     if (!mImageItemsValid) {
         return INVALID_OPERATION;
     }
@@ -1625,7 +1626,8 @@ status_t ItemTable::getImageOffsetAndSize(
     ImageItem &image = mItemIdToItemMap.editValueAt(mCurrentItemIndex);
     if (image.isGrid()) {
         uint32_t tileItemId;
-        status_t err = image.getNextTileItemId(&tileItemId, itemIndex != NULL);
+        status_t err = image.getNextTileItemId(
+                &tileItemId, itemIndex != NULL, tileIndex);
         if (err != OK) {
             return err;
         }
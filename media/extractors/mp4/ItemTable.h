@@ -54,8 +54,11 @@ public:
     sp<MetaData> getImageMeta(const uint32_t imageIndex);
     status_t findImageItem(const uint32_t imageIndex, uint32_t *itemIndex);
     status_t findThumbnailItem(const uint32_t imageIndex, uint32_t *itemIndex);
+    // If |itemIndex| is not NULL, (re)start reading the image at that item.
+    // For grid images, reading then starts at tile |tileIndex| (row-major),
+    // and each subsequent call returns the next tile.
     status_t getImageOffsetAndSize(
-            uint32_t *itemIndex, off64_t *offset, size_t *size);
+            uint32_t *itemIndex, off64_t *offset, size_t *size, uint32_t tileIndex = 0);
     status_t getExifOffsetAndSize(off64_t *offset, size_t *size);
 
 protected:
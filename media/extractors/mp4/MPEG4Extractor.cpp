@@ -4803,9 +4803,15 @@ status_t MPEG4Source::read(
             err = mSampleTable->getMetaDataForSample(
                     mCurrentSampleIndex, &offset, &size, &cts, &isSyncSample, &stts);
         } else {
+            // For grid images, SEEK_FRAME_INDEX seeks to the tile whose
+            // (row-major) index is given as the seek time.
+            uint32_t tileIndex = 0;
+            bool seeking = options && options->getSeekTo(&seekTimeUs, &mode);
+            if (seeking && mode == ReadOptions::SEEK_FRAME_INDEX && seekTimeUs > 0) {
+                tileIndex = (uint32_t)seekTimeUs;
+            }
             err = mItemTable->getImageOffsetAndSize(
-                    options && options->getSeekTo(&seekTimeUs, &mode) ?
-                            &mCurrentSampleIndex : NULL, &offset, &size);
+                    seeking ? &mCurrentSampleIndex : NULL, &offset, &size, tileIndex);
 
             cts = stts = 0;
             isSyncSample = 0;
@@ -140,6 +140,14 @@ protected:
 
     int32_t getDeviceChannelCount() const { return mDeviceChannelCount; }
 
+    /**
+     * @return true if the app data can go to or from the FIFO without conversion
+     */
+    bool isDeviceFormatSameAsApp() const {
+        return getFormat() == getDeviceFormat()
+                && getSamplesPerFrame() == getDeviceChannelCount();
+    }
+
     /**
      * @return true if running in audio service, versus in app process
      */
@@ -159,6 +167,11 @@ protected:
     uint8_t                 *mCallbackBuffer = nullptr;
     int32_t                  mCallbackFrames = 0;
 
+    // Set by callbackLoop() so that processDataNow() calls the app with a pointer
+    // into the FIFO, instead of copying through mCallbackBuffer.
+    bool                     mCallbackInPlace = false;
+    aaudio_data_callback_result_t mInPlaceCallbackResult = AAUDIO_CALLBACK_RESULT_CONTINUE;
+
     // The service uses this for SHARED mode.
     bool                     mInService = false;  // Is this running in the client or the service?
 
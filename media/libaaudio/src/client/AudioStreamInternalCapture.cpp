@@ -160,7 +160,19 @@ aaudio_result_t AudioStreamInternalCapture::readNowWithConversion(void *buffer,
     uint8_t *destination = (uint8_t *) buffer;
     int32_t framesLeft = numFrames;
 
-    mAudioEndpoint.getFullFramesAvailable(&wrappingBuffer);
+    int32_t framesAvailable = mAudioEndpoint.getFullFramesAvailable(&wrappingBuffer);
+
+    if (mCallbackInPlace) {
+        if (wrappingBuffer.numFrames[0] >= numFrames) {
+            // Let the app process the data straight from the FIFO.
+            mInPlaceCallbackResult = maybeCallDataCallback(wrappingBuffer.data[0], numFrames);
+            mAudioEndpoint.advanceReadIndex(numFrames);
+            return numFrames;
+        } else if (framesAvailable < numFrames) {
+            return 0; // wait until the whole burst is there
+        }
+        // The data is split by the wrap point so copy it into the buffer below.
+    }
 
     // Read data in one or two parts.
     for (int partIndex = 0; framesLeft > 0 && partIndex < WrappingBuffer::SIZE; partIndex++) {
@@ -203,6 +215,10 @@ aaudio_result_t AudioStreamInternalCapture::readNowWithConversion(void *buffer,
     int32_t framesProcessed = numFrames - framesLeft;
     mAudioEndpoint.advanceReadIndex(framesProcessed);
 
+    if (mCallbackInPlace) {
+        mInPlaceCallbackResult = maybeCallDataCallback(buffer, framesProcessed);
+    }
+
     //ALOGD("readNowWithConversion() returns %d", framesProcessed);
     return framesProcessed;
 }
@@ -241,7 +257,12 @@ void *AudioStreamInternalCapture::callbackLoop() {
         int64_t timeoutNanos = calculateReasonableTimeout(mCallbackFrames);
 
         // This is a BLOCKING READ!
+        // When the data does not need conversion, the app is called from inside read().
+        const bool inPlace = isDeviceFormatSameAsApp();
+        mInPlaceCallbackResult = AAUDIO_CALLBACK_RESULT_CONTINUE;
+        mCallbackInPlace = inPlace;
         result = read(mCallbackBuffer, mCallbackFrames, timeoutNanos);
+        mCallbackInPlace = false;
         if ((result != mCallbackFrames)) {
             ALOGE("callbackLoop: read() returned %d", result);
             if (result >= 0) {
@@ -252,8 +273,12 @@ void *AudioStreamInternalCapture::callbackLoop() {
             break;
         }
 
-        // Call application using the AAudio callback interface.
-        callbackResult = maybeCallDataCallback(mCallbackBuffer, mCallbackFrames);
+        if (inPlace) {
+            callbackResult = mInPlaceCallbackResult;
+        } else {
+            // Call application using the AAudio callback interface.
+            callbackResult = maybeCallDataCallback(mCallbackBuffer, mCallbackFrames);
+        }
 
         if (callbackResult == AAUDIO_CALLBACK_RESULT_STOP) {
             ALOGD("callback returned AAUDIO_CALLBACK_RESULT_STOP");
@@ -24,6 +24,7 @@
 #include <utils/Trace.h>
 
 #include "client/AudioStreamInternalPlay.h"
+#include "utility/AAudioUtilities.h"
 #include "utility/AudioClock.h"
 
 using android::WrappingBuffer;
@@ -203,7 +204,31 @@ aaudio_result_t AudioStreamInternalPlay::writeNowWithConversion(const void *buff
     uint8_t *byteBuffer = (uint8_t *) buffer;
     int32_t framesLeft = numFrames;
 
-    mAudioEndpoint.getEmptyFramesAvailable(&wrappingBuffer);
+    int32_t framesAvailable = mAudioEndpoint.getEmptyFramesAvailable(&wrappingBuffer);
+
+    if (mCallbackInPlace) {
+        if (wrappingBuffer.numFrames[0] >= numFrames) {
+            // Let the app render straight into the FIFO.
+            mInPlaceCallbackResult = maybeCallDataCallback(wrappingBuffer.data[0], numFrames);
+            if (mInPlaceCallbackResult == AAUDIO_CALLBACK_RESULT_CONTINUE) {
+                if (getDeviceFormat() == AAUDIO_FORMAT_PCM_FLOAT) {
+                    // Clip in place, as the conversion below would have.
+                    float *rendered = (float *) wrappingBuffer.data[0];
+                    AAudio_linearRamp(rendered, rendered, numFrames, getDeviceChannelCount(),
+                                      1.0f, 1.0f);
+                }
+                mAudioEndpoint.advanceWriteIndex(numFrames);
+            }
+            return numFrames;
+        } else if (framesAvailable < numFrames) {
+            return 0; // wait until the whole burst fits
+        }
+        // The room is split by the wrap point so render into the buffer and copy.
+        mInPlaceCallbackResult = maybeCallDataCallback(byteBuffer, numFrames);
+        if (mInPlaceCallbackResult != AAUDIO_CALLBACK_RESULT_CONTINUE) {
+            return numFrames;
+        }
+    }
 
     // Write data in one or two parts.
     int partIndex = 0;
@@ -282,12 +307,24 @@ void *AudioStreamInternalPlay::callbackLoop() {
 
     // result might be a frame count
     while (mCallbackEnabled.load() && isActive() && (result >= 0)) {
-        // Call application using the AAudio callback interface.
-        callbackResult = maybeCallDataCallback(mCallbackBuffer, mCallbackFrames);
+        if (canCallbackInPlace()) {
+            // The app is called from inside write() once there is room in the FIFO.
+            // This is a BLOCKING WRITE!
+            mInPlaceCallbackResult = AAUDIO_CALLBACK_RESULT_CONTINUE;
+            mCallbackInPlace = true;
+            result = write(mCallbackBuffer, mCallbackFrames, timeoutNanos);
+            mCallbackInPlace = false;
+            callbackResult = mInPlaceCallbackResult;
+        } else {
+            // Call application using the AAudio callback interface.
+            callbackResult = maybeCallDataCallback(mCallbackBuffer, mCallbackFrames);
+            if (callbackResult == AAUDIO_CALLBACK_RESULT_CONTINUE) {
+                // Write audio data to stream. This is a BLOCKING WRITE!
+                result = write(mCallbackBuffer, mCallbackFrames, timeoutNanos);
+            }
+        }
 
         if (callbackResult == AAUDIO_CALLBACK_RESULT_CONTINUE) {
-            // Write audio data to stream. This is a BLOCKING WRITE!
-            result = write(mCallbackBuffer, mCallbackFrames, timeoutNanos);
             if ((result != mCallbackFrames)) {
                 if (result >= 0) {
                     // Only wrote some of the frames requested. Must have timed out.
@@ -307,6 +344,14 @@ void *AudioStreamInternalPlay::callbackLoop() {
     return NULL;
 }
 
+bool AudioStreamInternalPlay::canCallbackInPlace() {
+    // Rendering in place waits for room for a whole burst before calling the app.
+    // So only do it when at least one more burst is still queued for the device.
+    return isDeviceFormatSameAsApp()
+            && mVolumeRamp.isSteadyAt(1.0f)
+            && mAudioEndpoint.getBufferSizeInFrames() >= 2 * mCallbackFrames;
+}
+
 //------------------------------------------------------------------------------
 // Implementation of PlayerBase
 status_t AudioStreamInternalPlay::doSetVolume() {
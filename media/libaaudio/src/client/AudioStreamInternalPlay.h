@@ -91,6 +91,9 @@ private:
     aaudio_result_t writeNowWithConversion(const void *buffer,
                                            int32_t numFrames);
 
+    // Can the app render straight into the FIFO without conversion or volume ramp?
+    bool canCallbackInPlace();
+
     int64_t                  mLastFramesRead = 0; // used to prevent retrograde motion
 
     LinearRamp               mVolumeRamp;
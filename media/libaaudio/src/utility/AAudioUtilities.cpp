@@ -30,14 +30,11 @@
 #include <assert.h>
 
 #include "utility/AAudioUtilities.h"
+#include "utility/SampleConversion.h"
 
+using namespace aaudio;
 using namespace android;
 
-// This is 3 dB, (10^(3/20)), to match the maximum headroom in AudioTrack for float data.
-// It is designed to allow occasional transient peaks.
-#define MAX_HEADROOM (1.41253754f)
-#define MIN_HEADROOM (0 - MAX_HEADROOM)
-
 int32_t AAudioConvert_formatToSizeInBytes(aaudio_format_t format) {
     int32_t size = AAUDIO_ERROR_ILLEGAL_ARGUMENT;
     switch (format) {
@@ -53,36 +50,12 @@ int32_t AAudioConvert_formatToSizeInBytes(aaudio_format_t format) {
     return size;
 }
 
-// TODO expose and call clamp16_from_float function in primitives.h
-static inline int16_t clamp16_from_float(float f) {
-    static const float scale = 1 << 15;
-    return (int16_t) roundf(fmaxf(fminf(f * scale, scale - 1.f), -scale));
-}
-
-// Clip to valid range of a float sample to prevent excessive volume.
-// By using fmin and fmax we also protect against NaN.
-static float clipToMinMaxHeadroom(float input) {
-    return fmin(MAX_HEADROOM, fmax(MIN_HEADROOM, input));
-}
-
-static float clipAndClampFloatToPcm16(float sample, float scaler) {
-    // Clip to valid range of a float sample to prevent excessive volume.
-    sample = clipToMinMaxHeadroom(sample);
-
-    // Scale and convert to a short.
-    float fval = sample * scaler;
-    return clamp16_from_float(fval);
-}
-
 void AAudioConvert_floatToPcm16(const float *source,
                                 int16_t *destination,
                                 int32_t numSamples,
                                 float amplitude) {
-    const float scaler = amplitude;
-    for (int i = 0; i < numSamples; i++) {
-        float sample = *source++;
-        *destination++ = clipAndClampFloatToPcm16(sample, scaler);
-    }
+    conversion::floatToPcm16<false>(source, destination, numSamples,
+                                    conversion::ConstantGain(amplitude));
 }
 
 void AAudioConvert_floatToPcm16(const float *source,
@@ -94,13 +67,16 @@ void AAudioConvert_floatToPcm16(const float *source,
     float scaler = amplitude1;
     // divide by numFrames so that we almost reach amplitude2
     float delta = (amplitude2 - amplitude1) / numFrames;
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        for (int sampleIndex = 0; sampleIndex < samplesPerFrame; sampleIndex++) {
-            float sample = *source++;
-            *destination++ = clipAndClampFloatToPcm16(sample, scaler);
-        }
-        scaler += delta;
-    }
+    conversion::rampInBlocks(numFrames, samplesPerFrame,
+            [&](int32_t) {
+                const float frameScaler = scaler;
+                scaler += delta;
+                return frameScaler;
+            },
+            [&](int32_t firstSample, int32_t numSamples, const auto &gain) {
+                conversion::floatToPcm16<false>(source + firstSample, destination + firstSample,
+                                                numSamples, gain);
+            });
 }
 
 #define SHORT_SCALE  32768
@@ -110,9 +86,8 @@ void AAudioConvert_pcm16ToFloat(const int16_t *source,
                                 int32_t numSamples,
                                 float amplitude) {
     const float scaler = amplitude / SHORT_SCALE;
-    for (int i = 0; i < numSamples; i++) {
-        destination[i] = source[i] * scaler;
-    }
+    conversion::pcm16ToFloat<false>(source, destination, numSamples,
+                                    conversion::ConstantGain(scaler));
 }
 
 // This code assumes amplitude1 and amplitude2 are between 0.0 and 1.0
@@ -124,12 +99,16 @@ void AAudioConvert_pcm16ToFloat(const int16_t *source,
                                 float amplitude2) {
     float scaler = amplitude1 / SHORT_SCALE;
     const float delta = (amplitude2 - amplitude1) / (SHORT_SCALE * (float) numFrames);
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        for (int sampleIndex = 0; sampleIndex < samplesPerFrame; sampleIndex++) {
-            *destination++ = *source++ * scaler;
-        }
-        scaler += delta;
-    }
+    conversion::rampInBlocks(numFrames, samplesPerFrame,
+            [&](int32_t) {
+                const float frameScaler = scaler;
+                scaler += delta;
+                return frameScaler;
+            },
+            [&](int32_t firstSample, int32_t numSamples, const auto &gain) {
+                conversion::pcm16ToFloat<false>(source + firstSample, destination + firstSample,
+                                                numSamples, gain);
+            });
 }
 
 
@@ -142,16 +121,17 @@ void AAudio_linearRamp(const float *source,
                        float amplitude2) {
     float scaler = amplitude1;
     const float delta = (amplitude2 - amplitude1) / numFrames;
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        for (int sampleIndex = 0; sampleIndex < samplesPerFrame; sampleIndex++) {
-            float sample = *source++;
-            // Clip to valid range of a float sample to prevent excessive volume.
-            sample = clipToMinMaxHeadroom(sample);
-
-            *destination++ = sample * scaler;
-        }
-        scaler += delta;
-    }
+    conversion::rampInBlocks(numFrames, samplesPerFrame,
+            [&](int32_t) {
+                const float frameScaler = scaler;
+                scaler += delta;
+                return frameScaler;
+            },
+            [&](int32_t firstSample, int32_t numSamples, const auto &gain) {
+                // Clip to valid range of a float sample to prevent excessive volume.
+                conversion::clipFloat<false>(source + firstSample, destination + firstSample,
+                                             numSamples, gain);
+            });
 }
 
 // This code assumes amplitude1 and amplitude2 are between 0.0 and 1.0
@@ -164,14 +144,16 @@ void AAudio_linearRamp(const int16_t *source,
     // Because we are converting from int16 to 1nt16, we do not have to scale by 1/32768.
     float scaler = amplitude1;
     const float delta = (amplitude2 - amplitude1) / numFrames;
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        for (int sampleIndex = 0; sampleIndex < samplesPerFrame; sampleIndex++) {
-            // No need to clip because int16_t range is inherently limited.
-            float sample =  *source++ * scaler;
-            *destination++ = (int16_t) roundf(sample);
-        }
-        scaler += delta;
-    }
+    conversion::rampInBlocks(numFrames, samplesPerFrame,
+            [&](int32_t) {
+                const float frameScaler = scaler;
+                scaler += delta;
+                return frameScaler;
+            },
+            [&](int32_t firstSample, int32_t numSamples, const auto &gain) {
+                conversion::scalePcm16<false>(source + firstSample, destination + firstSample,
+                                              numSamples, gain);
+            });
 }
 
 // *************************************************************************************
@@ -180,13 +162,8 @@ void AAudioConvert_formatMonoToStereo(const float *source,
                                       int16_t *destination,
                                       int32_t numFrames,
                                       float amplitude) {
-    const float scaler = amplitude;
-    for (int i = 0; i < numFrames; i++) {
-        float sample = *source++;
-        int16_t sample16 = clipAndClampFloatToPcm16(sample, scaler);
-        *destination++ = sample16;
-        *destination++ = sample16;
-    }
+    conversion::floatToPcm16<true>(source, destination, numFrames,
+                                   conversion::ConstantGain(amplitude));
 }
 
 void AAudioConvert_formatMonoToStereo(const float *source,
@@ -196,13 +173,14 @@ void AAudioConvert_formatMonoToStereo(const float *source,
                                       float amplitude2) {
     // divide by numFrames so that we almost reach amplitude2
     const float delta = (amplitude2 - amplitude1) / numFrames;
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        const float scaler = amplitude1 + (frameIndex * delta);
-        const float sample = *source++;
-        int16_t sample16 = clipAndClampFloatToPcm16(sample, scaler);
-        *destination++ = sample16;
-        *destination++ = sample16;
-    }
+    conversion::rampInBlocks(numFrames, 1,
+            [&](int32_t frameIndex) {
+                return amplitude1 + (frameIndex * delta);
+            },
+            [&](int32_t firstFrame, int32_t frames, const auto &gain) {
+                conversion::floatToPcm16<true>(source + firstFrame, destination + 2 * firstFrame,
+                                               frames, gain);
+            });
 }
 
 void AAudioConvert_formatMonoToStereo(const int16_t *source,
@@ -210,11 +188,8 @@ void AAudioConvert_formatMonoToStereo(const int16_t *source,
                                       int32_t numFrames,
                                       float amplitude) {
     const float scaler = amplitude / SHORT_SCALE;
-    for (int i = 0; i < numFrames; i++) {
-        float sample = source[i] * scaler;
-        *destination++ = sample;
-        *destination++ = sample;
-    }
+    conversion::pcm16ToFloat<true>(source, destination, numFrames,
+                                   conversion::ConstantGain(scaler));
 }
 
 // This code assumes amplitude1 and amplitude2 are between 0.0 and 1.0
@@ -225,12 +200,14 @@ void AAudioConvert_formatMonoToStereo(const int16_t *source,
                                       float amplitude2) {
     const float scaler1 = amplitude1 / SHORT_SCALE;
     const float delta = (amplitude2 - amplitude1) / (SHORT_SCALE * (float) numFrames);
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        float scaler = scaler1 + (frameIndex * delta);
-        float sample = source[frameIndex] * scaler;
-        *destination++ = sample;
-        *destination++ = sample;
-    }
+    conversion::rampInBlocks(numFrames, 1,
+            [&](int32_t frameIndex) {
+                return scaler1 + (frameIndex * delta);
+            },
+            [&](int32_t firstFrame, int32_t frames, const auto &gain) {
+                conversion::pcm16ToFloat<true>(source + firstFrame, destination + 2 * firstFrame,
+                                               frames, gain);
+            });
 }
 
 // This code assumes amplitude1 and amplitude2 are between 0.0 and 1.0
@@ -240,17 +217,15 @@ void AAudio_linearRampMonoToStereo(const float *source,
                                    float amplitude1,
                                    float amplitude2) {
     const float delta = (amplitude2 - amplitude1) / numFrames;
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        float sample = *source++;
-
-        // Clip to valid range of a float sample to prevent excessive volume.
-        sample = clipToMinMaxHeadroom(sample);
-
-        const float scaler = amplitude1 + (frameIndex * delta);
-        float sampleScaled = sample * scaler;
-        *destination++ = sampleScaled;
-        *destination++ = sampleScaled;
-    }
+    conversion::rampInBlocks(numFrames, 1,
+            [&](int32_t frameIndex) {
+                return amplitude1 + (frameIndex * delta);
+            },
+            [&](int32_t firstFrame, int32_t frames, const auto &gain) {
+                // Clip to valid range of a float sample to prevent excessive volume.
+                conversion::clipFloat<true>(source + firstFrame, destination + 2 * firstFrame,
+                                            frames, gain);
+            });
 }
 
 // This code assumes amplitude1 and amplitude2 are between 0.0 and 1.0
@@ -261,14 +236,14 @@ void AAudio_linearRampMonoToStereo(const int16_t *source,
                                    float amplitude2) {
     // Because we are converting from int16 to 1nt16, we do not have to scale by 1/32768.
     const float delta = (amplitude2 - amplitude1) / numFrames;
-    for (int frameIndex = 0; frameIndex < numFrames; frameIndex++) {
-        const float scaler = amplitude1 + (frameIndex * delta);
-        // No need to clip because int16_t range is inherently limited.
-        const float sample =  *source++ * scaler;
-        int16_t sample16 = (int16_t) roundf(sample);
-        *destination++ = sample16;
-        *destination++ = sample16;
-    }
+    conversion::rampInBlocks(numFrames, 1,
+            [&](int32_t frameIndex) {
+                return amplitude1 + (frameIndex * delta);
+            },
+            [&](int32_t firstFrame, int32_t frames, const auto &gain) {
+                conversion::scalePcm16<true>(source + firstFrame, destination + 2 * firstFrame,
+                                             frames, gain);
+            });
 }
 
 // *************************************************************************************
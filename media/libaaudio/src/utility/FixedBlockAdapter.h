@@ -30,6 +30,9 @@ public:
 
 /**
  * Base class for a variable-to-fixed-size block adapter.
+ *
+ * Whole fixed-size blocks are passed to the processor in place, straight out of the
+ * variable-sized block. Only a partial block is staged in internal storage.
  */
 class FixedBlockAdapter
 {
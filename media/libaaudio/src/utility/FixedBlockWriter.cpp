@@ -52,7 +52,9 @@ int32_t FixedBlockWriter::processVariableBlock(uint8_t *buffer, int32_t numBytes
     }
 
     // Write through if enough for a complete block.
-    while(bytesLeft > mSize && result == 0) {
+    // An exact block goes straight through too, rather than sitting in storage
+    // until the next call.
+    while(bytesLeft >= mSize && result == 0) {
         result = mFixedBlockProcessor.onProcessFixedBlock(buffer, mSize);
         buffer += mSize;
         bytesLeft -= mSize;
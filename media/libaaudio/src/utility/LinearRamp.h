@@ -71,6 +71,16 @@ public:
         return mLevelFrom;
     }
 
+    /**
+     * Call this from the same thread that calls nextSegment().
+     *
+     * @param level
+     * @return true if the ramp has finished at level and the target is still level
+     */
+    bool isSteadyAt(float level) {
+        return mRemaining == 0 && mLevelFrom == level && mTarget.load() == level;
+    }
+
     /**
      * Get levels for next ramp segment.
      *
@@ -0,0 +1,363 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UTILITY_SAMPLE_CONVERSION_H
+#define UTILITY_SAMPLE_CONVERSION_H
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * Sample kernels behind the AAudio format conversion and ramp functions.
+ *
+ * Each kernel processes 4 samples at a time with NEON or SSE2 and finishes
+ * with the scalar code, which is also the portable fallback. The vector paths
+ * produce bit-identical output to the scalar code:
+ *  - clipping uses min/max instructions that return the number when the input
+ *    is NaN, like fminf() and fmaxf(),
+ *  - conversion to int16_t rounds half away from zero, like roundf().
+ *
+ * NEON is only used on AArch64, which has both vminnm/vmaxnm and vcvta.
+ */
+
+#if defined(__aarch64__)
+#define AAUDIO_USE_NEON (true)
+#include <arm_neon.h>
+#else
+#define AAUDIO_USE_NEON (false)
+#endif
+
+#if !AAUDIO_USE_NEON && defined(__SSE2__)
+#define AAUDIO_USE_SSE (true)
+#include <emmintrin.h>
+#else
+#define AAUDIO_USE_SSE (false)
+#endif
+
+#define AAUDIO_USE_SIMD (AAUDIO_USE_NEON || AAUDIO_USE_SSE)
+
+namespace aaudio {
+namespace conversion {
+
+// This is 3 dB, (10^(3/20)), to match the maximum headroom in AudioTrack for float data.
+// It is designed to allow occasional transient peaks.
+static constexpr float kMaxHeadroom = 1.41253754f;
+static constexpr float kMinHeadroom = 0 - kMaxHeadroom;
+
+static constexpr float kShortScale = 32768.0f;
+
+// TODO expose and call clamp16_from_float function in primitives.h
+// That one rounds differently, so switching would change the output.
+static inline int16_t clamp16_from_float(float f) {
+    static const float scale = 1 << 15;
+    return (int16_t) roundf(fmaxf(fminf(f * scale, scale - 1.f), -scale));
+}
+
+// Clip to valid range of a float sample to prevent excessive volume.
+// By using fmin and fmax we also protect against NaN.
+static inline float clipToMinMaxHeadroom(float input) {
+    return fmin(kMaxHeadroom, fmax(kMinHeadroom, input));
+}
+
+static inline int16_t clipAndClampFloatToPcm16(float sample, float scaler) {
+    // Clip to valid range of a float sample to prevent excessive volume.
+    sample = clipToMinMaxHeadroom(sample);
+
+    // Scale and convert to a short.
+    float fval = sample * scaler;
+    return clamp16_from_float(fval);
+}
+
+#if AAUDIO_USE_NEON
+
+typedef float32x4_t vfloat;
+typedef int32x4_t vint;
+
+static inline vfloat vLoad(const float *p) { return vld1q_f32(p); }
+static inline void vStore(float *p, vfloat v) { vst1q_f32(p, v); }
+static inline vfloat vSplat(float f) { return vdupq_n_f32(f); }
+static inline vfloat vMul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+// Like fmaxf() and fminf(): a NaN operand loses against a number.
+static inline vfloat vMax(vfloat a, vfloat b) { return vmaxnmq_f32(a, b); }
+static inline vfloat vMin(vfloat a, vfloat b) { return vminnmq_f32(a, b); }
+
+static inline vfloat vLoadPcm16(const int16_t *p) {
+    return vcvtq_f32_s32(vmovl_s16(vld1_s16(p)));
+}
+
+// Like (int32_t) roundf(v).
+static inline vint vRound(vfloat v) { return vcvtaq_s32_f32(v); }
+
+static inline void vStorePcm16(int16_t *p, vint v) { vst1_s16(p, vqmovn_s32(v)); }
+
+// Store every lane twice, for mono to stereo.
+static inline void vStoreTwice(float *p, vfloat v) {
+    vst1q_f32(p, vzip1q_f32(v, v));
+    vst1q_f32(p + 4, vzip2q_f32(v, v));
+}
+
+static inline void vStorePcm16Twice(int16_t *p, vint v) {
+    int16x4_t narrow = vqmovn_s32(v);
+    vst1q_s16(p, vcombine_s16(vzip1_s16(narrow, narrow), vzip2_s16(narrow, narrow)));
+}
+
+#elif AAUDIO_USE_SSE
+
+typedef __m128 vfloat;
+typedef __m128i vint;
+
+static inline vfloat vLoad(const float *p) { return _mm_loadu_ps(p); }
+static inline void vStore(float *p, vfloat v) { _mm_storeu_ps(p, v); }
+static inline vfloat vSplat(float f) { return _mm_set1_ps(f); }
+static inline vfloat vMul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+// maxps and minps return the second operand if either one is NaN, so these
+// behave like fmaxf() and fminf() as long as b is never NaN.
+static inline vfloat vMax(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+static inline vfloat vMin(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+
+static inline vfloat vLoadPcm16(const int16_t *p) {
+    __m128i pcm = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+    return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16));
+}
+
+// Like (int32_t) roundf(v): truncate, then step away from zero if the
+// dropped fraction is at least one half. The fraction is exact for any
+// value that fits in an int16_t.
+static inline vint vRound(vfloat v) {
+    const vint truncated = _mm_cvttps_epi32(v);
+    const vfloat fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(truncated));
+    const vfloat magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), fraction);
+    const vint roundAway = _mm_castps_si128(_mm_cmpge_ps(magnitude, _mm_set1_ps(0.5f)));
+    // -1 for negative input, +1 otherwise
+    const vint step = _mm_or_si128(_mm_srai_epi32(_mm_castps_si128(v), 31), _mm_set1_epi32(1));
+    return _mm_add_epi32(truncated, _mm_and_si128(roundAway, step));
+}
+
+static inline void vStorePcm16(int16_t *p, vint v) {
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packs_epi32(v, v));
+}
+
+// Store every lane twice, for mono to stereo.
+static inline void vStoreTwice(float *p, vfloat v) {
+    _mm_storeu_ps(p, _mm_unpacklo_ps(v, v));
+    _mm_storeu_ps(p + 4, _mm_unpackhi_ps(v, v));
+}
+
+static inline void vStorePcm16Twice(int16_t *p, vint v) {
+    __m128i narrow = _mm_packs_epi32(v, v);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_unpacklo_epi16(narrow, narrow));
+}
+
+#endif // AAUDIO_USE_SSE
+
+/**
+ * Gain applied to every sample of a kernel call.
+ */
+class ConstantGain {
+public:
+    explicit ConstantGain(float gain)
+        : mGain(gain)
+#if AAUDIO_USE_SIMD
+        , mVector(vSplat(gain))
+#endif
+    {}
+
+    float scalar(int32_t /* index */) const { return mGain; }
+#if AAUDIO_USE_SIMD
+    vfloat vector(int32_t /* index */) const { return mVector; }
+#endif
+
+private:
+    const float mGain;
+#if AAUDIO_USE_SIMD
+    const vfloat mVector;
+#endif
+};
+
+/**
+ * One gain per source sample.
+ */
+class SampleGains {
+public:
+    explicit SampleGains(const float *gains) : mGains(gains) {}
+
+    float scalar(int32_t index) const { return mGains[index]; }
+#if AAUDIO_USE_SIMD
+    vfloat vector(int32_t index) const { return vLoad(mGains + index); }
+#endif
+
+private:
+    const float *mGains;
+};
+
+/*
+ * Kernels. Each one reads numSamples source samples and applies gain to them.
+ * When TWICE is true every result is written twice, which turns a mono source
+ * into a stereo destination.
+ */
+
+template <bool TWICE, typename Gain>
+static inline void floatToPcm16(const float *source, int16_t *destination,
+                                int32_t numSamples, const Gain &gain) {
+    int32_t i = 0;
+#if AAUDIO_USE_SIMD
+    const vfloat minHeadroom = vSplat(kMinHeadroom);
+    const vfloat maxHeadroom = vSplat(kMaxHeadroom);
+    const vfloat shortScale = vSplat(kShortScale);
+    const vfloat shortMin = vSplat(-kShortScale);
+    const vfloat shortMax = vSplat(kShortScale - 1.f);
+    for (; i + 4 <= numSamples; i += 4) {
+        vfloat sample = vMin(vMax(vLoad(source + i), minHeadroom), maxHeadroom);
+        sample = vMul(vMul(sample, gain.vector(i)), shortScale);
+        const vint sample16 = vRound(vMax(vMin(sample, shortMax), shortMin));
+        if (TWICE) {
+            vStorePcm16Twice(destination + 2 * i, sample16);
+        } else {
+            vStorePcm16(destination + i, sample16);
+        }
+    }
+#endif
+    for (; i < numSamples; i++) {
+        const int16_t sample16 = clipAndClampFloatToPcm16(source[i], gain.scalar(i));
+        if (TWICE) {
+            destination[2 * i] = sample16;
+            destination[2 * i + 1] = sample16;
+        } else {
+            destination[i] = sample16;
+        }
+    }
+}
+
+template <bool TWICE, typename Gain>
+static inline void pcm16ToFloat(const int16_t *source, float *destination,
+                                int32_t numSamples, const Gain &gain) {
+    int32_t i = 0;
+#if AAUDIO_USE_SIMD
+    for (; i + 4 <= numSamples; i += 4) {
+        const vfloat sample = vMul(vLoadPcm16(source + i), gain.vector(i));
+        if (TWICE) {
+            vStoreTwice(destination + 2 * i, sample);
+        } else {
+            vStore(destination + i, sample);
+        }
+    }
+#endif
+    for (; i < numSamples; i++) {
+        const float sample = source[i] * gain.scalar(i);
+        if (TWICE) {
+            destination[2 * i] = sample;
+            destination[2 * i + 1] = sample;
+        } else {
+            destination[i] = sample;
+        }
+    }
+}
+
+template <bool TWICE, typename Gain>
+static inline void clipFloat(const float *source, float *destination,
+                             int32_t numSamples, const Gain &gain) {
+    int32_t i = 0;
+#if AAUDIO_USE_SIMD
+    const vfloat minHeadroom = vSplat(kMinHeadroom);
+    const vfloat maxHeadroom = vSplat(kMaxHeadroom);
+    for (; i + 4 <= numSamples; i += 4) {
+        vfloat sample = vMin(vMax(vLoad(source + i), minHeadroom), maxHeadroom);
+        sample = vMul(sample, gain.vector(i));
+        if (TWICE) {
+            vStoreTwice(destination + 2 * i, sample);
+        } else {
+            vStore(destination + i, sample);
+        }
+    }
+#endif
+    for (; i < numSamples; i++) {
+        const float sample = clipToMinMaxHeadroom(source[i]) * gain.scalar(i);
+        if (TWICE) {
+            destination[2 * i] = sample;
+            destination[2 * i + 1] = sample;
+        } else {
+            destination[i] = sample;
+        }
+    }
+}
+
+// No need to clip because int16_t range is inherently limited.
+template <bool TWICE, typename Gain>
+static inline void scalePcm16(const int16_t *source, int16_t *destination,
+                              int32_t numSamples, const Gain &gain) {
+    int32_t i = 0;
+#if AAUDIO_USE_SIMD
+    for (; i + 4 <= numSamples; i += 4) {
+        const vint sample16 = vRound(vMul(vLoadPcm16(source + i), gain.vector(i)));
+        if (TWICE) {
+            vStorePcm16Twice(destination + 2 * i, sample16);
+        } else {
+            vStorePcm16(destination + i, sample16);
+        }
+    }
+#endif
+    for (; i < numSamples; i++) {
+        const int16_t sample16 = (int16_t) roundf(source[i] * gain.scalar(i));
+        if (TWICE) {
+            destination[2 * i] = sample16;
+            destination[2 * i + 1] = sample16;
+        } else {
+            destination[i] = sample16;
+        }
+    }
+}
+
+/**
+ * Run a kernel over a ramp, in blocks.
+ *
+ * nextScaler(frameIndex) is called once per frame, in order, and must compute
+ * the scaler exactly like the scalar loop did so the output does not change.
+ * kernel(firstSample, numSamples, gain) is called with a SampleGains for mono
+ * and stereo, and frame by frame with a ConstantGain for more channels.
+ */
+static constexpr int32_t kRampBlockFrames = 128;
+
+template <typename NextScaler, typename Kernel>
+static inline void rampInBlocks(int32_t numFrames, int32_t samplesPerFrame,
+                                NextScaler nextScaler, Kernel kernel) {
+    if (samplesPerFrame > 2) {
+        for (int32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+            kernel(frameIndex * samplesPerFrame, samplesPerFrame,
+                   ConstantGain(nextScaler(frameIndex)));
+        }
+        return;
+    }
+
+    float gains[kRampBlockFrames * 2];
+    for (int32_t firstFrame = 0; firstFrame < numFrames; firstFrame += kRampBlockFrames) {
+        const int32_t blockFrames = (numFrames - firstFrame < kRampBlockFrames)
+                ? numFrames - firstFrame : kRampBlockFrames;
+        float *gain = gains;
+        for (int32_t frameIndex = firstFrame; frameIndex < firstFrame + blockFrames;
+                frameIndex++) {
+            const float scaler = nextScaler(frameIndex);
+            for (int32_t sampleIndex = 0; sampleIndex < samplesPerFrame; sampleIndex++) {
+                *gain++ = scaler;
+            }
+        }
+        kernel(firstFrame * samplesPerFrame, blockFrames * samplesPerFrame, SampleGains(gains));
+    }
+}
+
+} // namespace conversion
+} // namespace aaudio
+
+#endif //UTILITY_SAMPLE_CONVERSION_H
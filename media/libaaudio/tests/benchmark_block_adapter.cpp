@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bytes staged by the block adapters for common pairs of device burst and
+// AAudio callback size.
+// Arguments are frames per variable-sized block and frames per callback.
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "utility/FixedBlockAdapter.h"
+#include "utility/FixedBlockReader.h"
+#include "utility/FixedBlockWriter.h"
+
+static const int32_t kBytesPerFrame = 2 * sizeof(float);
+
+static void BurstArguments(benchmark::internal::Benchmark *b) {
+    b->Args({192, 192});
+    b->Args({192, 96});
+    b->Args({96, 192});
+    b->Args({240, 192});
+    b->Args({256, 240});
+    b->Args({960, 192});
+}
+
+// Renders or consumes blocks and counts those that did not point into the caller's buffer.
+class StagingCounter : public FixedBlockProcessor {
+public:
+    explicit StagingCounter(int32_t variableBytes)
+            : mVariableBlock(variableBytes) {}
+
+    int32_t onProcessFixedBlock(uint8_t *buffer, int32_t numBytes) override {
+        uint8_t *begin = mVariableBlock.data();
+        if (buffer < begin || buffer + numBytes > begin + mVariableBlock.size()) {
+            mBytesStaged += numBytes;
+        }
+        benchmark::DoNotOptimize(buffer);
+        return 0;
+    }
+
+    std::vector<uint8_t> mVariableBlock;
+    int64_t              mBytesStaged = 0;
+};
+
+template <typename ADAPTER>
+static void BM_BlockAdapter(benchmark::State &state) {
+    const int32_t variableBytes = state.range(0) * kBytesPerFrame;
+    StagingCounter counter(variableBytes);
+    ADAPTER adapter(counter);
+    adapter.open(state.range(1) * kBytesPerFrame);
+    while (state.KeepRunning()) {
+        adapter.processVariableBlock(counter.mVariableBlock.data(), variableBytes);
+    }
+    adapter.close();
+    state.SetBytesProcessed(state.iterations() * variableBytes);
+    state.counters["staged"] = benchmark::Counter(counter.mBytesStaged,
+                                                  benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE(BM_BlockAdapter, FixedBlockReader)->Apply(BurstArguments);
+BENCHMARK_TEMPLATE(BM_BlockAdapter, FixedBlockWriter)->Apply(BurstArguments);
+
+BENCHMARK_MAIN();
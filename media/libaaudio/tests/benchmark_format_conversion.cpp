@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of converting one burst, vectorized vs the old scalar loops.
+// Arguments are frames per burst and channels per frame.
+
+#include <math.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "utility/AAudioUtilities.h"
+#include "scalar_conversion.h"
+
+static void BurstArguments(benchmark::internal::Benchmark *b) {
+    for (int frames : {48, 192, 960}) {
+        for (int channels : {1, 2}) {
+            b->Args({frames, channels});
+        }
+    }
+}
+
+static std::vector<float> makeSine(int32_t numSamples) {
+    std::vector<float> samples(numSamples);
+    for (int32_t i = 0; i < numSamples; i++) {
+        samples[i] = sinf(i * 0.01f);
+    }
+    return samples;
+}
+
+static std::vector<int16_t> makeShortSine(int32_t numSamples) {
+    std::vector<int16_t> samples(numSamples);
+    for (int32_t i = 0; i < numSamples; i++) {
+        samples[i] = (int16_t) (sinf(i * 0.01f) * 32767);
+    }
+    return samples;
+}
+
+template <void (*CONVERT)(const float *, int16_t *, int32_t, int32_t, float, float)>
+static void BM_FloatToPcm16Ramp(benchmark::State &state) {
+    const int32_t frames = state.range(0);
+    const int32_t channels = state.range(1);
+    std::vector<float> source = makeSine(frames * channels);
+    std::vector<int16_t> destination(frames * channels);
+    while (state.KeepRunning()) {
+        CONVERT(source.data(), destination.data(), frames, channels, 0.5f, 0.7f);
+        benchmark::DoNotOptimize(destination.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK_TEMPLATE(BM_FloatToPcm16Ramp, scalar::AAudioConvert_floatToPcm16)
+        ->Apply(BurstArguments);
+BENCHMARK_TEMPLATE(BM_FloatToPcm16Ramp, AAudioConvert_floatToPcm16)
+        ->Apply(BurstArguments);
+
+template <void (*CONVERT)(const float *, int16_t *, int32_t, float)>
+static void BM_FloatToPcm16(benchmark::State &state) {
+    const int32_t numSamples = state.range(0) * state.range(1);
+    std::vector<float> source = makeSine(numSamples);
+    std::vector<int16_t> destination(numSamples);
+    while (state.KeepRunning()) {
+        CONVERT(source.data(), destination.data(), numSamples, 0.7f);
+        benchmark::DoNotOptimize(destination.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_FloatToPcm16, scalar::AAudioConvert_floatToPcm16)
+        ->Apply(BurstArguments);
+BENCHMARK_TEMPLATE(BM_FloatToPcm16, AAudioConvert_floatToPcm16)
+        ->Apply(BurstArguments);
+
+template <void (*CONVERT)(const int16_t *, float *, int32_t, int32_t, float, float)>
+static void BM_Pcm16ToFloatRamp(benchmark::State &state) {
+    const int32_t frames = state.range(0);
+    const int32_t channels = state.range(1);
+    std::vector<int16_t> source = makeShortSine(frames * channels);
+    std::vector<float> destination(frames * channels);
+    while (state.KeepRunning()) {
+        CONVERT(source.data(), destination.data(), frames, channels, 0.5f, 0.7f);
+        benchmark::DoNotOptimize(destination.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK_TEMPLATE(BM_Pcm16ToFloatRamp, scalar::AAudioConvert_pcm16ToFloat)
+        ->Apply(BurstArguments);
+BENCHMARK_TEMPLATE(BM_Pcm16ToFloatRamp, AAudioConvert_pcm16ToFloat)
+        ->Apply(BurstArguments);
+
+template <void (*RAMP)(const float *, float *, int32_t, int32_t, float, float)>
+static void BM_LinearRampFloat(benchmark::State &state) {
+    const int32_t frames = state.range(0);
+    const int32_t channels = state.range(1);
+    std::vector<float> source = makeSine(frames * channels);
+    std::vector<float> destination(frames * channels);
+    while (state.KeepRunning()) {
+        RAMP(source.data(), destination.data(), frames, channels, 0.5f, 0.7f);
+        benchmark::DoNotOptimize(destination.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK_TEMPLATE(BM_LinearRampFloat, scalar::AAudio_linearRamp)
+        ->Apply(BurstArguments);
+BENCHMARK_TEMPLATE(BM_LinearRampFloat, AAudio_linearRamp)
+        ->Apply(BurstArguments);
+
+template <void (*RAMP)(const int16_t *, int16_t *, int32_t, int32_t, float, float)>
+static void BM_LinearRampPcm16(benchmark::State &state) {
+    const int32_t frames = state.range(0);
+    const int32_t channels = state.range(1);
+    std::vector<int16_t> source = makeShortSine(frames * channels);
+    std::vector<int16_t> destination(frames * channels);
+    while (state.KeepRunning()) {
+        RAMP(source.data(), destination.data(), frames, channels, 0.5f, 0.7f);
+        benchmark::DoNotOptimize(destination.data());
+    }
+    state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK_TEMPLATE(BM_LinearRampPcm16, scalar::AAudio_linearRamp)
+        ->Apply(BurstArguments);
+BENCHMARK_TEMPLATE(BM_LinearRampPcm16, AAudio_linearRamp)
+        ->Apply(BurstArguments);
+
+BENCHMARK_MAIN();
@@ -149,3 +149,53 @@ TEST(test_block_adapter, block_adapter_read) {
     ASSERT_EQ(0, result);
 };
 
+// Count the blocks that had to be staged in the adapter's storage.
+class InPlaceChecker : public FixedBlockProcessor {
+public:
+    int32_t onProcessFixedBlock(uint8_t *buffer, int32_t numBytes) override {
+        if (buffer >= mVariableBlock
+                && buffer + numBytes <= mVariableBlock + sizeof(mVariableBlock)) {
+            mBlocksInPlace++;
+        } else {
+            mBlocksStaged++;
+        }
+        return 0;
+    }
+
+    uint8_t mVariableBlock[sizeof(int32_t) * FIXED_BLOCK_SIZE * 2];
+    int32_t mBlocksInPlace = 0;
+    int32_t mBlocksStaged = 0;
+};
+
+TEST(test_block_adapter, block_adapter_write_in_place) {
+    InPlaceChecker checker;
+    FixedBlockWriter writer(checker);
+    const int32_t blockBytes = sizeof(int32_t) * FIXED_BLOCK_SIZE;
+    writer.open(blockBytes);
+
+    // Whole blocks must be delivered during the same call, without staging.
+    for (int i = 1; i <= 10; i++) {
+        ASSERT_EQ(0, writer.processVariableBlock(checker.mVariableBlock, blockBytes));
+        ASSERT_EQ(i, checker.mBlocksInPlace);
+    }
+    ASSERT_EQ(0, writer.processVariableBlock(checker.mVariableBlock, 2 * blockBytes));
+    ASSERT_EQ(12, checker.mBlocksInPlace);
+    ASSERT_EQ(0, checker.mBlocksStaged);
+    writer.close();
+}
+
+TEST(test_block_adapter, block_adapter_read_in_place) {
+    InPlaceChecker checker;
+    FixedBlockReader reader(checker);
+    const int32_t blockBytes = sizeof(int32_t) * FIXED_BLOCK_SIZE;
+    reader.open(blockBytes);
+
+    for (int i = 1; i <= 10; i++) {
+        ASSERT_EQ(0, reader.processVariableBlock(checker.mVariableBlock, blockBytes));
+        ASSERT_EQ(i, checker.mBlocksInPlace);
+    }
+    ASSERT_EQ(0, reader.processVariableBlock(checker.mVariableBlock, 2 * blockBytes));
+    ASSERT_EQ(12, checker.mBlocksInPlace);
+    ASSERT_EQ(0, checker.mBlocksStaged);
+    reader.close();
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Check that the vectorized conversions match the old scalar loops bit for bit.
+
+#include <math.h>
+#include <random>
+#include <string.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utility/AAudioUtilities.h"
+#include "scalar_conversion.h"
+
+// Odd sizes exercise the scalar tail after the vector loop.
+static const int32_t kFrameCounts[] = {1, 3, 4, 7, 64, 127, 128, 129, 192, 1001};
+static const int32_t kMaxChannels = 8;
+
+class FormatConversionTest : public ::testing::Test {
+protected:
+    void fill(int32_t numSamples) {
+        std::uniform_real_distribution<float> distribution(-1.6f, 1.6f);
+        mFloats.resize(numSamples);
+        mShorts.resize(numSamples);
+        for (int32_t i = 0; i < numSamples; i++) {
+            mFloats[i] = distribution(mRandom);
+            mShorts[i] = (int16_t) mRandom();
+        }
+        // Values that take the unusual paths of clipping and rounding.
+        const float specials[] = {
+                NAN, INFINITY, -INFINITY, -0.0f, 1e-40f,
+                1.0f, -1.0f, 0.5f / 32768, -0.5f / 32768, 2.5f / 32768, -2.5f / 32768,
+        };
+        for (size_t i = 0; i < sizeof(specials) / sizeof(specials[0]); i++) {
+            mFloats[mRandom() % numSamples] = specials[i];
+        }
+    }
+
+    template <typename T>
+    static void expectSame(const std::vector<T> &expected, const std::vector<T> &actual) {
+        ASSERT_EQ(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            ASSERT_EQ(0, memcmp(&expected[i], &actual[i], sizeof(T)))
+                    << "sample " << i << ": " << expected[i] << " != " << actual[i];
+        }
+    }
+
+    std::mt19937 mRandom{42};
+    std::vector<float> mFloats;
+    std::vector<int16_t> mShorts;
+};
+
+TEST_F(FormatConversionTest, float_to_pcm16) {
+    for (int32_t numFrames : kFrameCounts) {
+        for (int32_t channels = 1; channels <= kMaxChannels; channels++) {
+            const int32_t numSamples = numFrames * channels;
+            fill(numSamples);
+            std::vector<int16_t> expected(numSamples);
+            std::vector<int16_t> actual(numSamples);
+
+            scalar::AAudioConvert_floatToPcm16(mFloats.data(), expected.data(), numSamples, 0.7f);
+            AAudioConvert_floatToPcm16(mFloats.data(), actual.data(), numSamples, 0.7f);
+            expectSame(expected, actual);
+
+            scalar::AAudioConvert_floatToPcm16(mFloats.data(), expected.data(),
+                                               numFrames, channels, 0.2f, 0.9f);
+            AAudioConvert_floatToPcm16(mFloats.data(), actual.data(),
+                                       numFrames, channels, 0.2f, 0.9f);
+            expectSame(expected, actual);
+        }
+    }
+}
+
+TEST_F(FormatConversionTest, pcm16_to_float) {
+    for (int32_t numFrames : kFrameCounts) {
+        for (int32_t channels = 1; channels <= kMaxChannels; channels++) {
+            const int32_t numSamples = numFrames * channels;
+            fill(numSamples);
+            std::vector<float> expected(numSamples);
+            std::vector<float> actual(numSamples);
+
+            scalar::AAudioConvert_pcm16ToFloat(mShorts.data(), expected.data(), numSamples, 0.7f);
+            AAudioConvert_pcm16ToFloat(mShorts.data(), actual.data(), numSamples, 0.7f);
+            expectSame(expected, actual);
+
+            scalar::AAudioConvert_pcm16ToFloat(mShorts.data(), expected.data(),
+                                               numFrames, channels, 0.9f, 0.2f);
+            AAudioConvert_pcm16ToFloat(mShorts.data(), actual.data(),
+                                       numFrames, channels, 0.9f, 0.2f);
+            expectSame(expected, actual);
+        }
+    }
+}
+
+TEST_F(FormatConversionTest, linear_ramp) {
+    for (int32_t numFrames : kFrameCounts) {
+        for (int32_t channels = 1; channels <= kMaxChannels; channels++) {
+            const int32_t numSamples = numFrames * channels;
+            fill(numSamples);
+            std::vector<float> expectedFloats(numSamples);
+            std::vector<float> actualFloats(numSamples);
+            std::vector<int16_t> expectedShorts(numSamples);
+            std::vector<int16_t> actualShorts(numSamples);
+
+            scalar::AAudio_linearRamp(mFloats.data(), expectedFloats.data(),
+                                      numFrames, channels, 0.0f, 1.0f);
+            AAudio_linearRamp(mFloats.data(), actualFloats.data(),
+                              numFrames, channels, 0.0f, 1.0f);
+            expectSame(expectedFloats, actualFloats);
+
+            scalar::AAudio_linearRamp(mShorts.data(), expectedShorts.data(),
+                                      numFrames, channels, 1.0f, 0.3f);
+            AAudio_linearRamp(mShorts.data(), actualShorts.data(),
+                              numFrames, channels, 1.0f, 0.3f);
+            expectSame(expectedShorts, actualShorts);
+        }
+    }
+}
+
+// The mono to stereo conversions are only reachable through AAudioDataConverter.
+TEST_F(FormatConversionTest, mono_to_stereo) {
+    for (int32_t numFrames : kFrameCounts) {
+        fill(numFrames);
+        std::vector<float> expectedFloats(numFrames * 2);
+        std::vector<float> actualFloats(numFrames * 2);
+        std::vector<int16_t> expectedShorts(numFrames * 2);
+        std::vector<int16_t> actualShorts(numFrames * 2);
+
+        AAudioDataConverter::FormattedData floatMono(mFloats.data(), AAUDIO_FORMAT_PCM_FLOAT, 1);
+        AAudioDataConverter::FormattedData shortMono(mShorts.data(), AAUDIO_FORMAT_PCM_I16, 1);
+        AAudioDataConverter::FormattedData floatStereo(actualFloats.data(),
+                                                       AAUDIO_FORMAT_PCM_FLOAT, 2);
+        AAudioDataConverter::FormattedData shortStereo(actualShorts.data(),
+                                                       AAUDIO_FORMAT_PCM_I16, 2);
+
+        for (float levelTo : {0.4f, 0.8f}) {
+            const float levelFrom = 0.4f;
+
+            AAudioDataConverter::convert(floatMono, shortStereo, numFrames, levelFrom, levelTo);
+            if (levelFrom == levelTo) {
+                scalar::AAudioConvert_formatMonoToStereo(mFloats.data(), expectedShorts.data(),
+                                                         numFrames, levelTo);
+            } else {
+                scalar::AAudioConvert_formatMonoToStereo(mFloats.data(), expectedShorts.data(),
+                                                         numFrames, levelFrom, levelTo);
+            }
+            expectSame(expectedShorts, actualShorts);
+
+            AAudioDataConverter::convert(shortMono, floatStereo, numFrames, levelFrom, levelTo);
+            if (levelFrom == levelTo) {
+                scalar::AAudioConvert_formatMonoToStereo(mShorts.data(), expectedFloats.data(),
+                                                         numFrames, levelTo);
+            } else {
+                scalar::AAudioConvert_formatMonoToStereo(mShorts.data(), expectedFloats.data(),
+                                                         numFrames, levelFrom, levelTo);
+            }
+            expectSame(expectedFloats, actualFloats);
+
+            AAudioDataConverter::convert(floatMono, floatStereo, numFrames, levelFrom, levelTo);
+            scalar::AAudio_linearRampMonoToStereo(mFloats.data(), expectedFloats.data(),
+                                                  numFrames, levelFrom, levelTo);
+            expectSame(expectedFloats, actualFloats);
+
+            AAudioDataConverter::convert(shortMono, shortStereo, numFrames, levelFrom, levelTo);
+            scalar::AAudio_linearRampMonoToStereo(mShorts.data(), expectedShorts.data(),
+                                                  numFrames, levelFrom, levelTo);
+            expectSame(expectedShorts, actualShorts);
+        }
+    }
+}
+
+// Every float that lands within one step of a rounding boundary of int16_t.
+TEST_F(FormatConversionTest, float_to_pcm16_rounding) {
+    std::vector<float> source;
+    for (int32_t value = -32769; value <= 32768; value++) {
+        const float half = (value + 0.5f) / 32768;
+        source.push_back(nextafterf(half, -INFINITY));
+        source.push_back(half);
+        source.push_back(nextafterf(half, INFINITY));
+    }
+    std::vector<int16_t> expected(source.size());
+    std::vector<int16_t> actual(source.size());
+    scalar::AAudioConvert_floatToPcm16(source.data(), expected.data(), source.size(), 1.0f);
+    AAudioConvert_floatToPcm16(source.data(), actual.data(), source.size(), 1.0f);
+    expectSame(expected, actual);
+}
@@ -24,6 +24,8 @@
 #include <sys/types.h>
 #include <unordered_map>
 
+#include <cpustats/CycleTimeStatistics.h>
+
 #include <media/AudioBufferProvider.h>
 #include <media/AudioResampler.h>
 #include <media/AudioResamplerPublic.h>
@@ -132,9 +134,23 @@ public:
     void        setBufferProvider(int name, AudioBufferProvider* bufferProvider);
 
     void        process() {
+        if (mTimingEnabled) {
+            processTimed();
+            return;
+        }
         (this->*mHook)();
     }
 
+    // Enables or disables timing of process(). While enabled, the wall clock time of each
+    // process() call is kept per process hook, and the time spent in the hooks of each
+    // enabled track is kept per track. This costs two CLOCK_MONOTONIC reads per track hook
+    // call. Times kept so far are not discarded when disabled.
+    // Must be called from the thread that calls process(), or before it starts.
+    void        setTimingEnabled(bool enabled);
+
+    // Summarizes the times kept since timing was enabled, one line per hook and track.
+    std::string timingSummary() const;
+
     size_t      getUnreleasedFrames(int name) const;
 
     std::string trackNames() const {
@@ -216,6 +232,7 @@ private:
     struct Track {
         Track()
             : bufferProvider(nullptr)
+            , mMixNs(0)
         {
             // TODO: move additional initialization here.
         }
@@ -336,6 +353,11 @@ private:
 
         AudioPlaybackRate    mPlaybackRate;
 
+        // time spent in the track hooks during one process(), and its recent values,
+        // allocated once timing is enabled
+        int64_t                               mMixNs;
+        std::unique_ptr<CycleTimeStatistics> mMixStats;
+
     private:
         // hooks
         void track__genericResample(int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux);
@@ -372,6 +394,28 @@ private:
     template <int MIXTYPE, typename TO, typename TI, typename TA>
     void process__noResampleOneTrack();
 
+    // process hooks as told apart by timing
+    enum {
+        TIMING_NOP,
+        TIMING_GENERIC_NO_RESAMPLING,
+        TIMING_GENERIC_RESAMPLING,
+        TIMING_ONE_TRACK,       // process__oneTrack16BitsStereoNoResampling, process__noResampleOneTrack
+        TIMING_HOOK_COUNT,
+    };
+
+    void processTimed();
+
+    // Calls the hook of track t, and adds the time spent in it to the track if timing.
+    void callTrackHook(Track *t, int32_t* out, size_t numFrames, int32_t* temp, int32_t* aux) {
+        if (!mTimingEnabled) {
+            (t->*t->hook)(out, numFrames, temp, aux);
+            return;
+        }
+        const int64_t startNs = CycleTimeStatistics::monotonicNs();
+        (t->*t->hook)(out, numFrames, temp, aux);
+        t->mMixNs += CycleTimeStatistics::monotonicNs() - startNs;
+    }
+
     static process_hook_t getProcessHook(int processType, uint32_t channelCount,
             audio_format_t mixerInFormat, audio_format_t mixerOutFormat);
 
@@ -388,6 +432,11 @@ private:
 
     process_hook_t mHook = &AudioMixer::process__nop;   // one of process__*, never nullptr
 
+    bool mTimingEnabled = false;
+    // wall clock time of recent process() calls, indexed by TIMING_*, allocated once
+    // timing is enabled
+    std::unique_ptr<CycleTimeStatistics> mHookStats[TIMING_HOOK_COUNT];
+
     // the size of the type (int32_t) should be the largest of all types supported
     // by the mixer.
     std::unique_ptr<int32_t[]> mOutputTemp;
@@ -28,6 +28,9 @@ LOCAL_SHARED_LIBRARIES := \
     libsonic \
     libutils \
 
+LOCAL_STATIC_LIBRARIES := \
+    libcpustats \
+
 LOCAL_MODULE := libaudioprocessing
 
 LOCAL_CFLAGS := -Werror -Wall
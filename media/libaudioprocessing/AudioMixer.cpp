@@ -19,6 +19,7 @@
 //#define LOG_NDEBUG 0
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
@@ -171,6 +172,9 @@ status_t AudioMixer::create(
         // prepareForDownmix() may change mDownmixRequiresFormat
         ALOGVV("mMixerFormat:%#x  mMixerInFormat:%#x\n", t->mMixerFormat, t->mMixerInFormat);
         t->prepareForReformat();
+        if (mTimingEnabled) {
+            t->mMixStats.reset(new CycleTimeStatistics);
+        }
 
         mTracks[name] = t;
         return OK;
@@ -1252,6 +1256,101 @@ void AudioMixer::Track::track__16BitsMono(
     mIn = in;
 }
 
+void AudioMixer::setTimingEnabled(bool enabled)
+{
+    mTimingEnabled = enabled;
+    if (!enabled) {
+        return;
+    }
+    for (auto &stats : mHookStats) {
+        if (stats.get() == nullptr) {
+            stats.reset(new CycleTimeStatistics);
+        }
+    }
+    for (const auto &pair : mTracks) {
+        if (pair.second->mMixStats.get() == nullptr) {
+            pair.second->mMixStats.reset(new CycleTimeStatistics);
+        }
+    }
+}
+
+std::string AudioMixer::timingSummary() const
+{
+    static const char * const hookNames[TIMING_HOOK_COUNT] = {
+        "nop", "genericNoResampling", "genericResampling", "oneTrack",
+    };
+    std::stringstream ss;
+    char line[128];
+    for (size_t i = 0; i < TIMING_HOOK_COUNT; ++i) {
+        if (mHookStats[i].get() == nullptr) {
+            continue;
+        }
+        const CycleTimeStatistics::Summary summary = mHookStats[i]->summarize();
+        if (summary.n == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "    %-20s %4zu of %8llu calls %.0f/%.0f/%.0f/%.0f\n",
+                hookNames[i], summary.n, (unsigned long long) summary.count,
+                summary.wallMedian, summary.wall90, summary.wall99, summary.wallMax);
+        ss << line;
+    }
+    for (const auto &pair : mTracks) {
+        if (pair.second->mMixStats.get() == nullptr) {
+            continue;
+        }
+        const CycleTimeStatistics::Summary summary = pair.second->mMixStats->summarize();
+        if (summary.n == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "    track %-14d %4zu of %8llu calls %.0f/%.0f/%.0f/%.0f\n",
+                pair.first, summary.n, (unsigned long long) summary.count,
+                summary.wallMedian, summary.wall90, summary.wall99, summary.wallMax);
+        ss << line;
+    }
+    return ss.str();
+}
+
+void AudioMixer::processTimed()
+{
+    // process__validate() picks the hook and calls process() again, which times it.
+    if (mHook == &AudioMixer::process__validate) {
+        process__validate();
+        return;
+    }
+
+    size_t hook;
+    if (mHook == &AudioMixer::process__nop) {
+        hook = TIMING_NOP;
+    } else if (mHook == &AudioMixer::process__genericNoResampling) {
+        hook = TIMING_GENERIC_NO_RESAMPLING;
+    } else if (mHook == &AudioMixer::process__genericResampling) {
+        hook = TIMING_GENERIC_RESAMPLING;
+    } else {
+        hook = TIMING_ONE_TRACK;
+    }
+    for (const int name : mEnabled) {
+        mTracks[name]->mMixNs = 0;
+    }
+
+    const int64_t startNs = CycleTimeStatistics::monotonicNs();
+    (this->*mHook)();
+    const int64_t processNs = CycleTimeStatistics::monotonicNs() - startNs;
+
+    mHookStats[hook]->sample(processNs);
+    if (hook == TIMING_NOP) {
+        // no track is mixed
+        return;
+    }
+    if (hook == TIMING_ONE_TRACK && !mEnabled.empty()) {
+        // the one track is mixed inline rather than through its hook
+        mTracks[mEnabled[0]]->mMixNs = processNs;
+    }
+    for (const int name : mEnabled) {
+        const std::shared_ptr<Track> &t = mTracks[name];
+        t->mMixStats->sample(t->mMixNs);
+    }
+}
+
 // no-op case
 void AudioMixer::process__nop()
 {
@@ -1321,7 +1420,7 @@ void AudioMixer::process__genericNoResampling()
                     }
                     size_t inFrames = (t->frameCount > outFrames)?outFrames:t->frameCount;
                     if (inFrames > 0) {
-                        (t.get()->*t->hook)(
+                        callTrackHook(t.get(),
                                 outTemp + (frameCount - outFrames) * t->mMixerChannelCount,
                                 inFrames, mResampleTemp.get() /* naked ptr */, aux);
                         t->frameCount -= inFrames;
@@ -1386,7 +1485,7 @@ void AudioMixer::process__genericResampling()
             // acquire/release the buffers because it's done by
             // the resampler.
             if (t->needs & NEEDS_RESAMPLE) {
-                (t.get()->*t->hook)(outTemp, numFrames, mResampleTemp.get() /* naked ptr */, aux);
+                callTrackHook(t.get(), outTemp, numFrames, mResampleTemp.get() /* naked ptr */, aux);
             } else {
 
                 size_t outFrames = 0;
@@ -1399,7 +1498,7 @@ void AudioMixer::process__genericResampling()
                     // been enabled for mixing.
                     if (t->mIn == nullptr) break;
 
-                    (t.get()->*t->hook)(
+                    callTrackHook(t.get(),
                             outTemp + outFrames * t->mMixerChannelCount, t->buffer.frameCount,
                             mResampleTemp.get() /* naked ptr */,
                             aux != nullptr ? aux + outFrames : nullptr);
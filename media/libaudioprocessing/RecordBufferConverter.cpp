@@ -35,6 +35,12 @@ static inline T max(const T& a, const T& b)
     return a > b ? a : b;
 }
 
+template <typename T>
+static inline T min(const T& a, const T& b)
+{
+    return a < b ? a : b;
+}
+
 namespace android {
 
 RecordBufferConverter::RecordBufferConverter(
@@ -290,5 +296,97 @@ void RecordBufferConverter::convertResampler(
             frames * mDstChannelCount);
 }
 
+// ----------------------------------------------------------------------------
+
+SharedRecordBufferConverter::SharedRecordBufferConverter(
+        audio_channel_mask_t srcChannelMask, audio_format_t srcFormat,
+        uint32_t srcSampleRate,
+        audio_channel_mask_t dstChannelMask, audio_format_t dstFormat,
+        uint32_t dstSampleRate,
+        size_t frameCount) :
+            mConverter(srcChannelMask, srcFormat, srcSampleRate,
+                    dstChannelMask, dstFormat, dstSampleRate),
+            mDstChannelMask(dstChannelMask),
+            mDstFormat(dstFormat),
+            mDstSampleRate(dstSampleRate),
+            mFrameSize(audio_channel_count_from_in_mask(dstChannelMask)
+                    * audio_bytes_per_sample(dstFormat)),
+            mFrameCount(frameCount),
+            mBuffer(NULL),
+            mRear(0)
+{
+    if (mConverter.initCheck() != NO_ERROR || mFrameCount == 0) {
+        return;
+    }
+    (void)posix_memalign(&mBuffer, 32, mFrameCount * mFrameSize);
+}
+
+SharedRecordBufferConverter::~SharedRecordBufferConverter()
+{
+    free(mBuffer);
+}
+
+size_t SharedRecordBufferConverter::convert(AudioBufferProvider *provider, size_t frames)
+{
+    if (frames > mFrameCount) {
+        frames = mFrameCount;
+    }
+    size_t framesConverted = 0;
+    while (framesConverted < frames) {
+        // the ring may wrap, so convert into one contiguous part at a time
+        const size_t offset = mRear % mFrameCount;
+        const size_t part = min(frames - framesConverted, mFrameCount - offset);
+        const size_t done = mConverter.convert(
+                (uint8_t *)mBuffer + offset * mFrameSize, provider, part);
+        mRear += done;
+        framesConverted += done;
+        if (done < part) {
+            break;  // out of input
+        }
+    }
+    return framesConverted;
+}
+
+size_t SharedRecordBufferConverter::sync(int64_t *position, bool *hasOverrun) const
+{
+    const int64_t filled = mRear - *position;
+    size_t framesIn;
+    bool overrun = false;
+    if (filled < 0) {
+        // should not happen, but treat like a massive overrun and re-sync
+        framesIn = 0;
+        *position = mRear;
+        overrun = true;
+    } else if ((uint64_t) filled <= mFrameCount) {
+        framesIn = (size_t) filled;
+    } else {
+        // reader is not keeping up, but give it latest data
+        framesIn = mFrameCount;
+        *position = mRear - framesIn;
+        overrun = true;
+    }
+    if (hasOverrun != NULL) {
+        *hasOverrun = overrun;
+    }
+    return framesIn;
+}
+
+size_t SharedRecordBufferConverter::read(void *dst, int64_t *position, size_t frames) const
+{
+    const int64_t filled = mRear - *position;
+    LOG_ALWAYS_FATAL_IF(!(0 <= filled && (uint64_t) filled <= mFrameCount));
+    if (frames > (size_t) filled) {
+        frames = (size_t) filled;
+    }
+    const size_t offset = *position % mFrameCount;
+    const size_t part1 = min(frames, mFrameCount - offset);
+    memcpy(dst, (const uint8_t *)mBuffer + offset * mFrameSize, part1 * mFrameSize);
+    if (frames > part1) {
+        memcpy((uint8_t *)dst + part1 * mFrameSize, mBuffer, (frames - part1) * mFrameSize);
+    }
+    *position += frames;
+    return frames;
+}
+
 // ----------------------------------------------------------------------------
 } // namespace android
@@ -28,6 +28,32 @@ LOCAL_CFLAGS := -Werror -Wall
 
 include $(BUILD_NATIVE_TEST)
 
+#
+# record buffer converter unit test
+#
+include $(CLEAR_VARS)
+
+LOCAL_SHARED_LIBRARIES := \
+    libaudioutils \
+    libaudioprocessing \
+    libcutils \
+    liblog \
+    libutils \
+
+LOCAL_C_INCLUDES := \
+    $(call include-path-for, audio-utils) \
+
+LOCAL_SRC_FILES := \
+    record_buffer_converter_tests.cpp
+
+LOCAL_MODULE := record_buffer_converter_tests
+
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_TEST)
+
 #
 # audio mixer test tool
 #
@@ -85,3 +111,27 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_CFLAGS := -Werror -Wall
 
 include $(BUILD_EXECUTABLE)
+
+#
+# audio mixer benchmark
+#
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    mixer_benchmark.cpp \
+
+LOCAL_C_INCLUDES := \
+    $(call include-path-for, audio-utils) \
+
+LOCAL_SHARED_LIBRARIES := \
+    libaudioprocessing \
+    libaudioutils \
+    libcutils \
+    liblog \
+    libutils \
+
+LOCAL_MODULE := mixer_benchmark
+
+LOCAL_CFLAGS := -Werror -Wall
+
+include $(BUILD_NATIVE_BENCHMARK)
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures AudioMixer::process() with timing disabled and enabled, to show what the
+// per hook and per track timing costs. Arguments are the number of tracks, whether the
+// tracks are resampled, and whether timing is enabled.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/AudioMixer.h>
+
+using namespace android;
+
+static const size_t kMixerFrameCount = 960;   // 20 ms
+static const uint32_t kMixerSampleRate = 48000;
+static const size_t kChannelCount = 2;
+
+// Returns the same buffer of 16 bit stereo samples forever.
+class LoopProvider : public AudioBufferProvider {
+public:
+    explicit LoopProvider(size_t frames)
+        : mFrames(frames), mData(frames * kChannelCount) {
+        for (size_t i = 0; i < mData.size(); ++i) {
+            mData[i] = (int16_t) (i * 97);
+        }
+    }
+
+    virtual status_t getNextBuffer(Buffer *buffer) {
+        if (buffer->frameCount > mFrames) {
+            buffer->frameCount = mFrames;
+        }
+        buffer->i16 = mData.data();
+        return NO_ERROR;
+    }
+
+    virtual void releaseBuffer(Buffer *buffer) {
+        buffer->frameCount = 0;
+        buffer->raw = NULL;
+    }
+
+private:
+    const size_t mFrames;
+    std::vector<int16_t> mData;
+};
+
+static void BM_MixerProcess(benchmark::State& state) {
+    const size_t numTracks = state.range(0);
+    const bool resample = state.range(1) != 0;
+    const bool timing = state.range(2) != 0;
+
+    AudioMixer mixer(kMixerFrameCount, kMixerSampleRate);
+    mixer.setTimingEnabled(timing);
+    std::vector<float> output(kMixerFrameCount * kChannelCount);
+    std::vector<std::unique_ptr<LoopProvider>> providers;
+    const float volume = AudioMixer::UNITY_GAIN_FLOAT / numTracks;
+    for (size_t i = 0; i < numTracks; ++i) {
+        const int name = i;
+        providers.emplace_back(new LoopProvider(kMixerFrameCount * 2));
+        mixer.create(name, AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_16_BIT,
+                AUDIO_SESSION_OUTPUT_MIX);
+        mixer.setBufferProvider(name, providers.back().get());
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MAIN_BUFFER, output.data());
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_FORMAT,
+                (void *)(uintptr_t)AUDIO_FORMAT_PCM_FLOAT);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::FORMAT,
+                (void *)(uintptr_t)AUDIO_FORMAT_PCM_16_BIT);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::MIXER_CHANNEL_MASK,
+                (void *)(uintptr_t)AUDIO_CHANNEL_OUT_STEREO);
+        mixer.setParameter(name, AudioMixer::TRACK, AudioMixer::CHANNEL_MASK,
+                (void *)(uintptr_t)AUDIO_CHANNEL_OUT_STEREO);
+        mixer.setParameter(name, AudioMixer::RESAMPLE, AudioMixer::SAMPLE_RATE,
+                (void *)(uintptr_t)(resample ? 44100 : kMixerSampleRate));
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME0, (void *)&volume);
+        mixer.setParameter(name, AudioMixer::VOLUME, AudioMixer::VOLUME1, (void *)&volume);
+        mixer.enable(name);
+    }
+    // pick the process hook before measuring
+    mixer.process();
+
+    while (state.KeepRunning()) {
+        mixer.process();
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kMixerFrameCount);
+}
+
+// {tracks, resample, timing}
+BENCHMARK(BM_MixerProcess)
+    ->Args({1, 0, 0})->Args({1, 0, 1})
+    ->Args({4, 0, 0})->Args({4, 0, 1})
+    ->Args({16, 0, 0})->Args({16, 0, 1})
+    ->Args({4, 1, 0})->Args({4, 1, 1});
+
+BENCHMARK_MAIN();
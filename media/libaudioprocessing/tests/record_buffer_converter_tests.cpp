@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audioflinger_record_buffer_converter_tests"
+
+#include <math.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <log/log.h>
+#include <media/AudioBufferProvider.h>
+#include <media/RecordBufferConverter.h>
+
+using namespace android;
+
+// Stands in for the RecordThread input buffer: a stereo 16 bit stream
+// that grows by one HAL burst per cycle.
+class InputProvider : public AudioBufferProvider {
+public:
+    explicit InputProvider(uint32_t sampleRate) : mSampleRate(sampleRate), mFront(0) { }
+
+    void produce(size_t frames) {
+        for (size_t i = 0; i < frames; ++i) {
+            const double t = (double) (mData.size() / 2) / mSampleRate;
+            mData.push_back((int16_t) (sin(2 * M_PI * 440 * t) * 20000));
+            mData.push_back((int16_t) (sin(2 * M_PI * 1000 * t) * 20000));
+        }
+    }
+
+    size_t available() const { return mData.size() / 2 - mFront; }
+
+    // drops what was produced so far, like ResamplerBufferProvider::reset() at start()
+    void skipToRear() { mFront = mData.size() / 2; }
+
+    virtual status_t getNextBuffer(Buffer* buffer) {
+        const size_t frames = min(buffer->frameCount, available());
+        if (frames == 0) {
+            buffer->raw = NULL;
+            buffer->frameCount = 0;
+            return NOT_ENOUGH_DATA;
+        }
+        buffer->raw = &mData[mFront * 2];
+        buffer->frameCount = frames;
+        return NO_ERROR;
+    }
+
+    virtual void releaseBuffer(Buffer* buffer) {
+        mFront += buffer->frameCount;
+        buffer->raw = NULL;
+        buffer->frameCount = 0;
+    }
+
+private:
+    static size_t min(size_t a, size_t b) { return a < b ? a : b; }
+
+    const uint32_t       mSampleRate;
+    std::vector<int16_t> mData;
+    size_t               mFront;
+};
+
+// A fake capture client that drains the shared ring at its own pace.
+struct FakeClient {
+    FakeClient(const SharedRecordBufferConverter &shared, size_t framesPerCycle) :
+        mFramesPerCycle(framesPerCycle), mPosition(shared.rear()), mStart(shared.rear()),
+        mOverruns(0) { }
+
+    void cycle(const SharedRecordBufferConverter &shared, size_t frameSize) {
+        bool hasOverrun;
+        const size_t framesIn = shared.sync(&mPosition, &hasOverrun);
+        if (hasOverrun) {
+            mOverruns++;
+            // what was skipped is lost to this client
+            mReceived.resize((mPosition - mStart) * frameSize);
+        }
+        const size_t frames = framesIn < mFramesPerCycle ? framesIn : mFramesPerCycle;
+        const size_t offset = mReceived.size();
+        mReceived.resize(offset + frames * frameSize);
+        ASSERT_EQ(frames, shared.read(&mReceived[offset], &mPosition, frames));
+    }
+
+    const size_t         mFramesPerCycle;
+    int64_t              mPosition;
+    const int64_t        mStart;     // position at which the client joined
+    int                  mOverruns;
+    std::vector<uint8_t> mReceived;  // indexed from mStart; lost frames left as zero
+};
+
+class SharedRecordBufferConverterTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t kSrcSampleRate = 48000;
+    static constexpr size_t kBurstFrames = 240;
+    static constexpr size_t kRingFrames = 1024;
+
+    void SetUp() override {
+        restart();
+    }
+
+    // starts both inputs and the expected output over
+    void restart() {
+        mInput.reset(new InputProvider(kSrcSampleRate));
+        mReferenceInput.reset(new InputProvider(kSrcSampleRate));
+        mExpected.clear();
+    }
+
+    // One RecordThread cycle: a burst from the HAL, converted once for everyone
+    // and once by a private converter, which gives the expected output.
+    void cycle(SharedRecordBufferConverter *shared, RecordBufferConverter *reference,
+            size_t frameSize) {
+        mInput->produce(kBurstFrames);
+        mReferenceInput->produce(kBurstFrames);
+        const size_t framesOut = shared->frameCount();
+        shared->convert(mInput.get(), framesOut);
+
+        const size_t offset = mExpected.size();
+        mExpected.resize(offset + framesOut * frameSize);
+        const size_t expectedFrames = reference->convert(
+                &mExpected[offset], mReferenceInput.get(), framesOut);
+        mExpected.resize(offset + expectedFrames * frameSize);
+        ASSERT_EQ((int64_t) (mExpected.size() / frameSize), shared->rear());
+    }
+
+    void expectReceived(const FakeClient &client, size_t frameSize, bool allowGap) {
+        ASSERT_LE(client.mStart * frameSize + client.mReceived.size(), mExpected.size());
+        const uint8_t *expected = &mExpected[client.mStart * frameSize];
+        const uint8_t zero[64] = {};
+        ASSERT_LE(frameSize, sizeof(zero));
+        for (size_t i = 0; i < client.mReceived.size(); i += frameSize) {
+            if (allowGap && memcmp(&client.mReceived[i], zero, frameSize) == 0) {
+                continue;
+            }
+            ASSERT_EQ(0, memcmp(&client.mReceived[i], &expected[i], frameSize))
+                    << "frame " << i / frameSize;
+        }
+    }
+
+    std::unique_ptr<InputProvider> mInput;
+    std::unique_ptr<InputProvider> mReferenceInput;
+    std::vector<uint8_t> mExpected;
+};
+
+constexpr uint32_t SharedRecordBufferConverterTest::kSrcSampleRate;
+constexpr size_t SharedRecordBufferConverterTest::kBurstFrames;
+constexpr size_t SharedRecordBufferConverterTest::kRingFrames;
+
+// Clients draining at different rates all see exactly what a private converter produces.
+TEST_F(SharedRecordBufferConverterTest, fan_out_matches_private_conversion) {
+    struct {
+        audio_channel_mask_t channelMask;
+        audio_format_t       format;
+        uint32_t             sampleRate;
+    } configs[] = {
+        { AUDIO_CHANNEL_IN_MONO,   AUDIO_FORMAT_PCM_16_BIT, 16000 },
+        { AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT,  48000 },
+        { AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, 44100 },
+    };
+    for (const auto &config : configs) {
+        restart();
+        SharedRecordBufferConverter shared(
+                AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+                config.channelMask, config.format, config.sampleRate, kRingFrames);
+        ASSERT_EQ(NO_ERROR, shared.initCheck());
+        RecordBufferConverter reference(
+                AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+                config.channelMask, config.format, config.sampleRate);
+        ASSERT_EQ(NO_ERROR, reference.initCheck());
+        const size_t frameSize = audio_channel_count_from_in_mask(config.channelMask)
+                * audio_bytes_per_sample(config.format);
+
+        // Every client drains at least as fast as the input on average.
+        std::vector<FakeClient> clients;
+        clients.emplace_back(shared, 1000);
+        clients.emplace_back(shared, 600);
+        clients.emplace_back(shared, 333);
+        for (int i = 0; i < 200; ++i) {
+            cycle(&shared, &reference, frameSize);
+            for (size_t j = 0; j < clients.size(); ++j) {
+                // the slow client only reads every other cycle
+                if (j == 1 && (i & 1)) {
+                    continue;
+                }
+                clients[j].cycle(shared, frameSize);
+            }
+        }
+        for (const FakeClient &client : clients) {
+            EXPECT_EQ(0, client.mOverruns);
+            EXPECT_GT(client.mReceived.size(), 0u);
+            expectReceived(client, frameSize, false /* allowGap */);
+        }
+    }
+}
+
+// A client that stops draining overruns on its own and then picks up the
+// newest data; the others do not notice.
+TEST_F(SharedRecordBufferConverterTest, overrun_is_per_client) {
+    SharedRecordBufferConverter shared(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_16_BIT, 16000, kRingFrames);
+    ASSERT_EQ(NO_ERROR, shared.initCheck());
+    RecordBufferConverter reference(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            AUDIO_CHANNEL_IN_MONO, AUDIO_FORMAT_PCM_16_BIT, 16000);
+    const size_t frameSize = sizeof(int16_t);
+
+    FakeClient steady(shared, 4096);
+    FakeClient stalled(shared, 4096);
+    for (int i = 0; i < 100; ++i) {
+        cycle(&shared, &reference, frameSize);
+        steady.cycle(shared, frameSize);
+        // 80 bursts at 48 kHz is far more than the ring holds at 16 kHz
+        if (i < 10 || i >= 90) {
+            stalled.cycle(shared, frameSize);
+        }
+    }
+    EXPECT_EQ(0, steady.mOverruns);
+    EXPECT_EQ(1, stalled.mOverruns);
+    EXPECT_EQ(shared.rear(), steady.mPosition);
+    EXPECT_EQ(shared.rear(), stalled.mPosition);
+    expectReceived(steady, frameSize, false /* allowGap */);
+    expectReceived(stalled, frameSize, true /* allowGap */);
+
+    // after the overrun the stalled client got exactly the last ring's worth
+    bool hasOverrun;
+    int64_t position = shared.rear() - (int64_t) kRingFrames - 1;
+    EXPECT_EQ(kRingFrames, shared.sync(&position, &hasOverrun));
+    EXPECT_TRUE(hasOverrun);
+    EXPECT_EQ(shared.rear() - (int64_t) kRingFrames, position);
+}
+
+// A client joining later starts at the newest frame, like a RecordTrack start().
+TEST_F(SharedRecordBufferConverterTest, late_client_starts_at_rear) {
+    SharedRecordBufferConverter shared(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT, kSrcSampleRate, kRingFrames);
+    ASSERT_EQ(NO_ERROR, shared.initCheck());
+    RecordBufferConverter reference(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_FLOAT, kSrcSampleRate);
+    const size_t frameSize = 2 * sizeof(float);
+
+    FakeClient early(shared, kRingFrames);
+    for (int i = 0; i < 10; ++i) {
+        cycle(&shared, &reference, frameSize);
+        early.cycle(shared, frameSize);
+    }
+    FakeClient late(shared, kRingFrames);
+    EXPECT_EQ(0u, shared.sync(&late.mPosition));
+    for (int i = 0; i < 10; ++i) {
+        cycle(&shared, &reference, frameSize);
+        early.cycle(shared, frameSize);
+        late.cycle(shared, frameSize);
+    }
+    EXPECT_EQ(10 * kBurstFrames * frameSize, late.mReceived.size());
+    EXPECT_EQ(20 * kBurstFrames * frameSize, early.mReceived.size());
+    expectReceived(early, frameSize, false /* allowGap */);
+    expectReceived(late, frameSize, false /* allowGap */);
+}
+
+// A reader starting while another records on its own converter gets a shared
+// conversion from its start, and the running reader keeps its converter, as in
+// RecordThread::updateSharedConversions_l(): it neither skips nor repeats a frame.
+TEST_F(SharedRecordBufferConverterTest, join_while_another_reader_is_active) {
+    const audio_channel_mask_t channelMask = AUDIO_CHANNEL_IN_MONO;
+    const audio_format_t format = AUDIO_FORMAT_PCM_16_BIT;
+    const uint32_t sampleRate = 16000;
+    const size_t frameSize = sizeof(int16_t);
+
+    InputProvider runningInput(kSrcSampleRate);
+    RecordBufferConverter running(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            channelMask, format, sampleRate);
+    ASSERT_EQ(NO_ERROR, running.initCheck());
+    std::vector<uint8_t> runningReceived;
+    auto runningCycle = [&]() {
+        runningInput.produce(kBurstFrames);
+        const size_t offset = runningReceived.size();
+        runningReceived.resize(offset + kRingFrames * frameSize);
+        const size_t frames = running.convert(&runningReceived[offset], &runningInput,
+                kRingFrames);
+        runningReceived.resize(offset + frames * frameSize);
+    };
+
+    for (int i = 0; i < 10; ++i) {
+        mInput->produce(kBurstFrames);
+        mReferenceInput->produce(kBurstFrames);
+        runningCycle();
+    }
+
+    // the shared conversion is created for the reader that starts now
+    mInput->skipToRear();
+    mReferenceInput->skipToRear();
+    SharedRecordBufferConverter shared(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            channelMask, format, sampleRate, kRingFrames);
+    ASSERT_EQ(NO_ERROR, shared.initCheck());
+    RecordBufferConverter reference(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            channelMask, format, sampleRate);
+    FakeClient joining(shared, kRingFrames);
+    for (int i = 0; i < 10; ++i) {
+        cycle(&shared, &reference, frameSize);
+        joining.cycle(shared, frameSize);
+        runningCycle();
+    }
+    EXPECT_EQ(0, joining.mOverruns);
+    EXPECT_GT(joining.mReceived.size(), 0u);
+    expectReceived(joining, frameSize, false /* allowGap */);
+
+    // the running reader got everything a single uninterrupted conversion gives
+    InputProvider wholeInput(kSrcSampleRate);
+    wholeInput.produce(20 * kBurstFrames);
+    RecordBufferConverter whole(
+            AUDIO_CHANNEL_IN_STEREO, AUDIO_FORMAT_PCM_16_BIT, kSrcSampleRate,
+            channelMask, format, sampleRate);
+    std::vector<uint8_t> expected(runningReceived.size() + 16 * frameSize);
+    expected.resize(whole.convert(&expected[0], &wholeInput, expected.size() / frameSize)
+            * frameSize);
+    ASSERT_LE(runningReceived.size(), expected.size());
+    EXPECT_EQ(0, memcmp(&runningReceived[0], &expected[0], runningReceived.size()));
+}
@@ -10,3 +10,5 @@ adb root && adb wait-for-device remount
 
 adb shell /data/nativetest/resampler_tests/resampler_tests
 adb shell /data/nativetest64/resampler_tests/resampler_tests
+adb shell /data/nativetest/record_buffer_converter_tests/record_buffer_converter_tests
+adb shell /data/nativetest64/record_buffer_converter_tests/record_buffer_converter_tests
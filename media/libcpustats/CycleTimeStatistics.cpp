@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <cpustats/CycleTimeStatistics.h>
+
+void CycleTimeStatistics::sampleCycle()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    const int64_t cpuNs = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    const int64_t wallNs = monotonicNs();
+    if (mPreviousWallNs >= 0) {
+        sample(wallNs - mPreviousWallNs, cpuNs - mPreviousCpuNs);
+    }
+    mPreviousWallNs = wallNs;
+    mPreviousCpuNs = cpuNs;
+}
+
+void CycleTimeStatistics::endCycle()
+{
+    if (mPreviousWallNs < 0) {
+        return;
+    }
+    sampleCycle();
+    mPreviousWallNs = -1;
+    mPreviousCpuNs = -1;
+}
+
+// Sorts values in place, and returns the median, 90th and 99th percentiles and maximum in us.
+static void percentiles(uint32_t *values, size_t n,
+        double *median, double *p90, double *p99, double *max)
+{
+    std::sort(values, values + n);
+    *median = values[n / 2] * 0.001;
+    *p90 = values[(n * 90) / 100] * 0.001;
+    *p99 = values[(n * 99) / 100] * 0.001;
+    *max = values[n - 1] * 0.001;
+}
+
+CycleTimeStatistics::Summary CycleTimeStatistics::summarize() const
+{
+    Summary summary = {};
+    summary.count = mCount;
+    summary.n = mCount < kCapacity ? mCount : kCapacity;
+    summary.hasCpu = mHasCpu;
+    if (summary.n == 0) {
+        return summary;
+    }
+    uint32_t values[kCapacity];
+    std::copy(mWallNs, mWallNs + summary.n, values);
+    percentiles(values, summary.n,
+            &summary.wallMedian, &summary.wall90, &summary.wall99, &summary.wallMax);
+    if (mHasCpu) {
+        std::copy(mCpuNs, mCpuNs + summary.n, values);
+        percentiles(values, summary.n,
+                &summary.cpuMedian, &summary.cpu90, &summary.cpu99, &summary.cpuMax);
+    }
+    return summary;
+}
+
+void CycleTimeStatistics::reset()
+{
+    mCount = 0;
+    mHasCpu = false;
+    mPreviousWallNs = -1;
+    mPreviousCpuNs = -1;
+}
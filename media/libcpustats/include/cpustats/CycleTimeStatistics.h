@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CYCLE_TIME_STATISTICS_H
+#define _CYCLE_TIME_STATISTICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// Keeps the wall clock and CPU time of the most recent kCapacity executions of a region,
+// such as one cycle of a thread loop or one call of a processing function, in a ring buffer,
+// and summarizes them with percentiles on demand.
+// Adding a sample is a few stores, so it is cheap enough for real-time threads; the cost is
+// in reading the clocks. CLOCK_MONOTONIC is usually read without a system call, but
+// CLOCK_THREAD_CPUTIME_ID is not, so per-call regions should only measure wall clock time.
+// Single writer. summarize() may be called from another thread, for example by dumpsys,
+// in which case it can include a few samples that are being overwritten.
+class CycleTimeStatistics {
+
+public:
+
+    static const size_t kCapacity = 1024;   // must be a power of 2
+
+    CycleTimeStatistics() : mCount(0), mHasCpu(false), mPreviousWallNs(-1), mPreviousCpuNs(-1)
+            { }
+
+    ~CycleTimeStatistics() { }
+
+    // add a sample of wall clock time only
+    void sample(int64_t wallNs) {
+        const size_t i = mCount & (kCapacity - 1);
+        mWallNs[i] = clamp(wallNs);
+        mCpuNs[i] = 0;
+        ++mCount;
+    }
+
+    // add a sample of wall clock time and CPU time
+    void sample(int64_t wallNs, int64_t cpuNs) {
+        const size_t i = mCount & (kCapacity - 1);
+        mWallNs[i] = clamp(wallNs);
+        mCpuNs[i] = clamp(cpuNs);
+        mHasCpu = true;
+        ++mCount;
+    }
+
+    // For cyclic threads: adds a sample of the wall clock and CPU time of the calling thread
+    // since the previous call. The first call only starts the first cycle.
+    void sampleCycle();
+
+    // For cyclic threads: ends the current cycle before the calling thread sleeps or waits
+    // for work, so that the time asleep is not counted. The next sampleCycle() only starts
+    // a new cycle.
+    void endCycle();
+
+    // Returns the current CLOCK_MONOTONIC time in ns, for timing a region.
+    static int64_t monotonicNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    struct Summary {
+        uint64_t count;     // number of samples since construction or reset()
+        size_t   n;         // number of samples summarized, at most kCapacity
+        bool     hasCpu;    // whether the CPU values below are valid
+        // in microseconds
+        double   wallMedian, wall90, wall99, wallMax;
+        double   cpuMedian, cpu90, cpu99, cpuMax;
+    };
+
+    // summarize the most recent samples
+    Summary summarize() const;
+
+    // return the number of samples added so far
+    uint64_t count() const { return mCount; }
+
+    // reset the set of samples to be empty
+    void reset();
+
+private:
+    static uint32_t clamp(int64_t ns) {
+        return ns < 0 ? 0 : ns > UINT32_MAX ? UINT32_MAX : (uint32_t) ns;
+    }
+
+    uint64_t mCount;
+    bool     mHasCpu;
+    int64_t  mPreviousWallNs;   // for sampleCycle()
+    int64_t  mPreviousCpuNs;
+    uint32_t mWallNs[kCapacity];
+    uint32_t mCpuNs[kCapacity];
+};
+
+#endif // _CYCLE_TIME_STATISTICS_H
@@ -21,13 +21,80 @@
 
 #include <media/mediascanner.h>
 
-#include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace android {
 
+// Layout of the entries returned by getdents64().
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static const size_t kDirentBufferSize = 32 * 1024;
+static const long kMaxWalkerThreads = 4;
+// Bounds how far metadata prefetching may run ahead of the client.
+static const size_t kMaxPendingPrefetches = 64;
+
+// State shared between processDirectory() and the walker threads.
+// Walkers list directories concurrently and queue the listings, which
+// processDirectory() reports to the client on the calling thread, as the
+// client is not thread safe. When there is nothing to list, walkers
+// prefetch the files of listings that have not been reported yet.
+struct MediaScanner::Walk {
+    struct Entry {
+        String8 mPath;
+        FileStamp mStamp;
+        bool mIsDirectory;
+        bool mNoMedia;
+    };
+
+    struct Directory {
+        String8 mPath;
+        bool mNoMedia;
+    };
+
+    struct WalkerThread : public Thread {
+        WalkerThread(MediaScanner *scanner, Walk *walk)
+            : Thread(false /* canCallJava */), mScanner(scanner), mWalk(walk) {}
+
+    private:
+        MediaScanner *mScanner;
+        Walk *mWalk;
+
+        bool threadLoop() override {
+            mScanner->walkDirectories(mWalk);
+            return false;
+        }
+    };
+
+    Walk() : mBusyWalkers(0), mPrefetchEnabled(true), mAborted(false), mDone(false) {}
+
+    Mutex mLock;
+    Condition mWorkCondition;
+    Condition mListingCondition;
+    // directories to list, most recently found first to keep the walk
+    // depth first and the queue short
+    List<Directory> mDirectories;
+    List<Entry> mPrefetches;
+    List<Vector<Entry> > mListings;
+    size_t mBusyWalkers;
+    bool mPrefetchEnabled;
+    bool mAborted;
+    bool mDone;
+};
+
 MediaScanner::MediaScanner()
-    : mLocale(NULL), mSkipList(NULL), mSkipIndex(NULL) {
+    : mLocale(NULL), mSkipList(NULL), mSkipIndex(NULL), mSkipCacheLoaded(false),
+      mSkipCacheScan(0) {
     loadSkipList();
 }
 
@@ -51,6 +118,20 @@ const char *MediaScanner::locale() const {
     return mLocale;
 }
 
+void MediaScanner::setSkipCachePath(const char *path) {
+    Mutex::Autolock autoLock(mSkipCacheLock);
+    mSkipCachePath = path ? path : "";
+    mSkipCacheLoaded = false;
+    mSkipCache.clear();
+}
+
+void MediaScanner::prefetchFile(const char * /* path */, long long /* lastModified */,
+        long long /* fileSize */) {
+}
+
+void MediaScanner::endDirectoryScan() {
+}
+
 void MediaScanner::loadSkipList() {
     mSkipList = (char *)malloc(PROPERTY_VALUE_MAX * sizeof(char));
     if (mSkipList) {
@@ -78,35 +159,197 @@ void MediaScanner::loadSkipList() {
     }
 }
 
+void MediaScanner::loadSkipCache() {
+    Mutex::Autolock autoLock(mSkipCacheLock);
+    if (mSkipCacheLoaded || mSkipCachePath.isEmpty()) {
+        return;
+    }
+    mSkipCacheLoaded = true;
+
+    FILE *file = fopen(mSkipCachePath.string(), "re");
+    if (file == NULL) {
+        return;
+    }
+    // each line is "<last modified> <size> <path>"
+    char *line = NULL;
+    size_t lineSize = 0;
+    ssize_t length;
+    while ((length = getline(&line, &lineSize, file)) > 0) {
+        if (line[length - 1] == '\n') {
+            line[length - 1] = 0;
+        }
+        FileStamp stamp;
+        int pathOffset = 0;
+        if (sscanf(line, "%lld %lld %n", &stamp.mLastModified, &stamp.mFileSize,
+                &pathOffset) == 2 && pathOffset > 0 && line[pathOffset] != 0) {
+            mSkipCache[line + pathOffset] = CachedStamp{stamp, mSkipCacheScan};
+        }
+    }
+    free(line);
+    fclose(file);
+    ALOGV("loaded %zu entries from skip cache", mSkipCache.size());
+}
+
+void MediaScanner::saveSkipCache() {
+    Mutex::Autolock autoLock(mSkipCacheLock);
+    if (mSkipCachePath.isEmpty()) {
+        return;
+    }
+
+    String8 tmpPath(mSkipCachePath);
+    tmpPath.append(".tmp");
+    FILE *file = fopen(tmpPath.string(), "we");
+    if (file == NULL) {
+        ALOGW("failed to write skip cache %s: %s", tmpPath.string(), strerror(errno));
+        return;
+    }
+    for (const auto &entry : mSkipCache) {
+        const FileStamp &stamp = entry.second.mStamp;
+        fprintf(file, "%lld %lld %s\n",
+                stamp.mLastModified, stamp.mFileSize, entry.first.c_str());
+    }
+    if (fclose(file) != 0 || rename(tmpPath.string(), mSkipCachePath.string()) != 0) {
+        ALOGW("failed to save skip cache %s: %s", mSkipCachePath.string(), strerror(errno));
+        unlink(tmpPath.string());
+    }
+}
+
+bool MediaScanner::isFileUnchanged(const String8 &path, const FileStamp &stamp) {
+    Mutex::Autolock autoLock(mSkipCacheLock);
+    auto inserted = mSkipCache.emplace(path.string(), CachedStamp{stamp, mSkipCacheScan});
+    if (inserted.second) {
+        return false;
+    }
+    CachedStamp &cached = inserted.first->second;
+    bool unchanged = cached.mStamp.mLastModified == stamp.mLastModified
+            && cached.mStamp.mFileSize == stamp.mFileSize;
+    cached.mStamp = stamp;
+    cached.mScan = mSkipCacheScan;
+    return unchanged;
+}
+
+// Drops the files under |root| that the scan that just completed did not see,
+// so that deleted files do not stay in the cache for good.
+void MediaScanner::pruneSkipCache(const String8 &root) {
+    Mutex::Autolock autoLock(mSkipCacheLock);
+    size_t pruned = 0;
+    for (auto it = mSkipCache.begin(); it != mSkipCache.end(); ) {
+        if (it->second.mScan != mSkipCacheScan
+                && it->first.compare(0, root.length(), root.string()) == 0) {
+            it = mSkipCache.erase(it);
+            ++pruned;
+        } else {
+            ++it;
+        }
+    }
+    ALOGV("pruned %zu entries from skip cache", pruned);
+}
+
 MediaScanResult MediaScanner::processDirectory(
         const char *path, MediaScannerClient &client) {
     int pathLength = strlen(path);
     if (pathLength >= PATH_MAX) {
         return MEDIA_SCAN_RESULT_SKIPPED;
     }
-    char* pathBuffer = (char *)malloc(PATH_MAX + 1);
-    if (!pathBuffer) {
-        return MEDIA_SCAN_RESULT_ERROR;
-    }
 
-    int pathRemaining = PATH_MAX - pathLength;
-    strcpy(pathBuffer, path);
-    if (pathLength > 0 && pathBuffer[pathLength - 1] != '/') {
-        pathBuffer[pathLength] = '/';
-        pathBuffer[pathLength + 1] = 0;
-        --pathRemaining;
+    String8 root(path);
+    if (pathLength > 0 && path[pathLength - 1] != '/') {
+        root.append("/");
     }
 
     client.setLocale(locale());
 
-    MediaScanResult result = doProcessDirectory(pathBuffer, pathRemaining, client, false);
+    int rootFd = open(root.string(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+        ALOGW("Error opening directory '%s', skipping: %s.", root.string(), strerror(errno));
+        return MEDIA_SCAN_RESULT_SKIPPED;
+    }
+    close(rootFd);
+
+    loadSkipCache();
+    {
+        Mutex::Autolock autoLock(mSkipCacheLock);
+        ++mSkipCacheScan;
+    }
 
-    free(pathBuffer);
+    Walk walk;
+    walk.mDirectories.push_back(Walk::Directory{root, false});
+
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads > kMaxWalkerThreads) {
+        numThreads = kMaxWalkerThreads;
+    }
+    Vector<sp<Walk::WalkerThread> > threads;
+    for (long i = 0; i < numThreads; ++i) {
+        sp<Walk::WalkerThread> thread = new Walk::WalkerThread(this, &walk);
+        if (thread->run("MediaScanWalker") != OK) {
+            break;
+        }
+        threads.push(thread);
+    }
+    if (threads.isEmpty()) {
+        // walk the whole tree on this thread, there is nothing to prefetch ahead of
+        walk.mPrefetchEnabled = false;
+        walkDirectories(&walk);
+    }
+
+    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
+    size_t directoriesScanned = 0;
+    size_t filesScanned = 0;
+    for (;;) {
+        Vector<Walk::Entry> entries;
+        {
+            Mutex::Autolock autoLock(walk.mLock);
+            while (walk.mListings.empty() && !walk.mDone) {
+                walk.mListingCondition.wait(walk.mLock);
+            }
+            if (walk.mListings.empty()) {
+                break;
+            }
+            entries = *walk.mListings.begin();
+            walk.mListings.erase(walk.mListings.begin());
+        }
+
+        for (size_t i = 0; i < entries.size(); ++i) {
+            const Walk::Entry &entry = entries[i];
+            status_t status = client.scanFile(entry.mPath.string(),
+                    entry.mStamp.mLastModified, entry.mStamp.mFileSize,
+                    entry.mIsDirectory, entry.mNoMedia);
+            if (status) {
+                result = MEDIA_SCAN_RESULT_ERROR;
+                break;
+            }
+            if (!entry.mIsDirectory) {
+                ++filesScanned;
+            }
+        }
+        if (result == MEDIA_SCAN_RESULT_ERROR) {
+            break;
+        }
+        ++directoriesScanned;
+        client.onScanProgress(directoriesScanned, filesScanned);
+    }
+
+    {
+        Mutex::Autolock autoLock(walk.mLock);
+        walk.mAborted = true;
+        walk.mWorkCondition.broadcast();
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->join();
+    }
+    endDirectoryScan();
+
+    // only a walk that went through the whole tree knows what is gone
+    if (result == MEDIA_SCAN_RESULT_OK) {
+        pruneSkipCache(root);
+    }
+    saveSkipCache();
 
     return result;
 }
 
-bool MediaScanner::shouldSkipDirectory(char *path) {
+bool MediaScanner::shouldSkipDirectory(const char *path) {
     if (path && mSkipList && mSkipIndex) {
         int len = strlen(path);
         int idx = 0;
@@ -128,113 +371,155 @@ bool MediaScanner::shouldSkipDirectory(char *path) {
     return false;
 }
 
-MediaScanResult MediaScanner::doProcessDirectory(
-        char *path, int pathRemaining, MediaScannerClient &client, bool noMedia) {
-    // place to copy file or directory name
-    char* fileSpot = path + strlen(path);
-    struct dirent* entry;
+void MediaScanner::walkDirectories(Walk *walk) {
+    Mutex::Autolock autoLock(walk->mLock);
+    while (!walk->mAborted) {
+        if (!walk->mDirectories.empty()) {
+            Walk::Directory directory = *walk->mDirectories.begin();
+            walk->mDirectories.erase(walk->mDirectories.begin());
+            ++walk->mBusyWalkers;
+
+            walk->mLock.unlock();
+            listDirectory(walk, directory.mPath, directory.mNoMedia);
+            walk->mLock.lock();
+
+            --walk->mBusyWalkers;
+            if (walk->mDirectories.empty() && walk->mBusyWalkers == 0) {
+                walk->mDone = true;
+                walk->mListingCondition.signal();
+                walk->mWorkCondition.broadcast();
+            }
+        } else if (!walk->mPrefetches.empty()) {
+            Walk::Entry entry = *walk->mPrefetches.begin();
+            walk->mPrefetches.erase(walk->mPrefetches.begin());
+
+            walk->mLock.unlock();
+            prefetchFile(entry.mPath.string(),
+                    entry.mStamp.mLastModified, entry.mStamp.mFileSize);
+            walk->mLock.lock();
+        } else if (walk->mDone) {
+            break;
+        } else {
+            walk->mWorkCondition.wait(walk->mLock);
+        }
+    }
+}
 
-    if (shouldSkipDirectory(path)) {
-        ALOGD("Skipping: %s", path);
-        return MEDIA_SCAN_RESULT_OK;
+void MediaScanner::listDirectory(Walk *walk, const String8 &path, bool noMedia) {
+    if (shouldSkipDirectory(path.string())) {
+        ALOGD("Skipping: %s", path.string());
+        return;
     }
 
-    // Treat all files as non-media in directories that contain a  ".nomedia" file
-    if (pathRemaining >= 8 /* strlen(".nomedia") */ ) {
-        strcpy(fileSpot, ".nomedia");
-        if (access(path, F_OK) == 0) {
-            ALOGV("found .nomedia, setting noMedia flag");
-            noMedia = true;
-        }
+    int dirFd = open(path.string(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        ALOGW("Error opening directory '%s', skipping: %s.", path.string(), strerror(errno));
+        return;
+    }
 
-        // restore path
-        fileSpot[0] = 0;
+    // Treat all files as non-media in directories that contain a  ".nomedia" file
+    if (faccessat(dirFd, ".nomedia", F_OK, 0) == 0) {
+        ALOGV("found .nomedia, setting noMedia flag");
+        noMedia = true;
     }
 
-    DIR* dir = opendir(path);
-    if (!dir) {
-        ALOGW("Error opening directory '%s', skipping: %s.", path, strerror(errno));
-        return MEDIA_SCAN_RESULT_SKIPPED;
+    char *buffer = (char *)malloc(kDirentBufferSize);
+    if (!buffer) {
+        close(dirFd);
+        return;
     }
 
-    MediaScanResult result = MEDIA_SCAN_RESULT_OK;
-    while ((entry = readdir(dir))) {
-        if (doProcessDirectoryEntry(path, pathRemaining, client, noMedia, entry, fileSpot)
-                == MEDIA_SCAN_RESULT_ERROR) {
-            result = MEDIA_SCAN_RESULT_ERROR;
+    Vector<Walk::Entry> entries;
+    Vector<Walk::Directory> directories;
+    Vector<Walk::Entry> prefetches;
+    for (;;) {
+        int bytesRead = syscall(SYS_getdents64, dirFd, buffer, kDirentBufferSize);
+        if (bytesRead <= 0) {
+            if (bytesRead < 0) {
+                ALOGW("Error reading directory '%s': %s.", path.string(), strerror(errno));
+            }
             break;
         }
-    }
-    closedir(dir);
-    return result;
-}
-
-MediaScanResult MediaScanner::doProcessDirectoryEntry(
-        char *path, int pathRemaining, MediaScannerClient &client, bool noMedia,
-        struct dirent* entry, char* fileSpot) {
-    struct stat statbuf;
-    const char* name = entry->d_name;
 
-    // ignore "." and ".."
-    if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
-    }
+        for (int offset = 0; offset < bytesRead;) {
+            const struct linux_dirent64 *dirent =
+                    (const struct linux_dirent64 *)(buffer + offset);
+            offset += dirent->d_reclen;
 
-    int nameLength = strlen(name);
-    if (nameLength + 1 > pathRemaining) {
-        // path too long!
-        return MEDIA_SCAN_RESULT_SKIPPED;
-    }
-    strcpy(fileSpot, name);
-
-    int type = entry->d_type;
-    if (type == DT_UNKNOWN) {
-        // If the type is unknown, stat() the file instead.
-        // This is sometimes necessary when accessing NFS mounted filesystems, but
-        // could be needed in other cases well.
-        if (stat(path, &statbuf) == 0) {
-            if (S_ISREG(statbuf.st_mode)) {
-                type = DT_REG;
-            } else if (S_ISDIR(statbuf.st_mode)) {
-                type = DT_DIR;
+            const char *name = dirent->d_name;
+            // ignore "." and ".."
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+                continue;
             }
-        } else {
-            ALOGD("stat() failed for %s: %s", path, strerror(errno) );
-        }
-    }
-    if (type == DT_DIR) {
-        bool childNoMedia = noMedia;
-        // set noMedia flag on directories with a name that starts with '.'
-        // for example, the Mac ".Trashes" directory
-        if (name[0] == '.')
-            childNoMedia = true;
-
-        // report the directory to the client
-        if (stat(path, &statbuf) == 0) {
-            status_t status = client.scanFile(path, statbuf.st_mtime, 0,
-                    true /*isDirectory*/, childNoMedia);
-            if (status) {
-                return MEDIA_SCAN_RESULT_ERROR;
+            if (path.length() + strlen(name) + 1 >= PATH_MAX) {
+                // path too long!
+                continue;
             }
-        }
 
-        // and now process its contents
-        strcat(fileSpot, "/");
-        MediaScanResult result = doProcessDirectory(path, pathRemaining - nameLength - 1,
-                client, childNoMedia);
-        if (result == MEDIA_SCAN_RESULT_ERROR) {
-            return MEDIA_SCAN_RESULT_ERROR;
+            String8 entryPath(path);
+            entryPath.append(name);
+
+            struct stat statbuf;
+            bool haveStat = false;
+            int type = dirent->d_type;
+            if (type == DT_UNKNOWN) {
+                // If the type is unknown, stat() the file instead.
+                // This is sometimes necessary when accessing NFS mounted filesystems, but
+                // could be needed in other cases well.
+                if (fstatat(dirFd, name, &statbuf, 0) == 0) {
+                    haveStat = true;
+                    if (S_ISREG(statbuf.st_mode)) {
+                        type = DT_REG;
+                    } else if (S_ISDIR(statbuf.st_mode)) {
+                        type = DT_DIR;
+                    }
+                } else {
+                    ALOGD("stat() failed for %s: %s", entryPath.string(), strerror(errno));
+                }
+            }
+
+            if (type == DT_DIR) {
+                // set noMedia flag on directories with a name that starts with '.'
+                // for example, the Mac ".Trashes" directory
+                bool childNoMedia = noMedia || name[0] == '.';
+
+                // report the directory to the client
+                if (haveStat || fstatat(dirFd, name, &statbuf, 0) == 0) {
+                    entries.push(Walk::Entry{
+                            entryPath, {statbuf.st_mtime, 0}, true, childNoMedia});
+                }
+
+                // and list its contents later
+                entryPath.append("/");
+                directories.push(Walk::Directory{entryPath, childNoMedia});
+            } else if (type == DT_REG) {
+                if (!haveStat && fstatat(dirFd, name, &statbuf, 0) != 0) {
+                    memset(&statbuf, 0, sizeof(statbuf));
+                }
+                FileStamp stamp = {statbuf.st_mtime, statbuf.st_size};
+                entries.push(Walk::Entry{entryPath, stamp, false, noMedia});
+                if (!noMedia && !isFileUnchanged(entryPath, stamp)) {
+                    prefetches.push(entries.top());
+                }
+            }
         }
-    } else if (type == DT_REG) {
-        stat(path, &statbuf);
-        status_t status = client.scanFile(path, statbuf.st_mtime, statbuf.st_size,
-                false /*isDirectory*/, noMedia);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
+    }
+    free(buffer);
+    close(dirFd);
+
+    Mutex::Autolock autoLock(walk->mLock);
+    walk->mListings.push_back(entries);
+    walk->mListingCondition.signal();
+    for (size_t i = directories.size(); i > 0; --i) {
+        walk->mDirectories.push_front(directories[i - 1]);
+    }
+    if (walk->mPrefetchEnabled) {
+        for (size_t i = 0; i < prefetches.size()
+                && walk->mPrefetches.size() < kMaxPendingPrefetches; ++i) {
+            walk->mPrefetches.push_back(prefetches[i]);
         }
     }
-
-    return MEDIA_SCAN_RESULT_OK;
+    walk->mWorkCondition.broadcast();
 }
 
 MediaAlbumArt *MediaAlbumArt::clone() {
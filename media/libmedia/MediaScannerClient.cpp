@@ -48,4 +48,8 @@ status_t MediaScannerClient::addStringTag(const char* name, const char* value)
 void MediaScannerClient::endFile() {
 }
 
+void MediaScannerClient::onScanProgress(
+        size_t /* directoriesScanned */, size_t /* filesScanned */) {
+}
+
 }  // namespace android
@@ -113,6 +113,91 @@ private:
     int8_t               mIdxAry[sizeof(uint32_t) * 8]; // used for channel mask conversion
 };
 
+/* The SharedRecordBufferConverter converts the RecordThread input once for all
+ * RecordTracks that ask for the same channel mask, format and sample rate.
+ *
+ * convert() runs a single RecordBufferConverter into a ring of converted frames.
+ * Each reader keeps its own position in the ring and copies out with read(),
+ * so readers may drain at different rates.  As with the RecordThread input
+ * buffer, a reader that falls more than the ring size behind loses the oldest
+ * frames and is told that it has overrun.
+ *
+ * Positions are rolling frame counters that are never cleared.
+ * Not thread safe; all calls are expected from the RecordThread.
+ */
+class SharedRecordBufferConverter
+{
+public:
+    SharedRecordBufferConverter(
+            audio_channel_mask_t srcChannelMask, audio_format_t srcFormat,
+            uint32_t srcSampleRate,
+            audio_channel_mask_t dstChannelMask, audio_format_t dstFormat,
+            uint32_t dstSampleRate,
+            size_t frameCount);
+
+    ~SharedRecordBufferConverter();
+
+    // returns NO_ERROR if constructor was successful
+    status_t initCheck() const {
+        return mBuffer != NULL ? mConverter.initCheck() : NO_MEMORY;
+    }
+
+    bool matches(audio_channel_mask_t dstChannelMask, audio_format_t dstFormat,
+            uint32_t dstSampleRate) const {
+        return dstChannelMask == mDstChannelMask && dstFormat == mDstFormat
+                && dstSampleRate == mDstSampleRate;
+    }
+
+    audio_channel_mask_t channelMask() const { return mDstChannelMask; }
+    audio_format_t format() const { return mDstFormat; }
+    uint32_t sampleRate() const { return mDstSampleRate; }
+    size_t frameCount() const { return mFrameCount; }
+
+    /* Converts input data from an AudioBufferProvider into the ring,
+     * overwriting the oldest frames.
+     *
+     * Parameters
+     * provider:  buffer provider to obtain source data.
+     *   frames:  maximum number of frames to convert, capped at frameCount().
+     *
+     * Returns the number of frames converted.
+     */
+    size_t convert(AudioBufferProvider *provider, size_t frames);
+
+    // position of the next frame convert() will produce; a new reader starts here
+    int64_t rear() const { return mRear; }
+
+    /* Returns the number of frames ready for the reader at position.
+     * If the reader has overrun, position is moved up to the oldest frame
+     * still in the ring.
+     *
+     * Parameters
+     *   position:  reader position, updated on overrun.
+     * hasOverrun:  pointer to optional boolean, returns true if reader has overrun.
+     */
+    size_t sync(int64_t *position, bool *hasOverrun = NULL) const;
+
+    /* Copies converted frames to dst and advances position.
+     * Call sync() first so position is within the ring.
+     *
+     * Returns the number of frames copied.
+     */
+    size_t read(void *dst, int64_t *position, size_t frames) const;
+
+    // called to reset resampler buffers on input discontinuity
+    void reset() { mConverter.reset(); }
+
+private:
+    RecordBufferConverter mConverter;
+    const audio_channel_mask_t mDstChannelMask;
+    const audio_format_t mDstFormat;
+    const uint32_t       mDstSampleRate;
+    const size_t         mFrameSize;
+    const size_t         mFrameCount;
+    void                *mBuffer;
+    int64_t              mRear;     // next frame to convert
+};
+
 // ----------------------------------------------------------------------------
 } // namespace android
 
@@ -24,7 +24,8 @@
 #include <utils/String8.h>
 #include <pthread.h>
 
-struct dirent;
+#include <string>
+#include <unordered_map>
 
 namespace android {
 
@@ -80,24 +81,57 @@ struct MediaScanner {
 
     void setLocale(const char *locale);
 
+    // File used to persist the modification time and size of the files
+    // seen by processDirectory(). Files that have not changed since are
+    // not prefetched. They are still reported to the client, and parsed
+    // again if the client calls processFile() for them.
+    void setSkipCachePath(const char *path);
+
     virtual MediaAlbumArt *extractAlbumArt(int fd) = 0;
 
 protected:
     const char *locale() const;
 
+    // Called by the directory walker threads of processDirectory() for new
+    // or modified files, ahead of the client calling processFile() for
+    // them, with the modification time and size the walk found. Implementations
+    // may extract metadata in advance, and must be thread safe.
+    virtual void prefetchFile(const char *path, long long lastModified, long long fileSize);
+
+    // Called at the end of processDirectory(), once no prefetchFile() call
+    // is in progress. Implementations should drop what they prefetched.
+    virtual void endDirectoryScan();
+
 private:
+    struct Walk;
+    struct FileStamp {
+        long long mLastModified;
+        long long mFileSize;
+    };
+    struct CachedStamp {
+        FileStamp mStamp;
+        uint32_t mScan;  // mSkipCacheScan when the file was last seen
+    };
+
     // current locale (like "ja_JP"), created/destroyed with strdup()/free()
     char *mLocale;
     char *mSkipList;
     int *mSkipIndex;
 
-    MediaScanResult doProcessDirectory(
-            char *path, int pathRemaining, MediaScannerClient &client, bool noMedia);
-    MediaScanResult doProcessDirectoryEntry(
-            char *path, int pathRemaining, MediaScannerClient &client, bool noMedia,
-            struct dirent* entry, char* fileSpot);
+    String8 mSkipCachePath;
+    bool mSkipCacheLoaded;
+    Mutex mSkipCacheLock;
+    std::unordered_map<std::string, CachedStamp> mSkipCache;
+    uint32_t mSkipCacheScan;  // counts processDirectory() calls
+
+    void walkDirectories(Walk *walk);
+    void listDirectory(Walk *walk, const String8 &path, bool noMedia);
+    bool isFileUnchanged(const String8 &path, const FileStamp &stamp);
     void loadSkipList();
-    bool shouldSkipDirectory(char *path);
+    bool shouldSkipDirectory(const char *path);
+    void loadSkipCache();
+    void pruneSkipCache(const String8 &root);
+    void saveSkipCache();
 
 
     MediaScanner(const MediaScanner &);
@@ -119,6 +153,10 @@ public:
     virtual status_t handleStringTag(const char* name, const char* value) = 0;
     virtual status_t setMimeType(const char* mimeType) = 0;
 
+    // Called by MediaScanner::processDirectory() after each directory it
+    // has reported, with the running totals of the scan.
+    virtual void onScanProgress(size_t directoriesScanned, size_t filesScanned);
+
 protected:
     // default encoding from MediaScanner::mLocale
     String8 mLocale;
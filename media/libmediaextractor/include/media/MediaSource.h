@@ -89,6 +89,23 @@ struct MediaSource : public virtual RefBase {
         return ERROR_UNSUPPORTED;
     }
 
+    struct ReadyListener : public virtual RefBase {
+        // Called on a thread owned by the source, with no source lock held,
+        // whenever a buffer may have become available, or the stream may have
+        // ended. Spurious calls are allowed.
+        virtual void onBufferReady() = 0;
+    };
+
+    // Lets a consumer get told when read() would not block instead of
+    // parking a thread in read(). Once a listener is set, a read() with
+    // ReadOptions::setNonBlocking() returns WOULD_BLOCK if there is nothing
+    // to return yet. Passing NULL removes the listener. If the source
+    // cannot notify, ERROR_UNSUPPORTED is returned and the consumer has to
+    // keep reading with blocking read() calls.
+    virtual status_t setReadyListener(const sp<ReadyListener> & /* listener */) {
+        return ERROR_UNSUPPORTED;
+    }
+
 protected:
     virtual ~MediaSource();
 
@@ -77,6 +77,7 @@ enum {
     kKeyTargetTime        = 'tarT',  // int64_t (usecs)
     kKeyDriftTime         = 'dftT',  // int64_t (usecs)
     kKeyAnchorTime        = 'ancT',  // int64_t (usecs)
+    kKeyCaptureTime       = 'capT',  // int64_t (usecs, SYSTEM_TIME_MONOTONIC)
     kKeyDuration          = 'dura',  // int64_t (usecs)
     kKeyPixelFormat       = 'pixf',  // int32_t
     kKeyColorFormat       = 'colf',  // int32_t
@@ -2306,6 +2306,12 @@ status_t StagefrightRecorder::dump(
     snprintf(buffer, SIZE, "     Bit rate (bps): %d\n", mVideoBitRate);
     result.append(buffer);
     ::write(fd, result.string(), result.size());
+    if (mAudioEncoderSource != NULL) {
+        mAudioEncoderSource->dump(fd, args);
+    }
+    if (mVideoEncoderSource != NULL) {
+        mVideoEncoderSource->dump(fd, args);
+    }
     return OK;
 }
 }  // namespace android
@@ -17,6 +17,10 @@
 #define LOG_TAG "Pipe"
 //#define LOG_NDEBUG 0
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
 #include <utils/Log.h>
@@ -33,7 +37,11 @@ Pipe::Pipe(size_t maxFrames, const NBAIO_Format& format, void *buffer) :
         mFifo(mMaxFrames, Format_frameSize(format), mBuffer, false /*throttlesWriter*/),
         mFifoWriter(mFifo),
         mReaders(0),
-        mFreeBufferInDestructor(buffer == NULL)
+        mWriteSequence(0),
+        mWaitingReaders(0),
+        mFreeBufferInDestructor(buffer == NULL),
+        // mTimestampShared
+        mTimestampMutator(&mTimestampShared)
 {
 }
 
@@ -57,7 +65,18 @@ ssize_t Pipe::write(const void *buffer, size_t count)
         return actual;
     }
     mFramesWritten += (size_t) actual;
+    // android_atomic_inc() is a full barrier, so either a reader about to sleep is already
+    // counted in mWaitingReaders, or it sees the new sequence and does not sleep.
+    android_atomic_inc(&mWriteSequence);
+    if (CC_UNLIKELY(android_atomic_acquire_load(&mWaitingReaders) > 0)) {
+        (void) syscall(__NR_futex, &mWriteSequence, FUTEX_WAKE_PRIVATE, INT32_MAX);
+    }
     return actual;
 }
 
+void Pipe::setTimestamp(const ExtendedTimestamp &timestamp)
+{
+    mTimestampMutator.push(timestamp);
+}
+
 }   // namespace android
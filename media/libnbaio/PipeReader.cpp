@@ -17,6 +17,10 @@
 #define LOG_TAG "PipeReader"
 //#define LOG_NDEBUG 0
 
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
 #include <cutils/compiler.h>
 #include <cutils/atomic.h>
 #include <utils/Log.h>
@@ -28,7 +32,11 @@ PipeReader::PipeReader(Pipe& pipe) :
         NBAIO_Source(pipe.mFormat),
         mPipe(pipe), mFifoReader(mPipe.mFifo, false /*throttlesWriter*/, false /*flush*/),
         mFramesOverrun(0),
-        mOverruns(0)
+        mOverruns(0),
+        mReadTimeoutNs(0),
+        mTimestampObserver(&pipe.mTimestampShared),
+        // mTimestamp
+        mTimestampValid(false)
 {
     android_atomic_inc(&pipe.mReaders);
 }
@@ -62,7 +70,15 @@ ssize_t PipeReader::availableToRead()
 ssize_t PipeReader::read(void *buffer, size_t count)
 {
     size_t lost;
-    ssize_t actual = mFifoReader.read(buffer, count, NULL /*timeout*/, &lost);
+    ssize_t actual;
+    nsecs_t deadline = 0;
+    for (;;) {
+        int32_t sequence = android_atomic_acquire_load(&mPipe.mWriteSequence);
+        actual = mFifoReader.read(buffer, count, NULL /*timeout*/, &lost);
+        if (actual != 0 || count == 0 || !waitForWrite(sequence, &deadline)) {
+            break;
+        }
+    }
     ALOG_ASSERT(actual <= count);
     if (actual == -EOVERFLOW || lost > 0) {
         mFramesOverrun += lost;
@@ -76,6 +92,108 @@ ssize_t PipeReader::read(void *buffer, size_t count)
     return actual;
 }
 
+ssize_t PipeReader::readVia(readVia_t via, size_t total, void *user, size_t block)
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    static const size_t defaultBlock = 32;
+    if (block == 0) {
+        block = defaultBlock;
+    }
+    audio_utils_iovec iovec[2];
+    size_t lost;
+    ssize_t obtained;
+    nsecs_t deadline = 0;
+    for (;;) {
+        int32_t sequence = android_atomic_acquire_load(&mPipe.mWriteSequence);
+        obtained = mFifoReader.obtain(iovec, total, NULL /*timeout*/, &lost);
+        if (obtained != 0 || total == 0 || !waitForWrite(sequence, &deadline)) {
+            break;
+        }
+    }
+    if (obtained == -EOVERFLOW || lost > 0) {
+        mFramesOverrun += lost;
+        ++mOverruns;
+        obtained = OVERRUN;
+    }
+    if (obtained <= 0) {
+        return obtained;
+    }
+    // the callback consumes the frames in place, and may take fewer than offered
+    size_t accumulator = 0;
+    ssize_t ret = 0;
+    for (size_t i = 0; i < 2; ++i) {
+        const uint8_t *data = (const uint8_t *) mPipe.mBuffer + iovec[i].mOffset * mFrameSize;
+        size_t remaining = iovec[i].mLength;
+        while (remaining > 0) {
+            size_t count = remaining > block ? block : remaining;
+            ret = via(user, data, count);
+            if (ret <= 0) {
+                break;
+            }
+            ALOG_ASSERT((size_t) ret <= count);
+            accumulator += ret;
+            remaining -= ret;
+            data += ret * mFrameSize;
+            if ((size_t) ret < count) {
+                break;
+            }
+        }
+        if (remaining > 0) {
+            break;
+        }
+    }
+    mFifoReader.release(accumulator);
+    if (accumulator == 0) {
+        return ret;
+    }
+    mFramesRead += accumulator;
+    return accumulator;
+}
+
+void PipeReader::setReadTimeout(int64_t timeoutNs)
+{
+    mReadTimeoutNs = timeoutNs;
+}
+
+bool PipeReader::waitForWrite(int32_t sequence, nsecs_t *deadline)
+{
+    if (mReadTimeoutNs <= 0) {
+        return false;
+    }
+    nsecs_t now = systemTime();
+    if (*deadline == 0) {
+        *deadline = now + mReadTimeoutNs;
+    }
+    nsecs_t remainingNs = *deadline - now;
+    if (remainingNs <= 0) {
+        return false;
+    }
+    struct timespec remaining;
+    remaining.tv_sec = remainingNs / 1000000000;
+    remaining.tv_nsec = remainingNs % 1000000000;
+    android_atomic_inc(&mPipe.mWaitingReaders);
+    // returns at once if a write has happened since sequence was loaded
+    (void) syscall(__NR_futex, &mPipe.mWriteSequence, FUTEX_WAIT_PRIVATE, sequence, &remaining);
+    android_atomic_dec(&mPipe.mWaitingReaders);
+    return true;
+}
+
+status_t PipeReader::getTimestamp(ExtendedTimestamp &timestamp)
+{
+    ExtendedTimestamp ets;
+    if (mTimestampObserver.poll(ets)) {
+        mTimestamp = ets;
+        mTimestampValid = true;
+    }
+    if (!mTimestampValid) {
+        return INVALID_OPERATION;
+    }
+    timestamp = mTimestamp;
+    return OK;
+}
+
 ssize_t PipeReader::flush()
 {
     if (CC_UNLIKELY(!mNegotiated)) {
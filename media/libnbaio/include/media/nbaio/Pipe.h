@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_PIPE_H
 
 #include <audio_utils/fifo.h>
+#include <media/SingleStateQueue.h>
 #include <media/nbaio/NBAIO.h>
 
 namespace android {
@@ -25,6 +26,8 @@ namespace android {
 // Pipe is multi-thread safe for readers (see PipeReader), but safe for only a single writer thread.
 // It cannot UNDERRUN on write, unless we allow designation of a master reader that provides the
 // time-base. Readers can be added and removed dynamically, and it's OK to have no readers.
+// Each reader has its own read position and overrun accounting, so a single writer can feed
+// several consumers, which can read in place with readVia() and see the writer's timestamps.
 class Pipe : public NBAIO_Sink {
 
     friend class PipeReader;
@@ -57,13 +60,26 @@ public:
     virtual ssize_t write(const void *buffer, size_t count);
     //virtual ssize_t writeVia(writeVia_t via, size_t total, void *user, size_t block);
 
+    // Publishes a timestamp for the frames written so far, for example the capture position
+    // of the input they came from. Readers retrieve it with PipeReader::getTimestamp().
+    // Must be called from the writer thread.
+            void    setTimestamp(const ExtendedTimestamp &timestamp);
+
 private:
     const size_t    mMaxFrames;     // always a power of 2
     void * const    mBuffer;
     audio_utils_fifo        mFifo;
     audio_utils_fifo_writer mFifoWriter;
     volatile int32_t mReaders;      // number of PipeReader clients currently attached to this Pipe
+
+    // The fifo only wakes a reader that throttles the writer, which a Pipe has none of, so
+    // PipeReaders with a read timeout sleep on this counter, which each write() bumps.
+    volatile int32_t mWriteSequence;
+    volatile int32_t mWaitingReaders;   // number of PipeReaders sleeping on mWriteSequence
     const bool      mFreeBufferInDestructor;
+
+    SingleStateQueue<ExtendedTimestamp>::Shared     mTimestampShared;
+    SingleStateQueue<ExtendedTimestamp>::Mutator    mTimestampMutator;
 };
 
 }   // namespace android
@@ -17,6 +17,9 @@
 #ifndef ANDROID_AUDIO_PIPE_READER_H
 #define ANDROID_AUDIO_PIPE_READER_H
 
+#include <stdint.h>
+#include <utils/Timers.h>
+
 #include "Pipe.h"
 
 namespace android {
@@ -29,6 +32,15 @@ public:
     // Construct a PipeReader and associate it with a Pipe
     // FIXME make this constructor a factory method of Pipe.
     PipeReader(Pipe& pipe);
+
+    // By default read() and readVia() return 0 when there is nothing to read.
+    // A non-zero timeout makes them wait up to timeoutNs for the writer to provide at least
+    // one frame instead; they still return 0 if the timeout expires.
+            void    setReadTimeout(int64_t timeoutNs);
+
+    // Returns NO_ERROR and the latest timestamp published by Pipe::setTimestamp(), if any.
+    // Positions are in frames written to the pipe.
+            status_t getTimestamp(ExtendedTimestamp &timestamp);
     virtual ~PipeReader();
 
     // NBAIO_Port interface
@@ -47,6 +59,12 @@ public:
 
     virtual ssize_t read(void *buffer, size_t count);
 
+    // Passes the frames to the callback directly from the pipe buffer, without a copy.
+    // As for NBAIO_Source, block 0 means at most 32 frames per callback; pass
+    // kUnboundedBlock to offer each contiguous region of the pipe in one callback.
+    virtual ssize_t readVia(readVia_t via, size_t total, void *user, size_t block = 0);
+    static const size_t kUnboundedBlock = SIZE_MAX;
+
     virtual ssize_t flush();
 
     // NBAIO_Source end
@@ -60,6 +78,17 @@ private:
     audio_utils_fifo_reader mFifoReader;
     int64_t     mFramesOverrun;
     int64_t     mOverruns;
+
+    int64_t     mReadTimeoutNs;     // 0 means non-blocking
+
+    // Sleeps until the pipe's write sequence moves past sequence, or deadline is reached.
+    // *deadline is 0 on the first call of a read, and is then set from mReadTimeoutNs.
+    // Returns false without sleeping if the read is non-blocking or its timeout has expired.
+            bool    waitForWrite(int32_t sequence, nsecs_t *deadline);
+
+    SingleStateQueue<ExtendedTimestamp>::Observer   mTimestampObserver;
+    ExtendedTimestamp mTimestamp;
+    bool        mTimestampValid;
 };
 
 }   // namespace android
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "PipeReader_test"
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/nbaio/Pipe.h>
+#include <media/nbaio/PipeReader.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+static const size_t kPipeFrames = 1024;
+static const nsecs_t kTimeoutNs = 5000000000LL;     // 5 s
+static const useconds_t kWriteDelayUs = 20000;      // 20 ms
+
+class PipeReaderTest : public ::testing::Test {
+protected:
+    PipeReaderTest()
+        : mFormat(Format_from_SR_C(48000, 1, AUDIO_FORMAT_PCM_16_BIT)),
+          mPipe(kPipeFrames, mFormat),
+          mReader(mPipe) {
+        const NBAIO_Format offers[1] = {mFormat};
+        size_t numCounterOffers = 0;
+        EXPECT_EQ(0, mPipe.negotiate(offers, 1, NULL, numCounterOffers));
+        numCounterOffers = 0;
+        EXPECT_EQ(0, mReader.negotiate(offers, 1, NULL, numCounterOffers));
+    }
+
+    void writeFrames(size_t count) {
+        std::vector<int16_t> frames(count, 0x1234);
+        ASSERT_EQ((ssize_t) count, mPipe.write(frames.data(), count));
+    }
+
+    const NBAIO_Format mFormat;
+    Pipe mPipe;
+    PipeReader mReader;
+};
+
+struct ViaCounter {
+    size_t mCalls = 0;
+    size_t mLargestCount = 0;
+
+    static ssize_t via(void *user, const void * /*buffer*/, size_t count) {
+        ViaCounter *counter = (ViaCounter *) user;
+        ++counter->mCalls;
+        if (count > counter->mLargestCount) {
+            counter->mLargestCount = count;
+        }
+        return count;
+    }
+};
+
+TEST_F(PipeReaderTest, NonBlockingReadOfEmptyPipe) {
+    int16_t frames[16];
+    EXPECT_EQ(0, mReader.read(frames, 16));
+}
+
+// A reader blocked on an empty pipe returns as soon as the writer provides
+// frames, not when its timeout expires.
+TEST_F(PipeReaderTest, WriteWakesBlockedRead) {
+    mReader.setReadTimeout(kTimeoutNs);
+    std::thread writer([this]() {
+        usleep(kWriteDelayUs);
+        writeFrames(16);
+    });
+    int16_t frames[16];
+    nsecs_t start = systemTime();
+    ssize_t actual = mReader.read(frames, 16);
+    nsecs_t elapsedNs = systemTime() - start;
+    writer.join();
+    EXPECT_EQ(16, actual);
+    EXPECT_LT(elapsedNs, kTimeoutNs / 10);
+}
+
+TEST_F(PipeReaderTest, WriteWakesBlockedReadVia) {
+    mReader.setReadTimeout(kTimeoutNs);
+    std::thread writer([this]() {
+        usleep(kWriteDelayUs);
+        writeFrames(16);
+    });
+    ViaCounter counter;
+    nsecs_t start = systemTime();
+    ssize_t actual = mReader.readVia(ViaCounter::via, 16, &counter);
+    nsecs_t elapsedNs = systemTime() - start;
+    writer.join();
+    EXPECT_EQ(16, actual);
+    EXPECT_LT(elapsedNs, kTimeoutNs / 10);
+}
+
+TEST_F(PipeReaderTest, BlockedReadTimesOut) {
+    const nsecs_t timeoutNs = 50000000;    // 50 ms
+    mReader.setReadTimeout(timeoutNs);
+    int16_t frames[16];
+    nsecs_t start = systemTime();
+    EXPECT_EQ(0, mReader.read(frames, 16));
+    EXPECT_GE(systemTime() - start, timeoutNs);
+}
+
+TEST_F(PipeReaderTest, ReadViaDefaultBlock) {
+    writeFrames(100);
+    ViaCounter counter;
+    EXPECT_EQ(100, mReader.readVia(ViaCounter::via, 100, &counter));
+    EXPECT_EQ(32u, counter.mLargestCount);
+    EXPECT_EQ(4u, counter.mCalls);
+}
+
+TEST_F(PipeReaderTest, ReadViaUnboundedBlock) {
+    writeFrames(100);
+    ViaCounter counter;
+    EXPECT_EQ(100, mReader.readVia(ViaCounter::via, 100, &counter,
+            PipeReader::kUnboundedBlock));
+    EXPECT_EQ(100u, counter.mLargestCount);
+    EXPECT_EQ(1u, counter.mCalls);
+}
@@ -483,6 +483,7 @@ void NBLog::Writer::logVFormat(const char *fmt, log_hash_t hash, va_list argp)
     }
     Writer::logStart(fmt);
     int i;
+    int64_t ll;
     double f;
     char* s;
     int64_t t;
@@ -509,6 +510,19 @@ void NBLog::Writer::logVFormat(const char *fmt, log_hash_t hash, va_list argp)
             Writer::logInteger(i);
             break;
 
+        case 'l': // 64-bit integer, as %lld
+            while (p[1] == 'l') {
+                ++p;
+            }
+            if (p[1] != 'd') {
+                ALOGW("NBLog Writer parsed invalid format specifier: l%c", p[1]);
+                break;
+            }
+            ++p;
+            ll = va_arg(argp, long long);
+            Writer::log(EVENT_INTEGER64, &ll, sizeof(ll));
+            break;
+
         case 'f': // float
             f = va_arg(argp, double); // float arguments are promoted to double in vararg lists
             Writer::logFloat((float)f);
@@ -534,6 +548,42 @@ void NBLog::Writer::logVFormat(const char *fmt, log_hash_t hash, va_list argp)
     Writer::logEnd();
 }
 
+void NBLog::Writer::FormatBuffer::append(Event event, const void *data, size_t length)
+{
+    if (mOverflow) {
+        return;
+    }
+    if (length > Entry::kMaxLength || mSize + length + Entry::kOverhead > kMaxSize) {
+        mOverflow = true;
+        return;
+    }
+    // same layout as Entry::copyEntryDataAt()
+    mBuffer[mSize++] = event;
+    mBuffer[mSize++] = length;
+    if (length > 0) {
+        memcpy(&mBuffer[mSize], data, length);
+        mSize += length;
+    }
+    mBuffer[mSize++] = length;
+}
+
+void NBLog::Writer::FormatBuffer::appendArg(const char *s)
+{
+    LOG_ALWAYS_FATAL_IF(s == NULL, "Attempted to log NULL string");
+    append(EVENT_STRING, s, std::min(strlen(s), Entry::kMaxLength));
+}
+
+void NBLog::Writer::log(const FormatBuffer &buffer)
+{
+    if (buffer.mOverflow) {
+        // dropping the whole entry keeps format and arguments consistent for the reader
+        ALOGW("NBLog Writer dropped formatted entry larger than %zu bytes",
+                FormatBuffer::kMaxSize);
+        return;
+    }
+    mFifoWriter->write(buffer.mBuffer, buffer.mSize);
+}
+
 void NBLog::Writer::log(Event event, const void *data, size_t length)
 {
     if (!mEnabled) {
@@ -565,14 +615,15 @@ void NBLog::Writer::log(const NBLog::Entry *etr, bool trusted)
     size_t need = etr->mLength + Entry::kOverhead;    // mEvent, mLength, data[mLength], mLength
                                                       // need = number of bytes written to FIFO
 
-    // FIXME optimize this using memcpy for the data part of the Entry.
-    // The Entry could have a method copyTo(ptr, offset, size) to optimize the copy.
     // checks size of a single log Entry: type, length, data pointer and ending
     uint8_t temp[Entry::kMaxLength + Entry::kOverhead];
-    // write this data to temp array
-    for (size_t i = 0; i < need; i++) {
-        temp[i] = etr->copyEntryDataAt(i);
+    // write this data to temp array, in the layout of Entry::copyEntryDataAt()
+    temp[offsetof(entry, type)] = etr->mEvent;
+    temp[offsetof(entry, length)] = etr->mLength;
+    if (etr->mLength > 0) {
+        memcpy(&temp[offsetof(entry, data)], etr->mData, etr->mLength);
     }
+    temp[need + Entry::kPreviousLengthOffset] = etr->mLength;
     // write to circular buffer
     mFifoWriter->write(temp, need);
 }
@@ -856,6 +907,16 @@ void NBLog::MergeReader::getAndProcessSnapshot(NBLog::Reader::Snapshot &snapshot
     if (!body.isEmpty()) {
         dumpLine(timestamp, body);
     }
+
+    // periodically export the performance histograms of each thread
+    for (auto &thread : mThreadPerformanceAnalysis) {
+        const int author = thread.first;
+        const char *name = author >= 0 && author < (int) mNamedReaders.size() ?
+                mNamedReaders[author].name() : "";
+        for (auto &hash : thread.second) {
+            hash.second.reportAnalytics(name, author, hash.first);
+        }
+    }
 }
 
 void NBLog::MergeReader::getAndProcessSnapshot()
@@ -900,6 +961,12 @@ void NBLog::appendInt(String8 *body, const void *data) {
     body->appendFormat("<%d>", x);
 }
 
+void NBLog::appendInt64(String8 *body, const void *data) {
+    int64_t x;
+    memcpy(&x, data, sizeof(x));
+    body->appendFormat("<%lld>", (long long) x);
+}
+
 void NBLog::appendFloat(String8 *body, const void *data) {
     float f;
     memcpy(&f, data, sizeof(float));
@@ -998,6 +1065,20 @@ NBLog::EntryIterator NBLog::Reader::handleFormat(const FormatEntry &fmtEntry,
             appendInt(body, datum);
             break;
 
+        case 'l': // 64-bit integer, as %lld
+            while (fmt_offset + 1 < fmt_length && fmt[fmt_offset + 1] == 'l') {
+                ++fmt_offset;
+            }
+            if (fmt_offset + 1 < fmt_length && fmt[fmt_offset + 1] == 'd') {
+                ++fmt_offset;
+            } else {
+                ALOGW("NBLog Reader encountered unknown specifier starting with l");
+            }
+            ALOGW_IF(event != EVENT_INTEGER64,
+                "NBLog Reader incompatible event for 64-bit integer specifier: %d", event);
+            appendInt64(body, datum);
+            break;
+
         case 'f': // float
             ALOGW_IF(event != EVENT_FLOAT,
                 "NBLog Reader incompatible event for float specifier: %d", event);
@@ -1068,11 +1149,13 @@ void NBLog::Merger::merge() {
     // TODO custom heap implementation could allow to update top, improving performance
     // for bursty buffers
     std::priority_queue<MergeItem, std::vector<MergeItem>, std::greater<MergeItem>> timestamps;
+    // entry at each offset, built once and kept until it is copied
+    std::vector<std::unique_ptr<AbstractEntry>> entries(nLogs);
     for (int i = 0; i < nLogs; ++i)
     {
         if (offsets[i] != snapshots[i]->end()) {
-            int64_t ts = AbstractEntry::buildEntry(offsets[i])->timestamp();
-            timestamps.emplace(ts, i);
+            entries[i] = AbstractEntry::buildEntry(offsets[i]);
+            timestamps.emplace(entries[i]->timestamp(), i);
         }
     }
 
@@ -1080,13 +1163,12 @@ void NBLog::Merger::merge() {
         // find minimum timestamp
         int index = timestamps.top().index;
         // copy it to the log, increasing offset
-        offsets[index] = AbstractEntry::buildEntry(offsets[index])->copyWithAuthor(mFifoWriter,
-                                                                                   index);
+        offsets[index] = entries[index]->copyWithAuthor(mFifoWriter, index);
         // update data structures
         timestamps.pop();
         if (offsets[index] != snapshots[index]->end()) {
-            int64_t ts = AbstractEntry::buildEntry(offsets[index])->timestamp();
-            timestamps.emplace(ts, index);
+            entries[index] = AbstractEntry::buildEntry(offsets[index]);
+            timestamps.emplace(entries[index]->timestamp(), index);
         }
     }
 }
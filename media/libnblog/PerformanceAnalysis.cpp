@@ -24,6 +24,7 @@
 #include <iostream>
 #include <math.h>
 #include <numeric>
+#include <stdlib.h>
 #include <vector>
 #include <stdarg.h>
 #include <stdint.h>
@@ -33,6 +34,7 @@
 #include <time.h>
 #include <new>
 #include <audio_utils/roundup.h>
+#include <media/MediaAnalyticsItem.h>
 #include <media/nblog/NBLog.h>
 #include <media/nblog/PerformanceAnalysis.h>
 #include <media/nblog/ReportPerformance.h>
@@ -104,6 +106,14 @@ void PerformanceAnalysis::logTsEntry(timestamp ts) {
     }
     // add current time intervals to histogram
     ++mHists[0].second[diffJiffy];
+
+    // and to the histograms exported to MediaAnalytics
+    if (mPeriodHistogram.count() == 0) {
+        mAnalyticsStartTs = mBufferPeriod.mPrevTs;
+    }
+    const int64_t periodUs = (ts - mBufferPeriod.mPrevTs) / 1000;
+    mPeriodHistogram.add(periodUs);
+    mJitterHistogram.add(std::llabs(periodUs - static_cast<int64_t>(mBufferPeriod.mMean * 1000)));
     // update previous timestamp
     mBufferPeriod.mPrevTs = ts;
 }
@@ -249,6 +259,52 @@ inline double logRound(double x, double mean) {
     return (static_cast<int>(x) * factor) / factor;
 }
 
+void PerformanceAnalysis::reportAnalytics(const char *threadName, int author, log_hash_t hash,
+                                          bool force) {
+    static constexpr char kKey[] = "audiothread.performance";
+    static constexpr char kThread[] = "android.media.audiothread.performance.thread";
+    static constexpr char kAuthor[] = "android.media.audiothread.performance.author";
+    static constexpr char kHash[] = "android.media.audiothread.performance.hash";
+    static constexpr char kDurationMs[] = "android.media.audiothread.performance.durationMs";
+    static constexpr char kPeriod[] = "android.media.audiothread.performance.period";
+    static constexpr char kJitter[] = "android.media.audiothread.performance.jitter";
+
+    if (mPeriodHistogram.count() == 0) {
+        return;
+    }
+    const int durationMs = deltaMs(mAnalyticsStartTs, mBufferPeriod.mPrevTs);
+    if (!force && durationMs < kAnalyticsPeriodMs) {
+        return;
+    }
+
+    MediaAnalyticsItem *item = new MediaAnalyticsItem(kKey);
+    item->setCString(kThread, threadName);
+    item->setInt32(kAuthor, author);
+    item->setInt64(kHash, static_cast<int64_t>(hash));
+    item->setInt32(kDurationMs, durationMs);
+    // for each histogram: count, percentiles and max in microseconds, and the buckets
+    const std::pair<const char *, const LogLinearHistogram *> histograms[] = {
+        {kPeriod, &mPeriodHistogram},
+        {kJitter, &mJitterHistogram},
+    };
+    for (const auto &histogram : histograms) {
+        const std::string prefix(histogram.first);
+        const LogLinearHistogram &h = *histogram.second;
+        item->setInt64((prefix + ".count").c_str(), h.count());
+        item->setInt64((prefix + ".p50Us").c_str(), h.percentile(0.5));
+        item->setInt64((prefix + ".p90Us").c_str(), h.percentile(0.9));
+        item->setInt64((prefix + ".p99Us").c_str(), h.percentile(0.99));
+        item->setInt64((prefix + ".p999Us").c_str(), h.percentile(0.999));
+        item->setInt64((prefix + ".maxUs").c_str(), h.max());
+        item->setCString((prefix + ".histogram").c_str(), h.toString().c_str());
+    }
+    item->selfrecord();
+    delete item;
+
+    mPeriodHistogram.clear();
+    mJitterHistogram.clear();
+}
+
 // TODO Make it return a std::string instead of modifying body
 // TODO: move this to ReportPerformance, probably make it a friend function
 // of PerformanceAnalysis
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "ReportPerformance"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <queue>
@@ -128,6 +129,80 @@ void writeToFile(const std::deque<std::pair<timestamp, Histogram>> &hists,
     pfs.close();
 }
 
+void LogLinearHistogram::clear() {
+    memset(mCounts, 0, sizeof(mCounts));
+    mCount = 0;
+    mMin = 0;
+    mMax = 0;
+}
+
+void LogLinearHistogram::add(int64_t value) {
+    if (value < 0) {
+        value = 0;
+    }
+    ++mCounts[bucketOf(value)];
+    if (mCount == 0 || value < mMin) {
+        mMin = value;
+    }
+    if (mCount == 0 || value > mMax) {
+        mMax = value;
+    }
+    ++mCount;
+}
+
+int64_t LogLinearHistogram::percentile(double p) const {
+    if (mCount == 0) {
+        return 0;
+    }
+    const int64_t target = std::max<int64_t>(1, static_cast<int64_t>(p * mCount + 0.5));
+    int64_t accumulated = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        accumulated += mCounts[i];
+        if (accumulated >= target) {
+            return std::min(lowerBoundOf(i + 1) - 1, mMax);
+        }
+    }
+    return mMax;
+}
+
+std::string LogLinearHistogram::toString() const {
+    std::stringstream ss;
+    for (int i = 0; i < kBuckets; ++i) {
+        if (mCounts[i] == 0) {
+            continue;
+        }
+        if (ss.tellp() > 0) {
+            ss << ",";
+        }
+        ss << lowerBoundOf(i) << ":" << mCounts[i];
+    }
+    return ss.str();
+}
+
+// static
+int LogLinearHistogram::bucketOf(uint64_t value) {
+    if (value < kSubBuckets) {
+        return value;
+    }
+    if (value >= (1ull << kMaxExponent)) {
+        return kBuckets - 1;
+    }
+    // value is in [2^exponent, 2^(exponent + 1)), split into kSubBuckets buckets
+    const int exponent = 63 - __builtin_clzll(value);
+    const int subBucket = (value >> (exponent - kSubBucketBits)) - kSubBuckets;
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + subBucket;
+}
+
+// static
+int64_t LogLinearHistogram::lowerBoundOf(int bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const int group = bucket / kSubBuckets;
+    const int subBucket = bucket % kSubBuckets;
+    return static_cast<int64_t>(kSubBuckets + subBucket) << (group - 1);
+}
+
 } // namespace ReportPerformance
 
 }   // namespace android
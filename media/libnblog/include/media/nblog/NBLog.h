@@ -19,6 +19,7 @@
 #ifndef ANDROID_MEDIA_NBLOG_H
 #define ANDROID_MEDIA_NBLOG_H
 
+#include <algorithm>
 #include <deque>
 #include <map>
 #include <set>
@@ -63,6 +64,7 @@ public:
         EVENT_HISTOGRAM_ENTRY_TS,   // single datum for timestamp histogram
         EVENT_AUDIO_STATE,          // audio on/off event: logged on FastMixer::onStateChange call
         EVENT_END_FMT,              // end of logFormat argument list
+        EVENT_INTEGER64,            // 64-bit integer value entry
 
         EVENT_UPPER_BOUND,          // to check for invalid events
     };
@@ -268,6 +270,7 @@ private:
     //  byte[3+mLength]     start of next log entry
 
     static void    appendInt(String8 *body, const void *data);
+    static void    appendInt64(String8 *body, const void *data);
     static void    appendFloat(String8 *body, const void *data);
     static void    appendPID(String8 *body, const void *data, size_t length);
     static void    appendTimestamp(String8 *body, const void *data);
@@ -346,6 +349,16 @@ public:
         virtual void    logHash(log_hash_t hash);
         virtual void    logEventHistTs(Event event, log_hash_t hash);
 
+        // Same as logFormat(), but for use on real-time threads: arguments are encoded
+        // according to their C++ type instead of by parsing fmt, and the whole formatted
+        // entry reaches the FIFO with a single write. Formatting to text is left to the reader.
+        // Each argument must be an int (%d), a long long or int64_t (%lld), a float or double
+        // (%f), a string (%s) or a CLOCK_MONOTONIC timespec (%t), in the order of the
+        // conversions in fmt; %p is not supported.
+        // Not thread-safe, even for LockedWriter.
+        template <typename... Args>
+        void    logFormatArgs(const char *fmt, log_hash_t hash, const Args&... args);
+
         virtual bool    isEnabled() const;
 
         // return value for all of these is the previous isEnabled()
@@ -356,6 +369,40 @@ public:
         sp<IMemory>     getIMemory() const  { return mIMemory; }
 
     private:
+        // Formatted entry being built in local memory by logFormatArgs()
+        class FormatBuffer {
+        public:
+            FormatBuffer() : mSize(0), mOverflow(false) { }
+
+            // appends an entry, or marks the buffer as overflowed if it doesn't fit
+            void    append(Event event, const void *data, size_t length);
+
+            void    appendArg(int x)            { append(EVENT_INTEGER, &x, sizeof(x)); }
+            void    appendArg(float x)          { append(EVENT_FLOAT, &x, sizeof(x)); }
+            void    appendArg(double x)         { appendArg((float) x); }
+            // int64_t is one of long and long long, depending on the ABI
+            void    appendArg(long x)           { appendArg((long long) x); }
+            void    appendArg(long long x)      {
+                const int64_t v = x;
+                append(EVENT_INTEGER64, &v, sizeof(v));
+            }
+            void    appendArg(const timespec &ts) {
+                const int64_t ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+                append(EVENT_TIMESTAMP, &ns, sizeof(ns));
+            }
+            void    appendArg(const char *s);
+
+        private:
+            friend class Writer;
+            static const size_t kMaxSize = 1024;
+            size_t  mSize;
+            bool    mOverflow;
+            uint8_t mBuffer[kMaxSize];
+        };
+
+        // writes the entries of buffer to the FIFO, unless it has overflowed
+        void    log(const FormatBuffer &buffer);
+
         // 0 <= length <= kMaxLength
         // writes a single Entry to the FIFO
         void    log(Event event, const void *data, size_t length);
@@ -608,6 +655,24 @@ static inline int64_t get_monotonic_ns() {
     return 0; // should not happen.
 }
 
+template <typename... Args>
+void NBLog::Writer::logFormatArgs(const char *fmt, log_hash_t hash, const Args&... args)
+{
+    if (!mEnabled) {
+        return;
+    }
+    FormatBuffer buffer;
+    buffer.append(EVENT_START_FMT, fmt, std::min(strlen(fmt), Entry::kMaxLength));
+    const int64_t ts = get_monotonic_ns();
+    buffer.append(EVENT_TIMESTAMP, &ts, sizeof(ts));
+    buffer.append(EVENT_HASH, &hash, sizeof(hash));
+    // appends the arguments in order
+    const int unused[] = {0, (buffer.appendArg(args), 0)...};
+    (void) unused;
+    buffer.append(EVENT_END_FMT, NULL, 0);
+    log(buffer);
+}
+
 }   // namespace android
 
 #endif  // ANDROID_MEDIA_NBLOG_H
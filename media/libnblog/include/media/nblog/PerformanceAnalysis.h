@@ -62,6 +62,11 @@ public:
     // writes to mOutlierData <time elapsed since previous outlier, outlier timestamp>
     bool detectAndStoreOutlier(const msInterval diffMs);
 
+    // Records the wakeup period and jitter histograms as a MediaAnalytics item, at most every
+    // kAnalyticsPeriodMs of audio unless force is set, then starts new histograms.
+    void reportAnalytics(const char *threadName, int author, log_hash_t hash,
+                         bool force = false);
+
     // Generates a string of analysis of the buffer periods and prints to console
     // FIXME: move this data visualization to a separate class. Model/view/controller
     void reportPerformance(String8 *body, int author, log_hash_t hash,
@@ -82,6 +87,14 @@ private:
     // stores buffer period histograms with timestamp of first sample
     std::deque<std::pair<timestamp, Histogram>> mHists;
 
+    // wakeup periods and their deviation from the mean period, in microseconds,
+    // since mAnalyticsStartTs
+    LogLinearHistogram mPeriodHistogram;
+    LogLinearHistogram mJitterHistogram;
+    timestamp mAnalyticsStartTs = 0;
+
+    static constexpr int kAnalyticsPeriodMs = 10 * kSecPerMin * kMsPerSec;
+
     // Parameters used when detecting outliers
     struct BufferPeriod {
         double    mMean = -1;          // average time between audio processing wakeups
@@ -19,6 +19,7 @@
 
 #include <deque>
 #include <map>
+#include <string>
 #include <vector>
 
 namespace android {
@@ -56,6 +57,45 @@ static inline uint32_t log2(uint32_t x) {
     return 31 - __builtin_clz(x);
 }
 
+// Histogram with buckets of constant relative width, in the style of HdrHistogram:
+// values below kSubBuckets have their own bucket, and every power of 2 range above is split
+// into kSubBuckets linear buckets. This covers values from 0 to 2^kMaxExponent in a fixed
+// amount of memory, with a precision of 1/kSubBuckets, and can be merged and exported as is.
+class LogLinearHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxExponent = 32; // larger values are counted in the last bucket
+    static constexpr int kBuckets = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+    LogLinearHistogram() { clear(); }
+
+    void clear();
+
+    // negative values are counted as 0
+    void add(int64_t value);
+
+    int64_t count() const { return mCount; }
+    int64_t min() const { return mMin; }
+    int64_t max() const { return mMax; }
+
+    // Returns an upper bound of the value below which a fraction p (0 to 1) of the values
+    // fall, within the precision of the buckets. Returns 0 for an empty histogram.
+    int64_t percentile(double p) const;
+
+    // Returns the non-empty buckets as "lowerBound:count" pairs separated by commas.
+    std::string toString() const;
+
+private:
+    static int bucketOf(uint64_t value);
+    static int64_t lowerBoundOf(int bucket);
+
+    uint32_t mCounts[kBuckets];
+    int64_t  mCount;
+    int64_t  mMin;
+    int64_t  mMax;
+};
+
 // Writes outlier intervals, timestamps, peaks timestamps, and histograms to a file.
 void writeToFile(const std::deque<std::pair<timestamp, Histogram>> &hists,
                  const std::deque<std::pair<msInterval, timestamp>> &outlierData,
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Writer side cost of one formatted NBLog event, in ns per event: logFormat() parses the
+// format string and writes each argument to the FIFO separately, logFormatArgs() encodes
+// the arguments by type and writes the entry once. Nothing reads the FIFO, which wraps.
+
+#include <stdint.h>
+#include <time.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/nblog/NBLog.h>
+
+using namespace android;
+
+static const size_t kLogSize = 64 * 1024;
+
+class WriterFixture {
+public:
+    WriterFixture() : mMemory(NBLog::Timeline::sharedSize(kLogSize)) {
+        new (mMemory.data()) NBLog::Shared;
+        mWriter = new NBLog::Writer(mMemory.data(), kLogSize);
+    }
+
+    std::vector<char> mMemory;
+    sp<NBLog::Writer> mWriter;
+};
+
+static void BM_LogFormatInt64(benchmark::State& state) {
+    WriterFixture fixture;
+    long long frames = 0;
+    while (state.KeepRunning()) {
+        fixture.mWriter->logFormat("standby after %lld frames", 0 /* hash */, frames++);
+    }
+}
+BENCHMARK(BM_LogFormatInt64);
+
+static void BM_LogFormatArgsInt64(benchmark::State& state) {
+    WriterFixture fixture;
+    int64_t frames = 0;
+    while (state.KeepRunning()) {
+        fixture.mWriter->logFormatArgs("standby after %lld frames", 0 /* hash */, frames++);
+    }
+}
+BENCHMARK(BM_LogFormatArgsInt64);
+
+static void BM_LogFormatMixed(benchmark::State& state) {
+    WriterFixture fixture;
+    int i = 0;
+    while (state.KeepRunning()) {
+        fixture.mWriter->logFormat("track %d gain %f state %s frames %lld", 0 /* hash */,
+                i, 0.5, "active", (long long) i);
+        ++i;
+    }
+}
+BENCHMARK(BM_LogFormatMixed);
+
+static void BM_LogFormatArgsMixed(benchmark::State& state) {
+    WriterFixture fixture;
+    int i = 0;
+    while (state.KeepRunning()) {
+        fixture.mWriter->logFormatArgs("track %d gain %f state %s frames %lld", 0 /* hash */,
+                i, 0.5f, "active", (int64_t) i);
+        ++i;
+    }
+}
+BENCHMARK(BM_LogFormatArgsMixed);
+
+BENCHMARK_MAIN();
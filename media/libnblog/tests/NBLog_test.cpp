@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NBLog_test"
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/nblog/NBLog.h>
+#include <utils/String8.h>
+
+using namespace android;
+
+static const size_t kLogSize = 4096;
+
+// Exposes the formatting of a single format entry.
+class FormattingReader : public NBLog::Reader {
+public:
+    FormattingReader(const void *shared, size_t size) : Reader(shared, size) { }
+
+    // Formats the first format entry of the snapshot into body.
+    bool formatFirst(Snapshot &snapshot, String8 *body) {
+        String8 timestamp;
+        for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+            if (it->type == NBLog::EVENT_START_FMT) {
+                handleFormat(NBLog::FormatEntry(it), &timestamp, body);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+class NBLogTest : public ::testing::Test {
+protected:
+    NBLogTest()
+        : mMemory(NBLog::Timeline::sharedSize(kLogSize)) {
+        new (mMemory.data()) NBLog::Shared;
+        mWriter = new NBLog::Writer(mMemory.data(), kLogSize);
+        mReader = new FormattingReader(mMemory.data(), kLogSize);
+    }
+
+    // Returns the arguments of the first format entry logged, and its text in body.
+    std::vector<std::pair<int, std::vector<uint8_t>>> readFirst(String8 *body) {
+        std::vector<std::pair<int, std::vector<uint8_t>>> args;
+        std::unique_ptr<NBLog::Reader::Snapshot> snapshot = mReader->getSnapshot();
+        for (auto it = snapshot->begin(); it != snapshot->end(); ++it) {
+            if (it->type != NBLog::EVENT_START_FMT) {
+                continue;
+            }
+            for (auto arg = NBLog::FormatEntry(it).args();
+                    arg != snapshot->end() && arg->type != NBLog::EVENT_END_FMT; ++arg) {
+                args.emplace_back(arg->type,
+                        std::vector<uint8_t>(arg->data, arg->data + arg->length));
+            }
+            break;
+        }
+        EXPECT_TRUE(mReader->formatFirst(*snapshot, body));
+        return args;
+    }
+
+    static int64_t int64At(const std::vector<uint8_t> &data) {
+        int64_t x = 0;
+        EXPECT_EQ(sizeof(x), data.size());
+        memcpy(&x, data.data(), std::min(sizeof(x), data.size()));
+        return x;
+    }
+
+    std::vector<char> mMemory;
+    sp<NBLog::Writer> mWriter;
+    sp<FormattingReader> mReader;
+};
+
+// int64_t arguments are logged as 64-bit integers, not as timestamps, and %lld prints them.
+TEST_F(NBLogTest, LogFormatArgsInteger64) {
+    const int64_t frames = (int64_t) 1 << 40;
+    mWriter->logFormatArgs("standby after %lld frames", 0 /* hash */, frames);
+
+    String8 body;
+    auto args = readFirst(&body);
+    ASSERT_EQ(1u, args.size());
+    EXPECT_EQ(NBLog::EVENT_INTEGER64, args[0].first);
+    EXPECT_EQ(frames, int64At(args[0].second));
+    EXPECT_NE(-1, body.find("standby after <1099511627776> frames")) << body.string();
+}
+
+// long and long long take the same path whatever the size of long is.
+TEST_F(NBLogTest, LogFormatArgsLongAndLongLong) {
+    mWriter->logFormatArgs("%lld %ld %d", 0 /* hash */, -5LL, 7L, 3);
+
+    String8 body;
+    auto args = readFirst(&body);
+    ASSERT_EQ(3u, args.size());
+    EXPECT_EQ(NBLog::EVENT_INTEGER64, args[0].first);
+    EXPECT_EQ(-5, int64At(args[0].second));
+    EXPECT_EQ(NBLog::EVENT_INTEGER64, args[1].first);
+    EXPECT_EQ(7, int64At(args[1].second));
+    EXPECT_EQ(NBLog::EVENT_INTEGER, args[2].first);
+    EXPECT_NE(-1, body.find("<-5> <7> <3>")) << body.string();
+}
+
+// The varargs path parses %lld and writes the same event.
+TEST_F(NBLogTest, LogFormatInteger64) {
+    mWriter->logFormat("frames %lld", 0 /* hash */, (long long) INT64_MIN);
+
+    String8 body;
+    auto args = readFirst(&body);
+    ASSERT_EQ(1u, args.size());
+    EXPECT_EQ(NBLog::EVENT_INTEGER64, args[0].first);
+    EXPECT_EQ(INT64_MIN, int64At(args[0].second));
+    EXPECT_NE(-1, body.find("frames <-9223372036854775808>")) << body.string();
+}
+
+// Timestamps are passed as a timespec and stay distinct from 64-bit integers.
+TEST_F(NBLogTest, LogFormatArgsTimestamp) {
+    timespec ts;
+    ts.tv_sec = 12;
+    ts.tv_nsec = 345000000;
+    mWriter->logFormatArgs("at %t", 0 /* hash */, ts);
+
+    String8 body;
+    auto args = readFirst(&body);
+    ASSERT_EQ(1u, args.size());
+    EXPECT_EQ(NBLog::EVENT_TIMESTAMP, args[0].first);
+    EXPECT_EQ(12345000000LL, int64At(args[0].second));
+    EXPECT_NE(-1, body.find("at [12.345]")) << body.string();
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ReportPerformance_test"
+
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+#include <media/nblog/ReportPerformance.h>
+
+using namespace android::ReportPerformance;
+
+TEST(LogLinearHistogramTest, Empty) {
+    LogLinearHistogram h;
+    EXPECT_EQ(0, h.count());
+    EXPECT_EQ(0, h.min());
+    EXPECT_EQ(0, h.max());
+    EXPECT_EQ(0, h.percentile(0.5));
+    EXPECT_EQ("", h.toString());
+}
+
+// Values below kSubBuckets, and every value of the first power of 2 range above them,
+// have a bucket of their own.
+TEST(LogLinearHistogramTest, SmallValuesAreExact) {
+    LogLinearHistogram h;
+    for (int64_t value = 0; value < 2 * LogLinearHistogram::kSubBuckets; ++value) {
+        h.add(value);
+    }
+    h.add(7);
+    EXPECT_EQ("0:1,1:1,2:1,3:1,4:1,5:1,6:1,7:2,8:1,9:1,10:1,11:1,12:1,13:1,14:1,15:1,"
+            "16:1,17:1,18:1,19:1,20:1,21:1,22:1,23:1,24:1,25:1,26:1,27:1,28:1,29:1,30:1,31:1",
+            h.toString());
+    EXPECT_EQ(33, h.count());
+    EXPECT_EQ(0, h.min());
+    EXPECT_EQ(31, h.max());
+}
+
+// Each power of 2 range [2^e, 2^(e+1)) is split into kSubBuckets buckets of width
+// 2^(e - kSubBucketBits).
+TEST(LogLinearHistogramTest, BucketWidthDoublesPerPowerOf2) {
+    LogLinearHistogram h;
+    h.add(32);      // [32, 34)
+    h.add(33);
+    h.add(34);      // [34, 36)
+    h.add(63);      // [62, 64)
+    h.add(64);      // [64, 68)
+    h.add(67);
+    h.add(1000);    // [992, 1024)
+    h.add(1023);
+    h.add(1024);    // [1024, 1088)
+    EXPECT_EQ("32:2,34:1,62:1,64:2,992:2,1024:1", h.toString());
+}
+
+// Negative values count as 0, and values from 2^kMaxExponent up share the last bucket.
+TEST(LogLinearHistogramTest, OutOfRangeValues) {
+    LogLinearHistogram h;
+    h.add(-5);
+    h.add(0);
+    h.add((1LL << LogLinearHistogram::kMaxExponent) - 1);
+    h.add(1LL << LogLinearHistogram::kMaxExponent);
+    h.add(1LL << 40);
+    // the last bucket starts at 31 << 27
+    EXPECT_EQ("0:2,4160749568:3", h.toString());
+    EXPECT_EQ(0, h.min());
+    EXPECT_EQ(1LL << 40, h.max());
+}
+
+// Percentiles are the upper end of the bucket they fall in, capped by the maximum.
+TEST(LogLinearHistogramTest, Percentiles) {
+    LogLinearHistogram h;
+    for (int64_t value = 1; value <= 100; ++value) {
+        h.add(value);
+    }
+    EXPECT_EQ(1, h.percentile(0));
+    EXPECT_EQ(10, h.percentile(0.1));   // below 16, buckets are exact
+    EXPECT_EQ(51, h.percentile(0.5));   // [50, 52)
+    EXPECT_EQ(91, h.percentile(0.9));   // [88, 92)
+    EXPECT_EQ(99, h.percentile(0.99));  // [96, 100)
+    EXPECT_EQ(100, h.percentile(1));    // [100, 104), capped by the maximum
+}
+
+TEST(LogLinearHistogramTest, Clear) {
+    LogLinearHistogram h;
+    h.add(10);
+    h.add(1000);
+    h.clear();
+    EXPECT_EQ(0, h.count());
+    EXPECT_EQ(0, h.max());
+    EXPECT_EQ("", h.toString());
+    h.add(3);
+    EXPECT_EQ(3, h.min());
+    EXPECT_EQ("3:1", h.toString());
+}
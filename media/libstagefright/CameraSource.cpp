@@ -103,6 +103,7 @@ void CameraSourceListener::postDataTimestamp(
     sp<CameraSource> source = mSource.promote();
     if (source.get() != NULL) {
         source->dataCallbackTimestamp(timestamp/1000, msgType, dataPtr);
+        source->notifyReadyListener();
     }
 }
 
@@ -111,6 +112,7 @@ void CameraSourceListener::postRecordingFrameHandleTimestamp(nsecs_t timestamp,
     sp<CameraSource> source = mSource.promote();
     if (source.get() != nullptr) {
         source->recordingFrameHandleCallbackTimestamp(timestamp/1000, handle);
+        source->notifyReadyListener();
     }
 }
 
@@ -125,6 +127,7 @@ void CameraSourceListener::postRecordingFrameHandleTimestampBatch(
             modifiedTimestamps[i] = timestamps[i] / 1000;
         }
         source->recordingFrameHandleCallbackTimestampBatch(modifiedTimestamps, handles);
+        source->notifyReadyListener();
     }
 }
 
@@ -730,6 +733,9 @@ CameraSource::~CameraSource() {
         // Camera's lock is released in this case.
         releaseCamera();
     }
+
+    Mutex::Autolock autoLock(mLock);
+    releaseIdleFrameWrappersLocked();
 }
 
 status_t CameraSource::startCameraRecording() {
@@ -899,6 +905,7 @@ status_t CameraSource::reset() {
         mStarted = false;
         mEos = false;
         mStopSystemTimeUs = -1;
+        mReadyListener.clear();
         mFrameAvailableCondition.signal();
 
         int64_t token;
@@ -916,6 +923,7 @@ status_t CameraSource::reset() {
                     mFramesBeingEncoded.size());
             }
         }
+        releaseIdleFrameWrappersLocked();
         stopCameraRecording();
         if (isTokenValid) {
             IPCThreadState::self()->restoreCallingIdentity(token);
@@ -1067,8 +1075,18 @@ void CameraSource::signalBufferReturned(MediaBufferBase *buffer) {
             releaseOneRecordingFrame((*it));
             mFramesBeingEncoded.erase(it);
             ++mNumFramesEncoded;
-            buffer->setObserver(0);
-            buffer->release();
+            ssize_t index = mFrameWrappers.indexOfKey(buffer->data());
+            bool pooled = index >= 0 && mFrameWrappers.valueAt(index) == buffer;
+            if (pooled && mFrameWrappers.size() > kMaxFrameWrappers) {
+                // Frames are not coming from a fixed set of buffers (e.g.
+                // time lapse copies), stop caching this one.
+                mFrameWrappers.removeItemsAt(index);
+                pooled = false;
+            }
+            if (!pooled) {
+                buffer->setObserver(0);
+                buffer->release();
+            }
             mFrameCompleteCondition.signal();
             return;
         }
@@ -1076,6 +1094,60 @@ void CameraSource::signalBufferReturned(MediaBufferBase *buffer) {
     CHECK(!"signalBufferReturned: bogus buffer");
 }
 
+MediaBuffer *CameraSource::acquireFrameWrapperLocked(const sp<IMemory>& frame) {
+    MediaBuffer *buffer = NULL;
+    ssize_t index = mFrameWrappers.indexOfKey(frame->pointer());
+    if (index >= 0) {
+        buffer = mFrameWrappers.valueAt(index);
+        // The camera cannot deliver the same memory again before the
+        // previous wrapper came back through signalBufferReturned().
+        CHECK_EQ(buffer->refcount(), 0);
+        if (buffer->size() == frame->size()) {
+            buffer->reset();
+        } else {
+            mFrameWrappers.removeItemsAt(index);
+            buffer->setObserver(0);
+            buffer->release();
+            buffer = NULL;
+        }
+    }
+    if (buffer == NULL) {
+        buffer = new MediaBuffer(frame->pointer(), frame->size());
+        buffer->setObserver(this);
+        mFrameWrappers.add(frame->pointer(), buffer);
+    }
+    buffer->add_ref();
+    return buffer;
+}
+
+void CameraSource::releaseIdleFrameWrappersLocked() {
+    for (size_t i = mFrameWrappers.size(); i > 0; --i) {
+        MediaBuffer *buffer = mFrameWrappers.valueAt(i - 1);
+        if (buffer->refcount() == 0) {
+            mFrameWrappers.removeItemsAt(i - 1);
+            buffer->setObserver(0);
+            buffer->release();
+        }
+    }
+}
+
+status_t CameraSource::setReadyListener(const sp<ReadyListener> &listener) {
+    Mutex::Autolock autoLock(mLock);
+    mReadyListener = listener;
+    return OK;
+}
+
+void CameraSource::notifyReadyListener() {
+    sp<ReadyListener> listener;
+    {
+        Mutex::Autolock autoLock(mLock);
+        listener = mReadyListener;
+    }
+    if (listener != NULL) {
+        listener->onBufferReady();
+    }
+}
+
 status_t CameraSource::read(
         MediaBufferBase **buffer, const ReadOptions *options) {
     ALOGV("read");
@@ -1087,13 +1159,18 @@ status_t CameraSource::read(
     if (options && options->getSeekTo(&seekTimeUs, &mode)) {
         return ERROR_UNSUPPORTED;
     }
+    bool nonBlocking = options && options->getNonBlocking();
 
     sp<IMemory> frame;
     int64_t frameTime;
+    int64_t captureTime;
 
     {
         Mutex::Autolock autoLock(mLock);
         while (mStarted && !mEos && mFramesReceived.empty()) {
+            if (nonBlocking) {
+                return WOULD_BLOCK;
+            }
             if (NO_ERROR !=
                 mFrameAvailableCondition.waitRelative(mLock,
                     mTimeBetweenFrameCaptureUs * 1000LL + CAMERA_SOURCE_TIMEOUT_NS)) {
@@ -1117,11 +1194,12 @@ status_t CameraSource::read(
 
         frameTime = *mFrameTimes.begin();
         mFrameTimes.erase(mFrameTimes.begin());
+        captureTime = *mFrameCaptureTimes.begin();
+        mFrameCaptureTimes.erase(mFrameCaptureTimes.begin());
         mFramesBeingEncoded.push_back(frame);
-        *buffer = new MediaBuffer(frame->pointer(), frame->size());
-        (*buffer)->setObserver(this);
-        (*buffer)->add_ref();
+        *buffer = acquireFrameWrapperLocked(frame);
         (*buffer)->meta_data().setInt64(kKeyTime, frameTime);
+        (*buffer)->meta_data().setInt64(kKeyCaptureTime, captureTime);
     }
     return OK;
 }
@@ -1205,6 +1283,7 @@ void CameraSource::dataCallbackTimestamp(int64_t timestampUs,
     mFramesReceived.push_back(data);
     int64_t timeUs = mStartTimeUs + (timestampUs - mFirstFrameTimeUs);
     mFrameTimes.push_back(timeUs);
+    mFrameCaptureTimes.push_back(currentFrameCaptureTimeUs(timestampUs));
     ALOGV("initial delay: %" PRId64 ", current time stamp: %" PRId64,
         mStartTimeUs, timeUs);
     mFrameAvailableCondition.signal();
@@ -1271,6 +1350,7 @@ void CameraSource::recordingFrameHandleCallbackTimestamp(int64_t timestampUs,
     mFramesReceived.push_back(data);
     int64_t timeUs = mStartTimeUs + (timestampUs - mFirstFrameTimeUs);
     mFrameTimes.push_back(timeUs);
+    mFrameCaptureTimes.push_back(currentFrameCaptureTimeUs(timestampUs));
     ALOGV("initial delay: %" PRId64 ", current time stamp: %" PRId64, mStartTimeUs, timeUs);
     mFrameAvailableCondition.signal();
 }
@@ -1319,6 +1399,7 @@ void CameraSource::recordingFrameHandleCallbackTimestampBatch(
         mFramesReceived.push_back(data);
         int64_t timeUs = mStartTimeUs + (timestampUs - mFirstFrameTimeUs);
         mFrameTimes.push_back(timeUs);
+        mFrameCaptureTimes.push_back(currentFrameCaptureTimeUs(timestampUs));
         ALOGV("initial delay: %" PRId64 ", current time stamp: %" PRId64, mStartTimeUs, timeUs);
 
     }
@@ -1368,6 +1449,7 @@ bool CameraSource::BufferQueueListener::threadLoop() {
     while (mConsumer->acquireBuffer(&buffer, 0) == OK) {
         mCameraSource->processBufferQueueFrame(buffer);
     }
+    mCameraSource->notifyReadyListener();
 
     return true;
 }
@@ -1413,6 +1495,7 @@ void CameraSource::processBufferQueueFrame(BufferItem& buffer) {
     mFramesReceived.push_back(data);
     int64_t timeUs = mStartTimeUs + (timestampUs - mFirstFrameTimeUs);
     mFrameTimes.push_back(timeUs);
+    mFrameCaptureTimes.push_back(currentFrameCaptureTimeUs(timestampUs));
     ALOGV("initial delay: %" PRId64 ", current time stamp: %" PRId64,
         mStartTimeUs, timeUs);
     mFrameAvailableCondition.signal();
@@ -1440,11 +1523,13 @@ CameraSource::ProxyListener::ProxyListener(const sp<CameraSource>& source) {
 void CameraSource::ProxyListener::dataCallbackTimestamp(
         nsecs_t timestamp, int32_t msgType, const sp<IMemory>& dataPtr) {
     mSource->dataCallbackTimestamp(timestamp / 1000, msgType, dataPtr);
+    mSource->notifyReadyListener();
 }
 
 void CameraSource::ProxyListener::recordingFrameHandleCallbackTimestamp(nsecs_t timestamp,
         native_handle_t* handle) {
     mSource->recordingFrameHandleCallbackTimestamp(timestamp / 1000, handle);
+    mSource->notifyReadyListener();
 }
 
 void CameraSource::ProxyListener::recordingFrameHandleCallbackTimestampBatch(
@@ -1456,6 +1541,7 @@ void CameraSource::ProxyListener::recordingFrameHandleCallbackTimestampBatch(
         modifiedTimestamps[i] = timestampsUs[i] / 1000;
     }
     mSource->recordingFrameHandleCallbackTimestampBatch(modifiedTimestamps, handles);
+    mSource->notifyReadyListener();
 }
 
 void CameraSource::DeathNotifier::binderDied(const wp<IBinder>& who __unused) {
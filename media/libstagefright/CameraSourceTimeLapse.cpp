@@ -81,7 +81,8 @@ CameraSourceTimeLapse::CameraSourceTimeLapse(
                 storeMetaDataInVideoBuffers),
       mTimeBetweenTimeLapseVideoFramesUs(1E6/videoFrameRate),
       mLastTimeLapseFrameRealTimestampUs(0),
-      mSkipCurrentFrame(false) {
+      mSkipCurrentFrame(false),
+      mCurrentFrameCaptureTimeUs(0) {
 
     mTimeBetweenFrameCaptureUs = timeBetweenFrameCaptureUs;
     ALOGD("starting time lapse mode: %" PRId64 " us",
@@ -263,6 +264,10 @@ bool CameraSourceTimeLapse::skipCurrentFrame(int64_t /* timestampUs */) {
     }
 }
 
+int64_t CameraSourceTimeLapse::currentFrameCaptureTimeUs(int64_t /* timestampUs */) {
+    return mCurrentFrameCaptureTimeUs;
+}
+
 bool CameraSourceTimeLapse::skipFrameAndModifyTimeStamp(int64_t *timestampUs) {
     ALOGV("skipFrameAndModifyTimeStamp");
     if (mLastTimeLapseFrameRealTimestampUs == 0) {
@@ -328,6 +333,7 @@ bool CameraSourceTimeLapse::skipFrameAndModifyTimeStamp(int64_t *timestampUs) {
 void CameraSourceTimeLapse::dataCallbackTimestamp(int64_t timestampUs, int32_t msgType,
             const sp<IMemory> &data) {
     ALOGV("dataCallbackTimestamp");
+    mCurrentFrameCaptureTimeUs = timestampUs;
     mSkipCurrentFrame = skipFrameAndModifyTimeStamp(&timestampUs);
     CameraSource::dataCallbackTimestamp(timestampUs, msgType, data);
 }
@@ -335,6 +341,7 @@ void CameraSourceTimeLapse::dataCallbackTimestamp(int64_t timestampUs, int32_t m
 void CameraSourceTimeLapse::recordingFrameHandleCallbackTimestamp(int64_t timestampUs,
             native_handle_t* handle) {
     ALOGV("recordingFrameHandleCallbackTimestamp");
+    mCurrentFrameCaptureTimeUs = timestampUs;
     mSkipCurrentFrame = skipFrameAndModifyTimeStamp(&timestampUs);
     CameraSource::recordingFrameHandleCallbackTimestamp(timestampUs, handle);
 }
@@ -353,6 +360,7 @@ void CameraSourceTimeLapse::recordingFrameHandleCallbackTimestampBatch(
 void CameraSourceTimeLapse::processBufferQueueFrame(BufferItem& buffer) {
     ALOGV("processBufferQueueFrame");
     int64_t timestampUs = buffer.mTimestamp / 1000;
+    mCurrentFrameCaptureTimeUs = timestampUs;
     mSkipCurrentFrame = skipFrameAndModifyTimeStamp(&timestampUs);
     buffer.mTimestamp = timestampUs * 1000;
     CameraSource::processBufferQueueFrame(buffer);
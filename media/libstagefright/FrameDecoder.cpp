@@ -20,12 +20,14 @@
 #include "include/FrameDecoder.h"
 #include <binder/MemoryBase.h>
 #include <binder/MemoryHeapBase.h>
+#include <cutils/properties.h>
 #include <gui/Surface.h>
 #include <inttypes.h>
 #include <media/ICrypto.h>
 #include <media/IMediaSource.h>
 #include <media/MediaCodecBuffer.h>
 #include <media/stagefright/foundation/avc_utils.h>
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/ColorConverter.h>
@@ -41,6 +43,7 @@ namespace android {
 
 static const int64_t kBufferTimeOutUs = 10000ll; // 10 msec
 static const size_t kRetryCount = 50; // must be >0
+static const int32_t kMaxTileDecoders = 4;
 
 sp<IMemory> allocVideoFrame(const sp<MetaData>& trackMeta,
         int32_t width, int32_t height, int32_t tileWidth, int32_t tileHeight,
@@ -114,6 +117,35 @@ bool findGridInfo(const sp<MetaData> &trackMeta,
         && trackMeta->findInt32(kKeyGridCols, gridCols) && (*gridCols > 0);
 }
 
+// Scales |width|x|height| down so that the longer side is |targetSize|,
+// keeping the aspect ratio. Sizes that already fit are left alone.
+void getScaledSize(int32_t targetSize, int32_t width, int32_t height,
+        int32_t *scaledWidth, int32_t *scaledHeight) {
+    *scaledWidth = width;
+    *scaledHeight = height;
+    int32_t longerSide = (width > height) ? width : height;
+    if (targetSize <= 0 || longerSide <= targetSize) {
+        return;
+    }
+    *scaledWidth = ((int64_t)width * targetSize + longerSide / 2) / longerSide;
+    *scaledHeight = ((int64_t)height * targetSize + longerSide / 2) / longerSide;
+    if (*scaledWidth < 1) {
+        *scaledWidth = 1;
+    }
+    if (*scaledHeight < 1) {
+        *scaledHeight = 1;
+    }
+}
+
+// Display size is in full resolution pixels, adjust it to a scaled frame.
+void scaleDisplaySize(VideoFrame *frame, int32_t width, int32_t height) {
+    if (frame->mWidth == (uint32_t)width && frame->mHeight == (uint32_t)height) {
+        return;
+    }
+    frame->mDisplayWidth = (uint64_t)frame->mDisplayWidth * frame->mWidth / width;
+    frame->mDisplayHeight = (uint64_t)frame->mDisplayHeight * frame->mHeight / height;
+}
+
 bool getDstColorFormat(
         android_pixel_format_t colorFormat,
         OMX_COLOR_FORMATTYPE *dstFormat,
@@ -183,23 +215,31 @@ FrameDecoder::FrameDecoder(
       mSource(source),
       mDstFormat(OMX_COLOR_Format16bitRGB565),
       mDstBpp(2),
+      mTargetSize(0),
+      mNextInputDecoder(0),
+      mNextOutputDecoder(0),
       mHaveMoreInputs(true),
-      mFirstSample(true) {
+      mFirstSample(true),
+      mSourceStarted(false) {
 }
 
 FrameDecoder::~FrameDecoder() {
-    if (mDecoder != NULL) {
-        mDecoder->release();
+    for (size_t i = 0; i < mDecoders.size(); i++) {
+        mDecoders[i]->release();
+    }
+    if (mSourceStarted) {
         mSource->stop();
     }
 }
 
 status_t FrameDecoder::init(
-        int64_t frameTimeUs, size_t numFrames, int option, int colorFormat) {
+        int64_t frameTimeUs, size_t numFrames, int option, int colorFormat,
+        int32_t targetSize) {
     if (!getDstColorFormat(
             (android_pixel_format_t)colorFormat, &mDstFormat, &mDstBpp)) {
         return ERROR_UNSUPPORTED;
     }
+    mTargetSize = targetSize;
 
     sp<AMessage> videoFormat = onGetFormatAndSeekOptions(
             frameTimeUs, numFrames, option, &mReadOptions);
@@ -207,40 +247,227 @@ status_t FrameDecoder::init(
         ALOGE("video format or seek mode not supported");
         return ERROR_UNSUPPORTED;
     }
+    mVideoFormat = videoFormat;
 
-    status_t err;
-    sp<ALooper> looper = new ALooper;
-    looper->start();
-    sp<MediaCodec> decoder = MediaCodec::CreateByComponentName(
-            looper, mComponentName, &err);
-    if (decoder.get() == NULL || err != OK) {
-        ALOGW("Failed to instantiate decoder [%s]", mComponentName.c_str());
-        return (decoder.get() == NULL) ? NO_MEMORY : err;
+    size_t numDecoders = onGetNumDecoders();
+    if (numDecoders < 1) {
+        numDecoders = 1;
     }
 
-    err = decoder->configure(
-            videoFormat, NULL /* surface */, NULL /* crypto */, 0 /* flags */);
-    if (err != OK) {
-        ALOGW("configure returned error %d (%s)", err, asString(err));
-        decoder->release();
+    status_t err = OK;
+    std::vector<sp<MediaCodec> > decoders;
+    for (size_t i = 0; i < numDecoders; i++) {
+        sp<ALooper> looper = new ALooper;
+        looper->start();
+        sp<MediaCodec> decoder = MediaCodec::CreateByComponentName(
+                looper, mComponentName, &err);
+        if (decoder.get() == NULL || err != OK) {
+            ALOGW("Failed to instantiate decoder [%s]", mComponentName.c_str());
+            if (decoder.get() == NULL) {
+                err = NO_MEMORY;
+            }
+            break;
+        }
+
+        err = decoder->configure(
+                videoFormat, NULL /* surface */, NULL /* crypto */, 0 /* flags */);
+        if (err != OK) {
+            ALOGW("configure returned error %d (%s)", err, asString(err));
+            decoder->release();
+            break;
+        }
+
+        err = decoder->start();
+        if (err != OK) {
+            ALOGW("start returned error %d (%s)", err, asString(err));
+            decoder->release();
+            break;
+        }
+        decoders.push_back(decoder);
+    }
+
+    // Additional instances are optional, only the first one must succeed.
+    if (decoders.empty()) {
         return err;
     }
+    if (decoders.size() < numDecoders) {
+        ALOGW("using %zu of %zu requested decoder instances",
+                decoders.size(), numDecoders);
+    }
 
-    err = decoder->start();
+    err = mSource->start();
     if (err != OK) {
-        ALOGW("start returned error %d (%s)", err, asString(err));
-        decoder->release();
+        ALOGW("source failed to start: %d (%s)", err, asString(err));
+        for (size_t i = 0; i < decoders.size(); i++) {
+            decoders[i]->release();
+        }
         return err;
     }
+    mSourceStarted = true;
+    mDecoders = decoders;
+    mOutputFormats.resize(mDecoders.size());
+    mInputsInFlight.resize(mDecoders.size(), 0);
+    mEosQueued.resize(mDecoders.size(), false);
 
-    err = mSource->start();
+    return OK;
+}
+
+bool FrameDecoder::isCompatible(const sp<MetaData> &trackMeta) const {
+    const char *mime, *curMime;
+    int32_t width, height, curWidth, curHeight;
+    if (!trackMeta->findCString(kKeyMIMEType, &mime)
+            || !trackMeta->findInt32(kKeyWidth, &width)
+            || !trackMeta->findInt32(kKeyHeight, &height)
+            || !mTrackMeta->findCString(kKeyMIMEType, &curMime)
+            || !mTrackMeta->findInt32(kKeyWidth, &curWidth)
+            || !mTrackMeta->findInt32(kKeyHeight, &curHeight)) {
+        return false;
+    }
+    // tiled images configure the codec with the tile size
+    int32_t tileWidth = 0, tileHeight = 0, curTileWidth = 0, curTileHeight = 0;
+    trackMeta->findInt32(kKeyTileWidth, &tileWidth);
+    trackMeta->findInt32(kKeyTileHeight, &tileHeight);
+    mTrackMeta->findInt32(kKeyTileWidth, &curTileWidth);
+    mTrackMeta->findInt32(kKeyTileHeight, &curTileHeight);
+    return !strcasecmp(mime, curMime) && width == curWidth && height == curHeight
+            && tileWidth == curTileWidth && tileHeight == curTileHeight;
+}
+
+status_t FrameDecoder::reset(
+        const sp<MetaData> &trackMeta,
+        const sp<IMediaSource> &source,
+        int64_t frameTimeUs, size_t numFrames, int option) {
+    if (mDecoders.empty()) {
+        return NO_INIT;
+    }
+    if (!isCompatible(trackMeta)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    // Start the new source before letting go of the old one, so that a
+    // failure here leaves this decoder with a single, started source.
+    if (mSourceStarted && source == mSource) {
+        mSource->stop();
+        mSourceStarted = false;
+    }
+    status_t err = source->start();
     if (err != OK) {
         ALOGW("source failed to start: %d (%s)", err, asString(err));
-        decoder->release();
         return err;
     }
-    mDecoder = decoder;
+    if (mSourceStarted) {
+        mSource->stop();
+    }
+    mSource = source;
+    mSourceStarted = true;
+
+    for (size_t i = 0; i < mDecoders.size(); i++) {
+        err = mDecoders[i]->flush();
+        if (err != OK) {
+            ALOGW("flush returned error %d (%s)", err, asString(err));
+            return err;
+        }
+        mInputsInFlight[i] = 0;
+        mEosQueued[i] = false;
+    }
+
+    mTrackMeta = trackMeta;
+    mFrames.clear();
+    mReadOptions.reset();
+    mNextInputDecoder = 0;
+    mNextOutputDecoder = 0;
+    mHaveMoreInputs = true;
+    mFirstSample = true;
+
+    sp<AMessage> videoFormat = onGetFormatAndSeekOptions(
+            frameTimeUs, numFrames, option, &mReadOptions);
+    if (videoFormat == NULL) {
+        ALOGE("video format or seek mode not supported");
+        return ERROR_UNSUPPORTED;
+    }
+    mVideoFormat = videoFormat;
+
+    // The codec only picks up codec specific data at start, so after a
+    // flush it has to be sent again, in-band.
+    for (size_t i = 0; i < mDecoders.size(); i++) {
+        err = queueCodecSpecificData(mDecoders[i], videoFormat);
+        if (err != OK) {
+            return err;
+        }
+    }
+    return OK;
+}
+
+status_t FrameDecoder::queueCodecSpecificData(
+        const sp<MediaCodec> &decoder, const sp<AMessage> &format) {
+    for (size_t k = 0;; ++k) {
+        sp<ABuffer> csd;
+        if (!format->findBuffer(AStringPrintf("csd-%zu", k).c_str(), &csd)) {
+            break;
+        }
+
+        size_t index;
+        status_t err = decoder->dequeueInputBuffer(&index, kBufferTimeOutUs);
+        if (err != OK) {
+            ALOGE("failed to dequeue input buffer for csd (err %d)", err);
+            return err;
+        }
+        sp<MediaCodecBuffer> codecBuffer;
+        err = decoder->getInputBuffer(index, &codecBuffer);
+        if (err != OK) {
+            ALOGE("failed to get input buffer %zu", index);
+            return err;
+        }
+        if (csd->size() > codecBuffer->capacity()) {
+            ALOGE("csd size (%zu) too large for codec input size (%zu)",
+                    csd->size(), codecBuffer->capacity());
+            return BAD_VALUE;
+        }
+        memcpy(codecBuffer->data(), csd->data(), csd->size());
+        codecBuffer->setRange(0, csd->size());
+        err = decoder->queueInputBuffer(
+                index, 0, csd->size(), 0ll, MediaCodec::BUFFER_FLAG_CODECCONFIG);
+        if (err != OK) {
+            return err;
+        }
+    }
+    return OK;
+}
+
+void FrameDecoder::queueEndOfStream() {
+    for (size_t i = 0; i < mDecoders.size(); i++) {
+        if (mInputsInFlight[i] == 0 || mEosQueued[i]) {
+            continue;
+        }
+        // Without a free input buffer, this is tried again after the next output.
+        size_t index;
+        if (mDecoders[i]->dequeueInputBuffer(&index, 0) != OK) {
+            continue;
+        }
+        if (mDecoders[i]->queueInputBuffer(
+                index, 0, 0, 0, MediaCodec::BUFFER_FLAG_EOS) == OK) {
+            mEosQueued[i] = true;
+        }
+    }
+}
 
+status_t FrameDecoder::restartAfterEndOfStream() {
+    for (size_t i = 0; i < mDecoders.size(); i++) {
+        if (!mEosQueued[i]) {
+            continue;
+        }
+        status_t err = mDecoders[i]->flush();
+        if (err != OK) {
+            ALOGW("flush returned error %d (%s)", err, asString(err));
+            return err;
+        }
+        mInputsInFlight[i] = 0;
+        mEosQueued[i] = false;
+        err = queueCodecSpecificData(mDecoders[i], mVideoFormat);
+        if (err != OK) {
+            return err;
+        }
+    }
     return OK;
 }
 
@@ -268,29 +495,60 @@ status_t FrameDecoder::extractFrames(std::vector<sp<IMemory> >* frames) {
     return OK;
 }
 
+size_t FrameDecoder::pickOutputDecoder() {
+    // Prefer the next instance that has inputs pending, so that we don't
+    // block on an idle one while others have output ready.
+    for (size_t i = 0; i < mDecoders.size(); i++) {
+        size_t k = (mNextOutputDecoder + i) % mDecoders.size();
+        if (mInputsInFlight[k] > 0) {
+            return k;
+        }
+    }
+    return mNextOutputDecoder;
+}
+
 status_t FrameDecoder::extractInternal() {
-    status_t err = OK;
+    status_t err = restartAfterEndOfStream();
+    if (err != OK) {
+        return err;
+    }
     bool done = false;
-    size_t retriesLeft = kRetryCount;
+    size_t retriesLeft = kRetryCount * mDecoders.size();
     do {
         size_t index;
         int64_t ptsUs = 0ll;
         uint32_t flags = 0;
+        bool inputPaused = false;
 
         // Queue as many inputs as we possibly can, then block on dequeuing
         // outputs. After getting each output, come back and queue the inputs
-        // again to keep the decoder busy.
-        while (mHaveMoreInputs) {
-            err = mDecoder->dequeueInputBuffer(&index, 0);
+        // again to keep the decoders busy. With multiple decoder instances,
+        // inputs are queued round-robin until all instances are full.
+        size_t decodersFull = 0;
+        while (mHaveMoreInputs && decodersFull < mDecoders.size()) {
+            if (!onPrepareInput(&mReadOptions)) {
+                inputPaused = true;
+                break;
+            }
+
+            const size_t decoderIndex = mNextInputDecoder;
+            const sp<MediaCodec> &decoder = mDecoders[decoderIndex];
+            err = decoder->dequeueInputBuffer(&index, 0);
             if (err != OK) {
                 ALOGV("Timed out waiting for input");
-                if (retriesLeft) {
-                    err = OK;
+                if (!retriesLeft) {
+                    break;
                 }
-                break;
+                err = OK;
+                mNextInputDecoder = (mNextInputDecoder + 1) % mDecoders.size();
+                ++decodersFull;
+                continue;
             }
+            decodersFull = 0;
+            mNextInputDecoder = (mNextInputDecoder + 1) % mDecoders.size();
+
             sp<MediaCodecBuffer> codecBuffer;
-            err = mDecoder->getInputBuffer(index, &codecBuffer);
+            err = decoder->getInputBuffer(index, &codecBuffer);
             if (err != OK) {
                 ALOGE("failed to get input buffer %zu", index);
                 break;
@@ -303,7 +561,7 @@ status_t FrameDecoder::extractInternal() {
             if (err != OK) {
                 mHaveMoreInputs = false;
                 if (!mFirstSample && err == ERROR_END_OF_STREAM) {
-                    (void)mDecoder->queueInputBuffer(
+                    (void)decoder->queueInputBuffer(
                             index, 0, 0, 0, MediaCodec::BUFFER_FLAG_EOS);
                     err = OK;
                 } else {
@@ -320,13 +578,15 @@ status_t FrameDecoder::extractInternal() {
             } else {
                 codecBuffer->setRange(0, mediaBuffer->range_length());
 
-                CHECK(mediaBuffer->meta_data().findInt64(kKeyTime, &ptsUs));
                 memcpy(codecBuffer->data(),
                         (const uint8_t*)mediaBuffer->data() + mediaBuffer->range_offset(),
                         mediaBuffer->range_length());
 
                 onInputReceived(codecBuffer, mediaBuffer->meta_data(), mFirstSample, &flags);
                 mFirstSample = false;
+
+                // onInputReceived() may have retimed the sample.
+                CHECK(mediaBuffer->meta_data().findInt64(kKeyTime, &ptsUs));
             }
 
             mediaBuffer->release();
@@ -335,12 +595,15 @@ status_t FrameDecoder::extractInternal() {
                 ALOGV("QueueInput: size=%zu ts=%" PRId64 " us flags=%x",
                         codecBuffer->size(), ptsUs, flags);
 
-                err = mDecoder->queueInputBuffer(
+                err = decoder->queueInputBuffer(
                         index,
                         codecBuffer->offset(),
                         codecBuffer->size(),
                         ptsUs,
                         flags);
+                if (err == OK) {
+                    ++mInputsInFlight[decoderIndex];
+                }
 
                 if (flags & MediaCodec::BUFFER_FLAG_EOS) {
                     mHaveMoreInputs = false;
@@ -348,10 +611,27 @@ status_t FrameDecoder::extractInternal() {
             }
         }
 
+        if (err == OK && inputPaused) {
+            size_t inputsInFlight = 0;
+            for (size_t i = 0; i < mInputsInFlight.size(); i++) {
+                inputsInFlight += mInputsInFlight[i];
+            }
+            if (inputsInFlight == 0) {
+                // Nothing more is needed for this extraction.
+                done = true;
+                break;
+            }
+            // Decoders with output delay hold back the last outputs until
+            // they see EOS.
+            queueEndOfStream();
+        }
+
         while (err == OK) {
             size_t offset, size;
+            const size_t decoderIndex = pickOutputDecoder();
+            const sp<MediaCodec> &decoder = mDecoders[decoderIndex];
             // wait for a decoded buffer
-            err = mDecoder->dequeueOutputBuffer(
+            err = decoder->dequeueOutputBuffer(
                     &index,
                     &offset,
                     &size,
@@ -361,11 +641,12 @@ status_t FrameDecoder::extractInternal() {
 
             if (err == INFO_FORMAT_CHANGED) {
                 ALOGV("Received format change");
-                err = mDecoder->getOutputFormat(&mOutputFormat);
+                err = decoder->getOutputFormat(&mOutputFormats[decoderIndex]);
             } else if (err == INFO_OUTPUT_BUFFERS_CHANGED) {
                 ALOGV("Output buffers changed");
                 err = OK;
             } else {
+                mNextOutputDecoder = (decoderIndex + 1) % mDecoders.size();
                 if (err == -EAGAIN /* INFO_TRY_AGAIN_LATER */ && --retriesLeft > 0) {
                     ALOGV("Timed-out waiting for output.. retries left = %zu", retriesLeft);
                     err = OK;
@@ -373,14 +654,24 @@ status_t FrameDecoder::extractInternal() {
                     // If we're seeking with CLOSEST option and obtained a valid targetTimeUs
                     // from the extractor, decode to the specified frame. Otherwise we're done.
                     ALOGV("Received an output buffer, timeUs=%lld", (long long)ptsUs);
+                    if ((flags & MediaCodec::BUFFER_FLAG_EOS) && size == 0
+                            && mEosQueued[decoderIndex]) {
+                        // the output for the EOS from queueEndOfStream(), no frame
+                        decoder->releaseOutputBuffer(index);
+                        break;
+                    }
+                    if (mInputsInFlight[decoderIndex] > 0) {
+                        --mInputsInFlight[decoderIndex];
+                    }
                     sp<MediaCodecBuffer> videoFrameBuffer;
-                    err = mDecoder->getOutputBuffer(index, &videoFrameBuffer);
+                    err = decoder->getOutputBuffer(index, &videoFrameBuffer);
                     if (err != OK) {
                         ALOGE("failed to get output buffer %zu", index);
                         break;
                     }
-                    err = onOutputReceived(videoFrameBuffer, mOutputFormat, ptsUs, &done);
-                    mDecoder->releaseOutputBuffer(index);
+                    err = onOutputReceived(
+                            videoFrameBuffer, mOutputFormats[decoderIndex], ptsUs, &done);
+                    decoder->releaseOutputBuffer(index);
                 } else {
                     ALOGW("Received error %d (%s) instead of output", err, asString(err));
                     done = true;
@@ -420,6 +711,8 @@ sp<AMessage> VideoFrameDecoder::onGetFormatAndSeekOptions(
         return NULL;
     }
     mNumFrames = numFrames;
+    mNumFramesDecoded = 0;
+    mTargetTimeUs = -1ll;
 
     const char *mime;
     if (!trackMeta()->findCString(kKeyMIMEType, &mime)) {
@@ -512,22 +805,41 @@ status_t VideoFrameDecoder::onOutputReceived(
         crop_bottom = height - 1;
     }
 
+    int32_t srcFormat;
+    CHECK(outputFormat->findInt32("color-format", &srcFormat));
+
+    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
+
+    int32_t cropWidth = crop_right - crop_left + 1;
+    int32_t cropHeight = crop_bottom - crop_top + 1;
+    int32_t dstWidth = cropWidth;
+    int32_t dstHeight = cropHeight;
+    if (converter.isScalingSupported()) {
+        getScaledSize(targetSize(), cropWidth, cropHeight, &dstWidth, &dstHeight);
+    }
+
     sp<IMemory> frameMem = allocVideoFrame(
             trackMeta(),
-            (crop_right - crop_left + 1),
-            (crop_bottom - crop_top + 1),
+            dstWidth,
+            dstHeight,
             0,
             0,
             dstBpp());
     addFrame(frameMem);
     VideoFrame* frame = static_cast<VideoFrame*>(frameMem->pointer());
 
-    int32_t srcFormat;
-    CHECK(outputFormat->findInt32("color-format", &srcFormat));
-
-    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
-
     if (converter.isValid()) {
+        if (dstWidth != cropWidth || dstHeight != cropHeight) {
+            scaleDisplaySize(frame, cropWidth, cropHeight);
+            return converter.convert(
+                    (const uint8_t *)videoFrameBuffer->data(),
+                    width, height,
+                    crop_left, crop_top, crop_right, crop_bottom,
+                    frame->getFlattenedData(),
+                    frame->mWidth,
+                    frame->mHeight,
+                    0, 0, dstWidth - 1, dstHeight - 1);
+        }
         converter.convert(
                 (const uint8_t *)videoFrameBuffer->data(),
                 width, height,
@@ -559,7 +871,10 @@ ImageDecoder::ImageDecoder(
       mTileWidth(0),
       mTileHeight(0),
       mTilesDecoded(0),
-      mTargetTiles(0) {
+      mTargetTiles(0),
+      mNextPendingTile(0),
+      mNextTileToRead(0),
+      mTargetTileRect({0, 0, 0, 0}) {
 }
 
 sp<AMessage> ImageDecoder::onGetFormatAndSeekOptions(
@@ -617,6 +932,12 @@ sp<AMessage> ImageDecoder::onGetFormatAndSeekOptions(
         }
     }
     mTargetTiles = mGridCols * mGridRows;
+    mTileState.assign(mGridCols * mGridRows, kTileNotDecoded);
+    mPendingTiles.clear();
+    mNextPendingTile = 0;
+    mNextTileToRead = 0;
+    mTilesDecoded = 0;
+    mFrame = NULL;
 
     sp<AMessage> videoFormat;
     if (convertMetaDataToMessage(overrideMeta, &videoFormat) != OK) {
@@ -636,71 +957,145 @@ sp<AMessage> ImageDecoder::onGetFormatAndSeekOptions(
 }
 
 status_t ImageDecoder::onExtractRect(FrameRect *rect) {
-    // TODO:
-    // This callback is for verifying whether we can decode the rect,
-    // and if so, set up the internal variables for decoding.
-    // Currently, rect decoding is restricted to sequentially decoding one
-    // row of tiles at a time. We can't decode arbitrary rects, as the image
-    // track doesn't yet support seeking by tiles. So all we do here is to
-    // verify the rect against what we expect.
-    // When seeking by tile is supported, this code should be updated to
-    // set the seek parameters.
-    if (rect == NULL) {
-        if (mTilesDecoded > 0) {
+    // Set up the tiles that intersect |rect| for decoding. The image track
+    // supports seeking by tile, so rects can be decoded in any order, and
+    // only the tiles that have not been decoded yet are read.
+    FrameRect tileRect = {0, 0, mGridCols, mGridRows};
+    if (rect != NULL) {
+        if (mTileWidth <= 0 || mTileHeight <= 0) {
             return ERROR_UNSUPPORTED;
         }
-        mTargetTiles = mGridRows * mGridCols;
-        return OK;
+        if (rect->left < 0 || rect->top < 0
+                || rect->right > mWidth || rect->bottom > mHeight
+                || rect->left >= rect->right || rect->top >= rect->bottom) {
+            ALOGE("invalid rect {%d, %d, %d, %d} for picture size %dx%d",
+                    rect->left, rect->top, rect->right, rect->bottom, mWidth, mHeight);
+            return ERROR_UNSUPPORTED;
+        }
+        tileRect.left = rect->left / mTileWidth;
+        tileRect.top = rect->top / mTileHeight;
+        tileRect.right = (rect->right - 1) / mTileWidth + 1;
+        tileRect.bottom = (rect->bottom - 1) / mTileHeight + 1;
     }
 
-    if (mTileWidth <= 0 || mTileHeight <=0) {
-        return ERROR_UNSUPPORTED;
+    mTargetTileRect = tileRect;
+    mPendingTiles.clear();
+    mNextPendingTile = 0;
+    mTargetTiles = 0;
+    for (int32_t row = tileRect.top; row < tileRect.bottom; row++) {
+        for (int32_t col = tileRect.left; col < tileRect.right; col++) {
+            int32_t tile = row * mGridCols + col;
+            if (mTileState[tile] == kTileNotDecoded) {
+                mPendingTiles.push_back(tile);
+            }
+            if (mTileState[tile] != kTileDecoded) {
+                mTargetTiles++;
+            }
+        }
+    }
+    ALOGV("rect needs %d tiles, %zu to be read", mTargetTiles, mPendingTiles.size());
+    return OK;
+}
+
+bool ImageDecoder::isTargetTile(int32_t tile) const {
+    int32_t row = tile / mGridCols;
+    int32_t col = tile % mGridCols;
+    return row >= mTargetTileRect.top && row < mTargetTileRect.bottom
+            && col >= mTargetTileRect.left && col < mTargetTileRect.right;
+}
+
+size_t ImageDecoder::onGetNumDecoders() {
+    // Tiles are independently coded, so they can be spread across several
+    // codec instances. This is off by default as each instance holds its
+    // own set of buffers.
+    int32_t numTiles = mGridRows * mGridCols;
+    if (numTiles <= 1) {
+        return 1;
+    }
+    int32_t numDecoders = property_get_int32("media.stagefright.heif.tile-decoders", 1);
+    if (numDecoders > kMaxTileDecoders) {
+        numDecoders = kMaxTileDecoders;
     }
+    if (numDecoders > numTiles) {
+        numDecoders = numTiles;
+    }
+    return numDecoders > 1 ? numDecoders : 1;
+}
 
-    int32_t row = mTilesDecoded / mGridCols;
-    int32_t expectedTop = row * mTileHeight;
-    int32_t expectedBot = (row + 1) * mTileHeight;
-    if (expectedBot > mHeight) {
-        expectedBot = mHeight;
+bool ImageDecoder::onPrepareInput(MediaSource::ReadOptions *options) {
+    if (mNextPendingTile >= mPendingTiles.size()) {
+        return false;
     }
-    if (rect->left != 0 || rect->top != expectedTop
-            || rect->right != mWidth || rect->bottom != expectedBot) {
-        ALOGE("currently only support sequential decoding of slices");
-        return ERROR_UNSUPPORTED;
+    int32_t tile = mPendingTiles[mNextPendingTile];
+    if (tile != mNextTileToRead) {
+        // the seek time is interpreted as the tile index
+        options->setSeekTo(tile, MediaSource::ReadOptions::SEEK_FRAME_INDEX);
+    }
+    return true;
+}
+
+status_t ImageDecoder::onInputReceived(
+        const sp<MediaCodecBuffer> &codecBuffer __unused,
+        MetaDataBase &sampleMeta, bool firstSample __unused, uint32_t *flags __unused) {
+    if (mNextPendingTile >= mPendingTiles.size()) {
+        return OK;
     }
+    int32_t tile = mPendingTiles[mNextPendingTile++];
+    mTileState[tile] = kTileQueued;
+    mNextTileToRead = tile + 1;
 
-    // advance one row
-    mTargetTiles = mTilesDecoded + mGridCols;
+    // Tag the sample with its tile index, as outputs may come back
+    // from different decoder instances.
+    sampleMeta.setInt64(kKeyTime, tile);
     return OK;
 }
 
 status_t ImageDecoder::onOutputReceived(
         const sp<MediaCodecBuffer> &videoFrameBuffer,
-        const sp<AMessage> &outputFormat, int64_t /*timeUs*/, bool *done) {
+        const sp<AMessage> &outputFormat, int64_t timeUs, bool *done) {
     if (outputFormat == NULL) {
         return ERROR_MALFORMED;
     }
 
+    if (timeUs < 0 || timeUs >= (int64_t)mTileState.size()) {
+        ALOGE("output for unknown tile %lld", (long long)timeUs);
+        return ERROR_MALFORMED;
+    }
+    int32_t tile = (int32_t)timeUs;
+    if (mTileState[tile] == kTileDecoded) {
+        ALOGW("tile %d decoded twice", tile);
+        *done = (mTargetTiles <= 0);
+        return OK;
+    }
+
     int32_t width, height;
     CHECK(outputFormat->findInt32("width", &width));
     CHECK(outputFormat->findInt32("height", &height));
 
+    int32_t srcFormat;
+    CHECK(outputFormat->findInt32("color-format", &srcFormat));
+
+    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
+
     if (mFrame == NULL) {
+        // Only untiled images are scaled, tiles are converted in place;
+        // init() documents that |targetSize| is ignored for them.
+        int32_t dstWidth = mWidth;
+        int32_t dstHeight = mHeight;
+        if (mTileWidth == 0 && converter.isScalingSupported()) {
+            getScaledSize(targetSize(), mWidth, mHeight, &dstWidth, &dstHeight);
+        }
         sp<IMemory> frameMem = allocVideoFrame(
-                trackMeta(), mWidth, mHeight, mTileWidth, mTileHeight, dstBpp());
+                trackMeta(), dstWidth, dstHeight, mTileWidth, mTileHeight, dstBpp());
         mFrame = static_cast<VideoFrame*>(frameMem->pointer());
+        scaleDisplaySize(mFrame, mWidth, mHeight);
 
         addFrame(frameMem);
     }
 
-    int32_t srcFormat;
-    CHECK(outputFormat->findInt32("color-format", &srcFormat));
-
-    ColorConverter converter((OMX_COLOR_FORMATTYPE)srcFormat, dstFormat());
-
     int32_t dstLeft, dstTop, dstRight, dstBottom;
-    dstLeft = mTilesDecoded % mGridCols * width;
-    dstTop = mTilesDecoded / mGridCols * height;
+    dstLeft = tile % mGridCols * width;
+    dstTop = tile / mGridCols * height;
     dstRight = dstLeft + width - 1;
     dstBottom = dstTop + height - 1;
 
@@ -722,7 +1117,18 @@ status_t ImageDecoder::onOutputReceived(
         dstBottom = dstTop + crop_bottom;
     }
 
-    *done = (++mTilesDecoded >= mTargetTiles);
+    mTileState[tile] = kTileDecoded;
+    ++mTilesDecoded;
+    if (isTargetTile(tile)) {
+        --mTargetTiles;
+    }
+    *done = (mTargetTiles <= 0);
+
+    if (mFrame->mWidth != (uint32_t)mWidth || mFrame->mHeight != (uint32_t)mHeight) {
+        dstLeft = dstTop = 0;
+        dstRight = mFrame->mWidth - 1;
+        dstBottom = mFrame->mHeight - 1;
+    }
 
     if (converter.isValid()) {
         converter.convert(
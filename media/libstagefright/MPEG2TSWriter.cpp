@@ -29,6 +29,9 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
 
 #include "include/ESDS.h"
 
@@ -444,7 +447,7 @@ bool MPEG2TSWriter::SourceInfo::eosReceived() const {
 ////////////////////////////////////////////////////////////////////////////////
 
 MPEG2TSWriter::MPEG2TSWriter(int fd)
-    : mFile(fdopen(dup(fd), "wb")),
+    : mFd(dup(fd)),
       mWriteCookie(NULL),
       mWriteFunc(NULL),
       mStarted(false),
@@ -452,14 +455,15 @@ MPEG2TSWriter::MPEG2TSWriter(int fd)
       mNumTSPacketsWritten(0),
       mNumTSPacketsBeforeMeta(0),
       mPATContinuityCounter(0),
-      mPMTContinuityCounter(0) {
+      mPMTContinuityCounter(0),
+      mNumPacketsInBlock(0) {
     init();
 }
 
 MPEG2TSWriter::MPEG2TSWriter(
         void *cookie,
         ssize_t (*write)(void *cookie, const void *data, size_t size))
-    : mFile(NULL),
+    : mFd(-1),
       mWriteCookie(cookie),
       mWriteFunc(write),
       mStarted(false),
@@ -467,14 +471,19 @@ MPEG2TSWriter::MPEG2TSWriter(
       mNumTSPacketsWritten(0),
       mNumTSPacketsBeforeMeta(0),
       mPATContinuityCounter(0),
-      mPMTContinuityCounter(0) {
+      mPMTContinuityCounter(0),
+      mNumPacketsInBlock(0) {
     init();
 }
 
 void MPEG2TSWriter::init() {
-    CHECK(mFile != NULL || mWriteFunc != NULL);
+    CHECK(mFd >= 0 || mWriteFunc != NULL);
 
     initCrcTable();
+    buildProgramAssociationTable();
+
+    mBlock = new ABuffer(kMaxPacketsPerBlock * kTSPacketSize);
+    mBlock->setRange(0, 0);
 
     mLooper = new ALooper;
     mLooper->setName("MPEG2TSWriter");
@@ -493,9 +502,9 @@ MPEG2TSWriter::~MPEG2TSWriter() {
     mLooper->unregisterHandler(mReflector->id());
     mLooper->stop();
 
-    if (mFile != NULL) {
-        fclose(mFile);
-        mFile = NULL;
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
     }
 }
 
@@ -526,6 +535,8 @@ status_t MPEG2TSWriter::start(MetaData *param ) {
     mNumTSPacketsWritten = 0;
     mNumTSPacketsBeforeMeta = 0;
 
+    buildProgramMap();
+
     for (size_t i = 0; i < mSources.size(); ++i) {
         sp<AMessage> notify =
             new AMessage(kWhatSourceNotify, mReflector);
@@ -661,7 +672,7 @@ void MPEG2TSWriter::onMessageReceived(const sp<AMessage> &msg) {
     }
 }
 
-void MPEG2TSWriter::writeProgramAssociationTable() {
+void MPEG2TSWriter::buildProgramAssociationTable() {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -698,22 +709,26 @@ void MPEG2TSWriter::writeProgramAssociationTable() {
         0x00, 0x00, 0x00, 0x00   // b???? ???? ???? ???? ???? ???? ???? ????
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
+    memset(mPATPacket, 0xff, sizeof(mPATPacket));
+    memcpy(mPATPacket, kData, sizeof(kData));
+
+    // The continuity counter is outside of the section, the CRC never changes.
+    uint32_t crc = htonl(crc32(&mPATPacket[5], 12));
+    memcpy(&mPATPacket[17], &crc, sizeof(crc));
+}
 
+void MPEG2TSWriter::writeProgramAssociationTable() {
     if (++mPATContinuityCounter == 16) {
         mPATContinuityCounter = 0;
     }
-    buffer->data()[3] |= mPATContinuityCounter;
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12));
-    memcpy(&buffer->data()[17], &crc, sizeof(crc));
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), (ssize_t)buffer->size());
+    uint8_t *ptr = beginPacket();
+    memcpy(ptr, mPATPacket, kTSPacketSize);
+    ptr[3] |= mPATContinuityCounter;
+    commitBlockData(kTSPacketSize);
 }
 
-void MPEG2TSWriter::writeProgramMap() {
+void MPEG2TSWriter::buildProgramMap() {
     // 0x47
     // transport_error_indicator = b0
     // payload_unit_start_indicator = b1
@@ -755,24 +770,18 @@ void MPEG2TSWriter::writeProgramMap() {
         0xe0, 0x00, 0xf0, 0x00   // b111? ???? ???? ???? 1111 0000 0000 0000
     };
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-    memcpy(buffer->data(), kData, sizeof(kData));
-
-    if (++mPMTContinuityCounter == 16) {
-        mPMTContinuityCounter = 0;
-    }
-    buffer->data()[3] |= mPMTContinuityCounter;
+    memset(mPMTPacket, 0xff, sizeof(mPMTPacket));
+    memcpy(mPMTPacket, kData, sizeof(kData));
 
     size_t section_length = 5 * mSources.size() + 4 + 9;
-    buffer->data()[6] |= section_length >> 8;
-    buffer->data()[7] = section_length & 0xff;
+    mPMTPacket[6] |= section_length >> 8;
+    mPMTPacket[7] = section_length & 0xff;
 
     static const unsigned kPCR_PID = 0x1e1;
-    buffer->data()[13] |= (kPCR_PID >> 8) & 0x1f;
-    buffer->data()[14] = kPCR_PID & 0xff;
+    mPMTPacket[13] |= (kPCR_PID >> 8) & 0x1f;
+    mPMTPacket[14] = kPCR_PID & 0xff;
 
-    uint8_t *ptr = &buffer->data()[sizeof(kData)];
+    uint8_t *ptr = &mPMTPacket[sizeof(kData)];
     for (size_t i = 0; i < mSources.size(); ++i) {
         *ptr++ = mSources.editItemAt(i)->streamType();
 
@@ -783,10 +792,19 @@ void MPEG2TSWriter::writeProgramMap() {
         *ptr++ = 0x00;
     }
 
-    uint32_t crc = htonl(crc32(&buffer->data()[5], 12+mSources.size()*5));
-    memcpy(&buffer->data()[17+mSources.size()*5], &crc, sizeof(crc));
+    uint32_t crc = htonl(crc32(&mPMTPacket[5], 12+mSources.size()*5));
+    memcpy(&mPMTPacket[17+mSources.size()*5], &crc, sizeof(crc));
+}
+
+void MPEG2TSWriter::writeProgramMap() {
+    if (++mPMTContinuityCounter == 16) {
+        mPMTContinuityCounter = 0;
+    }
 
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), (ssize_t)buffer->size());
+    uint8_t *ptr = beginPacket();
+    memcpy(ptr, mPMTPacket, kTSPacketSize);
+    ptr[3] |= mPMTContinuityCounter;
+    commitBlockData(kTSPacketSize);
 }
 
 void MPEG2TSWriter::writeAccessUnit(
@@ -826,9 +844,6 @@ void MPEG2TSWriter::writeAccessUnit(
     // reserved = b1
     // the first fragment of "buffer" follows
 
-    sp<ABuffer> buffer = new ABuffer(188);
-    memset(buffer->data(), 0xff, buffer->size());
-
     const unsigned PID = 0x1e0 + sourceIndex + 1;
 
     const unsigned continuity_counter =
@@ -855,7 +870,8 @@ void MPEG2TSWriter::writeAccessUnit(
         PES_packet_length = 0;
     }
 
-    uint8_t *ptr = buffer->data();
+    uint8_t *packet = beginPacket();
+    uint8_t *ptr = packet;
     *ptr++ = 0x47;
     *ptr++ = 0x40 | (PID >> 8);
     *ptr++ = PID & 0xff;
@@ -865,6 +881,7 @@ void MPEG2TSWriter::writeAccessUnit(
         *ptr++ = paddingSize - 1;
         if (paddingSize >= 2) {
             *ptr++ = 0x00;
+            memset(ptr, 0xff, paddingSize - 2);
             ptr += paddingSize - 2;
         }
     }
@@ -883,15 +900,19 @@ void MPEG2TSWriter::writeAccessUnit(
     *ptr++ = (PTS >> 7) & 0xff;
     *ptr++ = ((PTS & 0x7f) << 1) | 1;
 
-    size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+    size_t sizeLeft = packet + kTSPacketSize - ptr;
     size_t copy = accessUnit->size();
     if (copy > sizeLeft) {
         copy = sizeLeft;
     }
 
-    memcpy(ptr, accessUnit->data(), copy);
-
-    CHECK_EQ(internalWrite(buffer->data(), buffer->size()), (ssize_t)buffer->size());
+    if (padding) {
+        memcpy(ptr, accessUnit->data(), copy);
+        commitBlockData(kTSPacketSize);
+    } else {
+        commitBlockData(ptr - packet);
+        appendPayload(accessUnit->data(), copy);
+    }
 
     size_t offset = copy;
     while (offset < accessUnit->size()) {
@@ -907,12 +928,11 @@ void MPEG2TSWriter::writeAccessUnit(
         // continuity_counter = b????
         // the fragment of "buffer" follows.
 
-        memset(buffer->data(), 0xff, buffer->size());
-
         const unsigned continuity_counter =
             mSources.editItemAt(sourceIndex)->incrementContinuityCounter();
 
-        ptr = buffer->data();
+        packet = beginPacket();
+        ptr = packet;
         *ptr++ = 0x47;
         *ptr++ = 0x00 | (PID >> 8);
         *ptr++ = PID & 0xff;
@@ -925,22 +945,32 @@ void MPEG2TSWriter::writeAccessUnit(
             *ptr++ = paddingSize - 1;
             if (paddingSize >= 2) {
                 *ptr++ = 0x00;
+                memset(ptr, 0xff, paddingSize - 2);
                 ptr += paddingSize - 2;
             }
         }
 
-        size_t sizeLeft = buffer->data() + buffer->size() - ptr;
+        size_t sizeLeft = packet + kTSPacketSize - ptr;
         size_t copy = accessUnit->size() - offset;
         if (copy > sizeLeft) {
             copy = sizeLeft;
         }
 
-        memcpy(ptr, accessUnit->data() + offset, copy);
-        CHECK_EQ(internalWrite(buffer->data(), buffer->size()),
-                 (ssize_t)buffer->size());
+        if (lastAccessUnit) {
+            memcpy(ptr, accessUnit->data() + offset, copy);
+            commitBlockData(kTSPacketSize);
+        } else {
+            // Full payloads are written straight from the access unit.
+            commitBlockData(ptr - packet);
+            appendPayload(accessUnit->data() + offset, copy);
+        }
 
         offset += copy;
     }
+
+    // The payloads are referenced, not copied, and the source reuses
+    // |accessUnit| as soon as it is asked for more data.
+    flushBlock();
 }
 
 void MPEG2TSWriter::writeTS() {
@@ -979,11 +1009,96 @@ uint32_t MPEG2TSWriter::crc32(const uint8_t *p_start, size_t length) {
     return crc;
 }
 
-ssize_t MPEG2TSWriter::internalWrite(const void *data, size_t size) {
-    if (mFile != NULL) {
-        return fwrite(data, 1, size, mFile);
+uint8_t *MPEG2TSWriter::beginPacket() {
+    // Every packet adds at most two entries, its header and a payload.
+    if (mNumPacketsInBlock == kMaxPacketsPerBlock
+            || mIOVecs.size() + 2 > IOV_MAX) {
+        flushBlock();
+    }
+
+    ++mNumPacketsInBlock;
+
+    return mBlock->data() + mBlock->size();
+}
+
+void MPEG2TSWriter::commitBlockData(size_t size) {
+    uint8_t *data = mBlock->data() + mBlock->size();
+    CHECK_LE(mBlock->size() + size, mBlock->capacity());
+    mBlock->setRange(0, mBlock->size() + size);
+
+    if (!mIOVecs.isEmpty()) {
+        struct iovec &last = mIOVecs.editTop();
+        if ((uint8_t *)last.iov_base + last.iov_len == data) {
+            last.iov_len += size;
+            return;
+        }
+    }
+
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = size;
+    mIOVecs.push(iov);
+}
+
+void MPEG2TSWriter::appendPayload(const uint8_t *data, size_t size) {
+    struct iovec iov;
+    iov.iov_base = const_cast<uint8_t *>(data);
+    iov.iov_len = size;
+    mIOVecs.push(iov);
+}
+
+void MPEG2TSWriter::flushBlock() {
+    if (mIOVecs.isEmpty()) {
+        return;
+    }
+
+    size_t size = mNumPacketsInBlock * kTSPacketSize;
+
+    if (mFd >= 0) {
+        struct iovec *iov = mIOVecs.editArray();
+        size_t iovcnt = mIOVecs.size();
+        while (iovcnt > 0) {
+            ssize_t n = writev(mFd, iov, iovcnt);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            CHECK_GT(n, 0);
+
+            while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+                n -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = (uint8_t *)iov->iov_base + n;
+                iov->iov_len -= n;
+            }
+        }
+    } else if (mIOVecs.size() == 1) {
+        CHECK_EQ(internalWrite(mIOVecs[0].iov_base, size), (ssize_t)size);
+    } else {
+        if (mGatherBuffer == NULL) {
+            mGatherBuffer = new ABuffer(kMaxPacketsPerBlock * kTSPacketSize);
+        }
+
+        uint8_t *ptr = mGatherBuffer->data();
+        for (size_t i = 0; i < mIOVecs.size(); ++i) {
+            memcpy(ptr, mIOVecs[i].iov_base, mIOVecs[i].iov_len);
+            ptr += mIOVecs[i].iov_len;
+        }
+        CHECK_EQ((size_t)(ptr - mGatherBuffer->data()), size);
+
+        CHECK_EQ(internalWrite(mGatherBuffer->data(), size), (ssize_t)size);
     }
 
+    mIOVecs.clear();
+    mBlock->setRange(0, 0);
+    mNumPacketsInBlock = 0;
+}
+
+ssize_t MPEG2TSWriter::internalWrite(const void *data, size_t size) {
+    CHECK(mWriteFunc != NULL);
+
     return (*mWriteFunc)(mWriteCookie, data, size);
 }
 
@@ -21,19 +21,27 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaAdapter.h>
 #include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaBufferGroup.h>
 
 namespace android {
 
 MediaAdapter::MediaAdapter(const sp<MetaData> &meta)
-    : mCurrentMediaBuffer(NULL),
+    : mPushedBuffer(NULL),
+      mMaxQueuedBuffers(kDefaultMaxQueuedBuffers),
+      mMaxQueuedDurationUs(kDefaultMaxQueuedDurationUs),
+      mBufferGroup(NULL),
       mStarted(false),
+      mStopping(false),
       mOutputFormat(meta) {
 }
 
 MediaAdapter::~MediaAdapter() {
     Mutex::Autolock autoLock(mAdapterLock);
     mOutputFormat.clear();
-    CHECK(mCurrentMediaBuffer == NULL);
+    CHECK(mQueuedBuffers.empty());
+    CHECK(mPushedBuffer == NULL);
+    delete mBufferGroup;
+    mBufferGroup = NULL;
 }
 
 status_t MediaAdapter::start(MetaData * /* params */) {
@@ -45,24 +53,44 @@ status_t MediaAdapter::start(MetaData * /* params */) {
 }
 
 status_t MediaAdapter::stop() {
-    MediaBuffer *currentBuffer = NULL;
+    List<MediaBufferBase *> unreadBuffers;
     {
         Mutex::Autolock autoLock(mAdapterLock);
         if (mStarted) {
-            mStarted = false;
-            // If stop() happens immediately after a pushBuffer(), we should
-            // clean up the mCurrentMediaBuffer. But need to release without
-            // the lock as signalBufferReturned() will acquire the lock.
-            currentBuffer = mCurrentMediaBuffer;
-            mCurrentMediaBuffer = NULL;
+            // Let read() hand out what is already queued before it reports the
+            // end of stream. The writer keeps reading until its source is
+            // stopped, so only buffers it stops taking are discarded.
+            mStopping = true;
+            mBufferReadCond.signal();
+            mQueueNotFullCond.broadcast();
+            while (!mQueuedBuffers.empty()) {
+                size_t queued = mQueuedBuffers.size();
+                if (mQueueDrainedCond.waitRelative(mAdapterLock, kDrainTimeoutNs) == TIMED_OUT
+                        && mQueuedBuffers.size() == queued) {
+                    ALOGW("%zu queued buffers were not read before stop", queued);
+                    break;
+                }
+            }
 
-            // While read() is still waiting, we should signal it to finish.
+            mStarted = false;
+            mStopping = false;
+            // If stop() happens before the queued buffers are read, we should
+            // clean them up. But need to release without the lock as
+            // signalBufferReturned() will acquire the lock.
+            while (!mQueuedBuffers.empty()) {
+                unreadBuffers.push_back(*mQueuedBuffers.begin());
+                mQueuedBuffers.erase(mQueuedBuffers.begin());
+            }
+
+            // While read() or queueBuffer() is still waiting, we should
+            // signal it to finish.
             mBufferReadCond.signal();
+            mQueueNotFullCond.broadcast();
         }
     }
-    if (currentBuffer != NULL) {
-        currentBuffer->release();
-        currentBuffer = NULL;
+    for (List<MediaBufferBase *>::iterator it = unreadBuffers.begin();
+            it != unreadBuffers.end(); ++it) {
+        (*it)->release();
     }
     return OK;
 }
@@ -75,10 +103,13 @@ sp<MetaData> MediaAdapter::getFormat() {
 void MediaAdapter::signalBufferReturned(MediaBufferBase *buffer) {
     Mutex::Autolock autoLock(mAdapterLock);
     CHECK(buffer != NULL);
+    if (buffer == mPushedBuffer) {
+        mPushedBuffer = NULL;
+        mBufferReturnedCond.broadcast();
+    }
     buffer->setObserver(0);
     buffer->release();
     ALOGV("buffer returned %p", buffer);
-    mBufferReturnedCond.signal();
 }
 
 status_t MediaAdapter::read(
@@ -89,21 +120,22 @@ status_t MediaAdapter::read(
         return ERROR_END_OF_STREAM;
     }
 
-    while (mCurrentMediaBuffer == NULL && mStarted) {
+    while (mQueuedBuffers.empty() && mStarted && !mStopping) {
         ALOGV("waiting @ read()");
         mBufferReadCond.wait(mAdapterLock);
     }
 
-    if (!mStarted) {
+    if (mQueuedBuffers.empty()) {
         ALOGV("read interrupted after stop");
-        CHECK(mCurrentMediaBuffer == NULL);
         return ERROR_END_OF_STREAM;
     }
 
-    CHECK(mCurrentMediaBuffer != NULL);
-
-    *buffer = mCurrentMediaBuffer;
-    mCurrentMediaBuffer = NULL;
+    *buffer = *mQueuedBuffers.begin();
+    mQueuedBuffers.erase(mQueuedBuffers.begin());
+    mQueueNotFullCond.signal();
+    if (mStopping) {
+        mQueueDrainedCond.signal();
+    }
 
     return OK;
 }
@@ -115,19 +147,93 @@ status_t MediaAdapter::pushBuffer(MediaBuffer *buffer) {
     }
 
     Mutex::Autolock autoLock(mAdapterLock);
-    if (!mStarted) {
+    // Another pushBuffer() on this track may still be waiting for its buffer.
+    while (mPushedBuffer != NULL && mStarted && !mStopping) {
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
+    if (!mStarted || mStopping) {
         ALOGE("pushBuffer called before start");
         return INVALID_OPERATION;
     }
-    mCurrentMediaBuffer = buffer;
-    mCurrentMediaBuffer->setObserver(this);
+    mPushedBuffer = buffer;
+    buffer->setObserver(this);
+    mQueuedBuffers.push_back(buffer);
     mBufferReadCond.signal();
 
     ALOGV("wait for the buffer returned @ pushBuffer! %p", buffer);
-    mBufferReturnedCond.wait(mAdapterLock);
+    while (mPushedBuffer == buffer) {
+        mBufferReturnedCond.wait(mAdapterLock);
+    }
 
     return OK;
 }
 
-}  // namespace android
+void MediaAdapter::setQueueLimits(size_t maxBuffers, int64_t maxDurationUs) {
+    Mutex::Autolock autoLock(mAdapterLock);
+    CHECK(maxBuffers > 0);
+    CHECK(mBufferGroup == NULL);
+    mMaxQueuedBuffers = maxBuffers;
+    mMaxQueuedDurationUs = maxDurationUs;
+}
+
+bool MediaAdapter::isQueueFull_l(MediaBufferBase *buffer) const {
+    if (mQueuedBuffers.size() >= mMaxQueuedBuffers) {
+        return true;
+    }
+    if (mQueuedBuffers.empty() || mMaxQueuedDurationUs <= 0) {
+        return false;
+    }
 
+    int64_t oldestTimeUs, timeUs;
+    if (!(*mQueuedBuffers.begin())->meta_data().findInt64(kKeyTime, &oldestTimeUs)
+            || !buffer->meta_data().findInt64(kKeyTime, &timeUs)) {
+        return false;
+    }
+    return timeUs - oldestTimeUs >= mMaxQueuedDurationUs;
+}
+
+status_t MediaAdapter::queueBuffer(MediaBufferBase *buffer) {
+    if (buffer == NULL) {
+        ALOGE("queueBuffer get an NULL buffer");
+        return -EINVAL;
+    }
+
+    {
+        Mutex::Autolock autoLock(mAdapterLock);
+        while (mStarted && !mStopping && isQueueFull_l(buffer)) {
+            ALOGV("wait for room in the queue @ queueBuffer! %p", buffer);
+            mQueueNotFullCond.wait(mAdapterLock);
+        }
+
+        if (mStarted && !mStopping) {
+            mQueuedBuffers.push_back(buffer);
+            mBufferReadCond.signal();
+            return OK;
+        }
+    }
+
+    ALOGE("queueBuffer called while not started");
+    // without the lock, in case the buffer is observed by us
+    buffer->release();
+    return INVALID_OPERATION;
+}
+
+status_t MediaAdapter::acquireBuffer(size_t size, MediaBufferBase **buffer) {
+    MediaBufferGroup *group;
+    {
+        Mutex::Autolock autoLock(mAdapterLock);
+        if (mBufferGroup == NULL) {
+            // one more than can be queued, for the buffer being written out
+            mBufferGroup = new MediaBufferGroup(mMaxQueuedBuffers + 1);
+        }
+        group = mBufferGroup;
+    }
+
+    status_t err = group->acquire_buffer(buffer, false /* nonBlocking */, size);
+    if (err == OK) {
+        (*buffer)->set_range(0, size);
+    }
+    return err;
+}
+
+}  // namespace android
@@ -19,6 +19,9 @@
 #define DEBUG_DRIFT_TIME 0
 
 #include <inttypes.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/Surface.h>
@@ -61,6 +64,10 @@ struct MediaCodecSource::Puller : public AHandler {
     status_t setStopTimeUs(int64_t stopTimeUs);
     bool readBuffer(MediaBufferBase **buffer);
 
+    // Reads whatever the source has ready without blocking. Called by the
+    // source through SourceListener once it accepted a ready listener.
+    void pullReadyBuffers();
+
 protected:
     virtual void onMessageReceived(const sp<AMessage> &msg);
     virtual ~Puller();
@@ -73,6 +80,8 @@ private:
         kWhatSetStopTimeUs,
     };
 
+    struct SourceListener;
+
     sp<MediaSource> mSource;
     sp<AMessage> mNotify;
     sp<ALooper> mLooper;
@@ -82,10 +91,16 @@ private:
         Queue()
             : mReadPendingSince(0),
               mPaused(false),
-              mPulling(false) { }
+              mPulling(false),
+              mPushing(false),
+              mNotifyPending(false) { }
         int64_t mReadPendingSince;
         bool mPaused;
         bool mPulling;
+        // the source calls pullReadyBuffers() instead of being read on the looper
+        bool mPushing;
+        // mNotify was posted and the encoder side has not read since
+        bool mNotifyPending;
         Vector<MediaBufferBase *> mReadBuffers;
 
         void flush();
@@ -96,14 +111,35 @@ private:
         void pushBuffer(MediaBufferBase *mbuf);
     };
     Mutexed<Queue> mQueue;
+    // serializes pullReadyBuffers(), the source may notify from several threads
+    Mutex mPullLock;
 
     status_t postSynchronouslyAndReturnError(const sp<AMessage> &msg);
     void schedulePull();
     void handleEOS();
+    // Queues the outcome of a source read and unlocks |queue|. Returns true
+    // if the source should be read again.
+    bool onBufferRead(Mutexed<Queue>::Locked &queue, MediaBufferBase *mbuf, status_t err);
 
     DISALLOW_EVIL_CONSTRUCTORS(Puller);
 };
 
+struct MediaCodecSource::Puller::SourceListener : public MediaSource::ReadyListener {
+    explicit SourceListener(const sp<Puller> &puller)
+        : mPuller(puller) {
+    }
+
+    virtual void onBufferReady() {
+        sp<Puller> puller = mPuller.promote();
+        if (puller != NULL) {
+            puller->pullReadyBuffers();
+        }
+    }
+
+private:
+    wp<Puller> mPuller;
+};
+
 MediaCodecSource::Puller::Puller(const sp<MediaSource> &source)
     : mSource(source),
       mLooper(new ALooper()),
@@ -147,6 +183,8 @@ void MediaCodecSource::Puller::Queue::flush() {
 
 bool MediaCodecSource::Puller::readBuffer(MediaBufferBase **mbuf) {
     Mutexed<Queue>::Locked queue(mQueue);
+    // the encoder side is draining, so the next buffer needs a new notify
+    queue->mNotifyPending = false;
     return queue->readBuffer(mbuf);
 }
 
@@ -188,16 +226,21 @@ status_t MediaCodecSource::Puller::start(const sp<MetaData> &meta, const sp<AMes
 
 void MediaCodecSource::Puller::stop() {
     bool interrupt = false;
+    bool pushing = false;
     {
         // mark stopping before actually reaching kWhatStop on the looper, so the pulling will
         // stop.
         Mutexed<Queue>::Locked queue(mQueue);
         queue->mPulling = false;
+        pushing = queue->mPushing;
         interrupt = queue->mReadPendingSince && (queue->mReadPendingSince < ALooper::GetNowUs() - 1000000);
         queue->flush(); // flush any unprocessed pulled buffers
     }
 
-    if (interrupt) {
+    if (pushing) {
+        // there is no pull loop to notice that we stopped
+        handleEOS();
+    } else if (interrupt) {
         interruptSource();
     }
 }
@@ -234,6 +277,69 @@ void MediaCodecSource::Puller::handleEOS() {
     msg->post();
 }
 
+bool MediaCodecSource::Puller::onBufferRead(
+        Mutexed<Queue>::Locked &queue, MediaBufferBase *mbuf, status_t err) {
+    // if we need to discard buffer
+    if (!queue->mPulling || queue->mPaused || err != OK) {
+        if (mbuf != NULL) {
+            mbuf->release();
+            mbuf = NULL;
+        }
+        if (queue->mPulling && err == OK) {
+            queue.unlock();
+            return true; // if simply paused, keep pulling source
+        } else if (err == ERROR_END_OF_STREAM) {
+            ALOGV("stream ended, mbuf %p", mbuf);
+        } else if (err != OK) {
+            ALOGE("error %d reading stream.", err);
+        }
+    }
+
+    bool notify = false;
+    if (mbuf != NULL) {
+        queue->pushBuffer(mbuf);
+        notify = !queue->mNotifyPending;
+        queue->mNotifyPending = true;
+    }
+
+    queue.unlock();
+
+    if (mbuf == NULL) {
+        handleEOS();
+        return false;
+    }
+    if (notify) {
+        mNotify->post();
+    }
+    return true;
+}
+
+void MediaCodecSource::Puller::pullReadyBuffers() {
+    Mutex::Autolock autoLock(mPullLock);
+    MediaSource::ReadOptions options;
+    options.setNonBlocking();
+
+    for (;;) {
+        Mutexed<Queue>::Locked queue(mQueue);
+        if (!queue->mPulling || !queue->mPushing) {
+            // stop() posts EOS for us
+            return;
+        }
+
+        queue.unlock();
+        MediaBufferBase *mbuf = NULL;
+        status_t err = mSource->read(&mbuf, &options);
+        if (err == WOULD_BLOCK) {
+            return;
+        }
+        queue.lock();
+
+        if (!onBufferRead(queue, mbuf, err)) {
+            return;
+        }
+    }
+}
+
 void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatStart:
@@ -249,7 +355,15 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
             status_t err = mSource->start(static_cast<MetaData *>(obj.get()));
 
             if (err == OK) {
-                schedulePull();
+                // Let the source tell us when frames are ready if it can, so
+                // that no read() is parked on this looper per frame.
+                if (mSource->setReadyListener(new SourceListener(this)) == OK) {
+                    ALOGV("puller (%s) driven by source", mIsAudio ? "audio" : "video");
+                    mQueue.lock()->mPushing = true;
+                    pullReadyBuffers();
+                } else {
+                    schedulePull();
+                }
             }
 
             sp<AMessage> response = new AMessage;
@@ -277,6 +391,9 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
 
         case kWhatStop:
         {
+            if (mQueue.lock()->mPushing) {
+                mSource->setReadyListener(NULL);
+            }
             mSource->stop();
 
             sp<AMessage> response = new AMessage;
@@ -303,33 +420,8 @@ void MediaCodecSource::Puller::onMessageReceived(const sp<AMessage> &msg) {
             queue.lock();
 
             queue->mReadPendingSince = 0;
-            // if we need to discard buffer
-            if (!queue->mPulling || queue->mPaused || err != OK) {
-                if (mbuf != NULL) {
-                    mbuf->release();
-                    mbuf = NULL;
-                }
-                if (queue->mPulling && err == OK) {
-                    msg->post(); // if simply paused, keep pulling source
-                    break;
-                } else if (err == ERROR_END_OF_STREAM) {
-                    ALOGV("stream ended, mbuf %p", mbuf);
-                } else if (err != OK) {
-                    ALOGE("error %d reading stream.", err);
-                }
-            }
-
-            if (mbuf != NULL) {
-                queue->pushBuffer(mbuf);
-            }
-
-            queue.unlock();
-
-            if (mbuf != NULL) {
-                mNotify->post();
+            if (onBufferRead(queue, mbuf, err)) {
                 msg->post();
-            } else {
-                handleEOS();
             }
             break;
         }
@@ -344,6 +436,45 @@ MediaCodecSource::Output::Output()
       mErrorCode(OK) {
 }
 
+MediaCodecSource::LatencyHistogram::LatencyHistogram()
+    : mCount(0),
+      mSumUs(0),
+      mMinUs(INT64_MAX),
+      mMaxUs(0) {
+    memset(mBuckets, 0, sizeof(mBuckets));
+}
+
+void MediaCodecSource::LatencyHistogram::add(int64_t latencyUs) {
+    if (latencyUs < 0) {
+        latencyUs = 0;
+    }
+    size_t bucket = 0;
+    while (bucket + 1 < kNumBuckets && latencyUs >= (1000ll << bucket)) {
+        ++bucket;
+    }
+    ++mBuckets[bucket];
+    ++mCount;
+    mSumUs += latencyUs;
+    mMinUs = std::min(mMinUs, latencyUs);
+    mMaxUs = std::max(mMaxUs, latencyUs);
+}
+
+void MediaCodecSource::LatencyHistogram::dump(String8 &result) const {
+    if (mCount == 0) {
+        result.append("       no samples\n");
+        return;
+    }
+    result.appendFormat("       samples: %" PRId64 ", min/avg/max (us): %" PRId64
+            "/%" PRId64 "/%" PRId64 "\n", mCount, mMinUs, mSumUs / mCount, mMaxUs);
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        if (i + 1 < kNumBuckets) {
+            result.appendFormat("       < %4d ms: %" PRId64 "\n", 1 << i, mBuckets[i]);
+        } else {
+            result.appendFormat("      >= %4d ms: %" PRId64 "\n", 1 << (i - 1), mBuckets[i]);
+        }
+    }
+}
+
 // static
 sp<MediaCodecSource> MediaCodecSource::Create(
         const sp<ALooper> &looper,
@@ -428,6 +559,15 @@ status_t MediaCodecSource::read(
     return output->mErrorCode;
 }
 
+status_t MediaCodecSource::dump(int fd, const Vector<String16>& /* args */) {
+    String8 result;
+    result.appendFormat("   MediaCodecSource %p (%s)\n", this, mIsVideo ? "video" : "audio");
+    result.append("     Capture to encoder latency:\n");
+    mCaptureLatency.lock()->dump(result);
+    ::write(fd, result.string(), result.size());
+    return OK;
+}
+
 void MediaCodecSource::signalBufferReturned(MediaBufferBase *buffer) {
     buffer->setObserver(0);
     buffer->release();
@@ -688,11 +828,15 @@ status_t MediaCodecSource::feedEncoderInputBuffers() {
         mAvailEncoderInputIndices.erase(mAvailEncoderInputIndices.begin());
 
         int64_t timeUs = 0ll;
+        int64_t captureTimeUs = -1ll;
         uint32_t flags = 0;
         size_t size = 0;
 
         if (mbuf != NULL) {
             CHECK(mbuf->meta_data().findInt64(kKeyTime, &timeUs));
+            if (!mbuf->meta_data().findInt64(kKeyCaptureTime, &captureTimeUs)) {
+                captureTimeUs = -1ll;
+            }
             if (mFirstSampleSystemTimeUs < 0ll) {
                 mFirstSampleSystemTimeUs = systemTime() / 1000;
                 if (mPausePending) {
@@ -755,6 +899,10 @@ status_t MediaCodecSource::feedEncoderInputBuffers() {
         if (err != OK) {
             return err;
         }
+
+        if (captureTimeUs >= 0ll) {
+            mCaptureLatency.lock()->add(systemTime() / 1000 - captureTimeUs);
+        }
     }
 
     return OK;
@@ -47,6 +47,8 @@ static bool isMp4Format(MediaMuxer::OutputFormat format) {
 
 MediaMuxer::MediaMuxer(int fd, OutputFormat format)
     : mFormat(format),
+      mMaxQueuedSamples(0),
+      mMaxQueuedDurationUs(0),
       mState(UNINITIALIZED) {
     if (isMp4Format(format)) {
         mWriter = new MPEG4Writer(fd);
@@ -128,10 +130,33 @@ status_t MediaMuxer::setLocation(int latitude, int longitude) {
     return static_cast<MPEG4Writer*>(mWriter.get())->setGeoData(latitude, longitude);
 }
 
+status_t MediaMuxer::setSampleQueueing(
+        size_t maxQueuedSamples, int64_t maxQueuedDurationUs) {
+    Mutex::Autolock autoLock(mMuxerLock);
+    if (mState != INITIALIZED) {
+        ALOGE("setSampleQueueing() must be called before start().");
+        return INVALID_OPERATION;
+    }
+
+    if (maxQueuedDurationUs < 0) {
+        ALOGE("setSampleQueueing() get a negative duration");
+        return -EINVAL;
+    }
+
+    mMaxQueuedSamples = maxQueuedSamples;
+    mMaxQueuedDurationUs = maxQueuedDurationUs;
+    return OK;
+}
+
 status_t MediaMuxer::start() {
     Mutex::Autolock autoLock(mMuxerLock);
     if (mState == INITIALIZED) {
         mState = STARTED;
+        if (mMaxQueuedSamples > 0) {
+            for (size_t i = 0; i < mTrackList.size(); i++) {
+                mTrackList[i]->setQueueLimits(mMaxQueuedSamples, mMaxQueuedDurationUs);
+            }
+        }
         mFileMeta->setInt32(kKeyRealTimeRecording, false);
         return mWriter->start(mFileMeta.get());
     } else {
@@ -157,8 +182,22 @@ status_t MediaMuxer::stop() {
     }
 }
 
-status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
-                                     int64_t timeUs, uint32_t flags) {
+static void setSampleMetaData(MetaDataBase &sampleMetaData, int64_t timeUs, uint32_t flags) {
+    sampleMetaData.setInt64(kKeyTime, timeUs);
+    // Just set the kKeyDecodingTime as the presentation time for now.
+    sampleMetaData.setInt64(kKeyDecodingTime, timeUs);
+
+    if (flags & MediaCodec::BUFFER_FLAG_SYNCFRAME) {
+        sampleMetaData.setInt32(kKeyIsSyncFrame, true);
+    }
+
+    if (flags & MediaCodec::BUFFER_FLAG_MUXER_DATA) {
+        sampleMetaData.setInt32(kKeyIsMuxerData, 1);
+    }
+}
+
+status_t MediaMuxer::getTrackForWrite(
+        const sp<ABuffer> &buffer, size_t trackIndex, sp<MediaAdapter> *track) {
     Mutex::Autolock autoLock(mMuxerLock);
 
     if (buffer.get() == NULL) {
@@ -176,27 +215,55 @@ status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackInde
         return -EINVAL;
     }
 
+    *track = mTrackList[trackIndex];
+    return OK;
+}
+
+// The muxer lock is not held while handing a sample to its track, so that
+// writers of different tracks do not wait for each other.
+status_t MediaMuxer::writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                                     int64_t timeUs, uint32_t flags) {
+    sp<MediaAdapter> currentTrack;
+    status_t err = getTrackForWrite(buffer, trackIndex, &currentTrack);
+    if (err != OK) {
+        return err;
+    }
+
+    if (mMaxQueuedSamples > 0) {
+        MediaBufferBase *mediaBuffer;
+        err = currentTrack->acquireBuffer(buffer->size(), &mediaBuffer);
+        if (err != OK) {
+            return err;
+        }
+        memcpy(mediaBuffer->data(), buffer->data(), buffer->size());
+        setSampleMetaData(mediaBuffer->meta_data(), timeUs, flags);
+        return currentTrack->queueBuffer(mediaBuffer);
+    }
+
     MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
 
     mediaBuffer->add_ref(); // Released in MediaAdapter::signalBufferReturned().
     mediaBuffer->set_range(buffer->offset(), buffer->size());
+    setSampleMetaData(mediaBuffer->meta_data(), timeUs, flags);
 
-    MetaDataBase &sampleMetaData = mediaBuffer->meta_data();
-    sampleMetaData.setInt64(kKeyTime, timeUs);
-    // Just set the kKeyDecodingTime as the presentation time for now.
-    sampleMetaData.setInt64(kKeyDecodingTime, timeUs);
+    // This pushBuffer will wait until the mediaBuffer is consumed.
+    return currentTrack->pushBuffer(mediaBuffer);
+}
 
-    if (flags & MediaCodec::BUFFER_FLAG_SYNCFRAME) {
-        sampleMetaData.setInt32(kKeyIsSyncFrame, true);
+status_t MediaMuxer::writeOwnedSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                                          int64_t timeUs, uint32_t flags) {
+    sp<MediaAdapter> currentTrack;
+    status_t err = getTrackForWrite(buffer, trackIndex, &currentTrack);
+    if (err != OK) {
+        return err;
     }
 
-    if (flags & MediaCodec::BUFFER_FLAG_MUXER_DATA) {
-        sampleMetaData.setInt32(kKeyIsMuxerData, 1);
-    }
+    // Deleted by the writer's release(), as it has no observer.
+    MediaBuffer* mediaBuffer = new MediaBuffer(buffer);
+    mediaBuffer->set_range(buffer->offset(), buffer->size());
+    setSampleMetaData(mediaBuffer->meta_data(), timeUs, flags);
 
-    sp<MediaAdapter> currentTrack = mTrackList[trackIndex];
-    // This pushBuffer will wait until the mediaBuffer is consumed.
-    return currentTrack->pushBuffer(mediaBuffer);
+    return currentTrack->queueBuffer(mediaBuffer);
 }
 
 }  // namespace android
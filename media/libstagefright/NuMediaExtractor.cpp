@@ -59,7 +59,7 @@ NuMediaExtractor::~NuMediaExtractor() {
     releaseAllTrackSamples();
 
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
-        TrackInfo *info = &mSelectedTracks.editItemAt(i);
+        TrackInfo *info = mSelectedTracks.editItemAt(i).get();
 
         status_t err = info->mSource->stop();
         ALOGE_IF(err != OK, "error %d stopping track %zu", err, i);
@@ -340,9 +340,7 @@ status_t NuMediaExtractor::selectTrack(size_t index,
     }
 
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
-        TrackInfo *info = &mSelectedTracks.editItemAt(i);
-
-        if (info->mTrackIndex == index) {
+        if (mSelectedTracks[i]->mTrackIndex == index) {
             // This track has already been selected.
             return OK;
         }
@@ -374,8 +372,7 @@ status_t NuMediaExtractor::selectTrack(size_t index,
     }
     ALOGV("selectTrack, track[%zu]: %s", index, mime);
 
-    mSelectedTracks.push();
-    TrackInfo *info = &mSelectedTracks.editItemAt(mSelectedTracks.size() - 1);
+    sp<TrackInfo> info = new TrackInfo;
 
     info->mSource = source;
     info->mTrackIndex = index;
@@ -390,15 +387,17 @@ status_t NuMediaExtractor::selectTrack(size_t index,
         info->mMaxFetchCount = 1;
     }
     info->mFinalResult = OK;
-    releaseTrackSamples(info);
     info->mTrackFlags = 0;
 
     if (!strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_VORBIS)) {
         info->mTrackFlags |= kIsVorbis;
     }
 
+    mSelectedTracks.push(info);
+
     if (startTimeUs >= 0) {
-        fetchTrackSamples(info, startTimeUs, mode);
+        Mutex::Autolock trackLock(info->mLock);
+        fetchTrackSamples(info.get(), startTimeUs, mode);
     }
 
     return OK;
@@ -417,9 +416,7 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
 
     size_t i;
     for (i = 0; i < mSelectedTracks.size(); ++i) {
-        TrackInfo *info = &mSelectedTracks.editItemAt(i);
-
-        if (info->mTrackIndex == index) {
+        if (mSelectedTracks[i]->mTrackIndex == index) {
             break;
         }
     }
@@ -429,13 +426,18 @@ status_t NuMediaExtractor::unselectTrack(size_t index) {
         return OK;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(i);
+    sp<TrackInfo> info = mSelectedTracks[i];
+    mSelectedTracks.removeAt(i);
+
+    Mutex::Autolock trackLock(info->mLock);
 
-    releaseTrackSamples(info);
+    releaseTrackSamples(info.get());
 
-    CHECK_EQ((status_t)OK, info->mSource->stop());
+    // A per-track reader still holding on to the track gets an error from
+    // now on instead of reading from a stopped source.
+    info->mFinalResult = INVALID_OPERATION;
 
-    mSelectedTracks.removeAt(i);
+    CHECK_EQ((status_t)OK, info->mSource->stop());
 
     return OK;
 }
@@ -468,17 +470,19 @@ void NuMediaExtractor::releaseTrackSamples(TrackInfo *info) {
 
 void NuMediaExtractor::releaseAllTrackSamples() {
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
-        releaseTrackSamples(&mSelectedTracks.editItemAt(i));
+        releaseTrackSamples(mSelectedTracks.editItemAt(i).get());
     }
 }
 
 ssize_t NuMediaExtractor::fetchAllTrackSamples(
         int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode mode) {
-    TrackInfo *minInfo = NULL;
     ssize_t minIndex = ERROR_END_OF_STREAM;
+    int64_t minTimeUs = 0;
 
     for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
-        TrackInfo *info = &mSelectedTracks.editItemAt(i);
+        TrackInfo *info = mSelectedTracks.editItemAt(i).get();
+        Mutex::Autolock trackLock(info->mLock);
+
         fetchTrackSamples(info, seekTimeUs, mode);
 
         status_t err = info->mFinalResult;
@@ -490,16 +494,10 @@ ssize_t NuMediaExtractor::fetchAllTrackSamples(
             continue;
         }
 
-        if (minInfo == NULL) {
-            minInfo = info;
+        int64_t timeUs = info->mSamples.begin()->mSampleTimeUs;
+        if (minIndex < 0 || timeUs < minTimeUs) {
             minIndex = i;
-        } else {
-            auto it = info->mSamples.begin();
-            auto itMin = minInfo->mSamples.begin();
-            if (it->mSampleTimeUs < itMin->mSampleTimeUs) {
-                minInfo = info;
-                minIndex = i;
-            }
+            minTimeUs = timeUs;
         }
     }
 
@@ -534,6 +532,40 @@ void NuMediaExtractor::fetchTrackSamples(TrackInfo *info,
         }
     }
 
+    appendTrackSamples(info, err, mediaBuffers);
+}
+
+// Tops up the samples of a track that is read through its own read pointer
+// once half of them are consumed, so that the next sample is usually cached
+// already instead of waiting on the source when the cache runs dry.
+void NuMediaExtractor::readAheadTrackSamples(TrackInfo *info) {
+    if (info->mSamples.empty()) {
+        fetchTrackSamples(info);
+        return;
+    }
+
+    if (info->mFinalResult != OK
+            || info->mSamples.size() > info->mMaxFetchCount / 2
+            || !info->mSource->supportReadMultiple()) {
+        return;
+    }
+
+    MediaSource::ReadOptions options;
+    options.setNonBlocking();
+    Vector<MediaBufferBase *> mediaBuffers;
+    status_t err = info->mSource->readMultiple(
+            &mediaBuffers, info->mMaxFetchCount - info->mSamples.size(), &options);
+    if (err == WOULD_BLOCK) {
+        // The source may be out of buffers while the reader still holds the
+        // ones cached here; keep what was read and top up again later.
+        err = OK;
+    }
+
+    appendTrackSamples(info, err, mediaBuffers);
+}
+
+void NuMediaExtractor::appendTrackSamples(
+        TrackInfo *info, status_t err, const Vector<MediaBufferBase *> &mediaBuffers) {
     info->mFinalResult = err;
     if (err != OK && err != ERROR_END_OF_STREAM) {
         ALOGW("read on track %zu failed with error %d", info->mTrackIndex, err);
@@ -592,7 +624,8 @@ status_t NuMediaExtractor::advance() {
         return ERROR_END_OF_STREAM;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    TrackInfo *info = mSelectedTracks.editItemAt(minIndex).get();
+    Mutex::Autolock trackLock(info->mLock);
 
     releaseOneSample(info);
 
@@ -662,7 +695,16 @@ status_t NuMediaExtractor::readSampleData(const sp<ABuffer> &buffer) {
         return ERROR_END_OF_STREAM;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    TrackInfo *info = mSelectedTracks.editItemAt(minIndex).get();
+    Mutex::Autolock trackLock(info->mLock);
+
+    return copySampleData(info, buffer);
+}
+
+status_t NuMediaExtractor::copySampleData(TrackInfo *info, const sp<ABuffer> &buffer) {
+    if (info->mSamples.empty()) {
+        return ERROR_END_OF_STREAM;
+    }
 
     auto it = info->mSamples.begin();
     size_t sampleSize = it->mBuffer->range_length();
@@ -704,7 +746,12 @@ status_t NuMediaExtractor::getSampleSize(size_t *sampleSize) {
         return ERROR_END_OF_STREAM;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    TrackInfo *info = mSelectedTracks.editItemAt(minIndex).get();
+    Mutex::Autolock trackLock(info->mLock);
+    if (info->mSamples.empty()) {
+        return ERROR_END_OF_STREAM;
+    }
+
     auto it = info->mSamples.begin();
     *sampleSize = it->mBuffer->range_length();
 
@@ -726,8 +773,7 @@ status_t NuMediaExtractor::getSampleTrackIndex(size_t *trackIndex) {
         return ERROR_END_OF_STREAM;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
-    *trackIndex = info->mTrackIndex;
+    *trackIndex = mSelectedTracks[minIndex]->mTrackIndex;
 
     return OK;
 }
@@ -741,7 +787,12 @@ status_t NuMediaExtractor::getSampleTime(int64_t *sampleTimeUs) {
         return ERROR_END_OF_STREAM;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    TrackInfo *info = mSelectedTracks.editItemAt(minIndex).get();
+    Mutex::Autolock trackLock(info->mLock);
+    if (info->mSamples.empty()) {
+        return ERROR_END_OF_STREAM;
+    }
+
     *sampleTimeUs = info->mSamples.begin()->mSampleTimeUs;
 
     return OK;
@@ -759,7 +810,129 @@ status_t NuMediaExtractor::getSampleMeta(sp<MetaData> *sampleMeta) {
         return err;
     }
 
-    TrackInfo *info = &mSelectedTracks.editItemAt(minIndex);
+    TrackInfo *info = mSelectedTracks.editItemAt(minIndex).get();
+    Mutex::Autolock trackLock(info->mLock);
+    if (info->mSamples.empty()) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    *sampleMeta = new MetaData(info->mSamples.begin()->mBuffer->meta_data());
+
+    return OK;
+}
+
+sp<NuMediaExtractor::TrackInfo> NuMediaExtractor::findSelectedTrack(size_t trackIndex) const {
+    Mutex::Autolock autoLock(mLock);
+
+    for (size_t i = 0; i < mSelectedTracks.size(); ++i) {
+        if (mSelectedTracks[i]->mTrackIndex == trackIndex) {
+            return mSelectedTracks[i];
+        }
+    }
+    return NULL;
+}
+
+status_t NuMediaExtractor::fetchFirstTrackSample(TrackInfo *info) {
+    fetchTrackSamples(info);
+
+    if (!info->mSamples.empty()) {
+        return OK;
+    }
+
+    status_t err = info->mFinalResult;
+    return (err != OK && err != ERROR_END_OF_STREAM) ? err : ERROR_END_OF_STREAM;
+}
+
+status_t NuMediaExtractor::readTrackSampleData(
+        size_t trackIndex, const sp<ABuffer> &buffer) {
+    sp<TrackInfo> info = findSelectedTrack(trackIndex);
+    if (info == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock trackLock(info->mLock);
+
+    status_t err = fetchFirstTrackSample(info.get());
+    if (err != OK) {
+        return err;
+    }
+
+    return copySampleData(info.get(), buffer);
+}
+
+status_t NuMediaExtractor::advanceTrack(size_t trackIndex) {
+    sp<TrackInfo> info = findSelectedTrack(trackIndex);
+    if (info == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock trackLock(info->mLock);
+
+    status_t err = fetchFirstTrackSample(info.get());
+    if (err != OK) {
+        return err;
+    }
+
+    releaseOneSample(info.get());
+    readAheadTrackSamples(info.get());
+
+    return OK;
+}
+
+status_t NuMediaExtractor::getTrackSampleSize(size_t trackIndex, size_t *sampleSize) {
+    sp<TrackInfo> info = findSelectedTrack(trackIndex);
+    if (info == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock trackLock(info->mLock);
+
+    status_t err = fetchFirstTrackSample(info.get());
+    if (err != OK) {
+        return err;
+    }
+
+    *sampleSize = info->mSamples.begin()->mBuffer->range_length();
+    if (info->mTrackFlags & kIsVorbis) {
+        *sampleSize += sizeof(int32_t);
+    }
+
+    return OK;
+}
+
+status_t NuMediaExtractor::getTrackSampleTime(size_t trackIndex, int64_t *sampleTimeUs) {
+    sp<TrackInfo> info = findSelectedTrack(trackIndex);
+    if (info == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock trackLock(info->mLock);
+
+    status_t err = fetchFirstTrackSample(info.get());
+    if (err != OK) {
+        return err;
+    }
+
+    *sampleTimeUs = info->mSamples.begin()->mSampleTimeUs;
+
+    return OK;
+}
+
+status_t NuMediaExtractor::getTrackSampleMeta(size_t trackIndex, sp<MetaData> *sampleMeta) {
+    *sampleMeta = NULL;
+
+    sp<TrackInfo> info = findSelectedTrack(trackIndex);
+    if (info == NULL) {
+        return -EINVAL;
+    }
+
+    Mutex::Autolock trackLock(info->mLock);
+
+    status_t err = fetchFirstTrackSample(info.get());
+    if (err != OK) {
+        return err;
+    }
+
     *sampleMeta = new MetaData(info->mSamples.begin()->mBuffer->meta_data());
 
     return OK;
@@ -75,14 +75,130 @@ MediaScanResult StagefrightMediaScanner::processFile(
 MediaScanResult StagefrightMediaScanner::processFileInternal(
         const char *path, const char * /* mimeType */,
         MediaScannerClient &client) {
+    sp<ExtractedFile> file = takePrefetchedFile(path);
+    if (file == NULL) {
+        file = extractFile(path);
+    }
+
+    if (file->mResult != MEDIA_SCAN_RESULT_OK) {
+        return file->mResult;
+    }
+
+    status_t status;
+    if (!file->mMimeType.isEmpty()) {
+        status = client.setMimeType(file->mMimeType.string());
+        if (status) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
+    for (size_t i = 0; i < file->mTags.size(); ++i) {
+        const ExtractedFile::Tag &tag = file->mTags[i];
+        status = client.addStringTag(tag.mName, tag.mValue.string());
+        if (status != OK) {
+            return MEDIA_SCAN_RESULT_ERROR;
+        }
+    }
+
+    return MEDIA_SCAN_RESULT_OK;
+}
+
+void StagefrightMediaScanner::prefetchFile(
+        const char *path, long long lastModified, long long fileSize) {
+    const char *extension = strrchr(path, '.');
+    if (!extension || !FileHasAcceptableExtension(extension)) {
+        return;
+    }
+
+    // Keeps prefetched files the client never asked for from piling up.
+    static const size_t kMaxPrefetchedFiles = 64;
+
+    PrefetchKey key = {String8(path), lastModified, fileSize};
+    {
+        Mutex::Autolock autoLock(mPrefetchLock);
+        if (mPrefetchedFiles.indexOfKey(key) >= 0) {
+            return;
+        }
+        if (mPrefetchedFiles.size() >= kMaxPrefetchedFiles) {
+            // evict the oldest file that is not being extracted
+            List<PrefetchKey>::iterator it = mPrefetchOrder.begin();
+            while (it != mPrefetchOrder.end()
+                    && mPrefetchedFiles.valueFor(*it)->mPending) {
+                ++it;
+            }
+            if (it == mPrefetchOrder.end()) {
+                return;
+            }
+            ALOGV("evicting prefetched '%s'", it->mPath.string());
+            mPrefetchedFiles.removeItem(*it);
+            mPrefetchOrder.erase(it);
+        }
+        mPrefetchedFiles.add(key, new ExtractedFile);
+        mPrefetchOrder.push_back(key);
+    }
+
+    sp<ExtractedFile> file = extractFile(path);
+
+    Mutex::Autolock autoLock(mPrefetchLock);
+    file->mPending = false;
+    // pending files are neither evicted nor taken, so the entry is still there
+    mPrefetchedFiles.replaceValueFor(key, file);
+    mPrefetchCondition.broadcast();
+}
+
+void StagefrightMediaScanner::endDirectoryScan() {
+    Mutex::Autolock autoLock(mPrefetchLock);
+    mPrefetchedFiles.clear();
+    mPrefetchOrder.clear();
+}
+
+sp<StagefrightMediaScanner::ExtractedFile> StagefrightMediaScanner::takePrefetchedFile(
+        const char *path) {
+    // only use what was extracted from the file as it is now
+    struct stat statbuf;
+    if (stat(path, &statbuf) != 0) {
+        return NULL;
+    }
+    PrefetchKey key = {String8(path), statbuf.st_mtime, statbuf.st_size};
+    Mutex::Autolock autoLock(mPrefetchLock);
+    ssize_t index;
+    while ((index = mPrefetchedFiles.indexOfKey(key)) >= 0
+            && mPrefetchedFiles.valueAt(index)->mPending) {
+        mPrefetchCondition.wait(mPrefetchLock);
+    }
+    if (index < 0) {
+        return NULL;
+    }
+
+    sp<ExtractedFile> file = mPrefetchedFiles.valueAt(index);
+    mPrefetchedFiles.removeItemsAt(index);
+    for (List<PrefetchKey>::iterator it = mPrefetchOrder.begin();
+            it != mPrefetchOrder.end(); ++it) {
+        if (*it == key) {
+            mPrefetchOrder.erase(it);
+            break;
+        }
+    }
+    ALOGV("using prefetched '%s'", path);
+    return file;
+}
+
+// static
+sp<StagefrightMediaScanner::ExtractedFile> StagefrightMediaScanner::extractFile(
+        const char *path) {
+    sp<ExtractedFile> file = new ExtractedFile;
+    file->mPending = false;
+
     const char *extension = strrchr(path, '.');
 
     if (!extension) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        file->mResult = MEDIA_SCAN_RESULT_SKIPPED;
+        return file;
     }
 
     if (!FileHasAcceptableExtension(extension)) {
-        return MEDIA_SCAN_RESULT_SKIPPED;
+        file->mResult = MEDIA_SCAN_RESULT_SKIPPED;
+        return file;
     }
 
     sp<MediaMetadataRetriever> mRetriever(new MediaMetadataRetriever);
@@ -99,16 +215,14 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
     }
 
     if (status) {
-        return MEDIA_SCAN_RESULT_ERROR;
+        file->mResult = MEDIA_SCAN_RESULT_ERROR;
+        return file;
     }
 
     const char *value;
     if ((value = mRetriever->extractMetadata(
                     METADATA_KEY_MIMETYPE)) != NULL) {
-        status = client.setMimeType(value);
-        if (status) {
-            return MEDIA_SCAN_RESULT_ERROR;
-        }
+        file->mMimeType = value;
     }
 
     struct KeyMap {
@@ -138,14 +252,12 @@ MediaScanResult StagefrightMediaScanner::processFileInternal(
     for (size_t i = 0; i < kNumEntries; ++i) {
         const char *value;
         if ((value = mRetriever->extractMetadata(kKeyMap[i].key)) != NULL) {
-            status = client.addStringTag(kKeyMap[i].tag, value);
-            if (status != OK) {
-                return MEDIA_SCAN_RESULT_ERROR;
-            }
+            ExtractedFile::Tag tag = { kKeyMap[i].tag, String8(value) };
+            file->mTags.push(tag);
         }
     }
 
-    return MEDIA_SCAN_RESULT_OK;
+    return file;
 }
 
 MediaAlbumArt *StagefrightMediaScanner::extractAlbumArt(int fd) {
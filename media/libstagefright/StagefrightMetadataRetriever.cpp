@@ -35,6 +35,7 @@
 #include <media/stagefright/MediaExtractorFactory.h>
 #include <media/stagefright/MetaData.h>
 #include <media/CharacterEncodingDetector.h>
+#include <utils/Thread.h>
 
 namespace android {
 
@@ -148,8 +149,18 @@ sp<IMemory> StagefrightMetadataRetriever::getImageRectAtIndex(
             index, colorFormat, false /*metaOnly*/, false /*thumbnail*/, &rect);
 }
 
+sp<IMemory> StagefrightMetadataRetriever::getScaledImageAtIndex(
+        int index, int colorFormat, int32_t targetSize) {
+    ALOGV("getScaledImageAtIndex: index(%d) colorFormat(%d) targetSize(%d)",
+            index, colorFormat, targetSize);
+
+    return getImageInternal(
+            index, colorFormat, false /*metaOnly*/, false /*thumbnail*/, NULL, targetSize);
+}
+
 sp<IMemory> StagefrightMetadataRetriever::getImageInternal(
-        int index, int colorFormat, bool metaOnly, bool thumbnail, FrameRect* rect) {
+        int index, int colorFormat, bool metaOnly, bool thumbnail, FrameRect* rect,
+        int32_t targetSize) {
 
     if (mExtractor.get() == NULL) {
         ALOGE("no extractor.");
@@ -184,6 +195,17 @@ sp<IMemory> StagefrightMetadataRetriever::getImageInternal(
 
     sp<MetaData> trackMeta = mExtractor->getTrackMetaData(i);
 
+    // Decoding a large enough thumbnail is a lot cheaper than decoding
+    // the full image and scaling it down.
+    int32_t thumbWidth, thumbHeight;
+    if (targetSize > 0 && !thumbnail && rect == NULL
+            && trackMeta->findInt32(kKeyThumbnailWidth, &thumbWidth)
+            && trackMeta->findInt32(kKeyThumbnailHeight, &thumbHeight)
+            && (thumbWidth >= targetSize || thumbHeight >= targetSize)) {
+        ALOGV("using %dx%d thumbnail for target size %d", thumbWidth, thumbHeight, targetSize);
+        thumbnail = true;
+    }
+
     if (metaOnly) {
         return FrameDecoder::getMetadataOnly(trackMeta, colorFormat, thumbnail);
     }
@@ -215,7 +237,8 @@ sp<IMemory> StagefrightMetadataRetriever::getImageInternal(
         const AString &componentName = matchingCodecs[i];
         sp<ImageDecoder> decoder = new ImageDecoder(componentName, trackMeta, source);
         int64_t frameTimeUs = thumbnail ? -1 : 0;
-        if (decoder->init(frameTimeUs, 1 /*numFrames*/, 0 /*option*/, colorFormat) == OK) {
+        if (decoder->init(frameTimeUs, 1 /*numFrames*/, 0 /*option*/, colorFormat,
+                targetSize) == OK) {
             sp<IMemory> frame = decoder->extractFrame(rect);
 
             if (frame != NULL) {
@@ -244,6 +267,18 @@ sp<IMemory> StagefrightMetadataRetriever::getFrameAtTime(
     return (err == OK) ? frame : NULL;
 }
 
+sp<IMemory> StagefrightMetadataRetriever::getScaledFrameAtTime(
+        int64_t timeUs, int option, int colorFormat, int32_t targetSize) {
+    ALOGV("getScaledFrameAtTime: %" PRId64 " us option: %d colorFormat: %d, targetSize: %d",
+            timeUs, option, colorFormat, targetSize);
+
+    sp<IMemory> frame;
+    status_t err = getFrameInternal(
+            timeUs, 1, option, colorFormat, false /*metaOnly*/, &frame,
+            NULL /*outFrames*/, targetSize);
+    return (err == OK) ? frame : NULL;
+}
+
 status_t StagefrightMetadataRetriever::getFrameAtIndex(
         std::vector<sp<IMemory> >* frames,
         int frameIndex, int numFrames, int colorFormat, bool metaOnly) {
@@ -257,7 +292,8 @@ status_t StagefrightMetadataRetriever::getFrameAtIndex(
 
 status_t StagefrightMetadataRetriever::getFrameInternal(
         int64_t timeUs, int numFrames, int option, int colorFormat, bool metaOnly,
-        sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames) {
+        sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames,
+        int32_t targetSize) {
     if (mExtractor.get() == NULL) {
         ALOGE("no extractor.");
         return NO_INIT;
@@ -335,7 +371,7 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
     for (size_t i = 0; i < matchingCodecs.size(); ++i) {
         const AString &componentName = matchingCodecs[i];
         VideoFrameDecoder decoder(componentName, trackMeta, source);
-        if (decoder.init(timeUs, numFrames, option, colorFormat) == OK) {
+        if (decoder.init(timeUs, numFrames, option, colorFormat, targetSize) == OK) {
             if (outFrame != NULL) {
                 *outFrame = decoder.extractFrame();
                 if (*outFrame != NULL) {
@@ -355,6 +391,158 @@ status_t StagefrightMetadataRetriever::getFrameInternal(
     return UNKNOWN_ERROR;
 }
 
+namespace {
+
+// A file opened for batch frame extraction.
+struct BatchSource {
+    sp<DataSource> mSource;
+    sp<IMediaExtractor> mExtractor;
+    sp<MetaData> mTrackMeta;
+    sp<IMediaSource> mTrack;
+};
+
+// Opens |fd| and instantiates the extractor and the first video track.
+// mTrack is left NULL on failure.
+void prepareBatchSource(int fd, BatchSource *out) {
+    off64_t length = lseek64(fd, 0, SEEK_END);
+    if (length < 0) {
+        ALOGE("failed to get size of fd %d", fd);
+        return;
+    }
+    sp<DataSource> source = new FileSource(dup(fd), 0, length);
+    if (source->initCheck() != OK) {
+        return;
+    }
+
+    sp<IMediaExtractor> extractor = MediaExtractorFactory::Create(source);
+    if (extractor == NULL) {
+        ALOGE("Unable to instantiate an extractor for fd %d.", fd);
+        return;
+    }
+
+    sp<MetaData> fileMeta = extractor->getMetaData();
+    int32_t drm = 0;
+    if (fileMeta == NULL
+            || (fileMeta->findInt32(kKeyIsDRM, &drm) && drm != 0)) {
+        ALOGE("frame grab not allowed for fd %d.", fd);
+        return;
+    }
+
+    size_t n = extractor->countTracks();
+    for (size_t i = 0; i < n; ++i) {
+        sp<MetaData> meta = extractor->getTrackMetaData(i);
+
+        const char *mime;
+        CHECK(meta->findCString(kKeyMIMEType, &mime));
+
+        if (!strncasecmp(mime, "video/", 6)) {
+            out->mSource = source;
+            out->mExtractor = extractor;
+            out->mTrackMeta = extractor->getTrackMetaData(
+                    i, MediaExtractor::kIncludeExtensiveMetaData);
+            out->mTrack = extractor->getTrack(i);
+            return;
+        }
+    }
+    ALOGE("no video track found for fd %d.", fd);
+}
+
+// Prepares the next file of a batch while the current one is decoded.
+struct BatchPrefetchThread : public Thread {
+    explicit BatchPrefetchThread(int fd) : Thread(false /* canCallJava */), mFd(fd) {}
+
+    BatchSource mResult;
+
+private:
+    int mFd;
+
+    bool threadLoop() override {
+        prepareBatchSource(mFd, &mResult);
+        return false;
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(BatchPrefetchThread);
+};
+
+}  // namespace
+
+status_t StagefrightMetadataRetriever::getFramesAtTimeBatch(
+        const std::vector<int> &fds, int64_t timeUs, int option, int colorFormat,
+        int32_t targetSize, std::vector<sp<IMemory> > *frames) {
+    ALOGV("getFramesAtTimeBatch: %zu files, %" PRId64 " us option: %d colorFormat: %d "
+            "targetSize: %d", fds.size(), timeUs, option, colorFormat, targetSize);
+
+    frames->clear();
+    if (fds.empty()) {
+        return OK;
+    }
+
+    BatchSource current;
+    prepareBatchSource(fds[0], &current);
+
+    sp<VideoFrameDecoder> decoder;
+    for (size_t k = 0; k < fds.size(); ++k) {
+        sp<BatchPrefetchThread> prefetch;
+        if (k + 1 < fds.size()) {
+            prefetch = new BatchPrefetchThread(fds[k + 1]);
+            if (prefetch->run("FrameBatchPrefetch") != OK) {
+                prefetch.clear();
+            }
+        }
+
+        sp<IMemory> frame;
+        if (current.mTrack != NULL) {
+            if (decoder != NULL && decoder->isCompatible(current.mTrackMeta)
+                    && decoder->reset(current.mTrackMeta, current.mTrack,
+                            timeUs, 1 /* numFrames */, option) == OK) {
+                frame = decoder->extractFrame();
+            }
+
+            if (frame == NULL) {
+                // release the old codec before instantiating a new one
+                decoder.clear();
+
+                const char *mime;
+                CHECK(current.mTrackMeta->findCString(kKeyMIMEType, &mime));
+
+                Vector<AString> matchingCodecs;
+                MediaCodecList::findMatchingCodecs(
+                        mime,
+                        false, /* encoder */
+                        MediaCodecList::kPreferSoftwareCodecs,
+                        &matchingCodecs);
+
+                for (size_t i = 0; i < matchingCodecs.size() && frame == NULL; ++i) {
+                    sp<VideoFrameDecoder> candidate = new VideoFrameDecoder(
+                            matchingCodecs[i], current.mTrackMeta, current.mTrack);
+                    if (candidate->init(timeUs, 1 /* numFrames */, option, colorFormat,
+                            targetSize) == OK) {
+                        frame = candidate->extractFrame();
+                        if (frame != NULL) {
+                            decoder = candidate;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (frame == NULL) {
+            ALOGW("failed to extract frame for file %zu of batch", k);
+        }
+        frames->push_back(frame);
+
+        current = BatchSource();
+        if (prefetch != NULL) {
+            prefetch->join();
+            current = prefetch->mResult;
+        } else if (k + 1 < fds.size()) {
+            prepareBatchSource(fds[k + 1], &current);
+        }
+    }
+
+    return OK;
+}
+
 MediaAlbumArt *StagefrightMetadataRetriever::extractAlbumArt() {
     ALOGV("extractAlbumArt (extractor: %s)", mExtractor.get() != NULL ? "YES" : "NO");
 
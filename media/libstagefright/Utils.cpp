@@ -37,6 +37,7 @@
 #include <media/stagefright/foundation/ALookup.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/ByteUtils.h>
+#include <media/stagefright/foundation/avc_utils.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/AudioSystem.h>
@@ -1103,12 +1104,19 @@ status_t convertMetaDataToMessage(
 }
 
 const uint8_t *findNextNalStartCode(const uint8_t *data, size_t length) {
-    uint8_t *res = NULL;
     if (length > 4) {
-        // minus 1 as to not match NAL start code at end
-        res = (uint8_t *)memmem(data, length - 1, "\x00\x00\x00\x01", 4);
+        // look for 3-byte prefixes preceded by a 0x00 byte, but exclude the last byte so as
+        // to not match NAL start code at end
+        const uint8_t *end = data + length - 1;
+        const uint8_t *ptr = data + 1;
+        while ((ptr = findNextStartCode(ptr, end - ptr)) != end) {
+            if (ptr[-1] == 0x00) {
+                return ptr - 1;
+            }
+            ptr += 3;
+        }
     }
-    return res != NULL && res < data + length - 4 ? res : &data[length];
+    return &data[length];
 }
 
 static size_t reassembleAVCC(const sp<ABuffer> &csd0, const sp<ABuffer> &csd1, char *avcc) {
@@ -25,9 +25,54 @@ namespace android {
 
 static const int64_t kMaxJitterUs = 2000;
 
+// Every kSignatureSampleStep-th pixel of every kSignatureSampleStep-th row
+// goes into a signature.
+static const size_t kSignatureSampleStep = 2;
+
+// Lower bitrates gain more from every frame that is not encoded and could
+// not show very small changes well anyway, so they tolerate more difference
+// and refresh a static picture less often.
+static const struct {
+    int32_t mMinBitrate;
+    uint16_t mTolerance;  // max difference of a cell, in signature units
+    int64_t mMaxStaticIntervalUs;
+} kStaticContentPolicies[] = {
+    { 8000000,  0,  250000 },
+    { 2000000, 16,  500000 },
+    {       0, 64, 1000000 },
+};
+
+template<typename SampleFn>
+static void fillSignature(
+        size_t width, size_t height, uint32_t sampleScale, SampleFn sample,
+        FrameDropper::Signature *signature) {
+    const size_t grid = FrameDropper::kSignatureGrid;
+    for (size_t cy = 0; cy < grid; ++cy) {
+        size_t y0 = cy * height / grid;
+        size_t y1 = (cy + 1) * height / grid;
+        for (size_t cx = 0; cx < grid; ++cx) {
+            size_t x0 = cx * width / grid;
+            size_t x1 = (cx + 1) * width / grid;
+            uint64_t sum = 0;
+            uint64_t count = 0;
+            for (size_t y = y0; y < y1; y += kSignatureSampleStep) {
+                for (size_t x = x0; x < x1; x += kSignatureSampleStep) {
+                    sum += sample(x, y);
+                    ++count;
+                }
+            }
+            signature->mCells[cy * grid + cx] = count == 0 ? 0 :
+                (uint16_t)(sum * FrameDropper::kSignatureScale / (count * sampleScale));
+        }
+    }
+}
+
 FrameDropper::FrameDropper()
     : mDesiredMinTimeUs(-1),
-      mMinIntervalUs(0) {
+      mMinIntervalUs(0),
+      mStaticTolerance(0),
+      mMaxStaticIntervalUs(0),
+      mLastKeptTimeUs(-1) {
 }
 
 FrameDropper::~FrameDropper() {
@@ -74,4 +119,70 @@ bool FrameDropper::shouldDrop(int64_t timeUs) {
     return false;
 }
 
+status_t FrameDropper::setStaticContentPolicy(int32_t targetBitrate) {
+    mLastKeptTimeUs = -1;
+    if (targetBitrate <= 0) {
+        mMaxStaticIntervalUs = 0;
+        return OK;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(kStaticContentPolicies); ++i) {
+        if (targetBitrate >= kStaticContentPolicies[i].mMinBitrate) {
+            mStaticTolerance = kStaticContentPolicies[i].mTolerance;
+            mMaxStaticIntervalUs = kStaticContentPolicies[i].mMaxStaticIntervalUs;
+            break;
+        }
+    }
+    ALOGV("static content policy for %d bps: tolerance %u, max interval %lld us",
+            targetBitrate, mStaticTolerance, (long long)mMaxStaticIntervalUs);
+    return OK;
+}
+
+bool FrameDropper::shouldDropUnchanged(int64_t timeUs, const Signature &signature) {
+    if (mMaxStaticIntervalUs <= 0) {
+        return false;
+    }
+
+    // Compare against the last kept frame rather than the last one seen, so
+    // that slow changes add up and eventually get through.
+    if (mLastKeptTimeUs >= 0 && timeUs >= mLastKeptTimeUs
+            && timeUs - mLastKeptTimeUs < mMaxStaticIntervalUs) {
+        bool unchanged = true;
+        for (size_t i = 0; i < ARRAY_SIZE(signature.mCells) && unchanged; ++i) {
+            int diff = (int)signature.mCells[i] - (int)mLastKeptSignature.mCells[i];
+            unchanged = (diff <= mStaticTolerance && -diff <= mStaticTolerance);
+        }
+        if (unchanged) {
+            ALOGV("drop unchanged frame %lld, last kept frame %lld",
+                    (long long)timeUs, (long long)mLastKeptTimeUs);
+            return true;
+        }
+    }
+
+    mLastKeptTimeUs = timeUs;
+    mLastKeptSignature = signature;
+    return false;
+}
+
+// static
+void FrameDropper::ComputeLumaSignature(
+        const uint8_t *luma, size_t width, size_t height, size_t stride,
+        Signature *signature) {
+    fillSignature(width, height, 1 /* sampleScale */,
+            [luma, stride](size_t x, size_t y) -> uint32_t {
+                return luma[y * stride + x];
+            }, signature);
+}
+
+// static
+void FrameDropper::ComputeRgbaSignature(
+        const uint8_t *rgba, size_t width, size_t height, size_t stride,
+        Signature *signature) {
+    fillSignature(width, height, 4 /* sampleScale */,
+            [rgba, stride](size_t x, size_t y) -> uint32_t {
+                const uint8_t *p = rgba + y * stride + x * 4;
+                return p[0] + 2 * p[1] + p[2];
+            }, signature);
+}
+
 }  // namespace android
@@ -22,6 +22,8 @@
 
 #define STRINGIFY_ENUMS // for asString in HardwareAPI.h/VideoAPI.h
 
+#include <cutils/properties.h>
+
 #include <media/stagefright/bqhelper/GraphicBufferSource.h>
 #include <media/stagefright/bqhelper/FrameDropper.h>
 #include <media/stagefright/foundation/ADebug.h>
@@ -294,6 +296,8 @@ GraphicBufferSource::GraphicBufferSource() :
     mStopTimeUs(-1),
     mLastActionTimeUs(-1ll),
     mSkipFramesBeforeNs(-1ll),
+    mConsumerUsage(0),
+    mTargetBitrate(0),
     mFrameRepeatIntervalUs(-1ll),
     mRepeatLastFrameGeneration(0),
     mOutstandingFrameRepeatCount(0),
@@ -666,6 +670,11 @@ bool GraphicBufferSource::fillCodecBuffer_l() {
             ALOGV("skipping frame (%lld) to meet max framerate", static_cast<long long>(timeUs));
             // set err to OK so that the skipped frame can still be saved as the lastest frame
             err = OK;
+        } else if (mStaticContentDropper != NULL && isUnchanged_l(item, timeUs)) {
+            ALOGV("skipping unchanged frame (%lld)", static_cast<long long>(timeUs));
+            // The last submitted frame stands in for this one, and stays the
+            // one that gets repeated.
+            return true;
         } else {
             err = submitBuffer_l(item); // this takes shared ownership of the acquired buffer on succeess
         }
@@ -1107,6 +1116,7 @@ status_t GraphicBufferSource::configure(
 
         consumerUsage |= GRALLOC_USAGE_HW_VIDEO_ENCODER;
         mConsumer->setConsumerUsageBits(consumerUsage);
+        mConsumerUsage = consumerUsage;
 
         // Sets the default buffer data space
         ALOGD("setting dataspace: %#x, acquired=%d", dataSpace, mNumOutstandingAcquires);
@@ -1119,6 +1129,8 @@ status_t GraphicBufferSource::configure(
         mEndOfStreamSent = false;
         mSkipFramesBeforeNs = -1ll;
         mFrameDropper.clear();
+        mTargetBitrate = 0;
+        mStaticContentDropper.clear();
         mFrameRepeatIntervalUs = -1ll;
         mRepeatLastFrameGeneration = 0;
         mOutstandingFrameRepeatCount = 0;
@@ -1200,6 +1212,7 @@ status_t GraphicBufferSource::setRepeatPreviousFrameDelayUs(int64_t repeatAfterU
     }
 
     mFrameRepeatIntervalUs = repeatAfterUs;
+    updateStaticContentDropper_l();
     return OK;
 }
 
@@ -1234,6 +1247,99 @@ status_t GraphicBufferSource::setMaxFps(float maxFps) {
     return OK;
 }
 
+status_t GraphicBufferSource::setTargetBitrate(int32_t bitrate) {
+    ALOGV("setTargetBitrate: bitrate=%d", bitrate);
+
+    Mutex::Autolock autoLock(mMutex);
+
+    if (mExecuting) {
+        return INVALID_OPERATION;
+    }
+
+    mTargetBitrate = bitrate;
+    updateStaticContentDropper_l();
+    return OK;
+}
+
+void GraphicBufferSource::updateStaticContentDropper_l() {
+    // Camera input practically never repeats itself; only pay for the
+    // signatures when the client expects static content and the device
+    // opted in, as CPU readable buffers may cost the producer.
+    if (mFrameRepeatIntervalUs <= 0ll || mTargetBitrate <= 0
+            || !property_get_bool("media.stagefright.drop-unchanged-frames", false)) {
+        if (mStaticContentDropper != NULL) {
+            mStaticContentDropper.clear();
+            mConsumer->setConsumerUsageBits(mConsumerUsage);
+        }
+        return;
+    }
+
+    mStaticContentDropper = new FrameDropper();
+    mStaticContentDropper->setStaticContentPolicy(mTargetBitrate);
+
+    // signatures are computed on the CPU
+    mConsumer->setConsumerUsageBits(mConsumerUsage | GRALLOC_USAGE_SW_READ_OFTEN);
+}
+
+// Returns false if |buffer| cannot be read yet or in its format.
+static bool computeSignature(
+        const sp<GraphicBuffer> &buffer, int fenceFd, FrameDropper::Signature *signature) {
+    // The producer may still be rendering into the buffer. Do not wait for it
+    // while holding mMutex; such a frame is just submitted.
+    if (fenceFd >= 0) {
+        sp<Fence> fence = new Fence(fenceFd);
+        if (fence->wait(0) != OK) {
+            return false;
+        }
+    }
+
+    switch (buffer->getPixelFormat()) {
+        case HAL_PIXEL_FORMAT_RGBA_8888:
+        case HAL_PIXEL_FORMAT_RGBX_8888:
+        case HAL_PIXEL_FORMAT_BGRA_8888:
+        {
+            void *data;
+            if (buffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, &data) != OK) {
+                return false;
+            }
+            FrameDropper::ComputeRgbaSignature(
+                    (const uint8_t *)data, buffer->getWidth(), buffer->getHeight(),
+                    buffer->getStride() * 4, signature);
+            buffer->unlock();
+            return true;
+        }
+
+        default:
+        {
+            // Try all other formats as YUV; this fails for anything that
+            // cannot be described as such.
+            android_ycbcr ycbcr;
+            if (buffer->lockYCbCr(GRALLOC_USAGE_SW_READ_OFTEN, &ycbcr) != OK) {
+                return false;
+            }
+            FrameDropper::ComputeLumaSignature(
+                    (const uint8_t *)ycbcr.y, buffer->getWidth(), buffer->getHeight(),
+                    ycbcr.ystride, signature);
+            buffer->unlock();
+            return true;
+        }
+    }
+}
+
+bool GraphicBufferSource::isUnchanged_l(const VideoBuffer &item, int64_t timeUs) {
+    sp<GraphicBuffer> buffer = item.mBuffer->getGraphicBuffer();
+    FrameDropper::Signature signature;
+    if (buffer == NULL
+            || !computeSignature(buffer, item.mBuffer->getAcquireFenceFd(), &signature)) {
+        // The frame gets submitted unseen, so the next one must not be
+        // compared against what was submitted before it.
+        mStaticContentDropper->forgetLastKept();
+        return false;
+    }
+
+    return mStaticContentDropper->shouldDropUnchanged(timeUs, signature);
+}
+
 status_t GraphicBufferSource::setStartTimeUs(int64_t skipFramesBeforeUs) {
     ALOGV("setStartTimeUs: skipFramesBeforeUs=%lld", (long long)skipFramesBeforeUs);
 
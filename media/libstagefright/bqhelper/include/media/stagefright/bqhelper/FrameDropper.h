@@ -26,6 +26,18 @@
 namespace android {
 
 struct FrameDropper : public RefBase {
+    enum {
+        // A frame signature holds kSignatureGrid x kSignatureGrid cells.
+        kSignatureGrid = 16,
+        // Cells hold the mean luma of the cell in 1/kSignatureScale steps.
+        kSignatureScale = 64,
+    };
+
+    // Downsampled luma of a frame, used to tell whether its content changed.
+    struct Signature {
+        uint16_t mCells[kSignatureGrid * kSignatureGrid];
+    };
+
     // No frames will be dropped until a valid max frame rate is set.
     FrameDropper();
 
@@ -38,6 +50,30 @@ struct FrameDropper : public RefBase {
     // Returns true if all frame drop logic should be disabled.
     bool disabled() { return (mMinIntervalUs == -1ll); }
 
+    // Enables dropping of frames whose content did not change since the last
+    // frame that was kept. How much difference is tolerated, and how long a
+    // static picture may go without a new frame, depend on targetBitrate.
+    // A non-positive targetBitrate disables it.
+    status_t setStaticContentPolicy(int32_t targetBitrate);
+
+    // Returns false if no static content policy has been set.
+    bool shouldDropUnchanged(int64_t timeUs, const Signature &signature);
+
+    // Called when a frame is kept without its signature; the next frame is
+    // then kept as well.
+    void forgetLastKept() { mLastKeptTimeUs = -1ll; }
+
+    // Compute the signature of an 8-bit luma plane.
+    static void ComputeLumaSignature(
+            const uint8_t *luma, size_t width, size_t height, size_t stride,
+            Signature *signature);
+
+    // Compute the signature of a packed 32-bit RGBA/RGBX/BGRA image, using
+    // (R + 2G + B) / 4 as luma.
+    static void ComputeRgbaSignature(
+            const uint8_t *rgba, size_t width, size_t height, size_t stride,
+            Signature *signature);
+
 protected:
     virtual ~FrameDropper();
 
@@ -45,6 +81,11 @@ private:
     int64_t mDesiredMinTimeUs;
     int64_t mMinIntervalUs;
 
+    uint16_t mStaticTolerance;
+    int64_t mMaxStaticIntervalUs;
+    int64_t mLastKeptTimeUs;
+    Signature mLastKeptSignature;
+
     DISALLOW_EVIL_CONSTRUCTORS(FrameDropper);
 };
 
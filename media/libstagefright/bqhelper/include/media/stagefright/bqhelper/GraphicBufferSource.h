@@ -166,6 +166,14 @@ public:
      */
     status_t setMaxFps(float maxFps);
 
+    // Sets the target bitrate of the encoder. When frame repeating is also
+    // enabled (which is how screen-like sources declare themselves), frames
+    // whose content did not change since the last submitted frame are not
+    // submitted at all; the previous frame simply lasts longer. How similar
+    // a frame has to be is picked according to the bitrate. This stays off
+    // unless the media.stagefright.drop-unchanged-frames property is set.
+    status_t setTargetBitrate(int32_t bitrate);
+
     // Sets the time lapse (or slow motion) parameters.
     // When set, the sample's timestamp will be modified to playback framerate,
     // and capture timestamp will be modified to capture rate.
@@ -398,6 +406,22 @@ private:
 
     sp<FrameDropper> mFrameDropper;
 
+    // Static content dropping
+    // -----------------------
+    // consumer usage requested in configure()
+    uint32_t mConsumerUsage;
+
+    // configuration parameter: encoder target bitrate (<= 0 if unknown)
+    int32_t mTargetBitrate;
+
+    // non-NULL while unchanged frames are dropped
+    sp<FrameDropper> mStaticContentDropper;
+
+    void updateStaticContentDropper_l();
+
+    // Returns true if |item| looks the same as the last submitted frame.
+    bool isUnchanged_l(const VideoBuffer &item, int64_t timeUs);
+
     sp<ALooper> mLooper;
     sp<AHandlerReflector<GraphicBufferSource> > mReflector;
 
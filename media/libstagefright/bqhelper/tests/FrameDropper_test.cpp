@@ -20,6 +20,8 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include <media/stagefright/bqhelper/FrameDropper.h>
 #include <media/stagefright/foundation/ADebug.h>
 
@@ -134,4 +136,76 @@ TEST_F(FrameDropperTest, TestVariableFps) {
     RunTest(testFramesVariableFps, ARRAY_SIZE(testFramesVariableFps));
 }
 
+TEST_F(FrameDropperTest, TestStaticContentDisabled) {
+    FrameDropper::Signature signature;
+    memset(&signature, 0, sizeof(signature));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1000000, signature));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1033333, signature));
+
+    EXPECT_EQ(OK, mFrameDropper->setStaticContentPolicy(0));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1066667, signature));
+}
+
+TEST_F(FrameDropperTest, TestStaticContent) {
+    static const size_t kWidth = 320;
+    static const size_t kHeight = 240;
+    std::vector<uint8_t> luma(kWidth * kHeight, 0x80);
+
+    FrameDropper::Signature still, brighter, cursor;
+    FrameDropper::ComputeLumaSignature(luma.data(), kWidth, kHeight, kWidth, &still);
+    // a barely visible brightness change over the whole picture
+    std::vector<uint8_t> brighterLuma(kWidth * kHeight, 0x81);
+    FrameDropper::ComputeLumaSignature(
+            brighterLuma.data(), kWidth, kHeight, kWidth, &brighter);
+    // a small 2x2 change, as from a text cursor
+    for (size_t y = 100; y < 102; ++y) {
+        for (size_t x = 150; x < 152; ++x) {
+            luma[y * kWidth + x] = 0xff;
+        }
+    }
+    FrameDropper::ComputeLumaSignature(luma.data(), kWidth, kHeight, kWidth, &cursor);
+
+    // high bitrate: any change is kept, a static picture is refreshed every 250ms
+    EXPECT_EQ(OK, mFrameDropper->setStaticContentPolicy(10000000));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1000000, still));
+    EXPECT_TRUE(mFrameDropper->shouldDropUnchanged(1033333, still));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1066667, brighter));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1100000, cursor));
+    EXPECT_TRUE(mFrameDropper->shouldDropUnchanged(1133333, cursor));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1350000, cursor));
+
+    // low bitrate: small differences are tolerated for up to a second
+    EXPECT_EQ(OK, mFrameDropper->setStaticContentPolicy(500000));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(2000000, still));
+    EXPECT_TRUE(mFrameDropper->shouldDropUnchanged(2033333, brighter));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(2066667, cursor));
+    EXPECT_TRUE(mFrameDropper->shouldDropUnchanged(3000000, cursor));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(3066667, cursor));
+}
+
+TEST_F(FrameDropperTest, TestStaticContentForgetLastKept) {
+    FrameDropper::Signature signature;
+    memset(&signature, 0, sizeof(signature));
+    EXPECT_EQ(OK, mFrameDropper->setStaticContentPolicy(10000000));
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1000000, signature));
+    EXPECT_TRUE(mFrameDropper->shouldDropUnchanged(1033333, signature));
+    // a frame kept unseen may have been anything, so the next one is kept
+    mFrameDropper->forgetLastKept();
+    EXPECT_FALSE(mFrameDropper->shouldDropUnchanged(1100000, signature));
+    EXPECT_TRUE(mFrameDropper->shouldDropUnchanged(1133333, signature));
+}
+
+TEST_F(FrameDropperTest, TestRgbaSignature) {
+    static const size_t kWidth = 64;
+    static const size_t kHeight = 48;
+    static const size_t kStride = 80 * 4;
+    std::vector<uint8_t> rgba(kStride * kHeight, 0x10);
+
+    FrameDropper::Signature signature;
+    FrameDropper::ComputeRgbaSignature(rgba.data(), kWidth, kHeight, kStride, &signature);
+    for (size_t i = 0; i < ARRAY_SIZE(signature.mCells); ++i) {
+        EXPECT_EQ(0x10 * FrameDropper::kSignatureScale, signature.mCells[i]);
+    }
+}
+
 } // namespace android
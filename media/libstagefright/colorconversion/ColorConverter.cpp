@@ -26,8 +26,10 @@
 #include "libyuv/convert_from.h"
 #include "libyuv/convert_argb.h"
 #include "libyuv/planar_functions.h"
+#include "libyuv/scale.h"
 #include "libyuv/video_common.h"
 #include <functional>
+#include <memory>
 #include <sys/time.h>
 
 #define USE_LIBYUV
@@ -94,6 +96,14 @@ bool ColorConverter::isDstRGB() const {
             || mDstFormat == OMX_COLOR_Format32bitBGRA8888;
 }
 
+bool ColorConverter::isScalingSupported() const {
+#ifdef USE_LIBYUV
+    return mSrcFormat == OMX_COLOR_FormatYUV420Planar && isValid();
+#else
+    return false;
+#endif
+}
+
 ColorConverter::BitmapParams::BitmapParams(
         void *bits,
         size_t width, size_t height,
@@ -170,12 +180,20 @@ status_t ColorConverter::convert(
             dstWidth, dstHeight,
             dstCropLeft, dstCropTop, dstCropRight, dstCropBottom, mDstFormat);
 
-    if (!((src.mCropLeft & 1) == 0
-        && src.cropWidth() == dst.cropWidth()
-        && src.cropHeight() == dst.cropHeight())) {
+    if ((src.mCropLeft & 1) != 0) {
         return ERROR_UNSUPPORTED;
     }
 
+    if (src.cropWidth() != dst.cropWidth()
+            || src.cropHeight() != dst.cropHeight()) {
+        if (!isScalingSupported()
+                || dst.cropWidth() > src.cropWidth()
+                || dst.cropHeight() > src.cropHeight()) {
+            return ERROR_UNSUPPORTED;
+        }
+        return convertYUV420PlanarScaledUseLibYUV(src, dst);
+    }
+
     status_t err;
 
     switch (mSrcFormat) {
@@ -326,6 +344,49 @@ status_t ColorConverter::convertYUV420PlanarUseLibYUV(
     return OK;
 }
 
+status_t ColorConverter::convertYUV420PlanarScaledUseLibYUV(
+        const BitmapParams &src, const BitmapParams &dst) {
+    // Box-filter the source crop down to the destination size first, so
+    // that only a destination-sized YUV image is ever converted to RGB.
+    size_t dstWidth = dst.cropWidth();
+    size_t dstHeight = dst.cropHeight();
+    size_t scaledWidth = (dstWidth + 1) & ~1;
+    size_t scaledHeight = (dstHeight + 1) & ~1;
+    size_t lumaSize = scaledWidth * scaledHeight;
+    std::unique_ptr<uint8_t[]> scaled(new (std::nothrow) uint8_t[lumaSize * 3 / 2]);
+    if (scaled == NULL) {
+        return NO_MEMORY;
+    }
+
+    const uint8_t *src_y =
+        (const uint8_t *)src.mBits + src.mCropTop * src.mStride + src.mCropLeft;
+
+    const uint8_t *src_u =
+        (const uint8_t *)src.mBits + src.mStride * src.mHeight
+        + (src.mCropTop / 2) * (src.mStride / 2) + (src.mCropLeft / 2);
+
+    const uint8_t *src_v =
+        src_u + (src.mStride / 2) * (src.mHeight / 2);
+
+    uint8_t *scaled_y = scaled.get();
+    uint8_t *scaled_u = scaled_y + lumaSize;
+    uint8_t *scaled_v = scaled_u + lumaSize / 4;
+
+    if (libyuv::I420Scale(
+            src_y, src.mStride, src_u, src.mStride / 2, src_v, src.mStride / 2,
+            src.cropWidth(), src.cropHeight(),
+            scaled_y, scaledWidth, scaled_u, scaledWidth / 2, scaled_v, scaledWidth / 2,
+            dstWidth, dstHeight, libyuv::kFilterBox) != 0) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    BitmapParams scaledSrc(
+            scaled.get(), scaledWidth, scaledHeight,
+            0, 0, dstWidth - 1, dstHeight - 1, OMX_COLOR_FormatYUV420Planar);
+
+    return convertYUV420PlanarUseLibYUV(scaledSrc, dst);
+}
+
 status_t ColorConverter::convertYUV420SemiPlanarUseLibYUV(
         const BitmapParams &src, const BitmapParams &dst) {
     uint8_t *dst_ptr = (uint8_t *)dst.mBits
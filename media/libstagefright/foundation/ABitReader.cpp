@@ -16,10 +16,29 @@
 
 #include "ABitReader.h"
 
+#include <string.h>
+
 #include <media/stagefright/foundation/ADebug.h>
 
 namespace android {
 
+// Loads 8 bytes from a possibly unaligned address as a big-endian value, so that the first byte
+// ends up in the most significant bits.
+static inline uint64_t loadBE64(const uint8_t *data) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// Returns true iff any of the bytes of |x| is 0.
+__attribute__((no_sanitize("integer")))
+static inline bool hasZeroByte(uint64_t x) {
+    return ((x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull) != 0;
+}
+
 ABitReader::ABitReader(const uint8_t *data, size_t size)
     : mData(data),
       mSize(size),
@@ -31,23 +50,36 @@ ABitReader::ABitReader(const uint8_t *data, size_t size)
 ABitReader::~ABitReader() {
 }
 
+void ABitReader::appendBytes(uint64_t bytes, size_t numBytes) {
+    // |bytes| holds |numBytes| bytes in its most significant bits and zeros below
+    mReservoir |= bytes >> mNumBitsLeft;
+    mNumBitsLeft += 8 * numBytes;
+}
+
 bool ABitReader::fillReservoir() {
     if (mSize == 0) {
         mOverRead = true;
         return false;
     }
 
-    mReservoir = 0;
-    size_t i;
-    for (i = 0; mSize > 0 && i < 4; ++i) {
-        mReservoir = (mReservoir << 8) | *mData;
-
-        ++mData;
-        --mSize;
+    size_t numBytes = (64 - mNumBitsLeft) / 8;
+    if (mSize >= sizeof(uint64_t)) {
+        uint64_t bytes = loadBE64(mData);
+        if (numBytes < sizeof(uint64_t)) {
+            bytes &= ~0ull << (64 - 8 * numBytes);
+        }
+        appendBytes(bytes, numBytes);
+    } else {
+        if (numBytes > mSize) {
+            numBytes = mSize;
+        }
+        for (size_t i = 0; i < numBytes; ++i) {
+            appendBytes((uint64_t)mData[i] << 56, 1);
+        }
     }
 
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
+    mData += numBytes;
+    mSize -= numBytes;
     return true;
 }
 
@@ -68,31 +100,37 @@ bool ABitReader::getBitsGraceful(size_t n, uint32_t *out) {
         return false;
     }
 
-    uint32_t result = 0;
-    while (n > 0) {
-        if (mNumBitsLeft == 0) {
-            if (!fillReservoir()) {
-                return false;
-            }
-        }
-
-        size_t m = n;
-        if (m > mNumBitsLeft) {
-            m = mNumBitsLeft;
+    while (n > mNumBitsLeft) {
+        if (!fillReservoir()) {
+            // the bits that were left are consumed by the failed read
+            mReservoir = 0;
+            mNumBitsLeft = 0;
+            return false;
         }
+    }
 
-        result = (result << m) | (mReservoir >> (32 - m));
-        mReservoir <<= m;
-        mNumBitsLeft -= m;
-
-        n -= m;
+    if (n == 0) {
+        *out = 0;
+        return true;
     }
 
-    *out = result;
+    *out = (uint32_t)(mReservoir >> (64 - n));
+    mReservoir <<= n;
+    mNumBitsLeft -= n;
     return true;
 }
 
 bool ABitReader::skipBits(size_t n) {
+    if (n < mNumBitsLeft) {
+        mReservoir <<= n;
+        mNumBitsLeft -= n;
+        return true;
+    }
+
+    n -= mNumBitsLeft;
+    mReservoir = 0;
+    mNumBitsLeft = 0;
+
     uint32_t dummy;
     while (n > 32) {
         if (!getBitsGraceful(32, &dummy)) {
@@ -107,21 +145,48 @@ bool ABitReader::skipBits(size_t n) {
     return true;
 }
 
+bool ABitReader::getBufferedUE(unsigned *out) {
+    if (mNumBitsLeft <= 56 && mSize > 0) {
+        fillReservoir();
+    }
+    if (mReservoir == 0) {
+        return false;
+    }
+
+    // the code is |numZeroes| zero bits, a one bit and |numZeroes| bits of value
+    size_t numZeroes = __builtin_clzll(mReservoir);
+    size_t numBits = 2 * numZeroes + 1;
+    if (numZeroes >= 32 || numBits > mNumBitsLeft) {
+        return false;
+    }
+
+    *out = (unsigned)(mReservoir >> (64 - numBits)) - 1;
+    mReservoir = numBits < 64 ? mReservoir << numBits : 0;
+    mNumBitsLeft -= numBits;
+    return true;
+}
+
 void ABitReader::putBits(uint32_t x, size_t n) {
     if (mOverRead) {
         return;
     }
 
     CHECK_LE(n, 32u);
+    if (n == 0) {
+        return;
+    }
 
-    while (mNumBitsLeft + n > 32) {
+    while (mNumBitsLeft + n > 64) {
         mNumBitsLeft -= 8;
         --mData;
         ++mSize;
     }
 
-    mReservoir = (mReservoir >> n) | (x << (32 - n));
+    mReservoir = (mReservoir >> n) | ((uint64_t)x << (64 - n));
     mNumBitsLeft += n;
+    if (mNumBitsLeft < 64) {
+        mReservoir &= ~0ull << (64 - mNumBitsLeft);
+    }
 }
 
 size_t ABitReader::numBitsLeft() const {
@@ -134,7 +199,32 @@ const uint8_t *ABitReader::data() const {
 
 NALBitReader::NALBitReader(const uint8_t *data, size_t size)
     : ABitReader(data, size),
-      mNumZeros(0) {
+      mNumZeros(0),
+      mNumSkippedBytes(0) {
+}
+
+size_t NALBitReader::numSkippedBytesBuffered() const {
+    // Walk back from the end of the buffered bytes: each skipped byte found among them moves
+    // their first raw byte back by one.
+    const uint8_t *start = ABitReader::data();
+    size_t numSkipped = 0;
+    while (numSkipped < mNumSkippedBytes && numSkipped < kMaxSkippedBytes) {
+        const uint8_t *skipped =
+                mSkippedBytes[(mNumSkippedBytes - 1 - numSkipped) % kMaxSkippedBytes];
+        if (skipped < start - numSkipped) {
+            break;
+        }
+        ++numSkipped;
+    }
+    return numSkipped;
+}
+
+size_t NALBitReader::numBitsLeft() const {
+    return ABitReader::numBitsLeft() + 8 * numSkippedBytesBuffered();
+}
+
+const uint8_t *NALBitReader::data() const {
+    return ABitReader::data() - numSkippedBytesBuffered();
 }
 
 bool NALBitReader::atLeastNumBitsLeft(size_t n) const {
@@ -175,9 +265,31 @@ bool NALBitReader::fillReservoir() {
         return false;
     }
 
-    mReservoir = 0;
+    size_t numBytes = (64 - mNumBitsLeft) / 8;
+    if (mSize >= sizeof(uint64_t)) {
+        // Without a 0x03 byte there is no emulation_prevention_three_byte to strip, so the
+        // next |numBytes| bytes are taken as they are.
+        uint64_t bytes = loadBE64(mData);
+        if (numBytes < sizeof(uint64_t)) {
+            bytes &= ~0ull << (64 - 8 * numBytes);
+        }
+        uint64_t value = bytes >> (64 - 8 * numBytes);
+        // the bytes outside of |value| are 0x00, which never match
+        if (!hasZeroByte(value ^ 0x0303030303030303ull)) {
+            appendBytes(bytes, numBytes);
+            if (value == 0) {
+                mNumZeros += numBytes;
+            } else {
+                mNumZeros = __builtin_ctzll(value) / 8;
+            }
+            mData += numBytes;
+            mSize -= numBytes;
+            return true;
+        }
+    }
+
     size_t i = 0;
-    while (mSize > 0 && i < 4) {
+    while (mSize > 0 && i < numBytes) {
         bool isEmulationPreventionByte = (mNumZeros >= 2 && *mData == 3);
 
         if (*mData == 0) {
@@ -188,16 +300,16 @@ bool NALBitReader::fillReservoir() {
 
         // skip emulation_prevention_three_byte
         if (!isEmulationPreventionByte) {
-            mReservoir = (mReservoir << 8) | *mData;
+            appendBytes((uint64_t)*mData << 56, 1);
             ++i;
+        } else {
+            mSkippedBytes[mNumSkippedBytes++ % kMaxSkippedBytes] = mData;
         }
 
         ++mData;
         --mSize;
     }
 
-    mNumBitsLeft = 8 * i;
-    mReservoir <<= 32 - mNumBitsLeft;
     return true;
 }
 
@@ -28,9 +28,22 @@
 #include <media/stagefright/MetaData.h>
 #include <utils/misc.h>
 
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 unsigned parseUE(ABitReader *br) {
+    unsigned value;
+    if (br->getBufferedUE(&value)) {
+        return value;
+    }
+
     unsigned numZeroes = 0;
     while (br->getBits(1) == 0) {
         ++numZeroes;
@@ -42,6 +55,11 @@ unsigned parseUE(ABitReader *br) {
 }
 
 unsigned parseUEWithFallback(ABitReader *br, unsigned fallback) {
+    unsigned value;
+    if (br->getBufferedUE(&value)) {
+        return value;
+    }
+
     unsigned numZeroes = 0;
     while (br->getBitsWithFallback(1, 1) == 0) {
         ++numZeroes;
@@ -275,6 +293,68 @@ void FindAVCDimensions(
     }
 }
 
+const uint8_t *findNextStartCode(const uint8_t *data, size_t size) {
+    const uint8_t *end = data + size;
+    const uint8_t *ptr = data;
+
+    // Each step rules out a block of candidate positions at once, reading 2 bytes past
+    // them for the rest of a start code that begins at the last position.
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    while (end - ptr >= 18) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)ptr);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(ptr + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *)(ptr + 2));
+        __m128i match = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                _mm_cmpeq_epi8(b2, one));
+        int mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+            return ptr + __builtin_ctz(mask);
+        }
+        ptr += 16;
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    while (end - ptr >= 18) {
+        uint8x16_t match = vandq_u8(
+                vandq_u8(vceqq_u8(vld1q_u8(ptr), zero), vceqq_u8(vld1q_u8(ptr + 1), zero)),
+                vceqq_u8(vld1q_u8(ptr + 2), one));
+        uint64x2_t match64 = vreinterpretq_u64_u8(match);
+        if ((vgetq_lane_u64(match64, 0) | vgetq_lane_u64(match64, 1)) != 0) {
+            break;  // the scalar loop below locates it within the next 16 bytes
+        }
+        ptr += 16;
+    }
+#else
+    // A start code beginning in the next 8 bytes needs a zero byte among them. A byte
+    // is non-zero iff its top bit or the carry of adding 0x7f to its low 7 bits is
+    // set; the additions cannot carry into the next byte or wrap around.
+    const uint64_t kLow7 = 0x7f7f7f7f7f7f7f7full;
+    while (end - ptr >= 10) {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
+        if ((((word & kLow7) + kLow7) | word | kLow7) != ~0ull) {
+            for (const uint8_t *candidate = ptr; candidate < ptr + 8; ++candidate) {
+                if (candidate[2] == 0x01 && candidate[0] == 0x00 && candidate[1] == 0x00) {
+                    return candidate;
+                }
+            }
+        }
+        ptr += 8;
+    }
+#endif
+
+    for (; end - ptr >= 3; ++ptr) {
+        if (ptr[2] == 0x01 && ptr[0] == 0x00 && ptr[1] == 0x00) {
+            return ptr;
+        }
+    }
+    return end;
+}
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
@@ -289,17 +369,10 @@ status_t getNextNALUnit(
         return -EAGAIN;
     }
 
-    size_t offset = 0;
-
     // A valid startcode consists of at least two 0x00 bytes followed by 0x01.
-    for (; offset + 2 < size; ++offset) {
-        if (data[offset + 2] == 0x01 && data[offset] == 0x00
-                && data[offset + 1] == 0x00) {
-            break;
-        }
-    }
-    if (offset + 2 >= size) {
-        *_data = &data[offset];
+    size_t offset = findNextStartCode(data, size) - data;
+    if (offset == size) {
+        *_data = &data[size - 2];
         *_size = 2;
         return -EAGAIN;
     }
@@ -307,25 +380,15 @@ status_t getNextNALUnit(
 
     size_t startOffset = offset;
 
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
-
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
-
+    // |offset| is set to the position of the 0x01 byte of the next startcode.
+    offset = findNextStartCode(&data[startOffset], size - startOffset) - data;
+    if (offset == size) {
+        if (!startCodeFollows) {
             return -EAGAIN;
         }
-
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+        offset = size + 2;
+    } else {
+        offset += 2;
     }
 
     size_t endOffset = offset - 2;
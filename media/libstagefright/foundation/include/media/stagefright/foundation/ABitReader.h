@@ -51,9 +51,15 @@ public:
     // store at most 32 bits. This is a no-op if the stream has already been over-read.
     void putBits(uint32_t x, size_t n);
 
-    size_t numBitsLeft() const;
+    // Tries to get an unsigned exp-golomb (ue) value with fewer than 32 leading zero bits using
+    // a single count-leading-zeros on the buffered bits. Returns false without consuming any
+    // bits if the value is longer, or not entirely available; use parseUE() in avc_utils.h,
+    // which falls back to reading bit by bit in that case.
+    bool getBufferedUE(unsigned *out);
 
-    const uint8_t *data() const;
+    virtual size_t numBitsLeft() const;
+
+    virtual const uint8_t *data() const;
 
     // Returns true iff the stream was over-read (e.g. any getBits operation has been unsuccessful
     // due to overread (and not trying to read >32 bits).)
@@ -63,12 +69,18 @@ protected:
     const uint8_t *mData;
     size_t mSize;
 
-    uint32_t mReservoir;  // left-aligned bits
+    uint64_t mReservoir;  // left-aligned bits, zero below the mNumBitsLeft valid ones
     size_t mNumBitsLeft;
     bool mOverRead;
 
+    // Adds whole bytes to the reservoir until it cannot hold another one, or the data is
+    // exhausted. Returns false and marks the stream over-read if there is no data left.
     virtual bool fillReservoir();
 
+    // Adds the |numBytes| most significant bytes of |bytes| to the reservoir. The rest of
+    // |bytes| must be zero.
+    void appendBytes(uint64_t bytes, size_t numBytes);
+
     DISALLOW_EVIL_CONSTRUCTORS(ABitReader);
 };
 
@@ -78,11 +90,29 @@ public:
 
     bool atLeastNumBitsLeft(size_t n) const;
 
+    // These count the raw bytes, including the emulation_prevention_three_bytes stripped from
+    // the buffered bits, so data() points at the raw byte holding the next bit to read.
+    virtual size_t numBitsLeft() const;
+
+    virtual const uint8_t *data() const;
+
 private:
+    // The buffered bits come from at most 8 bytes, with at most 4 skipped bytes in between, as
+    // an emulation_prevention_three_byte follows two zero bytes.
+    static const size_t kMaxSkippedBytes = 4;
+
     int32_t mNumZeros;
 
+    // the last emulation_prevention_three_bytes skipped, in a ring indexed by mNumSkippedBytes
+    const uint8_t *mSkippedBytes[kMaxSkippedBytes];
+    size_t mNumSkippedBytes;
+
     virtual bool fillReservoir();
 
+    // Returns the number of emulation_prevention_three_bytes skipped in between the raw bytes
+    // of the bits still buffered.
+    size_t numSkippedBytesBuffered() const;
+
     DISALLOW_EVIL_CONSTRUCTORS(NALBitReader);
 };
 
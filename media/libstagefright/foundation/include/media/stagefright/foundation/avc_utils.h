@@ -75,6 +75,11 @@ inline void skipSE(ABitReader *br) {
     (void)parseSEWithFallback(br, 0);
 }
 
+// Returns a pointer to the first Annex-B start code prefix (0x00 0x00 0x01) that lies entirely
+// within [data, data + size), or data + size if there is none. Scans 16 bytes at a time where
+// SSE2 or NEON is available, and a machine word at a time otherwise.
+const uint8_t *findNextStartCode(const uint8_t *data, size_t size);
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
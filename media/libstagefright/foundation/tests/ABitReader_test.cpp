@@ -0,0 +1,187 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ABitReader_test"
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABitReader.h>
+#include <media/stagefright/foundation/avc_utils.h>
+
+namespace android {
+
+class ABitReaderTest : public ::testing::Test {
+};
+
+TEST_F(ABitReaderTest, GetBitsAcrossReservoirRefills) {
+    uint8_t data[21];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = i * 0x11 + 1;
+    }
+    ABitReader br(data, sizeof(data));
+
+    // read all bits in groups of 1..32 bits and reassemble the bytes
+    size_t bitPos = 0;
+    size_t n = 1;
+    while (bitPos < 8 * sizeof(data)) {
+        size_t m = std::min(n, 8 * sizeof(data) - bitPos);
+        uint32_t expected = 0;
+        for (size_t i = bitPos; i < bitPos + m; ++i) {
+            expected = (expected << 1) | ((data[i / 8] >> (7 - i % 8)) & 1);
+        }
+        uint32_t value;
+        ASSERT_TRUE(br.getBitsGraceful(m, &value));
+        ASSERT_EQ(expected, value) << "at bit " << bitPos;
+        bitPos += m;
+        ASSERT_EQ(8 * sizeof(data) - bitPos, br.numBitsLeft());
+        n = n % 32 + 1;
+    }
+    EXPECT_FALSE(br.overRead());
+}
+
+TEST_F(ABitReaderTest, OverRead) {
+    static const uint8_t kData[] = { 0xAB, 0xCD, 0xEF };
+    ABitReader br(kData, sizeof(kData));
+
+    uint32_t value = 0x1234;
+    EXPECT_FALSE(br.getBitsGraceful(33, &value));      // too many bits is not an over-read
+    EXPECT_FALSE(br.overRead());
+    EXPECT_EQ(0x1234u, value);
+
+    EXPECT_EQ(0xAu, br.getBits(4));
+    EXPECT_EQ(0x5678u, br.getBitsWithFallback(24, 0x5678));
+    EXPECT_TRUE(br.overRead());
+    EXPECT_EQ(0u, br.numBitsLeft());                    // the failed read consumed the rest
+
+    EXPECT_TRUE(br.getBitsGraceful(0, &value));
+    EXPECT_EQ(0u, value);
+    EXPECT_FALSE(br.skipBits(1));
+}
+
+TEST_F(ABitReaderTest, SkipAndPutBits) {
+    static const uint8_t kData[] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98,
+    };
+    ABitReader br(kData, sizeof(kData));
+
+    EXPECT_TRUE(br.skipBits(12));
+    EXPECT_EQ(0x3456789Au, br.getBits(32));
+    br.putBits(0x9A, 8);
+    EXPECT_EQ(kData + 4, br.data());
+    EXPECT_EQ(0x9ABCDEFu, br.getBits(28));
+    EXPECT_TRUE(br.skipBits(24));
+    EXPECT_EQ(0x98u, br.getBits(8));
+    EXPECT_EQ(0u, br.numBitsLeft());
+    EXPECT_FALSE(br.overRead());
+}
+
+TEST_F(ABitReaderTest, ParseExpGolomb) {
+    // ue(v) codes for 0, 1, 2, 3, 7 and 65534, se(v) codes for 1 and -2, then zero padding:
+    // 1 010 011 00100 0001000 (15 x 0) (16 x 1) 010 00101 (22 x 0)
+    static const uint8_t kData[] = {
+        0xA6, 0x41, 0x00, 0x00, 0x3F, 0xFF, 0xD1, 0x40, 0x00, 0x00,
+    };
+    ABitReader br(kData, sizeof(kData));
+
+    EXPECT_EQ(0u, parseUE(&br));
+    EXPECT_EQ(1u, parseUE(&br));
+    EXPECT_EQ(2u, parseUE(&br));
+    EXPECT_EQ(3u, parseUE(&br));
+    EXPECT_EQ(7u, parseUE(&br));
+    EXPECT_EQ(65534u, parseUE(&br));
+    EXPECT_EQ(1, parseSE(&br));
+    EXPECT_EQ(-2, parseSE(&br));
+
+    // the remaining zero bits are not a complete code
+    EXPECT_EQ(42u, parseUEWithFallback(&br, 42));
+    EXPECT_TRUE(br.overRead());
+}
+
+TEST_F(ABitReaderTest, NALBitReaderSkipsEmulationPrevention) {
+    static const uint8_t kData[] = {
+        0x00, 0x00, 0x03, 0x01, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x00, 0x00, 0x03, 0x00,
+        0x00, 0x00, 0x03, 0x03, 0x77,
+    };
+    static const uint8_t kPayload[] = {
+        0x00, 0x00, 0x01, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x03, 0x77,
+    };
+    NALBitReader br(kData, sizeof(kData));
+
+    EXPECT_TRUE(br.atLeastNumBitsLeft(8 * sizeof(kPayload)));
+    EXPECT_FALSE(br.atLeastNumBitsLeft(8 * sizeof(kPayload) + 1));
+    for (size_t i = 0; i < sizeof(kPayload); ++i) {
+        ASSERT_EQ(kPayload[i], br.getBits(8)) << "at byte " << i;
+    }
+    EXPECT_EQ(0u, br.numBitsLeft());
+    EXPECT_FALSE(br.overRead());
+}
+
+// data() and numBitsLeft() refer to the raw bytes, including the emulation_prevention_three_bytes
+// that were stripped from the bits already buffered, as the CC decoders use them to pass the
+// rest of a SEI NAL unit on.
+TEST_F(ABitReaderTest, NALBitReaderDataAfterEmulationPrevention) {
+    // header bytes read by the CC decoders, then the payload passed on as raw bytes
+    static const uint8_t kData[] = {
+        0x04, 0x00, 0x00, 0x03, 0x01, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x02, 0x47, 0x41,
+        0xCC, 0x00, 0x00, 0x03, 0x03, 0xFC, 0x94, 0x2C, 0x00, 0x00, 0x03, 0x01, 0xFF, 0xEE,
+    };
+    static const uint8_t kPayload[] = {
+        0xCC, 0x00, 0x00, 0x03, 0x03, 0xFC, 0x94, 0x2C, 0x00, 0x00, 0x03, 0x01, 0xFF, 0xEE,
+    };
+    NALBitReader br(kData, sizeof(kData));
+
+    EXPECT_EQ(0x04u, br.getBits(8));
+    EXPECT_EQ(0x00u, br.getBits(8));
+    EXPECT_EQ(0x0001u, br.getBits(16));
+    EXPECT_EQ(0x00000000u, br.getBits(32));
+    EXPECT_EQ(0x02u, br.getBits(8));
+    EXPECT_EQ(0x4741u, br.getBits(16));
+    EXPECT_EQ(kData + sizeof(kData) - sizeof(kPayload), br.data());
+    EXPECT_EQ(8 * sizeof(kPayload), br.numBitsLeft());
+
+    // the same after every read or skip of n bits, which can leave a partial byte
+    static const size_t kRawIndex[] = {     // raw index of each unescaped byte
+        0, 1, 2, 4, 5, 6, 8, 9, 11, 12, 13, 14, 15, 16, 18, 19, 20, 21, 22, 23, 25, 26, 27,
+    };
+    for (size_t n = 1; n <= 32; ++n) {
+        NALBitReader br2(kData, sizeof(kData));
+        size_t bitPos = 0;
+        while (bitPos + n <= 8 * ARRAY_SIZE(kRawIndex)) {
+            if (n % 2) {
+                ASSERT_TRUE(br2.skipBits(n));
+            } else {
+                br2.getBits(n);
+            }
+            bitPos += n;
+            size_t byteIndex = bitPos / 8;
+            size_t raw = byteIndex < ARRAY_SIZE(kRawIndex) ? kRawIndex[byteIndex] : sizeof(kData);
+            const uint8_t *data = br2.data();
+            // an emulation_prevention_three_byte that is not read yet may also be pointed at
+            if (data != kData + raw) {
+                ASSERT_TRUE(raw > 0 && data == kData + raw - 1 && kData[raw - 1] == 0x03)
+                        << "n " << n << " at bit " << bitPos;
+            }
+            ASSERT_EQ(8 * (kData + sizeof(kData) - data) - bitPos % 8, br2.numBitsLeft())
+                    << "n " << n << " at bit " << bitPos;
+        }
+    }
+}
+
+}  // namespace android
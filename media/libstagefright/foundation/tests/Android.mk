@@ -8,7 +8,9 @@ LOCAL_MODULE := sf_foundation_test
 LOCAL_MODULE_TAGS := tests
 
 LOCAL_SRC_FILES := \
+	ABitReader_test.cpp \
 	AData_test.cpp \
+	AvcUtils_test.cpp \
 	Base64_test.cpp \
 	Flagged_test.cpp \
 	TypeTraits_test.cpp \
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "AvcUtils_test"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/Log.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/avc_utils.h>
+
+namespace android {
+
+// byte by byte reference for findNextStartCode()
+static const uint8_t *referenceFindNextStartCode(const uint8_t *data, size_t size) {
+    for (size_t i = 0; i + 2 < size; ++i) {
+        if (data[i] == 0x00 && data[i + 1] == 0x00 && data[i + 2] == 0x01) {
+            return &data[i];
+        }
+    }
+    return data + size;
+}
+
+// Random bytes with enough zeros and ones to form start codes, partial start codes and
+// emulation prevention patterns at every alignment.
+static std::vector<uint8_t> makeRandomStream(size_t size, unsigned seed) {
+    std::vector<uint8_t> stream(size);
+    srand(seed);
+    for (size_t i = 0; i < size; ++i) {
+        int r = rand() % 8;
+        stream[i] = r < 4 ? 0x00 : r == 4 ? 0x01 : r == 5 ? 0x03 : (uint8_t)rand();
+    }
+    return stream;
+}
+
+// An Annex-B stream of NAL units of random sizes and contents without emulated start codes.
+// Optionally returns the position of each NAL unit.
+static std::vector<uint8_t> makeAnnexBStream(
+        size_t numNals, unsigned seed, std::vector<NALPosition> *nals = nullptr) {
+    std::vector<uint8_t> stream;
+    srand(seed);
+    for (size_t i = 0; i < numNals; ++i) {
+        if (rand() % 2) {
+            stream.push_back(0x00);
+        }
+        stream.push_back(0x00);
+        stream.push_back(0x00);
+        stream.push_back(0x01);
+        NALPosition pos;
+        pos.nalOffset = stream.size();
+        pos.nalSize = 1 + rand() % 4096;
+        for (size_t j = 0; j < pos.nalSize; ++j) {
+            stream.push_back(0x02 + rand() % 0xfe);
+        }
+        if (nals != nullptr) {
+            nals->push_back(pos);
+        }
+    }
+    return stream;
+}
+
+static int64_t monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+class AvcUtilsTest : public ::testing::Test {
+};
+
+TEST_F(AvcUtilsTest, FindNextStartCodeMatchesReference) {
+    std::vector<uint8_t> stream = makeRandomStream(4096, 1);
+    // every start offset and length exercises the vector body and the scalar tail
+    for (size_t start = 0; start < 48; ++start) {
+        for (size_t size = 0; start + size <= 512; ++size) {
+            const uint8_t *data = stream.data() + start;
+            ASSERT_EQ(referenceFindNextStartCode(data, size), findNextStartCode(data, size))
+                    << "start " << start << " size " << size;
+        }
+    }
+
+    // long runs without start codes, with a single one at each position
+    std::vector<uint8_t> sparse(300, 0xff);
+    for (size_t pos = 0; pos + 3 <= sparse.size(); ++pos) {
+        std::fill(sparse.begin(), sparse.end(), 0xff);
+        sparse[pos] = 0x00;
+        sparse[pos + 1] = 0x00;
+        sparse[pos + 2] = 0x01;
+        ASSERT_EQ(sparse.data() + pos, findNextStartCode(sparse.data(), sparse.size()));
+        ASSERT_EQ(sparse.data() + pos + 2, findNextStartCode(sparse.data(), pos + 2));
+    }
+}
+
+TEST_F(AvcUtilsTest, GetNextNALUnit) {
+    static const uint8_t kStream[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00,   // SPS with 4-byte start code
+        0x00, 0x00, 0x01, 0x68, 0xce,               // PPS with 3-byte start code
+        0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x00,   // IDR slice with trailing zero
+        0x00, 0x00, 0x01, 0x06, 0x05, 0x80,         // SEI
+    };
+    const uint8_t *data = kStream;
+    size_t size = sizeof(kStream);
+    const uint8_t *nalStart;
+    size_t nalSize;
+
+    ASSERT_EQ(OK, getNextNALUnit(&data, &size, &nalStart, &nalSize));
+    EXPECT_EQ(kStream + 4, nalStart);
+    EXPECT_EQ(2u, nalSize);     // trailing zero belongs to the start code
+    ASSERT_EQ(OK, getNextNALUnit(&data, &size, &nalStart, &nalSize));
+    EXPECT_EQ(kStream + 10, nalStart);
+    EXPECT_EQ(2u, nalSize);
+    ASSERT_EQ(OK, getNextNALUnit(&data, &size, &nalStart, &nalSize));
+    EXPECT_EQ(kStream + 16, nalStart);
+    EXPECT_EQ(2u, nalSize);
+
+    // the last NAL unit is incomplete unless a start code follows
+    ASSERT_EQ(-EAGAIN, getNextNALUnit(&data, &size, &nalStart, &nalSize));
+    ASSERT_EQ(OK, getNextNALUnit(&data, &size, &nalStart, &nalSize, true));
+    EXPECT_EQ(kStream + 22, nalStart);
+    EXPECT_EQ(3u, nalSize);
+    EXPECT_EQ(nullptr, data);
+    EXPECT_EQ(0u, size);
+}
+
+TEST_F(AvcUtilsTest, GetNextNALUnitFindsAllUnits) {
+    std::vector<NALPosition> expected;
+    std::vector<uint8_t> stream = makeAnnexBStream(200, 2, &expected);
+    const uint8_t *data = stream.data();
+    size_t size = stream.size();
+    const uint8_t *nalStart;
+    size_t nalSize;
+    size_t numNals = 0;
+    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        ASSERT_LT(numNals, expected.size());
+        EXPECT_EQ(expected[numNals].nalOffset, (size_t)(nalStart - stream.data()));
+        EXPECT_EQ(expected[numNals].nalSize, nalSize);
+        ++numNals;
+    }
+    EXPECT_EQ(expected.size(), numNals);
+}
+
+// Reports the scan throughput on a synthetic stream, and on a raw H.264 or HEVC elementary
+// stream pushed to /data/local/tmp/startcode_bench.es if present.
+// Run with --gtest_also_run_disabled_tests.
+TEST_F(AvcUtilsTest, DISABLED_StartCodeScanBenchmark) {
+    std::vector<std::vector<uint8_t>> streams;
+    streams.push_back(makeAnnexBStream(4096, 3));
+
+    FILE *file = fopen("/data/local/tmp/startcode_bench.es", "rb");
+    if (file != NULL) {
+        struct stat st;
+        if (fstat(fileno(file), &st) == 0 && st.st_size > 0) {
+            std::vector<uint8_t> stream(st.st_size);
+            if (fread(stream.data(), 1, stream.size(), file) == stream.size()) {
+                streams.push_back(std::move(stream));
+            }
+        }
+        fclose(file);
+    }
+
+    for (const std::vector<uint8_t> &stream : streams) {
+        static const int kIterations = 20;
+        size_t numNals = 0;
+        int64_t referenceNs = 0;
+        int64_t scannerNs = 0;
+        for (int i = 0; i < kIterations; ++i) {
+            const uint8_t *end = stream.data() + stream.size();
+
+            int64_t startNs = monotonicNs();
+            for (const uint8_t *ptr = stream.data();
+                    (ptr = referenceFindNextStartCode(ptr, end - ptr)) != end; ptr += 3) {
+                ++numNals;
+            }
+            referenceNs += monotonicNs() - startNs;
+
+            startNs = monotonicNs();
+            for (const uint8_t *ptr = stream.data();
+                    (ptr = findNextStartCode(ptr, end - ptr)) != end; ptr += 3) {
+                --numNals;
+            }
+            scannerNs += monotonicNs() - startNs;
+        }
+        EXPECT_EQ(0u, numNals);
+
+        const double megabytes = (double)stream.size() * kIterations / 1e6;
+        printf("%zu bytes: byte-wise %.0f MB/s, findNextStartCode %.0f MB/s\n",
+                stream.size(), megabytes / (referenceNs * 1e-9), megabytes / (scannerNs * 1e-9));
+    }
+}
+
+}  // namespace android
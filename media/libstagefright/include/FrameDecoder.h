@@ -44,8 +44,28 @@ struct FrameDecoder : public RefBase {
             const sp<MetaData> &trackMeta,
             const sp<IMediaSource> &source);
 
+    // If |targetSize| is positive, frames are downscaled during color
+    // conversion so that their longer side is at most |targetSize|,
+    // without allocating a full resolution frame. This is only done for
+    // YUV420Planar decoder output when built with libyuv, and never for
+    // tiled images; |targetSize| is ignored otherwise and the frame comes
+    // out at full size.
     status_t init(
-            int64_t frameTimeUs, size_t numFrames, int option, int colorFormat);
+            int64_t frameTimeUs, size_t numFrames, int option, int colorFormat,
+            int32_t targetSize = 0);
+
+    // Returns true if the codec instances of this decoder can be reused
+    // for a track with |trackMeta|, see reset().
+    bool isCompatible(const sp<MetaData> &trackMeta) const;
+
+    // Flushes the codec instances and retargets them to a new compatible
+    // track, so that decoders can be kept warm across sources. Frames
+    // returned previously stay valid. On failure the decoder should not be
+    // used for extraction again, but may still be released.
+    status_t reset(
+            const sp<MetaData> &trackMeta,
+            const sp<IMediaSource> &source,
+            int64_t frameTimeUs, size_t numFrames, int option);
 
     sp<IMemory> extractFrame(FrameRect *rect = NULL);
 
@@ -65,6 +85,17 @@ protected:
 
     virtual status_t onExtractRect(FrameRect *rect) = 0;
 
+    // Number of codec instances to decode with. Inputs are spread across
+    // the instances, so more than one only makes sense when the samples
+    // can be decoded independently of each other (eg. image tiles).
+    virtual size_t onGetNumDecoders() { return 1; }
+
+    // Called before reading each input sample, may set up a seek in
+    // |options|. Returning false stops queueing inputs for the current
+    // extraction. EOS is then queued to the instances that still have
+    // outputs to return, and they are flushed before the next extraction.
+    virtual bool onPrepareInput(MediaSource::ReadOptions * /*options*/) { return true; }
+
     virtual status_t onInputReceived(
             const sp<MediaCodecBuffer> &codecBuffer,
             MetaDataBase &sampleMeta,
@@ -80,6 +111,7 @@ protected:
     sp<MetaData> trackMeta()     const      { return mTrackMeta; }
     OMX_COLOR_FORMATTYPE dstFormat() const  { return mDstFormat; }
     int32_t dstBpp()             const      { return mDstBpp; }
+    int32_t targetSize()         const      { return mTargetSize; }
 
     void addFrame(const sp<IMemory> &frame) {
         mFrames.push_back(frame);
@@ -91,14 +123,28 @@ private:
     sp<IMediaSource> mSource;
     OMX_COLOR_FORMATTYPE mDstFormat;
     int32_t mDstBpp;
+    int32_t mTargetSize;
     std::vector<sp<IMemory> > mFrames;
     MediaSource::ReadOptions mReadOptions;
-    sp<MediaCodec> mDecoder;
-    sp<AMessage> mOutputFormat;
+    std::vector<sp<MediaCodec> > mDecoders;
+    std::vector<sp<AMessage> > mOutputFormats;
+    std::vector<size_t> mInputsInFlight;
+    // EOS was queued to the instance by queueEndOfStream() since its last flush.
+    std::vector<bool> mEosQueued;
+    // the format the instances were configured with, for resending csd
+    sp<AMessage> mVideoFormat;
+    size_t mNextInputDecoder;
+    size_t mNextOutputDecoder;
     bool mHaveMoreInputs;
     bool mFirstSample;
+    // mSource has been started and not stopped since.
+    bool mSourceStarted;
 
     status_t extractInternal();
+    size_t pickOutputDecoder();
+    status_t queueCodecSpecificData(const sp<MediaCodec> &decoder, const sp<AMessage> &format);
+    void queueEndOfStream();
+    status_t restartAfterEndOfStream();
 
     DISALLOW_EVIL_CONSTRUCTORS(FrameDecoder);
 };
@@ -156,11 +202,15 @@ protected:
 
     virtual status_t onExtractRect(FrameRect *rect) override;
 
+    virtual size_t onGetNumDecoders() override;
+
+    virtual bool onPrepareInput(MediaSource::ReadOptions *options) override;
+
     virtual status_t onInputReceived(
-            const sp<MediaCodecBuffer> &codecBuffer __unused,
-            MetaDataBase &sampleMeta __unused,
-            bool firstSample __unused,
-            uint32_t *flags __unused) override { return OK; }
+            const sp<MediaCodecBuffer> &codecBuffer,
+            MetaDataBase &sampleMeta,
+            bool firstSample,
+            uint32_t *flags) override;
 
     virtual status_t onOutputReceived(
             const sp<MediaCodecBuffer> &videoFrameBuffer,
@@ -178,6 +228,23 @@ private:
     int32_t mTileHeight;
     int32_t mTilesDecoded;
     int32_t mTargetTiles;
+    // Tiles may be read and decoded in any order. mTileState tracks each
+    // tile of the grid, mPendingTiles holds the tiles of the current rect
+    // that are yet to be queued, and mTargetTileRect is the current rect
+    // in units of tiles.
+    std::vector<uint8_t> mTileState;
+    std::vector<int32_t> mPendingTiles;
+    size_t mNextPendingTile;
+    int32_t mNextTileToRead;
+    FrameRect mTargetTileRect;
+
+    bool isTargetTile(int32_t tile) const;
+
+    enum {
+        kTileNotDecoded,
+        kTileQueued,
+        kTileDecoded,
+    };
 };
 
 }  // namespace android
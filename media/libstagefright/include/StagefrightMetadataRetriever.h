@@ -55,6 +55,27 @@ struct StagefrightMetadataRetriever : public MediaMetadataRetrieverBase {
     virtual MediaAlbumArt *extractAlbumArt();
     virtual const char *extractMetadata(int keyCode);
 
+    // Like getFrameAtTime() and getImageAtIndex(), but the returned frame
+    // is downscaled so that its longer side is at most |targetSize|. For
+    // images, an embedded thumbnail is decoded instead if it is at least
+    // that large. Frames are only downscaled when the decoder outputs
+    // YUV420Planar and the image is not tiled; otherwise they are returned
+    // at full size, so callers must check the size they get.
+    sp<IMemory> getScaledFrameAtTime(
+            int64_t timeUs, int option, int colorFormat, int32_t targetSize);
+    sp<IMemory> getScaledImageAtIndex(
+            int index, int colorFormat, int32_t targetSize);
+
+    // Batch mode: extracts one frame from the video track of each file in
+    // |fds|, independently of this retriever's own data source. Decoders
+    // are kept and reused across files with compatible formats, and each
+    // file is opened and parsed while the previous one is being decoded.
+    // Frames are downscaled to |targetSize| if it is positive. |frames|
+    // gets one entry per file, NULL if extraction failed.
+    status_t getFramesAtTimeBatch(
+            const std::vector<int> &fds, int64_t timeUs, int option, int colorFormat,
+            int32_t targetSize, std::vector<sp<IMemory> > *frames);
+
 private:
     sp<DataSource> mSource;
     sp<IMediaExtractor> mExtractor;
@@ -71,9 +92,11 @@ private:
 
     status_t getFrameInternal(
             int64_t timeUs, int numFrames, int option, int colorFormat, bool metaOnly,
-            sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames);
+            sp<IMemory>* outFrame, std::vector<sp<IMemory> >* outFrames,
+            int32_t targetSize = 0);
     virtual sp<IMemory> getImageInternal(
-            int index, int colorFormat, bool metaOnly, bool thumbnail, FrameRect* rect);
+            int index, int colorFormat, bool metaOnly, bool thumbnail, FrameRect* rect,
+            int32_t targetSize = 0);
 
     StagefrightMetadataRetriever(const StagefrightMetadataRetriever &);
 
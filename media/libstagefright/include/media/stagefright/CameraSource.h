@@ -26,6 +26,7 @@
 #include <camera/ICameraRecordingProxyListener.h>
 #include <camera/CameraParameters.h>
 #include <gui/BufferItemConsumer.h>
+#include <utils/KeyedVector.h>
 #include <utils/List.h>
 #include <utils/RefBase.h>
 #include <utils/String16.h>
@@ -99,6 +100,7 @@ public:
     virtual status_t read(
             MediaBufferBase **buffer, const ReadOptions *options = NULL);
     virtual status_t setStopTimeUs(int64_t stopTimeUs);
+    virtual status_t setReadyListener(const sp<ReadyListener> &listener);
 
     /**
      * Check whether a CameraSource object is properly initialized.
@@ -226,6 +228,10 @@ protected:
     // Called from dataCallbackTimestamp.
     virtual bool skipCurrentFrame(int64_t /*timestampUs*/) {return false;}
 
+    // Returns the time the current frame was captured at, given the
+    // timestamp it is recorded with. Called from dataCallbackTimestamp.
+    virtual int64_t currentFrameCaptureTimeUs(int64_t timestampUs) {return timestampUs;}
+
     // Callback called when still camera raw data is available.
     virtual void dataCallback(int32_t /*msgType*/, const sp<IMemory>& /*data*/) {}
 
@@ -244,6 +250,11 @@ protected:
 
     void releaseCamera();
 
+    // Tells the ready listener, if any, that a frame may have been queued.
+    // Called by the camera listeners after a frame callback has returned,
+    // with mLock not held.
+    void notifyReadyListener();
+
 private:
     friend struct CameraSourceListener;
 
@@ -253,6 +264,13 @@ private:
     List<sp<IMemory> > mFramesReceived;
     List<sp<IMemory> > mFramesBeingEncoded;
     List<int64_t> mFrameTimes;
+    List<int64_t> mFrameCaptureTimes;
+    sp<ReadyListener> mReadyListener;
+
+    // MediaBuffer wrappers handed out by read(), keyed by frame memory. The
+    // camera cycles through a fixed set of frame buffers, so a wrapper and
+    // its MetaData are reused once the encoder has returned them.
+    KeyedVector<const void *, MediaBuffer *> mFrameWrappers;
 
     int64_t mFirstFrameTimeUs;
     int64_t mStopSystemTimeUs;
@@ -265,6 +283,7 @@ private:
     int32_t mVideoBufferMode;
 
     static const uint32_t kDefaultVideoBufferCount = 32;
+    static const size_t kMaxFrameWrappers = 2 * kDefaultVideoBufferCount;
 
     /**
      * The following variables are used in VIDEO_BUFFER_MODE_BUFFER_QUEUE mode.
@@ -293,6 +312,8 @@ private:
 
     void releaseQueuedFrames();
     void releaseOneRecordingFrame(const sp<IMemory>& frame);
+    MediaBuffer *acquireFrameWrapperLocked(const sp<IMemory>& frame);
+    void releaseIdleFrameWrappersLocked();
     void createVideoBufferMemoryHeap(size_t size, uint32_t bufferCount);
 
     status_t init(const sp<hardware::ICamera>& camera, const sp<ICameraRecordingProxy>& proxy,
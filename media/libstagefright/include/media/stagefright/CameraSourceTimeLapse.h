@@ -75,6 +75,10 @@ private:
     // to know if current frame needs to be skipped.
     bool mSkipCurrentFrame;
 
+    // Real timestamp of the current frame, saved in dataCallbackTimestamp()
+    // before skipFrameAndModifyTimeStamp() rewrites it.
+    int64_t mCurrentFrameCaptureTimeUs;
+
     // Lock for accessing mCameraIdle
     Mutex mCameraIdleLock;
 
@@ -137,6 +141,10 @@ private:
     // frame needs to be skipped and this function just returns the value of mSkipCurrentFrame.
     virtual bool skipCurrentFrame(int64_t timestampUs);
 
+    // Returns the real timestamp of the current frame, so that the capture
+    // latency is not measured against the time lapse timestamp.
+    virtual int64_t currentFrameCaptureTimeUs(int64_t timestampUs);
+
     // In the video camera case calls skipFrameAndModifyTimeStamp() to modify
     // timestamp and set mSkipCurrentFrame.
     // Then it calls the base CameraSource::dataCallbackTimestamp()
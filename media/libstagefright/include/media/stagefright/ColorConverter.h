@@ -35,6 +35,10 @@ struct ColorConverter {
 
     bool isDstRGB() const;
 
+    // Whether convert() can downscale, ie. take a destination crop that
+    // is smaller than the source crop.
+    bool isScalingSupported() const;
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight,
@@ -78,6 +82,9 @@ private:
     status_t convertYUV420PlanarUseLibYUV(
             const BitmapParams &src, const BitmapParams &dst);
 
+    status_t convertYUV420PlanarScaledUseLibYUV(
+            const BitmapParams &src, const BitmapParams &dst);
+
     status_t convertYUV420SemiPlanarUseLibYUV(
             const BitmapParams &src, const BitmapParams &dst);
 
@@ -22,6 +22,9 @@
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/MediaWriter.h>
+#include <utils/Vector.h>
+
+#include <sys/uio.h>
 
 namespace android {
 
@@ -51,9 +54,15 @@ private:
         kWhatSourceNotify = 'noti'
     };
 
+    enum {
+        kTSPacketSize = 188,
+        // TS packets gathered into one output block before it is written.
+        kMaxPacketsPerBlock = 256,
+    };
+
     struct SourceInfo;
 
-    FILE *mFile;
+    int mFd;
 
     void *mWriteCookie;
     ssize_t (*mWriteFunc)(void *cookie, const void *data, size_t size);
@@ -72,6 +81,21 @@ private:
     int mPMTContinuityCounter;
     uint32_t mCrcTable[256];
 
+    // PAT and PMT packets with their CRCs already filled in, only the
+    // continuity counter changes from one copy to the next.
+    uint8_t mPATPacket[kTSPacketSize];
+    uint8_t mPMTPacket[kTSPacketSize];
+
+    // Packet headers, PSI and partially filled packets of the current output
+    // block. Full 184 byte payloads are not copied here, they are referenced
+    // straight from the access unit through mIOVecs.
+    sp<ABuffer> mBlock;
+    Vector<struct iovec> mIOVecs;
+    size_t mNumPacketsInBlock;
+
+    // Only used to flatten a block for mWriteFunc, which cannot gather.
+    sp<ABuffer> mGatherBuffer;
+
     void init();
 
     void writeTS();
@@ -81,6 +105,14 @@ private:
     void initCrcTable();
     uint32_t crc32(const uint8_t *start, size_t length);
 
+    void buildProgramAssociationTable();
+    void buildProgramMap();
+
+    uint8_t *beginPacket();
+    void commitBlockData(size_t size);
+    void appendPayload(const uint8_t *data, size_t size);
+    void flushBlock();
+
     ssize_t internalWrite(const void *data, size_t size);
     status_t reset();
 
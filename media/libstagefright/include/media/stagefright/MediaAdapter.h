@@ -21,10 +21,13 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/List.h>
 #include <utils/threads.h>
 
 namespace android {
 
+class MediaBufferGroup;
+
 // Convert the MediaMuxer's push model into MPEG4Writer's pull model.
 // Used only by the MediaMuxer for now.
 struct MediaAdapter : public MediaSource, public MediaBufferObserver {
@@ -37,6 +40,8 @@ public:
     /////////////////////////////////////////////////
 
     virtual status_t start(MetaData *params = NULL);
+    // Waits for queued buffers to be read before read() reports the end of
+    // stream; buffers not read for kDrainTimeoutNs are discarded.
     virtual status_t stop();
     virtual sp<MetaData> getFormat();
     virtual status_t read(
@@ -56,18 +61,55 @@ public:
     // deep copy, such that after pushBuffer return, the buffer can be re-used.
     status_t pushBuffer(MediaBuffer *buffer);
 
+    // Limits how far queueBuffer() lets the producer run ahead of read():
+    // at most maxBuffers buffers, whose timestamps span less than
+    // maxDurationUs, are queued at any time. Call before start().
+    void setQueueLimits(size_t maxBuffers, int64_t maxDurationUs);
+
+    // Queues a buffer, which must carry kKeyTime, and returns without
+    // waiting for it to be read; only blocks while the queue is at its
+    // limits. The adapter takes over the caller's reference to the buffer,
+    // also on failure.
+    status_t queueBuffer(MediaBufferBase *buffer);
+
+    // Returns a pooled buffer of at least size bytes to fill and pass to
+    // queueBuffer(), blocking while all pooled buffers are in use.
+    status_t acquireBuffer(size_t size, MediaBufferBase **buffer);
+
 private:
+    enum {
+        kDefaultMaxQueuedBuffers = 32,
+        kDefaultMaxQueuedDurationUs = 500000,
+    };
+    // How long stop() waits for the reader to take another queued buffer.
+    static const nsecs_t kDrainTimeoutNs = 1000000000ll;
+
     Mutex mAdapterLock;
     // Make sure the read() wait for the incoming buffer.
     Condition mBufferReadCond;
     // Make sure the pushBuffer() wait for the current buffer consumed.
     Condition mBufferReturnedCond;
+    // Make sure the queueBuffer() wait for room in the queue.
+    Condition mQueueNotFullCond;
+    // Make sure the stop() wait for the queued buffers to be read.
+    Condition mQueueDrainedCond;
+
+    // Buffers waiting for read(), oldest first.
+    List<MediaBufferBase *> mQueuedBuffers;
+    // The buffer pushBuffer() is waiting on to be returned.
+    MediaBufferBase *mPushedBuffer;
 
-    MediaBuffer *mCurrentMediaBuffer;
+    size_t mMaxQueuedBuffers;
+    int64_t mMaxQueuedDurationUs;
+    MediaBufferGroup *mBufferGroup;
 
     bool mStarted;
+    // stop() is waiting for the queue to be read.
+    bool mStopping;
     sp<MetaData> mOutputFormat;
 
+    bool isQueueFull_l(MediaBufferBase *buffer) const;
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaAdapter);
 };
 
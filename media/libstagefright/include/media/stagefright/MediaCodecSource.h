@@ -22,6 +22,9 @@
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <media/stagefright/foundation/Mutexed.h>
 #include <media/stagefright/PersistentSurface.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -61,6 +64,26 @@ struct MediaCodecSource : public MediaSource,
             const ReadOptions *options = NULL);
     virtual status_t setStopTimeUs(int64_t stopTimeUs);
 
+    // Time from capture (kKeyCaptureTime) to the buffer being queued to the
+    // encoder. Bucket i counts latencies below 2^i ms, the last bucket
+    // everything above.
+    struct LatencyHistogram {
+        static const size_t kNumBuckets = 10;
+
+        LatencyHistogram();
+        void add(int64_t latencyUs);
+        void dump(String8 &result) const;
+
+        int64_t mBuckets[kNumBuckets];
+        int64_t mCount;
+        int64_t mSumUs;
+        int64_t mMinUs;
+        int64_t mMaxUs;
+    };
+
+    // Writes the capture-to-encoder latency histogram. Only sources that
+    // stamp their buffers with kKeyCaptureTime contribute to it.
+    status_t dump(int fd, const Vector<String16>& args);
 
     // MediaBufferObserver
     virtual void signalBufferReturned(MediaBufferBase *buffer);
@@ -147,6 +170,8 @@ private:
     int64_t mFirstSampleTimeUs;
     List<int64_t> mDriftTimeQueue;
 
+    Mutexed<LatencyHistogram> mCaptureLatency;
+
     struct Output {
         Output();
         List<MediaBufferBase*> mBufferQueue;
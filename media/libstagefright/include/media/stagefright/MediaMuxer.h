@@ -116,11 +116,42 @@ public:
     status_t writeSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
                              int64_t timeUs, uint32_t flags) ;
 
+    /**
+     * Let writeSampleData() return before the writer has consumed a sample.
+     * Samples are copied into pooled buffers and queued per track instead,
+     * so the writer takes them in batches and interleaves the tracks over
+     * a time window. writeSampleData() then only blocks while a track has
+     * maxQueuedSamples samples, or samples spanning maxQueuedDurationUs,
+     * waiting to be written. This has to be called before start().
+     * @param maxQueuedSamples the number of samples queued per track at
+     *                         most, 0 to hand each sample over directly.
+     * @param maxQueuedDurationUs the time span queued per track at most.
+     * @return OK if no error.
+     */
+    status_t setSampleQueueing(size_t maxQueuedSamples, int64_t maxQueuedDurationUs);
+
+    /**
+     * Send a sample buffer for muxing, handing it over to the muxer.
+     * Unlike writeSampleData(), the buffer is neither copied nor waited
+     * for: it is queued as it is, and must not be modified or reused by the
+     * caller afterwards. This only blocks while the track's queue is full
+     * (see setSampleQueueing()).
+     * @param buffer the incoming sample buffer, now owned by the muxer.
+     * @param trackIndex the buffer's track index number.
+     * @param timeUs the buffer's time stamp.
+     * @param flags same as for writeSampleData().
+     * @return OK if no error.
+     */
+    status_t writeOwnedSampleData(const sp<ABuffer> &buffer, size_t trackIndex,
+                                  int64_t timeUs, uint32_t flags);
+
 private:
     const OutputFormat mFormat;
     sp<MediaWriter> mWriter;
     Vector< sp<MediaAdapter> > mTrackList;  // Each track has its MediaAdapter.
     sp<MetaData> mFileMeta;  // Metadata for the whole file.
+    size_t mMaxQueuedSamples;  // 0 if samples are handed over directly.
+    int64_t mMaxQueuedDurationUs;
 
     Mutex mMuxerLock;
 
@@ -132,6 +163,9 @@ private:
     };
     State mState;
 
+    status_t getTrackForWrite(
+            const sp<ABuffer> &buffer, size_t trackIndex, sp<MediaAdapter> *track);
+
     DISALLOW_EVIL_CONSTRUCTORS(MediaMuxer);
 };
 
@@ -95,6 +95,18 @@ struct NuMediaExtractor : public RefBase {
     status_t getSampleMeta(sp<MetaData> *sampleMeta);
     status_t getMetrics(Parcel *reply);
 
+    // Per-track reading. The calls above always operate on the selected
+    // track with the lowest timestamp and serialize all callers. These
+    // operate on the read pointer of the given selected track only and just
+    // lock that track, so that different tracks can be consumed from
+    // different threads in parallel. A track should be read either through
+    // these or through the calls above, not both.
+    status_t readTrackSampleData(size_t trackIndex, const sp<ABuffer> &buffer);
+    status_t advanceTrack(size_t trackIndex);
+    status_t getTrackSampleSize(size_t trackIndex, size_t *sampleSize);
+    status_t getTrackSampleTime(size_t trackIndex, int64_t *sampleTimeUs);
+    status_t getTrackSampleMeta(size_t trackIndex, sp<MetaData> *sampleMeta);
+
     bool getCachedDuration(int64_t *durationUs, bool *eos) const;
 
 protected:
@@ -116,7 +128,11 @@ private:
         int64_t mSampleTimeUs;
     };
 
-    struct TrackInfo {
+    struct TrackInfo : public RefBase {
+        // Guards the read pointer: reads from mSource, mSamples and
+        // mFinalResult. Nests inside NuMediaExtractor::mLock.
+        Mutex mLock;
+
         sp<IMediaSource> mSource;
         size_t mTrackIndex;
         media_track_type mTrackType;
@@ -125,6 +141,11 @@ private:
         std::list<Sample> mSamples;
 
         uint32_t mTrackFlags;  // bitmask of "TrackFlags"
+
+        TrackInfo() {}
+
+    private:
+        DISALLOW_EVIL_CONSTRUCTORS(TrackInfo);
     };
 
     mutable Mutex mLock;
@@ -134,7 +155,7 @@ private:
     sp<IMediaExtractor> mImpl;
     HInterfaceToken mCasToken;
 
-    Vector<TrackInfo> mSelectedTracks;
+    Vector<sp<TrackInfo> > mSelectedTracks;
     int64_t mTotalBitrate;  // in bits/sec
     int64_t mDurationUs;
 
@@ -148,6 +169,13 @@ private:
             MediaSource::ReadOptions::SeekMode mode =
                 MediaSource::ReadOptions::SEEK_CLOSEST_SYNC);
 
+    void readAheadTrackSamples(TrackInfo *info);
+    void appendTrackSamples(
+            TrackInfo *info, status_t err, const Vector<MediaBufferBase *> &mediaBuffers);
+    sp<TrackInfo> findSelectedTrack(size_t trackIndex) const;
+    status_t fetchFirstTrackSample(TrackInfo *info);
+    status_t copySampleData(TrackInfo *info, const sp<ABuffer> &buffer);
+
     void releaseOneSample(TrackInfo *info);
     void releaseTrackSamples(TrackInfo *info);
     void releaseAllTrackSamples();
@@ -19,6 +19,10 @@
 #define STAGEFRIGHT_MEDIA_SCANNER_H_
 
 #include <media/mediascanner.h>
+#include <utils/KeyedVector.h>
+#include <utils/List.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
 
 namespace android {
 
@@ -32,13 +36,64 @@ struct StagefrightMediaScanner : public MediaScanner {
 
     virtual MediaAlbumArt *extractAlbumArt(int fd);
 
+protected:
+    virtual void prefetchFile(const char *path, long long lastModified, long long fileSize);
+    virtual void endDirectoryScan();
+
 private:
+    // Metadata extracted from a file, to be reported to the client.
+    struct ExtractedFile : public RefBase {
+        struct Tag {
+            const char *mName;
+            String8 mValue;
+        };
+
+        ExtractedFile() : mResult(MEDIA_SCAN_RESULT_OK), mPending(true) {}
+
+        MediaScanResult mResult;
+        String8 mMimeType;
+        Vector<Tag> mTags;
+        // still being extracted by prefetchFile()
+        bool mPending;
+    };
+
+    // A file as it was when it got prefetched, so that a file that has
+    // changed since does not get the metadata of its previous version.
+    struct PrefetchKey {
+        String8 mPath;
+        long long mLastModified;
+        long long mFileSize;
+
+        bool operator<(const PrefetchKey &other) const {
+            if (mPath != other.mPath) {
+                return mPath < other.mPath;
+            }
+            if (mLastModified != other.mLastModified) {
+                return mLastModified < other.mLastModified;
+            }
+            return mFileSize < other.mFileSize;
+        }
+        bool operator==(const PrefetchKey &other) const {
+            return mPath == other.mPath && mLastModified == other.mLastModified
+                    && mFileSize == other.mFileSize;
+        }
+    };
+
+    Mutex mPrefetchLock;
+    Condition mPrefetchCondition;
+    KeyedVector<PrefetchKey, sp<ExtractedFile> > mPrefetchedFiles;
+    // keys of mPrefetchedFiles, oldest first
+    List<PrefetchKey> mPrefetchOrder;
+
     StagefrightMediaScanner(const StagefrightMediaScanner &);
     StagefrightMediaScanner &operator=(const StagefrightMediaScanner &);
 
     MediaScanResult processFileInternal(
             const char *path, const char *mimeType,
             MediaScannerClient &client);
+
+    sp<ExtractedFile> takePrefetchedFile(const char *path);
+    static sp<ExtractedFile> extractFile(const char *path);
 };
 
 }  // namespace android
@@ -44,6 +44,7 @@ AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
       mFormat(NULL),
       mLastQueuedTimeUs(0),
       mEstimatedBufferDurationUs(-1),
+      mNumDataBuffers(0),
       mEOSResult(OK),
       mLatestEnqueuedMeta(NULL),
       mLatestDequeuedMeta(NULL) {
@@ -81,6 +82,25 @@ void AnotherPacketSource::setFormat(const sp<MetaData> &meta) {
 AnotherPacketSource::~AnotherPacketSource() {
 }
 
+AnotherPacketSource::QueueEntry::QueueEntry(const sp<ABuffer> &buffer)
+    : mBuffer(buffer),
+      mTimeUs(0),
+      mHasTimeUs(false),
+      mIsDiscontinuity(false) {
+    int32_t discontinuity;
+    mIsDiscontinuity = buffer->meta()->findInt32("discontinuity", &discontinuity);
+    mHasTimeUs = buffer->meta()->findInt64("timeUs", &mTimeUs);
+}
+
+AnotherPacketSource::QueueEntry AnotherPacketSource::popFront_l() {
+    QueueEntry entry = mBuffers.front();
+    mBuffers.pop_front();
+    if (!entry.mIsDiscontinuity) {
+        --mNumDataBuffers;
+    }
+    return entry;
+}
+
 status_t AnotherPacketSource::start(MetaData * /* params */) {
     return OK;
 }
@@ -95,19 +115,14 @@ sp<MetaData> AnotherPacketSource::getFormat() {
         return mFormat;
     }
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        sp<ABuffer> buffer = *it;
-        int32_t discontinuity;
-        if (!buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+    for (const QueueEntry &entry : mBuffers) {
+        if (!entry.mIsDiscontinuity) {
             sp<RefBase> object;
-            if (buffer->meta()->findObject("format", &object)) {
+            if (entry.mBuffer->meta()->findObject("format", &object)) {
                 setFormat(static_cast<MetaData*>(object.get()));
                 return mFormat;
             }
         }
-
-        ++it;
     }
     return NULL;
 }
@@ -121,26 +136,27 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
     }
 
     if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        const QueueEntry entry = popFront_l();
+        *buffer = entry.mBuffer;
 
-        int32_t discontinuity;
-        if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
+        if (entry.mIsDiscontinuity) {
+            int32_t discontinuity;
+            CHECK((*buffer)->meta()->findInt32("discontinuity", &discontinuity));
             if (wasFormatChange(discontinuity)) {
                 mFormat.clear();
             }
 
-            mDiscontinuitySegments.erase(mDiscontinuitySegments.begin());
+            mDiscontinuitySegments.pop_front();
             // CHECK(!mDiscontinuitySegments.empty());
             return INFO_DISCONTINUITY;
         }
 
         // CHECK(!mDiscontinuitySegments.empty());
-        DiscontinuitySegment &seg = *mDiscontinuitySegments.begin();
+        DiscontinuitySegment &seg = mDiscontinuitySegments.front();
 
-        int64_t timeUs;
+        CHECK(entry.mHasTimeUs);
+        int64_t timeUs = entry.mTimeUs;
         mLatestDequeuedMeta = (*buffer)->meta()->dup();
-        CHECK(mLatestDequeuedMeta->findInt64("timeUs", &timeUs));
         if (timeUs > seg.mMaxDequeTimeUs) {
             seg.mMaxDequeTimeUs = timeUs;
         }
@@ -159,7 +175,10 @@ status_t AnotherPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
 void AnotherPacketSource::requeueAccessUnit(const sp<ABuffer> &buffer) {
     // TODO: update corresponding book keeping info.
     Mutex::Autolock autoLock(mLock);
-    mBuffers.push_front(buffer);
+    mBuffers.push_front(QueueEntry(buffer));
+    if (!mBuffers.front().mIsDiscontinuity) {
+        ++mNumDataBuffers;
+    }
 }
 
 status_t AnotherPacketSource::read(
@@ -173,16 +192,17 @@ status_t AnotherPacketSource::read(
 
     if (!mBuffers.empty()) {
 
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+        const QueueEntry entry = popFront_l();
+        const sp<ABuffer> &buffer = entry.mBuffer;
 
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+        if (entry.mIsDiscontinuity) {
+            int32_t discontinuity;
+            CHECK(buffer->meta()->findInt32("discontinuity", &discontinuity));
             if (wasFormatChange(discontinuity)) {
                 mFormat.clear();
             }
 
-            mDiscontinuitySegments.erase(mDiscontinuitySegments.begin());
+            mDiscontinuitySegments.pop_front();
             // CHECK(!mDiscontinuitySegments.empty());
             return INFO_DISCONTINUITY;
         }
@@ -194,10 +214,10 @@ status_t AnotherPacketSource::read(
             setFormat(static_cast<MetaData*>(object.get()));
         }
 
-        int64_t timeUs;
-        CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+        CHECK(entry.mHasTimeUs);
+        int64_t timeUs = entry.mTimeUs;
         // CHECK(!mDiscontinuitySegments.empty());
-        DiscontinuitySegment &seg = *mDiscontinuitySegments.begin();
+        DiscontinuitySegment &seg = mDiscontinuitySegments.front();
         if (timeUs > seg.mMaxDequeTimeUs) {
             seg.mMaxDequeTimeUs = timeUs;
         }
@@ -278,11 +298,10 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     }
 
     Mutex::Autolock autoLock(mLock);
-    mBuffers.push_back(buffer);
+    mBuffers.push_back(QueueEntry(buffer));
     mCondition.signal();
 
-    int32_t discontinuity;
-    if (buffer->meta()->findInt32("discontinuity", &discontinuity)){
+    if (mBuffers.back().mIsDiscontinuity) {
         ALOGV("queueing a discontinuity with queueAccessUnit");
 
         mLastQueuedTimeUs = 0ll;
@@ -293,14 +312,16 @@ void AnotherPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
         return;
     }
 
-    int64_t lastQueuedTimeUs;
-    CHECK(buffer->meta()->findInt64("timeUs", &lastQueuedTimeUs));
+    ++mNumDataBuffers;
+
+    CHECK(mBuffers.back().mHasTimeUs);
+    int64_t lastQueuedTimeUs = mBuffers.back().mTimeUs;
     mLastQueuedTimeUs = lastQueuedTimeUs;
     ALOGV("queueAccessUnit timeUs=%" PRIi64 " us (%.2f secs)",
             mLastQueuedTimeUs, mLastQueuedTimeUs / 1E6);
 
     // CHECK(!mDiscontinuitySegments.empty());
-    DiscontinuitySegment &tailSeg = *(--mDiscontinuitySegments.end());
+    DiscontinuitySegment &tailSeg = mDiscontinuitySegments.back();
     if (lastQueuedTimeUs > tailSeg.mMaxEnqueTimeUs) {
         tailSeg.mMaxEnqueTimeUs = lastQueuedTimeUs;
     }
@@ -330,6 +351,7 @@ void AnotherPacketSource::clear() {
     Mutex::Autolock autoLock(mLock);
 
     mBuffers.clear();
+    mNumDataBuffers = 0;
     mEOSResult = OK;
 
     mDiscontinuitySegments.clear();
@@ -349,24 +371,18 @@ void AnotherPacketSource::queueDiscontinuity(
 
     if (discard) {
         // Leave only discontinuities in the queue.
-        List<sp<ABuffer> >::iterator it = mBuffers.begin();
-        while (it != mBuffers.end()) {
-            sp<ABuffer> oldBuffer = *it;
-
-            int32_t oldDiscontinuityType;
-            if (!oldBuffer->meta()->findInt32(
-                        "discontinuity", &oldDiscontinuityType)) {
-                it = mBuffers.erase(it);
-                continue;
+        if (mNumDataBuffers > 0) {
+            std::deque<QueueEntry> discontinuities;
+            for (const QueueEntry &entry : mBuffers) {
+                if (entry.mIsDiscontinuity) {
+                    discontinuities.push_back(entry);
+                }
             }
-
-            ++it;
+            mBuffers.swap(discontinuities);
+            mNumDataBuffers = 0;
         }
 
-        for (List<DiscontinuitySegment>::iterator it2 = mDiscontinuitySegments.begin();
-                it2 != mDiscontinuitySegments.end();
-                ++it2) {
-            DiscontinuitySegment &seg = *it2;
+        for (DiscontinuitySegment &seg : mDiscontinuitySegments) {
             seg.clear();
         }
 
@@ -386,7 +402,7 @@ void AnotherPacketSource::queueDiscontinuity(
     buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
     buffer->meta()->setMessage("extra", extra);
 
-    mBuffers.push_back(buffer);
+    mBuffers.push_back(QueueEntry(buffer));
     mCondition.signal();
 }
 
@@ -418,12 +434,8 @@ bool AnotherPacketSource::hasDataBufferAvailable(status_t *finalResult) {
     if (!mEnabled) {
         return false;
     }
-    List<sp<ABuffer> >::iterator it;
-    for (it = mBuffers.begin(); it != mBuffers.end(); it++) {
-        int32_t discontinuity;
-        if (!(*it)->meta()->findInt32("discontinuity", &discontinuity)) {
-            return true;
-        }
+    if (mNumDataBuffers > 0) {
+        return true;
     }
 
     *finalResult = mEOSResult;
@@ -449,10 +461,7 @@ int64_t AnotherPacketSource::getBufferedDurationUs(status_t *finalResult) {
     *finalResult = mEOSResult;
 
     int64_t durationUs = 0;
-    for (List<DiscontinuitySegment>::iterator it = mDiscontinuitySegments.begin();
-            it != mDiscontinuitySegments.end();
-            ++it) {
-        const DiscontinuitySegment &seg = *it;
+    for (const DiscontinuitySegment &seg : mDiscontinuitySegments) {
         // dequeued access units should be a subset of enqueued access units
         // CHECK(seg.maxEnqueTimeUs >= seg.mMaxDequeTimeUs);
         durationUs += (seg.mMaxEnqueTimeUs - seg.mMaxDequeTimeUs);
@@ -467,23 +476,34 @@ int64_t AnotherPacketSource::getEstimatedBufferDurationUs() {
         return mEstimatedBufferDurationUs;
     }
 
-    SortedVector<int64_t> maxTimesUs;
-    List<sp<ABuffer> >::iterator it;
-    int64_t t1 = 0, t2 = 0;
-    for (it = mBuffers.begin(); it != mBuffers.end(); ++it) {
-        int64_t timeUs = 0;
-        const sp<ABuffer> &buffer = *it;
-        if (!buffer->meta()->findInt64("timeUs", &timeUs)) {
+    // Keep the three largest distinct timestamps, in descending order; the
+    // estimate is only made once at least three have been seen.
+    int64_t maxTimesUs[3] = { 0, 0, 0 };
+    size_t numTimes = 0;
+    for (const QueueEntry &entry : mBuffers) {
+        if (!entry.mHasTimeUs) {
             continue;
         }
-        maxTimesUs.add(timeUs);
-        while (maxTimesUs.size() > 2) {
-            maxTimesUs.removeAt(0);
-            t1 = maxTimesUs.itemAt(0);
-            t2 = maxTimesUs.itemAt(1);
+        int64_t timeUs = entry.mTimeUs;
+        size_t i = 0;
+        while (i < numTimes && timeUs < maxTimesUs[i]) {
+            ++i;
+        }
+        if (i == 3 || (i < numTimes && timeUs == maxTimesUs[i])) {
+            continue;
+        }
+        for (size_t j = (numTimes < 3 ? numTimes : 2); j > i; --j) {
+            maxTimesUs[j] = maxTimesUs[j - 1];
+        }
+        maxTimesUs[i] = timeUs;
+        if (numTimes < 3) {
+            ++numTimes;
         }
     }
-    return mEstimatedBufferDurationUs = t2 - t1;
+    if (numTimes < 3) {
+        return mEstimatedBufferDurationUs = 0;
+    }
+    return mEstimatedBufferDurationUs = maxTimesUs[0] - maxTimesUs[1];
 }
 
 status_t AnotherPacketSource::nextBufferTime(int64_t *timeUs) {
@@ -495,8 +515,8 @@ status_t AnotherPacketSource::nextBufferTime(int64_t *timeUs) {
         return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
     }
 
-    sp<ABuffer> buffer = *mBuffers.begin();
-    CHECK(buffer->meta()->findInt64("timeUs", timeUs));
+    CHECK(mBuffers.front().mHasTimeUs);
+    *timeUs = mBuffers.front().mTimeUs;
 
     return OK;
 }
@@ -537,18 +557,15 @@ sp<AMessage> AnotherPacketSource::getMetaAfterLastDequeued(int64_t delayUs) {
     int64_t lastUs = -1;
     int64_t durationUs = 0;
 
-    List<sp<ABuffer> >::iterator it;
-    for (it = mBuffers.begin(); it != mBuffers.end(); ++it) {
-        const sp<ABuffer> &buffer = *it;
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+    for (const QueueEntry &entry : mBuffers) {
+        if (entry.mIsDiscontinuity) {
             durationUs += lastUs - firstUs;
             firstUs = -1;
             lastUs = -1;
             continue;
         }
-        int64_t timeUs;
-        if (buffer->meta()->findInt64("timeUs", &timeUs)) {
+        if (entry.mHasTimeUs) {
+            int64_t timeUs = entry.mTimeUs;
             if (firstUs < 0) {
                 firstUs = timeUs;
             }
@@ -556,7 +573,7 @@ sp<AMessage> AnotherPacketSource::getMetaAfterLastDequeued(int64_t delayUs) {
                 lastUs = timeUs;
             }
             if (durationUs + (lastUs - firstUs) >= delayUs) {
-                return buffer->meta();
+                return entry.mBuffer->meta();
             }
         }
     }
@@ -582,14 +599,14 @@ void AnotherPacketSource::trimBuffersAfterMeta(
     ALOGV("trimBuffersAfterMeta: discontinuitySeq %d, timeUs %lld",
             stopTime.mSeq, (long long)stopTime.mTimeUs);
 
-    List<sp<ABuffer> >::iterator it;
-    List<DiscontinuitySegment >::iterator it2;
+    std::deque<QueueEntry>::iterator it;
+    std::deque<DiscontinuitySegment>::iterator it2;
     sp<AMessage> newLatestEnqueuedMeta = NULL;
     int64_t newLastQueuedTimeUs = 0;
+    size_t numDataBuffers = 0;
     for (it = mBuffers.begin(), it2 = mDiscontinuitySegments.begin(); it != mBuffers.end(); ++it) {
-        const sp<ABuffer> &buffer = *it;
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
+        const sp<ABuffer> &buffer = it->mBuffer;
+        if (it->mIsDiscontinuity) {
             // CHECK(it2 != mDiscontinuitySegments.end());
             ++it2;
             continue;
@@ -603,9 +620,11 @@ void AnotherPacketSource::trimBuffersAfterMeta(
         }
         newLatestEnqueuedMeta = buffer->meta();
         newLastQueuedTimeUs = curTime.mTimeUs;
+        ++numDataBuffers;
     }
 
     mBuffers.erase(it, mBuffers.end());
+    mNumDataBuffers = numDataBuffers;
     mLatestEnqueuedMeta = newLatestEnqueuedMeta;
     mLastQueuedTimeUs = newLastQueuedTimeUs;
 
@@ -641,12 +660,12 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
     sp<MetaData> format;
     bool isAvc = false;
 
-    List<sp<ABuffer> >::iterator it;
+    std::deque<QueueEntry>::iterator it;
+    size_t numDataBuffersTrimmed = 0;
     for (it = mBuffers.begin(); it != mBuffers.end(); ++it) {
-        const sp<ABuffer> &buffer = *it;
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
-            mDiscontinuitySegments.erase(mDiscontinuitySegments.begin());
+        const sp<ABuffer> &buffer = it->mBuffer;
+        if (it->mIsDiscontinuity) {
+            mDiscontinuitySegments.pop_front();
             // CHECK(!mDiscontinuitySegments.empty());
             format = NULL;
             isAvc = false;
@@ -663,6 +682,7 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
             }
         }
         if (isAvc && !IsIDR(buffer->data(), buffer->size())) {
+            ++numDataBuffersTrimmed;
             continue;
         }
 
@@ -674,12 +694,14 @@ sp<AMessage> AnotherPacketSource::trimBuffersBeforeMeta(
             firstTimeUs = curTime.mTimeUs;
             break;
         }
+        ++numDataBuffersTrimmed;
     }
     mBuffers.erase(mBuffers.begin(), it);
+    mNumDataBuffers -= numDataBuffersTrimmed;
     mLatestDequeuedMeta = NULL;
 
     // CHECK(!mDiscontinuitySegments.empty());
-    DiscontinuitySegment &seg = *mDiscontinuitySegments.begin();
+    DiscontinuitySegment &seg = mDiscontinuitySegments.front();
     if (firstTimeUs >= 0) {
         seg.mMaxDequeTimeUs = firstTimeUs;
     } else {
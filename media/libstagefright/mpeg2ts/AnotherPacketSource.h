@@ -21,7 +21,8 @@
 #include <media/MediaSource.h>
 #include <media/stagefright/foundation/ABase.h>
 #include <utils/threads.h>
-#include <utils/List.h>
+
+#include <deque>
 
 #include "ATSParser.h"
 
@@ -106,7 +107,19 @@ private:
     // discontinuity markers. There should always be at least _ONE_
     // discontinuity segment, hence the various CHECKs in
     // AnotherPacketSource.cpp for non-empty()-ness.
-    List<DiscontinuitySegment> mDiscontinuitySegments;
+    std::deque<DiscontinuitySegment> mDiscontinuitySegments;
+
+    // A queued access unit or discontinuity marker. The timestamp and type are
+    // looked up once when queued, so that the queries below do not need to
+    // search the meta of every buffer.
+    struct QueueEntry {
+        sp<ABuffer> mBuffer;
+        int64_t mTimeUs;
+        bool mHasTimeUs;
+        bool mIsDiscontinuity;
+
+        explicit QueueEntry(const sp<ABuffer> &buffer);
+    };
 
     Mutex mLock;
     Condition mCondition;
@@ -117,13 +130,17 @@ private:
     sp<MetaData> mFormat;
     int64_t mLastQueuedTimeUs;
     int64_t mEstimatedBufferDurationUs;
-    List<sp<ABuffer> > mBuffers;
+    std::deque<QueueEntry> mBuffers;
+    size_t mNumDataBuffers;     // number of entries in mBuffers that are not discontinuities
     status_t mEOSResult;
     sp<AMessage> mLatestEnqueuedMeta;
     sp<AMessage> mLatestDequeuedMeta;
 
     bool wasFormatChange(int32_t discontinuityType) const;
 
+    // Removes and returns the entry at the head of the queue. mLock must be held.
+    QueueEntry popFront_l();
+
     DISALLOW_EVIL_CONSTRUCTORS(AnotherPacketSource);
 };
 
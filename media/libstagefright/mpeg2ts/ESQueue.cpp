@@ -291,17 +291,11 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
-
-                if (startOffset < 0) {
+                const uint8_t *startCode = findNextStartCode(ptr, size);
+                if (startCode == ptr + size) {
                     return ERROR_MALFORMED;
                 }
+                ssize_t startOffset = startCode - ptr;
 
                 if (mFormat == NULL && startOffset > 0) {
                     ALOGI("found something resembling an H.264/MPEG syncword "
@@ -324,17 +318,11 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
-
-                if (startOffset < 0) {
+                const uint8_t *startCode = findNextStartCode(ptr, size);
+                if (startCode == ptr + size) {
                     return ERROR_MALFORMED;
                 }
+                ssize_t startOffset = startCode - ptr;
 
                 if (startOffset > 0) {
                     ALOGI("found something resembling an H.264/MPEG syncword "
@@ -1358,9 +1346,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
 
     size_t offset = 0;
     while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+        // the start code value following the prefix must be available too
+        offset = findNextStartCode(&data[offset], size - offset - 1) - data;
+        if (offset + 3 >= size) {
+            break;
         }
 
         pprevStartCode = prevStartCode;
@@ -1505,16 +1494,12 @@ static ssize_t getNextChunkSize(
         return -EAGAIN;
     }
 
-    size_t offset = 4;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
+    const uint8_t *next = findNextStartCode(&data[4], size - 4);
+    if (next == data + size) {
+        return -EAGAIN;
     }
 
-    return -EAGAIN;
+    return next - data;
 }
 
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
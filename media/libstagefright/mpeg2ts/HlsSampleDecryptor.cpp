@@ -106,33 +106,44 @@ size_t HlsSampleDecryptor::processNal(uint8_t *nalData, size_t nalSize) {
         //    }
         //}
 
-        size_t offset = VIDEO_CLEAR_LEAD;
-        size_t remainingBytes = nalSize - VIDEO_CLEAR_LEAD;
+        // The encrypted blocks form a single CBC chain, so they are gathered
+        // into one contiguous buffer and decrypted in a single pass, which
+        // lets AES_cbc_encrypt() pipeline the blocks instead of being
+        // called once per block. Clear bytes are left in place.
+        static const size_t kPatternSize = 10 * AES_BLOCK_SIZE;
+
+        size_t numBlocks = 0;
+        for (size_t offset = VIDEO_CLEAR_LEAD; offset + AES_BLOCK_SIZE < nalSize;
+                offset += kPatternSize) {
+            ++numBlocks;
+        }
+
+        uint8_t *encrypted = nalData + VIDEO_CLEAR_LEAD;
+        if (numBlocks > 1) {
+            mGatherBuffer.resize(numBlocks * AES_BLOCK_SIZE);
+            encrypted = mGatherBuffer.editArray();
+            for (size_t i = 0; i < numBlocks; ++i) {
+                memcpy(encrypted + i * AES_BLOCK_SIZE,
+                        nalData + VIDEO_CLEAR_LEAD + i * kPatternSize, AES_BLOCK_SIZE);
+            }
+        }
 
         // a copy of initVec as decryptBlock updates it
         unsigned char AESInitVec[AES_BLOCK_SIZE];
         memcpy(AESInitVec, mAESInitVec, AES_BLOCK_SIZE);
 
-        while (remainingBytes > 0) {
-            // encrypted_block: protected block uses 10% skip encryption
-            if (remainingBytes > AES_BLOCK_SIZE) {
-                uint8_t *encrypted = nalData + offset;
-                status_t ret = decryptBlock(encrypted, AES_BLOCK_SIZE, AESInitVec);
-                if (ret != OK) {
-                    ALOGE("processNal failed with %d", ret);
-                    return nalSize; // revisit this
-                }
-
-                offset += AES_BLOCK_SIZE;
-                remainingBytes -= AES_BLOCK_SIZE;
-            }
-
-            // unencrypted_block
-            size_t clearBytes = std::min(remainingBytes, (size_t)(9 * AES_BLOCK_SIZE));
+        status_t ret = decryptBlock(encrypted, numBlocks * AES_BLOCK_SIZE, AESInitVec);
+        if (ret != OK) {
+            ALOGE("processNal failed with %d", ret);
+            return nalSize; // revisit this
+        }
 
-            offset += clearBytes;
-            remainingBytes -= clearBytes;
-        } // while
+        if (numBlocks > 1) {
+            for (size_t i = 0; i < numBlocks; ++i) {
+                memcpy(nalData + VIDEO_CLEAR_LEAD + i * kPatternSize,
+                        encrypted + i * AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+            }
+        }
 
     } else { // isEncrypted == false
         ALOGV("processNal[%d]: Unencrypted NALU  (%p)/%zu", nalType, nalData, nalSize);
@@ -54,6 +54,8 @@ private:
     AES_KEY mAesKey;
     uint8_t mAESInitVec[AES_BLOCK_SIZE];
     bool mValidKeyInfo;
+    // encrypted blocks of a NAL unit, gathered for decryption
+    Vector<uint8_t> mGatherBuffer;
 
     DISALLOW_EVIL_CONSTRUCTORS(HlsSampleDecryptor);
 };
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "HlsSampleDecryptor_test"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <openssl/aes.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+#include "HlsSampleDecryptor.h"
+
+namespace android {
+
+static const size_t kVideoClearLead = 32;
+static const size_t kPatternSize = 10 * AES_BLOCK_SIZE;
+
+// Adds emulation prevention bytes: 0x03 after two zero bytes that are followed by
+// a byte <= 3.
+static std::vector<uint8_t> escape(const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> escaped;
+    size_t zeros = 0;
+    for (uint8_t byte : data) {
+        if (zeros >= 2 && byte <= 3) {
+            escaped.push_back(3);
+            zeros = 0;
+        }
+        escaped.push_back(byte);
+        zeros = byte == 0 ? zeros + 1 : 0;
+    }
+    return escaped;
+}
+
+// Removes the 0x03 of each [0, 0, 3], as processNal() does before decrypting.
+static size_t unescape(uint8_t *data, size_t size) {
+    size_t out = 0;
+    for (size_t in = 0; in < size; ++in) {
+        if (in + 2 < size && data[in] == 0 && data[in + 1] == 0 && data[in + 2] == 3) {
+            data[out++] = 0;
+            data[out++] = 0;
+            in += 2;
+            continue;
+        }
+        data[out++] = data[in];
+    }
+    return out;
+}
+
+// processNal() before the encrypted blocks were gathered: one AES_cbc_encrypt()
+// call per encrypted block of the unescaped NAL unit.
+static size_t processNalPerBlock(const AES_KEY &key, const uint8_t iv[AES_BLOCK_SIZE],
+        uint8_t *nalData, size_t nalSize) {
+    if (nalSize <= kVideoClearLead + AES_BLOCK_SIZE) {
+        return nalSize;
+    }
+    nalSize = unescape(nalData, nalSize);
+
+    uint8_t AESInitVec[AES_BLOCK_SIZE];
+    memcpy(AESInitVec, iv, AES_BLOCK_SIZE);
+
+    size_t offset = kVideoClearLead;
+    size_t remainingBytes = nalSize - kVideoClearLead;
+    while (remainingBytes > 0) {
+        if (remainingBytes > AES_BLOCK_SIZE) {
+            AES_cbc_encrypt(nalData + offset, nalData + offset, AES_BLOCK_SIZE, &key,
+                    AESInitVec, AES_DECRYPT);
+            offset += AES_BLOCK_SIZE;
+            remainingBytes -= AES_BLOCK_SIZE;
+        }
+        size_t clearBytes = std::min(remainingBytes, (size_t)(9 * AES_BLOCK_SIZE));
+        offset += clearBytes;
+        remainingBytes -= clearBytes;
+    }
+    return nalSize;
+}
+
+class HlsSampleDecryptorTest : public ::testing::Test {
+protected:
+    HlsSampleDecryptorTest() {
+        for (size_t i = 0; i < AES_BLOCK_SIZE; ++i) {
+            mKeyData[i] = 0x2b + i * 13;
+            mInitVec[i] = 0xf0 - i * 5;
+        }
+        AES_set_encrypt_key(mKeyData, 8 * AES_BLOCK_SIZE, &mEncryptKey);
+        AES_set_decrypt_key(mKeyData, 8 * AES_BLOCK_SIZE, &mDecryptKey);
+    }
+
+    sp<AMessage> keyItem() const {
+        sp<AMessage> item = new AMessage;
+        sp<ABuffer> keyData = new ABuffer(AES_BLOCK_SIZE);
+        memcpy(keyData->data(), mKeyData, AES_BLOCK_SIZE);
+        sp<ABuffer> initVec = new ABuffer(AES_BLOCK_SIZE);
+        memcpy(initVec->data(), mInitVec, AES_BLOCK_SIZE);
+        item->setBuffer("keyData", keyData);
+        item->setBuffer("initVec", initVec);
+        return item;
+    }
+
+    // Returns a clear NAL unit of the given type and size, with runs of zeros in its
+    // clear bytes, before and after the encrypted blocks, that need escaping.
+    static std::vector<uint8_t> makeNal(uint8_t nalType, size_t size) {
+        std::vector<uint8_t> nal(size);
+        uint32_t x = size;
+        for (size_t i = 0; i < size; ++i) {
+            x = x * 1103515245 + 12345;
+            nal[i] = x >> 24;
+        }
+        nal[0] = 0x60 | nalType;
+
+        static const uint8_t kZeroRuns[][4] = {
+            {0, 0, 1, 0xaa}, {0, 0, 0, 0}, {0, 0, 3, 0x55}, {0, 0, 2, 0},
+        };
+        size_t run = 0;
+        for (size_t offset = 3; offset + 4 <= size; offset += kPatternSize) {
+            memcpy(&nal[offset], kZeroRuns[run++ % 4], 4);
+        }
+        for (size_t offset = kVideoClearLead + AES_BLOCK_SIZE; offset + 4 <= size;
+                offset += kPatternSize) {
+            memcpy(&nal[offset], kZeroRuns[run++ % 4], 4);
+        }
+        for (size_t offset = kVideoClearLead - 2; offset + 2 <= size;
+                offset += kPatternSize) {
+            // zeros right before an encrypted block
+            nal[offset] = 0;
+            nal[offset + 1] = 0;
+        }
+        return nal;
+    }
+
+    // Encrypts the blocks of a clear NAL unit one at a time, in a single CBC chain
+    // starting from the IV, and escapes it.
+    std::vector<uint8_t> encryptNal(const std::vector<uint8_t> &clear) const {
+        std::vector<uint8_t> nal(clear);
+        if (nal.size() > kVideoClearLead + AES_BLOCK_SIZE) {
+            uint8_t iv[AES_BLOCK_SIZE];
+            memcpy(iv, mInitVec, AES_BLOCK_SIZE);
+            for (size_t offset = kVideoClearLead; offset + AES_BLOCK_SIZE < nal.size();
+                    offset += kPatternSize) {
+                AES_cbc_encrypt(&nal[offset], &nal[offset], AES_BLOCK_SIZE, &mEncryptKey,
+                        iv, AES_ENCRYPT);
+            }
+        }
+        return escape(nal);
+    }
+
+    uint8_t mKeyData[AES_BLOCK_SIZE];
+    uint8_t mInitVec[AES_BLOCK_SIZE];
+    AES_KEY mEncryptKey;
+    AES_KEY mDecryptKey;
+};
+
+// Several NAL units with emulation prevention bytes, decrypted by one decryptor so that
+// the gather buffer is reused across sizes, give the same bytes and sizes as the per
+// block decryption, and the clear NAL units back.
+TEST_F(HlsSampleDecryptorTest, SinglePassMatchesPerBlock) {
+    static const struct {
+        uint8_t type;
+        size_t size;
+    } kNals[] = {
+        {5, 4000},  // IDR slice
+        {1, 20},    // too short to be encrypted
+        {1, 48},    // no room for a block after the leader
+        {1, 49},    // one block
+        {1, 192},   // one block, the second one would end the NAL unit
+        {1, 209},   // two blocks
+        {5, 1500},
+        {1, 353},   // three blocks, one byte after the last one
+        {1, 700},
+    };
+
+    sp<HlsSampleDecryptor> decryptor = new HlsSampleDecryptor(keyItem());
+    size_t escapedNals = 0;
+    for (const auto &nalInfo : kNals) {
+        SCOPED_TRACE(testing::Message() << "NAL size " << nalInfo.size);
+        const std::vector<uint8_t> clear = makeNal(nalInfo.type, nalInfo.size);
+        const std::vector<uint8_t> encrypted = encryptNal(clear);
+        if (encrypted.size() > clear.size()) {
+            ++escapedNals;
+        }
+
+        std::vector<uint8_t> expected(encrypted);
+        size_t expectedSize = processNalPerBlock(mDecryptKey, mInitVec, expected.data(),
+                expected.size());
+        expected.resize(expectedSize);
+
+        std::vector<uint8_t> actual(encrypted);
+        size_t actualSize = decryptor->processNal(actual.data(), actual.size());
+        ASSERT_EQ(expectedSize, actualSize);
+        actual.resize(actualSize);
+        EXPECT_EQ(expected, actual);
+
+        if (clear.size() > kVideoClearLead + AES_BLOCK_SIZE) {
+            EXPECT_EQ(clear, actual);
+        }
+    }
+    EXPECT_EQ(sizeof(kNals) / sizeof(kNals[0]), escapedNals);
+}
+
+// A new key restarts the CBC chain from its own IV.
+TEST_F(HlsSampleDecryptorTest, NewKeyAfterNals) {
+    sp<HlsSampleDecryptor> decryptor = new HlsSampleDecryptor(keyItem());
+    std::vector<uint8_t> nal = encryptNal(makeNal(1, 1000));
+    decryptor->processNal(nal.data(), nal.size());
+
+    for (size_t i = 0; i < AES_BLOCK_SIZE; ++i) {
+        mKeyData[i] ^= 0x5a;
+        mInitVec[i] += 1;
+    }
+    AES_set_encrypt_key(mKeyData, 8 * AES_BLOCK_SIZE, &mEncryptKey);
+    AES_set_decrypt_key(mKeyData, 8 * AES_BLOCK_SIZE, &mDecryptKey);
+    decryptor->signalNewSampleAesKey(keyItem());
+
+    const std::vector<uint8_t> clear = makeNal(5, 2345);
+    std::vector<uint8_t> encrypted = encryptNal(clear);
+    std::vector<uint8_t> expected(encrypted);
+    expected.resize(processNalPerBlock(mDecryptKey, mInitVec, expected.data(),
+            expected.size()));
+    encrypted.resize(decryptor->processNal(encrypted.data(), encrypted.size()));
+    EXPECT_EQ(expected, encrypted);
+    EXPECT_EQ(clear, encrypted);
+}
+
+}  // namespace android
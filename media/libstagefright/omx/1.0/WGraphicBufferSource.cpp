@@ -34,6 +34,7 @@ namespace V1_0 {
 namespace implementation {
 
 static const OMX_U32 kPortIndexInput = 0;
+static const OMX_U32 kPortIndexOutput = 1;
 
 struct TWGraphicBufferSource::TWOmxNodeWrapper : public IOmxNodeWrapper {
     sp<IOmxNode> mOmxNode;
@@ -179,14 +180,35 @@ Return<Status> TWGraphicBufferSource::configure(
         return toStatus(fnStatus);
     }
 
+    // The bitrate is optional, it only tunes dropping of unchanged frames.
+    OMX_VIDEO_PARAM_BITRATETYPE bitrate;
+    InitOMXParams(&bitrate);
+    bitrate.nPortIndex = kPortIndexOutput;
 
-    return toStatus(mBase->configure(
+    _params = &bitrate;
+    params = static_cast<uint8_t*>(_params);
+    fnStatus = UNKNOWN_ERROR;
+    transStatus = omxNode->getParameter(
+            static_cast<uint32_t>(OMX_IndexParamVideoBitrate),
+            inHidlBytes(&bitrate, sizeof(bitrate)),
+            _hidl_cb);
+    int32_t targetBitrate = 0;
+    if (transStatus.isOk() && fnStatus == NO_ERROR) {
+        targetBitrate = bitrate.nTargetBitrate;
+    }
+
+    fnStatus = mBase->configure(
             new TWOmxNodeWrapper(omxNode),
             toRawDataspace(dataspace),
             def.nBufferCountActual,
             def.format.video.nFrameWidth,
             def.format.video.nFrameHeight,
-            consumerUsage));
+            consumerUsage);
+    if (fnStatus != NO_ERROR) {
+        return toStatus(fnStatus);
+    }
+
+    return toStatus(mBase->setTargetBitrate(targetBitrate));
 }
 
 Return<Status> TWGraphicBufferSource::setSuspend(
@@ -27,6 +27,7 @@
 namespace android {
 
 static const OMX_U32 kPortIndexInput = 0;
+static const OMX_U32 kPortIndexOutput = 1;
 
 struct BWGraphicBufferSource::BWOmxNodeWrapper : public IOmxNodeWrapper {
     sp<IOMXNode> mOMXNode;
@@ -119,13 +120,29 @@ BWGraphicBufferSource::BWGraphicBufferSource(
         return Status::fromStatusT(UNKNOWN_ERROR);
     }
 
-    return Status::fromStatusT(mBase->configure(
+    // The bitrate is optional, it only tunes dropping of unchanged frames.
+    OMX_VIDEO_PARAM_BITRATETYPE bitrate;
+    InitOMXParams(&bitrate);
+    bitrate.nPortIndex = kPortIndexOutput;
+
+    int32_t targetBitrate = 0;
+    if (omxNode->getParameter(
+            OMX_IndexParamVideoBitrate, &bitrate, sizeof(bitrate)) == OK) {
+        targetBitrate = bitrate.nTargetBitrate;
+    }
+
+    err = mBase->configure(
               new BWOmxNodeWrapper(omxNode),
               dataSpace,
               def.nBufferCountActual,
               def.format.video.nFrameWidth,
               def.format.video.nFrameHeight,
-              consumerUsage));
+              consumerUsage);
+    if (err != OK) {
+        return Status::fromStatusT(err);
+    }
+
+    return Status::fromStatusT(mBase->setTargetBitrate(targetBitrate));
 }
 
 ::android::binder::Status BWGraphicBufferSource::setSuspend(
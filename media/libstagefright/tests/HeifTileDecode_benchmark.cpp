@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Latency of decoding a grid HEIF image whole, and tile by tile through
+// getImageRectAtIndex(). Reads a grid image pushed to kHeifPath; the
+// benchmarks fail with an error if it is missing or has no grid.
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+#include <private/media/VideoFrame.h>
+#include <system/graphics.h>
+
+#include "StagefrightMetadataRetriever.h"
+
+namespace android {
+
+static const char *kHeifPath = "/data/local/tmp/heif_grid.heic";
+
+struct GridInfo {
+    int32_t mWidth;
+    int32_t mHeight;
+    int32_t mTileWidth;
+    int32_t mTileHeight;
+    int32_t mCols;
+    int32_t mRows;
+};
+
+static sp<StagefrightMetadataRetriever> openImage(benchmark::State &state) {
+    int fd = open(kHeifPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        state.SkipWithError("cannot open image");
+        return NULL;
+    }
+    struct stat st;
+    sp<StagefrightMetadataRetriever> retriever = new StagefrightMetadataRetriever;
+    if (fstat(fd, &st) != 0 || retriever->setDataSource(fd, 0, st.st_size) != OK) {
+        state.SkipWithError("cannot set data source");
+        retriever.clear();
+    }
+    close(fd);
+    return retriever;
+}
+
+static bool getGridInfo(benchmark::State &state, GridInfo *info) {
+    sp<StagefrightMetadataRetriever> retriever = openImage(state);
+    if (retriever == NULL) {
+        return false;
+    }
+    sp<IMemory> frameMem = retriever->getImageAtIndex(
+            0, HAL_PIXEL_FORMAT_RGB_565, true /* metaOnly */, false /* thumbnail */);
+    if (frameMem == NULL) {
+        state.SkipWithError("no image");
+        return false;
+    }
+    VideoFrame *frame = static_cast<VideoFrame *>(frameMem->pointer());
+    if (frame->mTileWidth == 0 || frame->mTileHeight == 0) {
+        state.SkipWithError("image has no grid");
+        return false;
+    }
+    info->mWidth = frame->mWidth;
+    info->mHeight = frame->mHeight;
+    info->mTileWidth = frame->mTileWidth;
+    info->mTileHeight = frame->mTileHeight;
+    info->mCols = (info->mWidth + info->mTileWidth - 1) / info->mTileWidth;
+    info->mRows = (info->mHeight + info->mTileHeight - 1) / info->mTileHeight;
+    return true;
+}
+
+static sp<IMemory> decodeTile(
+        const sp<StagefrightMetadataRetriever> &retriever, const GridInfo &info, int32_t tile) {
+    int32_t left = tile % info.mCols * info.mTileWidth;
+    int32_t top = tile / info.mCols * info.mTileHeight;
+    return retriever->getImageRectAtIndex(
+            0, HAL_PIXEL_FORMAT_RGB_565, left, top,
+            std::min(left + info.mTileWidth, info.mWidth),
+            std::min(top + info.mTileHeight, info.mHeight));
+}
+
+static void BM_DecodeWholeImage(benchmark::State &state) {
+    GridInfo info;
+    if (!getGridInfo(state, &info)) {
+        return;
+    }
+    // declared here so that releasing the previous decoder is not timed
+    sp<StagefrightMetadataRetriever> retriever;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        retriever = openImage(state);
+        state.ResumeTiming();
+        if (retriever == NULL || retriever->getImageAtIndex(
+                0, HAL_PIXEL_FORMAT_RGB_565, false /* metaOnly */, false /* thumbnail */)
+                == NULL) {
+            state.SkipWithError("decode failed");
+            break;
+        }
+    }
+    state.counters["tiles"] = info.mCols * info.mRows;
+}
+BENCHMARK(BM_DecodeWholeImage)->Unit(benchmark::kMillisecond);
+
+// A single tile on a fresh decoder. The argument selects the first or the
+// last tile of the grid, the latter being reached by seeking.
+static void BM_DecodeOneTile(benchmark::State &state) {
+    GridInfo info;
+    if (!getGridInfo(state, &info)) {
+        return;
+    }
+    int32_t tile = state.range(0) == 0 ? 0 : info.mCols * info.mRows - 1;
+    sp<StagefrightMetadataRetriever> retriever;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        retriever = openImage(state);
+        state.ResumeTiming();
+        if (retriever == NULL || decodeTile(retriever, info, tile) == NULL) {
+            state.SkipWithError("decode failed");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_DecodeOneTile)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// One more tile on a decoder that has already returned a tile, as when
+// panning over a large image.
+static void BM_DecodeNextTile(benchmark::State &state) {
+    GridInfo info;
+    if (!getGridInfo(state, &info)) {
+        return;
+    }
+    if (info.mCols * info.mRows < 2) {
+        state.SkipWithError("grid has a single tile");
+        return;
+    }
+    sp<StagefrightMetadataRetriever> retriever;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        retriever = openImage(state);
+        if (retriever == NULL || decodeTile(retriever, info, 0) == NULL) {
+            state.SkipWithError("decode failed");
+            break;
+        }
+        state.ResumeTiming();
+        if (decodeTile(retriever, info, info.mCols * info.mRows - 1) == NULL) {
+            state.SkipWithError("decode failed");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_DecodeNextTile)->Unit(benchmark::kMillisecond);
+
+}  // namespace android
+
+BENCHMARK_MAIN();
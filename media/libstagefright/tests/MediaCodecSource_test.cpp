@@ -0,0 +1,306 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "MediaCodecSource_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <binder/ProcessState.h>
+#include <media/MediaSource.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaCodecSource.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Condition.h>
+#include <utils/List.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Thread.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+static const size_t kNumFrames = 50;
+// 20 ms of 8 kHz mono 16 bit PCM, one AMR-NB frame.
+static const size_t kFrameSize = 320;
+static const int64_t kFrameDurationUs = 20000;
+
+// Produces PCM frames on its own thread and, once a ready listener is set,
+// only hands them out through non-blocking reads.
+struct PushingSource : public MediaSource {
+    PushingSource()
+        : mStarted(false),
+          mEos(false),
+          mBlockingReads(0),
+          mNonBlockingReads(0) {
+    }
+
+    virtual status_t start(MetaData * /* params */) {
+        Mutex::Autolock autoLock(mLock);
+        mStarted = true;
+        mProducer = new Producer(this);
+        return mProducer->run("PushingSource");
+    }
+
+    virtual status_t stop() {
+        sp<Producer> producer;
+        {
+            Mutex::Autolock autoLock(mLock);
+            mStarted = false;
+            mCondition.broadcast();
+            producer = mProducer;
+            mProducer.clear();
+        }
+        if (producer != NULL) {
+            producer->join();
+        }
+        Mutex::Autolock autoLock(mLock);
+        while (!mFrames.empty()) {
+            (*mFrames.begin())->release();
+            mFrames.erase(mFrames.begin());
+        }
+        return OK;
+    }
+
+    virtual sp<MetaData> getFormat() {
+        sp<MetaData> meta = new MetaData;
+        meta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_RAW);
+        meta->setInt32(kKeyChannelCount, 1);
+        meta->setInt32(kKeySampleRate, 8000);
+        return meta;
+    }
+
+    virtual status_t read(MediaBufferBase **buffer, const ReadOptions *options) {
+        *buffer = NULL;
+        Mutex::Autolock autoLock(mLock);
+        bool nonBlocking = options != NULL && options->getNonBlocking();
+        if (nonBlocking) {
+            ++mNonBlockingReads;
+        } else {
+            ++mBlockingReads;
+        }
+        while (mFrames.empty()) {
+            if (mEos || !mStarted) {
+                return ERROR_END_OF_STREAM;
+            }
+            if (nonBlocking) {
+                return WOULD_BLOCK;
+            }
+            mCondition.wait(mLock);
+        }
+        *buffer = *mFrames.begin();
+        mFrames.erase(mFrames.begin());
+        return OK;
+    }
+
+    virtual status_t setReadyListener(const sp<ReadyListener> &listener) {
+        Mutex::Autolock autoLock(mLock);
+        mListener = listener;
+        mCondition.broadcast();
+        return OK;
+    }
+
+    size_t blockingReads() {
+        Mutex::Autolock autoLock(mLock);
+        return mBlockingReads;
+    }
+
+    size_t nonBlockingReads() {
+        Mutex::Autolock autoLock(mLock);
+        return mNonBlockingReads;
+    }
+
+private:
+    struct Producer : public Thread {
+        explicit Producer(PushingSource *source)
+            : Thread(false /* canCallJava */), mSource(source) {}
+
+        virtual bool threadLoop() {
+            mSource->produce();
+            return false;
+        }
+
+        PushingSource *mSource;
+    };
+
+    void produce() {
+        {
+            // The puller sets the listener right after start() returns.
+            Mutex::Autolock autoLock(mLock);
+            while (mStarted && mListener == NULL) {
+                if (mCondition.waitRelative(mLock, seconds(1)) == TIMED_OUT) {
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i <= kNumFrames; ++i) {
+            sp<ReadyListener> listener;
+            {
+                Mutex::Autolock autoLock(mLock);
+                if (!mStarted) {
+                    return;
+                }
+                if (i < kNumFrames) {
+                    MediaBuffer *frame = new MediaBuffer(kFrameSize);
+                    memset(frame->data(), 0, kFrameSize);
+                    frame->meta_data().setInt64(kKeyTime, i * kFrameDurationUs);
+                    frame->meta_data().setInt64(kKeyCaptureTime, systemTime() / 1000);
+                    mFrames.push_back(frame);
+                } else {
+                    mEos = true;
+                }
+                mCondition.broadcast();
+                listener = mListener;
+            }
+            if (listener != NULL) {
+                listener->onBufferReady();
+            }
+            usleep(2000);
+        }
+    }
+
+    Mutex mLock;
+    Condition mCondition;
+    sp<Producer> mProducer;
+    sp<ReadyListener> mListener;
+    List<MediaBufferBase *> mFrames;
+    bool mStarted;
+    bool mEos;
+    size_t mBlockingReads;
+    size_t mNonBlockingReads;
+};
+
+static String8 dumpToString(const sp<MediaCodecSource> &source) {
+    String8 result;
+    FILE *file = tmpfile();
+    if (file == NULL) {
+        return result;
+    }
+    source->dump(fileno(file), Vector<String16>());
+    rewind(file);
+    char buf[256];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        result.append(buf, n);
+    }
+    fclose(file);
+    return result;
+}
+
+// Bucket i counts latencies below 2^i ms, the last one everything above.
+TEST(MediaCodecSourceTest, LatencyHistogramBuckets) {
+    MediaCodecSource::LatencyHistogram histogram;
+    histogram.add(-10);      // clamped to 0
+    histogram.add(999);      // < 1 ms
+    histogram.add(1000);     // < 2 ms
+    histogram.add(1999);     // < 2 ms
+    histogram.add(2000);     // < 4 ms
+    histogram.add(255999);   // < 256 ms
+    histogram.add(256000);   // >= 256 ms
+    histogram.add(10000000); // >= 256 ms
+
+    const int64_t expected[MediaCodecSource::LatencyHistogram::kNumBuckets] =
+            { 2, 2, 1, 0, 0, 0, 0, 0, 1, 2 };
+    for (size_t i = 0; i < MediaCodecSource::LatencyHistogram::kNumBuckets; ++i) {
+        EXPECT_EQ(expected[i], histogram.mBuckets[i]) << "bucket " << i;
+    }
+    EXPECT_EQ(8, histogram.mCount);
+    EXPECT_EQ(0, histogram.mMinUs);
+    EXPECT_EQ(10000000, histogram.mMaxUs);
+    EXPECT_EQ(0 + 999 + 1000 + 1999 + 2000 + 255999 + 256000 + 10000000, histogram.mSumUs);
+}
+
+TEST(MediaCodecSourceTest, LatencyHistogramDump) {
+    MediaCodecSource::LatencyHistogram histogram;
+    String8 empty;
+    histogram.dump(empty);
+    EXPECT_STREQ("       no samples\n", empty.string());
+
+    histogram.add(500);
+    histogram.add(1500);
+    histogram.add(300000);
+    String8 result;
+    histogram.dump(result);
+    EXPECT_STREQ(
+            "       samples: 3, min/avg/max (us): 500/100666/300000\n"
+            "       <    1 ms: 1\n"
+            "       <    2 ms: 1\n"
+            "       <    4 ms: 0\n"
+            "       <    8 ms: 0\n"
+            "       <   16 ms: 0\n"
+            "       <   32 ms: 0\n"
+            "       <   64 ms: 0\n"
+            "       <  128 ms: 0\n"
+            "       <  256 ms: 0\n"
+            "      >=  256 ms: 1\n",
+            result.string());
+}
+
+// A source that takes a ready listener is only ever read without blocking,
+// every frame still reaches the encoder, and each one is counted in the
+// capture latency histogram.
+TEST(MediaCodecSourceTest, ReadyListenerPushesFrames) {
+    ProcessState::self()->startThreadPool();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("MediaCodecSource_test");
+    ASSERT_EQ(OK, looper->start());
+
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", MEDIA_MIMETYPE_AUDIO_AMR_NB);
+    format->setInt32("channel-count", 1);
+    format->setInt32("sample-rate", 8000);
+    format->setInt32("bitrate", 12200);
+    format->setInt32("max-input-size", kFrameSize);
+
+    sp<PushingSource> source = new PushingSource;
+    sp<MediaCodecSource> encoder = MediaCodecSource::Create(
+            looper, format, source, NULL /* persistentSurface */,
+            MediaCodecSource::FLAG_PREFER_SOFTWARE_CODEC);
+    ASSERT_TRUE(encoder != NULL);
+    ASSERT_EQ(OK, encoder->start());
+
+    size_t outputs = 0;
+    MediaBufferBase *buffer;
+    status_t err;
+    while ((err = encoder->read(&buffer)) == OK) {
+        ++outputs;
+        buffer->release();
+    }
+    EXPECT_EQ(ERROR_END_OF_STREAM, err);
+    EXPECT_GT(outputs, 0u);
+
+    EXPECT_EQ(0u, source->blockingReads());
+    EXPECT_GT(source->nonBlockingReads(), kNumFrames);
+
+    String8 dump = dumpToString(encoder);
+    EXPECT_NE(-1, dump.find(String8::format("samples: %zu,", kNumFrames).string()))
+            << dump.string();
+
+    EXPECT_EQ(OK, encoder->stop());
+    looper->stop();
+}
+
+} // namespace android
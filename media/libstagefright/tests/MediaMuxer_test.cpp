@@ -0,0 +1,124 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "MediaMuxer_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaAdapter.h>
+#include <media/stagefright/MediaBufferBase.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaMuxer.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/NuMediaExtractor.h>
+#include <utils/Thread.h>
+
+namespace android {
+
+static const size_t kSampleSize = 32;
+static const int64_t kSampleDurationUs = 20000;
+
+// Reads an adapter slowly, as a writer track thread would.
+struct SlowReader : public Thread {
+    SlowReader(const sp<MediaAdapter> &adapter)
+        : Thread(false /* canCallJava */), mAdapter(adapter), mRead(0) {}
+
+    virtual bool threadLoop() {
+        MediaBufferBase *buffer;
+        while (mAdapter->read(&buffer) == OK) {
+            buffer->release();
+            ++mRead;
+            usleep(2000);
+        }
+        return false;
+    }
+
+    sp<MediaAdapter> mAdapter;
+    size_t mRead;
+};
+
+// Buffers queued before stop() are still read, only then is the stream over.
+TEST(MediaMuxerTest, AdapterStopDrainsQueue) {
+    const size_t kNumBuffers = 20;
+    sp<MediaAdapter> adapter = new MediaAdapter(new MetaData);
+    adapter->setQueueLimits(kNumBuffers, 0 /* maxDurationUs */);
+    ASSERT_EQ(OK, adapter->start());
+    for (size_t i = 0; i < kNumBuffers; ++i) {
+        MediaBufferBase *buffer;
+        ASSERT_EQ(OK, adapter->acquireBuffer(kSampleSize, &buffer));
+        buffer->meta_data().setInt64(kKeyTime, i * kSampleDurationUs);
+        ASSERT_EQ(OK, adapter->queueBuffer(buffer));
+    }
+
+    sp<SlowReader> reader = new SlowReader(adapter);
+    ASSERT_EQ(OK, reader->run("SlowReader"));
+    ASSERT_EQ(OK, adapter->stop());
+    reader->join();
+    EXPECT_EQ(kNumBuffers, reader->mRead);
+
+    MediaBufferBase *buffer;
+    EXPECT_EQ(ERROR_END_OF_STREAM, adapter->read(&buffer));
+}
+
+// Every sample handed to the muxer before stop() ends up in the file.
+TEST(MediaMuxerTest, StopKeepsQueuedSamples) {
+    const size_t kNumSamples = 200;
+    char path[] = "/data/local/tmp/MediaMuxer_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+
+    sp<MediaMuxer> muxer = new MediaMuxer(fd, MediaMuxer::OUTPUT_FORMAT_MPEG_4);
+    sp<AMessage> format = new AMessage;
+    format->setString("mime", MEDIA_MIMETYPE_AUDIO_AMR_NB);
+    format->setInt32("channel-count", 1);
+    format->setInt32("sample-rate", 8000);
+    ssize_t trackIndex = muxer->addTrack(format);
+    ASSERT_GE(trackIndex, 0);
+    ASSERT_EQ(OK, muxer->setSampleQueueing(64, 10000000ll));
+    ASSERT_EQ(OK, muxer->start());
+    for (size_t i = 0; i < kNumSamples; ++i) {
+        sp<ABuffer> sample = new ABuffer(kSampleSize);
+        memset(sample->data(), i, kSampleSize);
+        ASSERT_EQ(OK, muxer->writeOwnedSampleData(
+                sample, trackIndex, i * kSampleDurationUs, 0 /* flags */));
+    }
+    ASSERT_EQ(OK, muxer->stop());
+    muxer.clear();
+
+    sp<NuMediaExtractor> extractor = new NuMediaExtractor;
+    ASSERT_EQ(OK, extractor->setDataSource(fd, 0, lseek(fd, 0, SEEK_END)));
+    ASSERT_EQ(1u, extractor->countTracks());
+    ASSERT_EQ(OK, extractor->selectTrack(0));
+    size_t samples = 0;
+    size_t index;
+    while (extractor->getSampleTrackIndex(&index) == OK) {
+        ++samples;
+        extractor->advance();
+    }
+    EXPECT_EQ(kNumSamples, samples);
+    close(fd);
+}
+
+}  // namespace android
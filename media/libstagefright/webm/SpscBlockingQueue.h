@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPSCBLOCKINGQUEUE_H_
+#define SPSCBLOCKINGQUEUE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <atomic>
+
+namespace android {
+
+// Bounded queue for exactly one producer thread and one consumer thread.
+//
+// Elements are passed through a ring indexed by two free running counters,
+// each written by one side only. The lock is only taken by a side that has
+// to sleep (consumer on an empty queue, producer on a full one) and by the
+// other side when it sees that its peer is asleep.
+//
+// close() wakes both sides for good: a consumer gets a NULL element once the
+// queue is empty, and a producer no longer blocks on a full queue.
+template<typename T>
+class SpscBlockingQueue {
+    T *mRing;
+    const size_t mCapacity;
+    std::atomic<size_t> mHead;  // next element to take, written by the consumer
+    std::atomic<size_t> mTail;  // next free slot, written by the producer
+
+    Mutex mLock;
+    Condition mNotEmptyCondition;
+    Condition mNotFullCondition;
+    std::atomic<bool> mConsumerWaiting;
+    std::atomic<bool> mProducerWaiting;
+    std::atomic<bool> mClosed;
+
+    T &slot(size_t index) {
+        return mRing[index & (mCapacity - 1)];
+    }
+
+    // All index and flag accesses below are sequentially consistent: a side
+    // publishes its index and then checks the peer's flag, the peer sets its
+    // flag and then rechecks the index, so one of the two always notices.
+    //
+    // Returns false if the queue is empty and closed.
+    bool waitForContent(size_t *head) {
+        *head = mHead.load(std::memory_order_relaxed);
+        if (*head == mTail.load()) {
+            Mutex::Autolock autolock(mLock);
+            mConsumerWaiting.store(true);
+            while (*head == mTail.load() && !mClosed.load()) {
+                mNotEmptyCondition.wait(mLock);
+            }
+            mConsumerWaiting.store(false);
+        }
+        return *head != mTail.load();
+    }
+
+    void publish(size_t tail) {
+        mTail.store(tail + 1);
+        if (mConsumerWaiting.load()) {
+            Mutex::Autolock autolock(mLock);
+            mNotEmptyCondition.signal();
+        }
+    }
+
+    DISALLOW_EVIL_CONSTRUCTORS(SpscBlockingQueue);
+
+public:
+    // capacity must be a power of 2.
+    explicit SpscBlockingQueue(size_t capacity)
+        : mRing(new T[capacity]),
+          mCapacity(capacity),
+          mHead(0),
+          mTail(0),
+          mConsumerWaiting(false),
+          mProducerWaiting(false),
+          mClosed(false) {
+        CHECK(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    ~SpscBlockingQueue() {
+        delete[] mRing;
+    }
+
+    bool empty() {
+        return mHead.load() == mTail.load();
+    }
+
+    // Empties and reopens the queue. Only safe while neither side is running.
+    void clear() {
+        while (!empty()) {
+            take();
+        }
+        mClosed.store(false);
+    }
+
+    void close() {
+        mClosed.store(true);
+        Mutex::Autolock autolock(mLock);
+        mNotEmptyCondition.broadcast();
+        mNotFullCondition.broadcast();
+    }
+
+    // Consumer side; these return T() if the queue is empty and closed.
+    T peek() {
+        size_t head;
+        if (!waitForContent(&head)) {
+            return T();
+        }
+        return slot(head);
+    }
+
+    T take() {
+        size_t head;
+        if (!waitForContent(&head)) {
+            return T();
+        }
+        T e = slot(head);
+        slot(head) = T();
+        mHead.store(head + 1);
+        if (mProducerWaiting.load()) {
+            Mutex::Autolock autolock(mLock);
+            mNotFullCondition.signal();
+        }
+        return e;
+    }
+
+    // Producer side; blocks while the queue is full. Returns false if the
+    // queue was full when it got closed, and e is dropped.
+    bool push(const T &e) {
+        size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load() == mCapacity) {
+            Mutex::Autolock autolock(mLock);
+            mProducerWaiting.store(true);
+            while (tail - mHead.load() == mCapacity && !mClosed.load()) {
+                mNotFullCondition.wait(mLock);
+            }
+            mProducerWaiting.store(false);
+            if (tail - mHead.load() == mCapacity) {
+                return false;
+            }
+        }
+        slot(tail) = e;
+        publish(tail);
+        return true;
+    }
+};
+
+} /* namespace android */
+#endif /* SPSCBLOCKINGQUEUE_H_ */
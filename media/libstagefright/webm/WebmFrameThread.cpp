@@ -24,7 +24,10 @@
 #include <media/stagefright/foundation/ADebug.h>
 
 #include <utils/Log.h>
+#include <errno.h>
 #include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
 
 using namespace webm;
 
@@ -61,7 +64,7 @@ status_t WebmFrameThread::stop() {
 
 WebmFrameSourceThread::WebmFrameSourceThread(
     int type,
-    LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameQueue& sink)
     : mType(type), mSink(sink) {
 }
 
@@ -72,27 +75,27 @@ WebmFrameSinkThread::WebmFrameSinkThread(
         const uint64_t& off,
         sp<WebmFrameSourceThread> videoThread,
         sp<WebmFrameSourceThread> audioThread,
-        List<sp<WebmElement> >& cues)
+        sp<ABuffer>& cues)
     : mFd(fd),
       mSegmentDataStart(off),
-      mVideoFrames(videoThread->mSink),
-      mAudioFrames(audioThread->mSink),
       mCues(cues),
       mDone(true) {
+    mFrameQueues.push(&videoThread->mSink);
+    mFrameQueues.push(&audioThread->mSink);
 }
 
 WebmFrameSinkThread::WebmFrameSinkThread(
         const int& fd,
         const uint64_t& off,
-        LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-        LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
-        List<sp<WebmElement> >& cues)
+        WebmFrameQueue& videoSource,
+        WebmFrameQueue& audioSource,
+        sp<ABuffer>& cues)
     : mFd(fd),
       mSegmentDataStart(off),
-      mVideoFrames(videoSource),
-      mAudioFrames(audioSource),
       mCues(cues),
       mDone(true) {
+    mFrameQueues.push(&videoSource);
+    mFrameQueues.push(&audioSource);
 }
 
 // Initializes a webm cluster with its starting timecode.
@@ -126,10 +129,42 @@ void WebmFrameSinkThread::writeCluster(List<sp<WebmElement> >& children) {
     // children must contain at least one simpleblock and its timecode
     CHECK_GE(children.size(), 2u);
 
-    uint64_t size;
     sp<WebmElement> cluster = new WebmMaster(kMkvCluster, children);
-    cluster->write(mFd, size);
+    uint64_t size = cluster->totalSize();
+    if (mClusterBuffer == NULL || mClusterBuffer->capacity() < size) {
+        // leave some headroom, clusters of a recording tend to grow alike
+        mClusterBuffer = new ABuffer(size + size / 4);
+    }
+    cluster->serializeInto(mClusterBuffer->data());
     children.clear();
+
+    const uint8_t *data = mClusterBuffer->data();
+    while (size > 0) {
+        ssize_t n = ::write(mFd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ALOGE("failed to write cluster; errno = %d", errno);
+            break;
+        }
+        data += n;
+        size -= n;
+    }
+}
+
+// Serializes cuePoint at the end of mCues, so that stopping only needs to
+// prepend the Cues element header instead of visiting every cue point.
+void WebmFrameSinkThread::appendCuePoint(const sp<WebmElement>& cuePoint) {
+    uint64_t size = cuePoint->totalSize();
+    if (mCues->size() + size > mCues->capacity()) {
+        sp<ABuffer> cues = new ABuffer(2 * mCues->capacity() + size);
+        memcpy(cues->data(), mCues->data(), mCues->size());
+        cues->setRange(0, mCues->size());
+        mCues = cues;
+    }
+    cuePoint->serializeInto(mCues->data() + mCues->size());
+    mCues->setRange(0, mCues->size() + size);
 }
 
 // Write out (possibly multiple) webm cluster(s) from frames split on video key frames.
@@ -186,7 +221,7 @@ void WebmFrameSinkThread::flushFrames(List<const sp<WebmFrame> >& frames, bool l
 
     writeCluster(children);
     sp<WebmElement> cuePoint = WebmElement::CuePointEntry(cueTime, 1, fpos - mSegmentDataStart);
-    mCues.push_back(cuePoint);
+    appendCuePoint(cuePoint);
 }
 
 status_t WebmFrameSinkThread::start() {
@@ -196,8 +231,11 @@ status_t WebmFrameSinkThread::start() {
 
 status_t WebmFrameSinkThread::stop() {
     mDone = true;
-    mVideoFrames.push(WebmFrame::EOS);
-    mAudioFrames.push(WebmFrame::EOS);
+    // Wakes up a run() waiting on an empty queue, and any source still
+    // pushing to a full one now that run() no longer drains it.
+    for (size_t i = 0; i < mFrameQueues.size(); ++i) {
+        mFrameQueues[i]->close();
+    }
     return WebmFrameThread::stop();
 }
 
@@ -205,28 +243,33 @@ void WebmFrameSinkThread::run() {
     int numVideoKeyFrames = 0;
     List<const sp<WebmFrame> > outstandingFrames;
     while (!mDone) {
-        ALOGV("wait v frame");
-        const sp<WebmFrame> videoFrame = mVideoFrames.peek();
-        ALOGV("v frame: %p", videoFrame.get());
-
-        ALOGV("wait a frame");
-        const sp<WebmFrame> audioFrame = mAudioFrames.peek();
-        ALOGV("a frame: %p", audioFrame.get());
+        // k-way merge: take the earliest head of all tracks. EOS sorts after
+        // everything else, so the earliest head is EOS only once every track
+        // is done.
+        size_t minIndex = 0;
+        sp<WebmFrame> minFrame;
+        for (size_t i = 0; i < mFrameQueues.size(); ++i) {
+            ALOGV("wait frame from queue %zu", i);
+            sp<WebmFrame> frame = mFrameQueues[i]->peek();
+            if (frame == NULL) {
+                // closed: nothing more is coming from this track
+                frame = WebmFrame::EOS;
+            }
+            if (minFrame == NULL || *frame < *minFrame) {
+                minIndex = i;
+                minFrame = frame;
+            }
+        }
 
-        if (videoFrame->mEos && audioFrame->mEos) {
+        if (minFrame->mEos) {
             break;
         }
 
-        if (*audioFrame < *videoFrame) {
-            ALOGV("take a frame");
-            mAudioFrames.take();
-            outstandingFrames.push_back(audioFrame);
-        } else {
-            ALOGV("take v frame");
-            mVideoFrames.take();
-            outstandingFrames.push_back(videoFrame);
-            if (videoFrame->mKey)
-                numVideoKeyFrames++;
+        ALOGV("take %s frame", minFrame->mType == kVideoType ? "v" : "a");
+        mFrameQueues[minIndex]->take();
+        outstandingFrames.push_back(minFrame);
+        if (minFrame->mType == kVideoType && minFrame->mKey) {
+            numVideoKeyFrames++;
         }
 
         if (numVideoKeyFrames == 2) {
@@ -254,7 +297,7 @@ void WebmFrameMediaSourceThread::clearFlags() {
 WebmFrameMediaSourceThread::WebmFrameMediaSourceThread(
         const sp<MediaSource>& source,
         int type,
-        LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+        WebmFrameQueue& sink,
         uint64_t timeCodeScale,
         int64_t startTimeRealUs,
         int32_t startTimeOffsetMs,
@@ -316,11 +359,17 @@ status_t WebmFrameMediaSourceThread::pause() {
     return OK;
 }
 
+void WebmFrameMediaSourceThread::requestStop() {
+    if (mStarted && !mDone) {
+        mDone = true;
+        mSource->stop();
+    }
+}
+
 status_t WebmFrameMediaSourceThread::stop() {
     if (mStarted) {
+        requestStop();
         mStarted = false;
-        mDone = true;
-        mSource->stop();
         return WebmFrameThread::stop();
     }
     return OK;
@@ -18,18 +18,21 @@
 #define WEBMFRAMETHREAD_H_
 
 #include "WebmFrame.h"
-#include "LinkedBlockingQueue.h"
+#include "SpscBlockingQueue.h"
 
 #include <media/MediaSource.h>
 #include <media/stagefright/FileSource.h>
 
 #include <utils/List.h>
 #include <utils/Errors.h>
+#include <utils/Vector.h>
 
 #include <pthread.h>
 
 namespace android {
 
+typedef SpscBlockingQueue<sp<WebmFrame> > WebmFrameQueue;
+
 class WebmFrameThread : public LightRefBase<WebmFrameThread> {
 public:
     virtual void run() = 0;
@@ -61,14 +64,14 @@ public:
             const uint64_t& off,
             sp<WebmFrameSourceThread> videoThread,
             sp<WebmFrameSourceThread> audioThread,
-            List<sp<WebmElement> >& cues);
+            sp<ABuffer>& cues);
 
     WebmFrameSinkThread(
             const int& fd,
             const uint64_t& off,
-            LinkedBlockingQueue<const sp<WebmFrame> >& videoSource,
-            LinkedBlockingQueue<const sp<WebmFrame> >& audioSource,
-            List<sp<WebmElement> >& cues);
+            WebmFrameQueue& videoSource,
+            WebmFrameQueue& audioSource,
+            sp<ABuffer>& cues);
 
     void run();
     bool running() {
@@ -80,9 +83,12 @@ public:
 private:
     const int& mFd;
     const uint64_t& mSegmentDataStart;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mVideoFrames;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mAudioFrames;
-    List<sp<WebmElement> >& mCues;
+    // One queue per track, merged in timestamp order.
+    Vector<WebmFrameQueue *> mFrameQueues;
+    // Serialized CuePoint elements, appended as clusters are written.
+    sp<ABuffer>& mCues;
+    // Whole clusters are serialized here and written with one call.
+    sp<ABuffer> mClusterBuffer;
 
     volatile bool mDone;
 
@@ -91,6 +97,7 @@ private:
             uint64_t& clusterTimecodeL,
             List<sp<WebmElement> >& children);
     void writeCluster(List<sp<WebmElement> >& children);
+    void appendCuePoint(const sp<WebmElement>& cuePoint);
     void flushFrames(List<const sp<WebmFrame> >& frames, bool last);
 };
 
@@ -98,11 +105,13 @@ private:
 
 class WebmFrameSourceThread : public WebmFrameThread {
 public:
-    WebmFrameSourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink);
+    WebmFrameSourceThread(int type, WebmFrameQueue& sink);
     virtual int64_t getDurationUs() = 0;
+    // Makes run() finish without waiting for it; stop() still has to be called.
+    virtual void requestStop() {}
 protected:
     const int mType;
-    LinkedBlockingQueue<const sp<WebmFrame> >& mSink;
+    WebmFrameQueue& mSink;
 
     friend class WebmFrameSinkThread;
 };
@@ -111,7 +120,7 @@ protected:
 
 class WebmFrameEmptySourceThread : public WebmFrameSourceThread {
 public:
-    WebmFrameEmptySourceThread(int type, LinkedBlockingQueue<const sp<WebmFrame> >& sink)
+    WebmFrameEmptySourceThread(int type, WebmFrameQueue& sink)
         : WebmFrameSourceThread(type, sink) {
     }
     void run() { mSink.push(WebmFrame::EOS); }
@@ -125,7 +134,7 @@ public:
     WebmFrameMediaSourceThread(
             const sp<MediaSource>& source,
             int type,
-            LinkedBlockingQueue<const sp<WebmFrame> >& sink,
+            WebmFrameQueue& sink,
             uint64_t timeCodeScale,
             int64_t startTimeRealUs,
             int32_t startTimeOffsetMs,
@@ -136,6 +145,7 @@ public:
     status_t start();
     status_t resume();
     status_t pause();
+    void requestStop();
     status_t stop();
     int64_t getDurationUs() {
         return mTrackDurationUs;
@@ -69,7 +69,9 @@ WebmWriter::WebmWriter(int fd)
       mIsFileSizeLimitExplicitlyRequested(false),
       mIsRealTimeRecording(false),
       mStreamableFile(true),
-      mEstimatedCuesSize(0) {
+      mEstimatedCuesSize(0),
+      mCuePoints(new ABuffer(4096)) {
+    mCuePoints->setRange(0, 0);
     mStreams[kAudioIndex] = WebmStream(kAudioType, "Audio", &WebmWriter::audioTrack);
     mStreams[kVideoIndex] = WebmStream(kVideoType, "Video", &WebmWriter::videoTrack);
     mSinkThread = new WebmFrameSinkThread(
@@ -269,6 +271,16 @@ status_t WebmWriter::reset() {
         }
     }
 
+    // Stop every source before joining any of them. A source thread blocked
+    // on its full queue is only released by the sink, which may itself be
+    // waiting for a frame from another track; once every track is ending,
+    // each of them pushes its EOS and the sink drains all queues.
+    for (int i = 0; i < kMaxStreams; ++i) {
+        if (mStreams[i].mThread != NULL) {
+            mStreams[i].mThread->requestStop();
+        }
+    }
+
     status_t err = OK;
     int64_t maxDurationUs = 0;
     int64_t minDurationUs = 0x7fffffffffffffffLL;
@@ -305,7 +317,9 @@ status_t WebmWriter::reset() {
         return err;
     }
 
-    sp<WebmElement> cues = new WebmMaster(kMkvCues, mCuePoints);
+    // The cue points are already serialized; writing them out is a single
+    // copy no matter how long the recording was.
+    sp<WebmElement> cues = new WebmBinary(kMkvCues, mCuePoints);
     uint64_t cuesSize = cues->totalSize();
     // TRICKY Even when the cues do fit in the space we reserved, if they do not fit
     // perfectly, we still need to check if there is enough "extra space" to write an
@@ -321,7 +335,7 @@ status_t WebmWriter::reset() {
         space->write(mFd, spaceSize);
     }
 
-    mCuePoints.clear();
+    mCuePoints->setRange(0, 0);
     mStreams[kVideoIndex].mSink.clear();
     mStreams[kAudioIndex].mSink.clear();
 
@@ -19,7 +19,6 @@
 
 #include "WebmConstants.h"
 #include "WebmFrameThread.h"
-#include "LinkedBlockingQueue.h"
 
 #include <media/MediaSource.h>
 #include <media/stagefright/MediaWriter.h>
@@ -72,7 +71,8 @@ private:
     uint64_t mEstimatedCuesSize;
 
     Mutex mLock;
-    List<sp<WebmElement> > mCuePoints;
+    // Payload of the Cues element, serialized by the sink thread as it goes.
+    sp<ABuffer> mCuePoints;
 
     enum {
         kAudioIndex     =  0,
@@ -80,6 +80,12 @@ private:
         kMaxStreams     =  2,
     };
 
+    enum {
+        // Frames a source thread may queue ahead of the sink before it
+        // blocks; comfortably covers the initial a/v start time offset.
+        kMaxQueuedFrames = 256,
+    };
+
     struct WebmStream {
         int mType;
         const char *mName;
@@ -88,18 +94,20 @@ private:
         sp<MediaSource> mSource;
         sp<WebmElement> mTrackEntry;
         sp<WebmFrameSourceThread> mThread;
-        LinkedBlockingQueue<const sp<WebmFrame> > mSink;
+        WebmFrameQueue mSink;
 
         WebmStream()
             : mType(kInvalidType),
               mName("Invalid"),
-              mMakeTrack(NULL) {
+              mMakeTrack(NULL),
+              mSink(kMaxQueuedFrames) {
         }
 
         WebmStream(int type, const char *name, sp<WebmElement> (*makeTrack)(const sp<MetaData>&))
             : mType(type),
               mName(name),
-              mMakeTrack(makeTrack) {
+              mMakeTrack(makeTrack),
+              mSink(kMaxQueuedFrames) {
         }
 
         WebmStream &operator=(const WebmStream &other) {
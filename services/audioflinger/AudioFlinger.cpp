@@ -521,6 +521,9 @@ status_t AudioFlinger::dump(int fd, const Vector<String16>& args)
             mMmapThreads.valueAt(i)->dump(fd, args);
         }
 
+        // dump software patches between HW modules
+        mPatchPanel->dump(fd);
+
         // dump orphan effect chains
         if (mOrphanEffectChains.size() != 0) {
             write(fd, "  Orphan Effect Chains\n", strlen("  Orphan Effect Chains\n"));
@@ -913,6 +916,7 @@ status_t AudioFlinger::setMasterVolume(float value)
         }
         mPlaybackThreads.valueAt(i)->setMasterVolume(value);
     }
+    mPatchPanel->setMasterVolume(value);
 
     return NO_ERROR;
 }
@@ -1046,6 +1050,7 @@ status_t AudioFlinger::setMasterMute(bool muted)
     for (size_t i = 0; i < volumeInterfaces.size(); i++) {
         volumeInterfaces[i]->setMasterMute(muted);
     }
+    mPatchPanel->setMasterMute(muted);
 
     return NO_ERROR;
 }
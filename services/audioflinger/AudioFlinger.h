@@ -63,6 +63,7 @@
 #include <media/VolumeShaper.h>
 
 #include <audio_utils/SimpleLog.h>
+#include <cpustats/CycleTimeStatistics.h>
 
 #include "FastCapture.h"
 #include "FastMixer.h"
@@ -91,6 +92,7 @@ class EffectsFactoryHalInterface;
 class FastMixer;
 class PassthruBufferProvider;
 class RecordBufferConverter;
+class SharedRecordBufferConverter;
 class ServerProxy;
 
 // ----------------------------------------------------------------------------
@@ -419,7 +419,11 @@ void AudioFlinger::EffectModule::process()
                 }
             }
 #endif
-            ret = mEffectInterface->process();
+            {
+                const int64_t processStartNs = CycleTimeStatistics::monotonicNs();
+                ret = mEffectInterface->process();
+                mProcessStats.sample(CycleTimeStatistics::monotonicNs() - processStartNs);
+            }
 #ifdef FLOAT_EFFECT_CHAIN
             if (!mSupportsFloat) { // convert output int16_t back to float.
                 sp<EffectBufferHalInterface> target =
@@ -1436,6 +1440,14 @@ void AudioFlinger::EffectModule::dump(int fd, const Vector<String16>& args __unu
             dumpInOutBuffer(false /* isInput */, mOutConversionBuffer).c_str());
 #endif
 
+    const CycleTimeStatistics::Summary process = mProcessStats.summarize();
+    if (process.n > 0) {
+        result.appendFormat("\t\t- Process time over last %zu of %llu calls (us):\n"
+                "\t\t\tmedian %.0f 90%% %.0f 99%% %.0f max %.0f\n",
+                process.n, (unsigned long long) process.count,
+                process.wallMedian, process.wall90, process.wall99, process.wallMax);
+    }
+
     result.appendFormat("\t\t%zu Clients:\n", mHandles.size());
     result.append("\t\t\t  Pid Priority Ctrl Locked client server\n");
     char buffer[256];
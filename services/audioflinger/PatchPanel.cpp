@@ -20,12 +20,18 @@
 //#define LOG_NDEBUG 0
 
 #include "Configuration.h"
+#include <algorithm>
+#include <time.h>
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <audio_utils/primitives.h>
 
 #include "AudioFlinger.h"
 #include "ServiceUtilities.h"
 #include <media/AudioParameter.h>
+#include <media/AudioResamplerPublic.h>
+#include <media/RecordBufferConverter.h>
+#include <media/audiohal/StreamHalInterface.h>
 
 // ----------------------------------------------------------------------------
 
@@ -174,7 +180,8 @@ status_t AudioFlinger::PatchPanel::createAudioPatch(const struct audio_patch *pa
                 if ((removedPatch->mRecordPatchHandle
                         != AUDIO_PATCH_HANDLE_NONE) ||
                         (removedPatch->mPlaybackPatchHandle !=
-                                AUDIO_PATCH_HANDLE_NONE)) {
+                                AUDIO_PATCH_HANDLE_NONE) ||
+                        (removedPatch->mForwarder != 0)) {
                     clearPatchConnections(removedPatch);
                 }
                 // 2) if the new patch and old patch source or sink are devices from different
@@ -252,6 +259,19 @@ status_t AudioFlinger::PatchPanel::createAudioPatch(const struct audio_patch *pa
                 ((patch->sinks[0].type == AUDIO_PORT_TYPE_DEVICE) &&
                  ((patch->sinks[0].ext.device.hw_module != srcModule) ||
                   !audioHwDevice->supportsAudioPatches()))) {
+                // Nothing else plays into the output of a one source patch, so the record
+                // and playback threads can be replaced by a single forwarding thread.
+                // Set af.patch.single_hop to false to compare with the two thread bridge.
+                if (patch->num_sources == 1 &&
+                        property_get_bool("af.patch.single_hop", true /* default_value */)) {
+                    status = createPatchForwarder(newPatch, patch);
+                    if (status == NO_ERROR) {
+                        goto exit;
+                    }
+                    ALOGW("createAudioPatch() forwarder failed %d, using record and playback "
+                          "threads", status);
+                    status = NO_ERROR;
+                }
                 if (patch->num_sources == 2) {
                     if (patch->sources[1].type != AUDIO_PORT_TYPE_MIX ||
                             (patch->num_sinks != 0 && patch->sinks[0].ext.device.hw_module !=
@@ -514,6 +534,126 @@ status_t AudioFlinger::PatchPanel::createPatchConnections(Patch *patch,
     return status;
 }
 
+status_t AudioFlinger::PatchPanel::createPatchForwarder(Patch *patch,
+                                                        const struct audio_patch *audioPatch)
+{
+    sp<AudioFlinger> audioflinger = mAudioFlinger.promote();
+    if (audioflinger == 0) {
+        return NO_INIT;
+    }
+
+    // open output stream on sink device
+    audio_config_t outConfig = AUDIO_CONFIG_INITIALIZER;
+    audio_devices_t outDevice = audioPatch->sinks[0].ext.device.type;
+    String8 outAddress = String8(audioPatch->sinks[0].ext.device.address);
+    AudioHwDevice *outHwDev = audioflinger->findSuitableHwDev_l(
+                                                audioPatch->sinks[0].ext.device.hw_module,
+                                                outDevice);
+    if (outHwDev == NULL) {
+        return BAD_VALUE;
+    }
+    audio_io_handle_t output = audioflinger->nextUniqueId(AUDIO_UNIQUE_ID_USE_OUTPUT);
+    AudioStreamOut *outputStream = NULL;
+    status_t status = outHwDev->openOutputStream(&outputStream,
+                                                 output,
+                                                 outDevice,
+                                                 AUDIO_OUTPUT_FLAG_NONE,
+                                                 &outConfig,
+                                                 outAddress.string());
+    if (status != NO_ERROR) {
+        return status;
+    }
+    // the forwarder converts like a RecordThread does, so it needs PCM at both ends
+    if (!audio_is_linear_pcm(outputStream->getFormat())) {
+        delete outputStream;
+        return INVALID_OPERATION;
+    }
+    // master volume and mute are only applied in software to 16 bit and float outputs
+    if ((!outHwDev->canSetMasterVolume() || !outHwDev->canSetMasterMute()) &&
+            outputStream->getFormat() != AUDIO_FORMAT_PCM_16_BIT &&
+            outputStream->getFormat() != AUDIO_FORMAT_PCM_FLOAT) {
+        delete outputStream;
+        return INVALID_OPERATION;
+    }
+
+    // open input stream with source device audio properties if provided or
+    // default to output stream properties otherwise.
+    const struct audio_port_config *source = &audioPatch->sources[0];
+    audio_config_t inConfig = AUDIO_CONFIG_INITIALIZER;
+    inConfig.sample_rate = (source->config_mask & AUDIO_PORT_CONFIG_SAMPLE_RATE) ?
+            source->sample_rate : outputStream->getSampleRate();
+    inConfig.channel_mask = (source->config_mask & AUDIO_PORT_CONFIG_CHANNEL_MASK) ?
+            source->channel_mask :
+            audio_channel_in_mask_from_count(
+                    audio_channel_count_from_out_mask(outputStream->getChannelMask()));
+    inConfig.format = (source->config_mask & AUDIO_PORT_CONFIG_FORMAT) ?
+            source->format : outputStream->getFormat();
+
+    audio_devices_t inDevice = source->ext.device.type;
+    String8 inAddress = String8(source->ext.device.address);
+    AudioHwDevice *inHwDev = audioflinger->findSuitableHwDev_l(source->ext.device.hw_module,
+                                                               inDevice);
+    if (inHwDev == NULL) {
+        delete outputStream;
+        return BAD_VALUE;
+    }
+    audio_io_handle_t input = audioflinger->nextUniqueId(AUDIO_UNIQUE_ID_USE_INPUT);
+    audio_config_t halConfig = inConfig;
+    sp<StreamInHalInterface> inStream;
+    status = inHwDev->hwDevice()->openInputStream(input, inDevice, &halConfig,
+            AUDIO_INPUT_FLAG_NONE, inAddress.string(), AUDIO_SOURCE_MIC, &inStream);
+    // as in openInput_l(), take the parameters proposed by the HAL if we can convert them
+    if (status == BAD_VALUE &&
+            audio_is_linear_pcm(halConfig.format) &&
+            (halConfig.sample_rate <= AUDIO_RESAMPLER_DOWN_RATIO_MAX * inConfig.sample_rate) &&
+            (audio_channel_count_from_in_mask(halConfig.channel_mask) <= FCC_8)) {
+        inStream.clear();
+        status = inHwDev->hwDevice()->openInputStream(input, inDevice, &halConfig,
+                AUDIO_INPUT_FLAG_NONE, inAddress.string(), AUDIO_SOURCE_MIC, &inStream);
+    }
+    if (status != NO_ERROR || inStream == 0) {
+        delete outputStream;
+        return status != NO_ERROR ? status : NO_INIT;
+    }
+
+    sp<PatchForwarder> forwarder = new PatchForwarder(
+            new AudioStreamIn(inHwDev, inStream, AUDIO_INPUT_FLAG_NONE), input,
+            outputStream, output);
+    status = forwarder->initCheck();
+    if (status == NO_ERROR) {
+        forwarder->setMasterVolume(audioflinger->masterVolume_l());
+        forwarder->setMasterMute(audioflinger->masterMute_l());
+        status = forwarder->createRoutes(audioPatch);
+    }
+    if (status == NO_ERROR) {
+        status = forwarder->run("AudioPatchForwarder", ANDROID_PRIORITY_URGENT_AUDIO);
+    }
+    if (status != NO_ERROR) {
+        forwarder->releaseRoutes();
+        return status;
+    }
+    patch->mForwarder = forwarder;
+    return NO_ERROR;
+}
+
+void AudioFlinger::PatchPanel::setMasterVolume(float value)
+{
+    for (size_t i = 0; i < mPatches.size(); i++) {
+        if (mPatches[i]->mForwarder != 0) {
+            mPatches[i]->mForwarder->setMasterVolume(value);
+        }
+    }
+}
+
+void AudioFlinger::PatchPanel::setMasterMute(bool muted)
+{
+    for (size_t i = 0; i < mPatches.size(); i++) {
+        if (mPatches[i]->mForwarder != 0) {
+            mPatches[i]->mForwarder->setMasterMute(muted);
+        }
+    }
+}
+
 void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
 {
     sp<AudioFlinger> audioflinger = mAudioFlinger.promote();
@@ -524,6 +664,12 @@ void AudioFlinger::PatchPanel::clearPatchConnections(Patch *patch)
     ALOGV("clearPatchConnections() patch->mRecordPatchHandle %d patch->mPlaybackPatchHandle %d",
           patch->mRecordPatchHandle, patch->mPlaybackPatchHandle);
 
+    if (patch->mForwarder != 0) {
+        patch->mForwarder->requestExitAndWait();
+        patch->mForwarder->releaseRoutes();
+        patch->mForwarder.clear();
+    }
+
     if (patch->mPatchRecord != 0) {
         patch->mPatchRecord->stop();
     }
@@ -604,7 +750,8 @@ status_t AudioFlinger::PatchPanel::releaseAudioPatch(audio_patch_handle_t handle
             }
 
             if (removedPatch->mRecordPatchHandle != AUDIO_PATCH_HANDLE_NONE ||
-                    removedPatch->mPlaybackPatchHandle != AUDIO_PATCH_HANDLE_NONE) {
+                    removedPatch->mPlaybackPatchHandle != AUDIO_PATCH_HANDLE_NONE ||
+                    removedPatch->mForwarder != 0) {
                 clearPatchConnections(removedPatch);
                 break;
             }
@@ -694,4 +841,369 @@ status_t AudioFlinger::PatchPanel::setAudioPortConfig(const struct audio_port_co
     return audioHwDevice->hwDevice()->setAudioPortConfig(config);
 }
 
+void AudioFlinger::PatchPanel::dump(int fd) const
+{
+    String8 result;
+    for (size_t i = 0; i < mPatches.size(); i++) {
+        const Patch *patch = mPatches[i];
+        if (patch->mForwarder != 0) {
+            result.appendFormat("  Software patch %d: single thread\n", patch->mHandle);
+            write(fd, result.string(), result.size());
+            result.clear();
+            patch->mForwarder->dump(fd);
+        } else if (patch->mRecordThread != 0 && patch->mPlaybackThread != 0) {
+            // what the same route costs through the record and playback threads
+            sp<RecordThread> recordThread = patch->mRecordThread;
+            sp<PlaybackThread> playbackThread = patch->mPlaybackThread;
+            size_t patchFrames = patch->mPatchRecord != 0 ?
+                    patch->mPatchRecord->bufferSize() / playbackThread->frameSize() : 0;
+            result.appendFormat("  Software patch %d: record thread %d, playback thread %d\n",
+                                patch->mHandle, recordThread->id(), playbackThread->id());
+            result.appendFormat("    latency %.1f ms input period + %.1f ms patch buffer"
+                                " + %u ms output\n",
+                                1000.0 * recordThread->frameCount() / recordThread->sampleRate(),
+                                1000.0 * patchFrames / playbackThread->sampleRate(),
+                                playbackThread->latency());
+        }
+    }
+    write(fd, result.string(), result.size());
+}
+
+// ----------------------------------------------------------------------------
+//      PatchForwarder
+// ----------------------------------------------------------------------------
+
+static int64_t patchForwarderNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+AudioFlinger::PatchPanel::PatchForwarder::PatchForwarder(AudioStreamIn *input,
+                                                         audio_io_handle_t inputId,
+                                                         AudioStreamOut *output,
+                                                         audio_io_handle_t outputId)
+    :   Thread(false /*canCallJava*/),
+        mInput(input), mInputId(inputId), mOutput(output), mOutputId(outputId),
+        mStatus(NO_INIT), mInSampleRate(0), mInChannelMask(AUDIO_CHANNEL_NONE),
+        mInFormat(AUDIO_FORMAT_INVALID), mInFrameSize(0), mInFrameCount(0),
+        mOutSampleRate(output->getSampleRate()), mOutFrameSize(output->getFrameSize()),
+        mOutFrameCount(0), mOutLatencyMs(0), mMasterVolume(1.0f), mMasterMute(false),
+        mAppliedVolume(1.0f), mConverter(NULL), mRing(NULL), mRingFrames(0),
+        mRingFront(0), mRingRear(0), mOutBuffer(NULL),
+        mInputHalPatch(AUDIO_PATCH_HANDLE_NONE), mOutputHalPatch(AUDIO_PATCH_HANDLE_NONE),
+        mStartNs(0), mCpuNs(0), mFramesForwarded(0), mErrors(0)
+{
+    size_t bufferSize;
+    status_t status = mInput->stream->getAudioProperties(
+            &mInSampleRate, &mInChannelMask, &mInFormat);
+    if (status == OK) {
+        status = mInput->stream->getFrameSize(&mInFrameSize);
+    }
+    if (status == OK) {
+        status = mInput->stream->getBufferSize(&bufferSize);
+    }
+    if (status != OK || mInFrameSize == 0 || bufferSize < mInFrameSize) {
+        ALOGE("PatchForwarder() cannot get input stream properties, status %d", status);
+        return;
+    }
+    mInFrameCount = bufferSize / mInFrameSize;
+    if (mOutput->stream->getLatency(&mOutLatencyMs) != OK) {
+        mOutLatencyMs = 0;
+    }
+
+    const audio_channel_mask_t outChannelMask = audio_channel_in_mask_from_count(
+            audio_channel_count_from_out_mask(mOutput->getChannelMask()));
+    if (mInSampleRate != mOutSampleRate || mInFormat != mOutput->getFormat() ||
+            audio_channel_count_from_in_mask(mInChannelMask) !=
+                    audio_channel_count_from_in_mask(outChannelMask)) {
+        mConverter = new RecordBufferConverter(mInChannelMask, mInFormat, mInSampleRate,
+                                               outChannelMask, mOutput->getFormat(),
+                                               mOutSampleRate);
+        if (mConverter->initCheck() != NO_ERROR) {
+            ALOGE("PatchForwarder() cannot convert from %#x %#x %u to %#x %#x %u",
+                  mInFormat, mInChannelMask, mInSampleRate,
+                  mOutput->getFormat(), outChannelMask, mOutSampleRate);
+            return;
+        }
+        // Two reads fit in the ring, so there is always room for one more behind
+        // what the resampler holds on to.
+        mRingFrames = 2 * mInFrameCount;
+        mRing = new uint8_t[(mRingFrames + mInFrameCount) * mInFrameSize];
+        mOutFrameCount = destinationFramesPossible(mRingFrames, mInSampleRate, mOutSampleRate);
+        mOutBuffer = new uint8_t[mOutFrameCount * mOutFrameSize];
+    } else {
+        // same frames at both ends: read and write the same buffer
+        mRingFrames = mInFrameCount;
+        mRing = new uint8_t[mRingFrames * mInFrameSize];
+    }
+    mStatus = NO_ERROR;
+}
+
+AudioFlinger::PatchPanel::PatchForwarder::~PatchForwarder()
+{
+    mInput->stream->standby();
+    mOutput->standby();
+    delete mConverter;
+    delete[] mRing;
+    delete[] (uint8_t *)mOutBuffer;
+    delete mInput;
+    delete mOutput;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::getInputPortConfig(
+        struct audio_port_config *config) const
+{
+    config->type = AUDIO_PORT_TYPE_MIX;
+    config->role = AUDIO_PORT_ROLE_SINK;
+    config->ext.mix.handle = mInputId;
+    config->ext.mix.hw_module = mInput->audioHwDev->handle();
+    config->ext.mix.usecase.source = AUDIO_SOURCE_MIC;
+    config->sample_rate = mInSampleRate;
+    config->format = mInFormat;
+    config->channel_mask = mInChannelMask;
+    config->config_mask = AUDIO_PORT_CONFIG_SAMPLE_RATE|AUDIO_PORT_CONFIG_CHANNEL_MASK|
+                            AUDIO_PORT_CONFIG_FORMAT;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::getOutputPortConfig(
+        struct audio_port_config *config) const
+{
+    config->type = AUDIO_PORT_TYPE_MIX;
+    config->role = AUDIO_PORT_ROLE_SOURCE;
+    config->ext.mix.handle = mOutputId;
+    config->ext.mix.hw_module = mOutput->audioHwDev->handle();
+    config->ext.mix.usecase.stream = AUDIO_STREAM_DEFAULT;
+    config->sample_rate = mOutSampleRate;
+    config->format = mOutput->getFormat();
+    config->channel_mask = mOutput->getChannelMask();
+    config->config_mask = AUDIO_PORT_CONFIG_SAMPLE_RATE|AUDIO_PORT_CONFIG_CHANNEL_MASK|
+                            AUDIO_PORT_CONFIG_FORMAT;
+}
+
+status_t AudioFlinger::PatchPanel::PatchForwarder::createRoutes(const struct audio_patch *patch)
+{
+    struct audio_port_config mix = {};
+    status_t status;
+
+    // source device to input stream
+    getInputPortConfig(&mix);
+    if (mInput->audioHwDev->supportsAudioPatches()) {
+        sp<DeviceHalInterface> hwDevice = mInput->audioHwDev->hwDevice();
+        status = hwDevice->createAudioPatch(1, &patch->sources[0], 1, &mix, &mInputHalPatch);
+    } else {
+        char *address;
+        if (strcmp(patch->sources[0].ext.device.address, "") != 0) {
+            address = audio_device_address_to_parameter(
+                                                patch->sources[0].ext.device.type,
+                                                patch->sources[0].ext.device.address);
+        } else {
+            address = (char *)calloc(1, 1);
+        }
+        AudioParameter param = AudioParameter(String8(address));
+        free(address);
+        param.addInt(String8(AudioParameter::keyRouting),
+                     (int)patch->sources[0].ext.device.type);
+        param.addInt(String8(AudioParameter::keyInputSource), (int)AUDIO_SOURCE_MIC);
+        status = mInput->stream->setParameters(param.toString());
+    }
+    if (status != NO_ERROR) {
+        return status;
+    }
+
+    // output stream to sink device
+    getOutputPortConfig(&mix);
+    if (mOutput->audioHwDev->supportsAudioPatches()) {
+        sp<DeviceHalInterface> hwDevice = mOutput->audioHwDev->hwDevice();
+        status = hwDevice->createAudioPatch(1, &mix, 1, &patch->sinks[0], &mOutputHalPatch);
+    } else {
+        char *address;
+        if (strcmp(patch->sinks[0].ext.device.address, "") != 0) {
+            address = audio_device_address_to_parameter(
+                                                patch->sinks[0].ext.device.type,
+                                                patch->sinks[0].ext.device.address);
+        } else {
+            address = (char *)calloc(1, 1);
+        }
+        AudioParameter param = AudioParameter(String8(address));
+        free(address);
+        param.addInt(String8(AudioParameter::keyRouting), (int)patch->sinks[0].ext.device.type);
+        status = mOutput->stream->setParameters(param.toString());
+    }
+    return status;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::releaseRoutes()
+{
+    if (mInput->audioHwDev->supportsAudioPatches()) {
+        if (mInputHalPatch != AUDIO_PATCH_HANDLE_NONE) {
+            mInput->audioHwDev->hwDevice()->releaseAudioPatch(mInputHalPatch);
+        }
+    } else {
+        AudioParameter param;
+        param.addInt(String8(AudioParameter::keyRouting), 0);
+        mInput->stream->setParameters(param.toString());
+    }
+    mInputHalPatch = AUDIO_PATCH_HANDLE_NONE;
+
+    if (mOutput->audioHwDev->supportsAudioPatches()) {
+        if (mOutputHalPatch != AUDIO_PATCH_HANDLE_NONE) {
+            mOutput->audioHwDev->hwDevice()->releaseAudioPatch(mOutputHalPatch);
+        }
+    } else {
+        AudioParameter param;
+        param.addInt(String8(AudioParameter::keyRouting), 0);
+        mOutput->stream->setParameters(param.toString());
+    }
+    mOutputHalPatch = AUDIO_PATCH_HANDLE_NONE;
+}
+
+bool AudioFlinger::PatchPanel::PatchForwarder::threadLoop()
+{
+    if (mStartNs == 0) {
+        mStartNs = patchForwarderNs(CLOCK_MONOTONIC);
+    }
+
+    // Read one HAL period behind the frames the resampler has not consumed yet.
+    // The ring has room for a whole read past its end, which is folded back below.
+    const size_t rearIndex = mRingRear % mRingFrames;
+    uint8_t *readBuffer = mRing + rearIndex * mInFrameSize;
+    size_t bytesRead = 0;
+    status_t status = mInput->stream->read(readBuffer, mInFrameCount * mInFrameSize,
+                                           &bytesRead);
+    const size_t framesRead = bytesRead / mInFrameSize;
+    if (status != OK || framesRead == 0) {
+        ALOGW_IF(mErrors == 0, "PatchForwarder read failed %d", status);
+        mErrors++;
+        // do not spin on a failing HAL, wait for about one period
+        usleep((useconds_t)(1000000LL * mInFrameCount / mInSampleRate));
+        return true;
+    }
+
+    ssize_t framesWritten;
+    if (mConverter == NULL) {
+        applyMasterVolume(readBuffer, framesRead);
+        framesWritten = writeFrames(readBuffer, framesRead);
+    } else {
+        if (rearIndex + framesRead > mRingFrames) {
+            const size_t overflow = rearIndex + framesRead - mRingFrames;
+            memcpy(mRing, mRing + mRingFrames * mInFrameSize, overflow * mInFrameSize);
+        }
+        mRingRear += framesRead;
+        const size_t framesOut = std::min(mOutFrameCount,
+                destinationFramesPossible(mRingRear - mRingFront, mInSampleRate, mOutSampleRate));
+        const size_t framesConverted = mConverter->convert(mOutBuffer, this, framesOut);
+        applyMasterVolume(mOutBuffer, framesConverted);
+        framesWritten = writeFrames(mOutBuffer, framesConverted);
+    }
+    if (framesWritten < 0) {
+        ALOGW_IF(mErrors == 0, "PatchForwarder write failed %zd", framesWritten);
+        mErrors++;
+    } else {
+        mFramesForwarded += framesWritten;
+    }
+    mCpuNs = patchForwarderNs(CLOCK_THREAD_CPUTIME_ID);
+    return true;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::setMasterVolume(float value)
+{
+    mMasterVolume = mOutput->audioHwDev->canSetMasterVolume() ? 1.0f : value;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::setMasterMute(bool muted)
+{
+    mMasterMute = mOutput->audioHwDev->canSetMasterMute() ? false : muted;
+}
+
+// Ramps from the volume applied to the previous buffer to the current one over the
+// buffer, so that volume changes do not click.
+void AudioFlinger::PatchPanel::PatchForwarder::applyMasterVolume(void *buffer, size_t frames)
+{
+    const float volume = mMasterMute ? 0.0f : (float)mMasterVolume;
+    if (frames == 0 || (volume == 1.0f && mAppliedVolume == 1.0f)) {
+        return;
+    }
+    const size_t channelCount = mOutFrameSize / audio_bytes_per_sample(mOutput->getFormat());
+    if (volume == 0.0f && mAppliedVolume == 0.0f) {
+        memset(buffer, 0, frames * mOutFrameSize);
+        return;
+    }
+    const float step = (volume - mAppliedVolume) / frames;
+    float gain = mAppliedVolume;
+    if (mOutput->getFormat() == AUDIO_FORMAT_PCM_16_BIT) {
+        int16_t *samples = (int16_t *)buffer;
+        for (size_t i = 0; i < frames; i++) {
+            gain += step;
+            for (size_t c = 0; c < channelCount; c++, samples++) {
+                *samples = clamp16_from_float(float_from_i16(*samples) * gain);
+            }
+        }
+    } else {
+        float *samples = (float *)buffer;
+        for (size_t i = 0; i < frames; i++) {
+            gain += step;
+            for (size_t c = 0; c < channelCount; c++, samples++) {
+                *samples *= gain;
+            }
+        }
+    }
+    mAppliedVolume = volume;
+}
+
+ssize_t AudioFlinger::PatchPanel::PatchForwarder::writeFrames(const void *buffer, size_t frames)
+{
+    const uint8_t *data = (const uint8_t *)buffer;
+    size_t bytesLeft = frames * mOutFrameSize;
+    while (bytesLeft > 0 && !exitPending()) {
+        ssize_t written = mOutput->write(data, bytesLeft);
+        if (written <= 0) {
+            return written < 0 ? written : (ssize_t)NOT_ENOUGH_DATA;
+        }
+        data += written;
+        bytesLeft -= written;
+    }
+    return frames - bytesLeft / mOutFrameSize;
+}
+
+status_t AudioFlinger::PatchPanel::PatchForwarder::getNextBuffer(
+        AudioBufferProvider::Buffer *buffer)
+{
+    const size_t frontIndex = mRingFront % mRingFrames;
+    size_t frames = std::min((size_t)(mRingRear - mRingFront), mRingFrames - frontIndex);
+    if (frames > buffer->frameCount) {
+        frames = buffer->frameCount;
+    }
+    buffer->frameCount = frames;
+    buffer->raw = frames > 0 ? mRing + frontIndex * mInFrameSize : NULL;
+    return frames > 0 ? NO_ERROR : NOT_ENOUGH_DATA;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::releaseBuffer(
+        AudioBufferProvider::Buffer *buffer)
+{
+    mRingFront += buffer->frameCount;
+    buffer->raw = NULL;
+    buffer->frameCount = 0;
+}
+
+void AudioFlinger::PatchPanel::PatchForwarder::dump(int fd) const
+{
+    String8 result;
+    const int64_t startNs = mStartNs;
+    const int64_t elapsedNs = startNs != 0 ? patchForwarderNs(CLOCK_MONOTONIC) - startNs : 0;
+    result.appendFormat("    input %d: %u Hz, format %#x, channel mask %#x, %zu frames\n",
+                        mInputId, mInSampleRate, mInFormat, mInChannelMask, mInFrameCount);
+    result.appendFormat("    output %d: %u Hz, format %#x, channel mask %#x, %s\n",
+                        mOutputId, mOutSampleRate, mOutput->getFormat(),
+                        mOutput->getChannelMask(), mConverter != NULL ? "converted" : "as is");
+    result.appendFormat("    latency %.1f ms input period + %u ms output\n",
+                        1000.0 * mInFrameCount / mInSampleRate, mOutLatencyMs);
+    result.appendFormat("    cpu %.2f%%, %lld frames forwarded, %d errors\n",
+                        elapsedNs > 0 ? 100.0 * mCpuNs / elapsedNs : 0.0,
+                        (long long)mFramesForwarded, (int)mErrors);
+    write(fd, result.string(), result.size());
+}
+
 } // namespace android
@@ -50,8 +50,97 @@ public:
 
     status_t createPatchConnections(Patch *patch,
                                     const struct audio_patch *audioPatch);
+    status_t createPatchForwarder(Patch *patch,
+                                  const struct audio_patch *audioPatch);
     void clearPatchConnections(Patch *patch);
 
+    // Forwarders write to their own output streams, which setMasterVolume() and
+    // setMasterMute() do not reach through the playback threads.
+    void setMasterVolume(float value);
+    void setMasterMute(bool muted);
+
+    void dump(int fd) const;
+
+    // Moves audio from an input stream to an output stream on a single thread, with format,
+    // channel and sample rate conversion done inline. A software patch that does not mix into
+    // an existing output uses this instead of a RecordThread feeding a PlaybackThread, which
+    // costs an extra period of latency and a second wakeup per period.
+    // Like the PlaybackThread opened for such a patch, its output is private to the patch and
+    // unknown to the audio policy, so no other track or effect is ever attached to it; master
+    // volume and mute are the only processing that still applies.
+    class PatchForwarder : public Thread, private AudioBufferProvider {
+    public:
+        PatchForwarder(AudioStreamIn *input, audio_io_handle_t inputId,
+                       AudioStreamOut *output, audio_io_handle_t outputId);
+        virtual ~PatchForwarder();
+
+        status_t initCheck() const { return mStatus; }
+
+        // Applied in software unless the output HAL does it, as PlaybackThread does.
+        void setMasterVolume(float value);
+        void setMasterMute(bool muted);
+
+        // Connect the source device to the input stream and the output stream to the sink
+        // device, the same way RecordThread and PlaybackThread do in createAudioPatch_l().
+        status_t createRoutes(const struct audio_patch *patch);
+        void releaseRoutes();
+
+        void dump(int fd) const;
+
+    private:
+        virtual bool threadLoop();
+
+        // AudioBufferProvider, hands the staged input frames to mConverter
+        virtual status_t getNextBuffer(AudioBufferProvider::Buffer *buffer);
+        virtual void releaseBuffer(AudioBufferProvider::Buffer *buffer);
+
+        ssize_t writeFrames(const void *buffer, size_t frames);
+        void applyMasterVolume(void *buffer, size_t frames);
+
+        void getInputPortConfig(struct audio_port_config *config) const;
+        void getOutputPortConfig(struct audio_port_config *config) const;
+
+        AudioStreamIn * const   mInput;
+        const audio_io_handle_t mInputId;
+        AudioStreamOut * const  mOutput;
+        const audio_io_handle_t mOutputId;
+        status_t                mStatus;
+
+        uint32_t                mInSampleRate;
+        audio_channel_mask_t    mInChannelMask;
+        audio_format_t          mInFormat;
+        size_t                  mInFrameSize;
+        size_t                  mInFrameCount;     // frames per read from the HAL
+        uint32_t                mOutSampleRate;
+        size_t                  mOutFrameSize;
+        size_t                  mOutFrameCount;    // capacity of mOutBuffer
+        uint32_t                mOutLatencyMs;     // as reported by the HAL
+
+        std::atomic<float>      mMasterVolume;
+        std::atomic<bool>       mMasterMute;
+        float                   mAppliedVolume;    // reached by the end of the last write
+
+        // null when the output takes the input data as is
+        RecordBufferConverter  *mConverter;
+
+        // Input frames waiting for mConverter. The resampler may keep a few of them
+        // between cycles, so this is a ring with room past the end for one whole read.
+        uint8_t                *mRing;
+        size_t                  mRingFrames;
+        int64_t                 mRingFront;        // next frame to convert
+        int64_t                 mRingRear;         // next frame to read into
+        void                   *mOutBuffer;
+
+        audio_patch_handle_t    mInputHalPatch;
+        audio_patch_handle_t    mOutputHalPatch;
+
+        // for dump(), written by the forwarding thread only
+        std::atomic<int64_t>    mStartNs;
+        std::atomic<int64_t>    mCpuNs;
+        std::atomic<int64_t>    mFramesForwarded;
+        std::atomic<int32_t>    mErrors;
+    };
+
     class Patch {
     public:
         explicit Patch(const struct audio_patch *patch) :
@@ -81,6 +170,10 @@ public:
         // handle for audio patch connecting playback thread output to sink device
         // created by createPatchConnections() and released by clearPatchConnections()
         audio_patch_handle_t            mPlaybackPatchHandle;
+        // single thread forwarding from source to sink device, used instead of the record and
+        // playback threads above. created by createPatchForwarder() and released by
+        // clearPatchConnections()
+        sp<PatchForwarder>              mForwarder;
 
     };
 
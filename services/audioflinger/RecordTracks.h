@@ -96,6 +96,14 @@ private:
 
             // used by the record thread to convert frames to proper destination format
             RecordBufferConverter              *mRecordBufferConverter;
+
+            // set instead when the conversion is shared with other tracks;
+            // only the record thread loop and start() touch these
+            sp<SharedConversion>               mSharedConversion;
+            int64_t                            mSharedConversionPosition;
+            // only a track that has not read anything since start() may join one,
+            // so that no track already recording drops frames or resampler state
+            bool                               mMayShareConversion;
             audio_input_flags_t                mFlags;
 
             bool                               mSilenced;
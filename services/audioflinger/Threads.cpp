@@ -844,6 +844,14 @@ void AudioFlinger::ThreadBase::dumpBase(int fd, const Vector<String16>& args __u
     dprintf(fd, "  Output device: %#x (%s)\n", mOutDevice, devicesToString(mOutDevice).c_str());
     dprintf(fd, "  Input device: %#x (%s)\n", mInDevice, devicesToString(mInDevice).c_str());
     dprintf(fd, "  Audio source: %d (%s)\n", mAudioSource, sourceToString(mAudioSource));
+    const CycleTimeStatistics::Summary cycles = mCycleStats.summarize();
+    if (cycles.n > 0) {
+        dprintf(fd, "  Cycle times over last %zu of %llu cycles (us, median/90%%/99%%/max):\n",
+                cycles.n, (unsigned long long) cycles.count);
+        dprintf(fd, "    wall %.0f/%.0f/%.0f/%.0f cpu %.0f/%.0f/%.0f/%.0f\n",
+                cycles.wallMedian, cycles.wall90, cycles.wall99, cycles.wallMax,
+                cycles.cpuMedian, cycles.cpu90, cycles.cpu99, cycles.cpuMax);
+    }
 
     if (locked) {
         mLock.unlock();
@@ -3169,6 +3177,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
         mAudioFlinger->requestLogMerge();
 
         cpuStats.sample(myName);
+        mCycleStats.sampleCycle();
 
         Vector< sp<EffectChain> > effectChains;
 
@@ -3260,8 +3269,8 @@ bool AudioFlinger::PlaybackThread::threadLoop()
             if (z % 100 == 0) {
                 timespec ts;
                 clock_gettime(CLOCK_MONOTONIC, &ts);
-                LOGT("This is an integer %d, this is a float %f, this is my "
-                    "pid %p %% %s %t", 42, 3.14, "and this is a timestamp", ts);
+                LOGT("This is an integer %d, this is a float %f, this is a "
+                    "percent sign %% %s %t", 42, 3.14, "and this is a timestamp", ts);
                 LOGT("A deceptive null-terminated string %\0");
             }
             ++z;
@@ -3282,6 +3291,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
                 const int64_t waitNs = computeWaitTimeNs_l();
                 ALOGV("wait async completion (wait time: %lld)", (long long)waitNs);
+                mCycleStats.endCycle();
                 status_t status = mWaitWorkCV.waitRelative(mLock, waitNs);
                 if (status == TIMED_OUT) {
                     mSignalPending = true; // if timeout recheck everything
@@ -3322,6 +3332,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     releaseWakeLock_l();
                     // wait until we have something to do...
                     ALOGV("%s going to sleep", myName.string());
+                    mCycleStats.endCycle();
                     mWaitWorkCV.wait(mLock);
                     ALOGV("%s waking up", myName.string());
                     acquireWakeLock_l();
@@ -3508,6 +3519,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
 
                         const int32_t throttleMs = (int32_t)mHalfBufferMs - deltaMs;
                         if ((signed)mHalfBufferMs >= throttleMs && throttleMs > 0) {
+                            mCycleStats.endCycle();
                             usleep(throttleMs * 1000);
                             // notify of throttle start on verbose log
                             ALOGV_IF(mThreadThrottleEndMs == mThreadThrottleTimeMs,
@@ -3559,6 +3571,7 @@ bool AudioFlinger::PlaybackThread::threadLoop()
                     mSleepTimeUs = deltaNs / 1000;
                 }
                 if (!mSignalPending && mConfigEvents.isEmpty() && !exitPending()) {
+                    mCycleStats.endCycle();
                     mWaitWorkCV.waitRelative(mLock, microseconds((nsecs_t)mSleepTimeUs));
                 }
                 ATRACE_END();
@@ -3799,6 +3812,7 @@ AudioFlinger::MixerThread::MixerThread(const sp<AudioFlinger>& audioFlinger, Aud
             mSampleRate, mChannelMask, mChannelCount, mFormat, mFrameSize, mFrameCount,
             mNormalFrameCount);
     mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+    mAudioMixer->setTimingEnabled(true);
 
     if (type == DUPLICATING) {
         // The Duplicating thread uses the AudioMixer and delivers data to OutputTracks
@@ -4998,6 +5012,7 @@ bool AudioFlinger::MixerThread::checkForNewParameter_l(const String8& keyValuePa
             readOutputParameters_l();
             delete mAudioMixer;
             mAudioMixer = new AudioMixer(mNormalFrameCount, mSampleRate);
+            mAudioMixer->setTimingEnabled(true);
             for (const auto &track : mTracks) {
                 const int name = track->name();
                 status_t status = mAudioMixer->create(
@@ -5024,6 +5039,11 @@ void AudioFlinger::MixerThread::dumpInternals(int fd, const Vector<String16>& ar
     PlaybackThread::dumpInternals(fd, args);
     dprintf(fd, "  Thread throttle time (msecs): %u\n", mThreadThrottleTimeMs);
     dprintf(fd, "  AudioMixer tracks: %s\n", mAudioMixer->trackNames().c_str());
+    const std::string mixerTimes = mAudioMixer->timingSummary();
+    if (!mixerTimes.empty()) {
+        dprintf(fd, "  AudioMixer process hook and track times (us, median/90%%/99%%/max):\n%s",
+                mixerTimes.c_str());
+    }
     dprintf(fd, "  Master mono: %s\n", mMasterMono ? "on" : "off");
 
     if (hasFastMixer()) {
@@ -6424,6 +6444,8 @@ reacquire_wakelock:
 
     // loop while there is work to do
     for (;;) {
+        mCycleStats.sampleCycle();
+
         Vector< sp<EffectChain> > effectChains;
 
         // activeTracks accumulates a copy of a subset of mActiveTracks
@@ -6449,6 +6471,7 @@ reacquire_wakelock:
             // sleep with mutex unlocked
             if (sleepUs > 0) {
                 ATRACE_BEGIN("sleepC");
+                mCycleStats.endCycle();
                 mWaitWorkCV.waitRelative(mLock, microseconds((nsecs_t)sleepUs));
                 ATRACE_END();
                 sleepUs = 0;
@@ -6463,6 +6486,7 @@ reacquire_wakelock:
                 releaseWakeLock_l();
                 ALOGV("RecordThread: loop stopping");
                 // go to sleep
+                mCycleStats.endCycle();
                 mWaitWorkCV.wait(mLock);
                 ALOGV("RecordThread: loop starting");
                 goto reacquire_wakelock;
@@ -6532,6 +6556,8 @@ reacquire_wakelock:
 
             updateMetadata_l();
 
+            updateSharedConversions_l(activeTracks);
+
             if (allStopped) {
                 standbyIfNotAlreadyInStandby();
             }
@@ -6717,6 +6743,18 @@ reacquire_wakelock:
         }
         rear = mRsmpInRear += framesRead;
 
+        // convert once for all tracks sharing a conversion
+        for (size_t i = 0; i < mSharedConversions.size(); i++) {
+            const sp<SharedConversion>& conversion = mSharedConversions[i];
+            size_t framesIn;
+            conversion->mProvider.sync(&framesIn);
+            if (framesIn > 0) {
+                conversion->mConverter->convert(&conversion->mProvider,
+                        destinationFramesPossible(
+                                framesIn, mSampleRate, conversion->mConverter->sampleRate()));
+            }
+        }
+
         size = activeTracks.size();
 
         // loop over each active track
@@ -6737,6 +6775,11 @@ reacquire_wakelock:
                 OVERRUN_FALSE
             } overrun = OVERRUN_UNKNOWN;
 
+            // set if the frames were already converted for several tracks
+            SharedRecordBufferConverter *sharedConverter =
+                    activeTrack->mSharedConversion != 0 ?
+                            activeTrack->mSharedConversion->mConverter : NULL;
+
             // loop over getNextBuffer to handle circular sink
             for (;;) {
 
@@ -6749,7 +6792,12 @@ reacquire_wakelock:
                 // if the record track isn't draining fast enough.
                 bool hasOverrun;
                 size_t framesIn;
-                activeTrack->mResamplerBufferProvider->sync(&framesIn, &hasOverrun);
+                if (sharedConverter != NULL) {
+                    framesIn = sharedConverter->sync(
+                            &activeTrack->mSharedConversionPosition, &hasOverrun);
+                } else {
+                    activeTrack->mResamplerBufferProvider->sync(&framesIn, &hasOverrun);
+                }
                 if (hasOverrun) {
                     overrun = OVERRUN_TRUE;
                 }
@@ -6757,16 +6805,24 @@ reacquire_wakelock:
                     break;
                 }
 
-                // Don't allow framesOut to be larger than what is possible with resampling
-                // from framesIn.
-                // This isn't strictly necessary but helps limit buffer resizing in
-                // RecordBufferConverter.  TODO: remove when no longer needed.
-                framesOut = min(framesOut,
-                        destinationFramesPossible(
-                                framesIn, mSampleRate, activeTrack->mSampleRate));
-                // process frames from the RecordThread buffer provider to the RecordTrack buffer
-                framesOut = activeTrack->mRecordBufferConverter->convert(
-                        activeTrack->mSink.raw, activeTrack->mResamplerBufferProvider, framesOut);
+                if (sharedConverter != NULL) {
+                    // copy frames already converted to the track format
+                    framesOut = sharedConverter->read(activeTrack->mSink.raw,
+                            &activeTrack->mSharedConversionPosition, framesOut);
+                } else {
+                    // Don't allow framesOut to be larger than what is possible with resampling
+                    // from framesIn.
+                    // This isn't strictly necessary but helps limit buffer resizing in
+                    // RecordBufferConverter.  TODO: remove when no longer needed.
+                    framesOut = min(framesOut,
+                            destinationFramesPossible(
+                                    framesIn, mSampleRate, activeTrack->mSampleRate));
+                    // process frames from the RecordThread buffer provider to the RecordTrack
+                    // buffer
+                    framesOut = activeTrack->mRecordBufferConverter->convert(
+                            activeTrack->mSink.raw, activeTrack->mResamplerBufferProvider,
+                            framesOut);
+                }
 
                 if (framesOut > 0 && (overrun == OVERRUN_UNKNOWN)) {
                     overrun = OVERRUN_FALSE;
@@ -7140,6 +7196,9 @@ status_t AudioFlinger::RecordThread::start(RecordThread::RecordTrack* recordTrac
         recordTrack->mResamplerBufferProvider->reset();
         // clear any converter state as new data will be discontinuous
         recordTrack->mRecordBufferConverter->reset();
+        // the thread loop assigns a shared conversion again if there is one to join
+        recordTrack->mSharedConversion.clear();
+        recordTrack->mMayShareConversion = true;
         recordTrack->mState = TrackBase::STARTING_2;
         // signal thread to start
         mWaitWorkCV.broadcast();
@@ -7306,6 +7365,12 @@ void AudioFlinger::RecordThread::dumpInternals(int fd, const Vector<String16>& a
 
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
     dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
+    for (size_t i = 0; i < mSharedConversions.size(); i++) {
+        const SharedRecordBufferConverter *converter = mSharedConversions[i]->mConverter;
+        dprintf(fd, "  Shared conversion to %#x %#x %u Hz: %zu tracks, %zu frames\n",
+                converter->channelMask(), converter->format(), converter->sampleRate(),
+                mSharedConversions[i]->mUsers, converter->frameCount());
+    }
 
     // Make a non-atomic copy of fast capture dump state so it won't change underneath us
     // while we are dumping it.  It may be inconsistent, but it won't mutate!
@@ -7371,9 +7436,16 @@ void AudioFlinger::RecordThread::setRecordSilenced(uid_t uid, bool silenced)
     }
 }
 
+AudioFlinger::RecordThread::ResamplerBufferProvider::ResamplerBufferProvider(
+        RecordThread* recordThread) :
+    mThread(recordThread),
+    mRsmpInUnrel(0), mRsmpInFront(0)
+{
+}
+
 void AudioFlinger::RecordThread::ResamplerBufferProvider::reset()
 {
-    sp<ThreadBase> threadBase = mRecordTrack->mThread.promote();
+    sp<ThreadBase> threadBase = mThread.promote();
     RecordThread *recordThread = (RecordThread *) threadBase.get();
     mRsmpInFront = recordThread->mRsmpInRear;
     mRsmpInUnrel = 0;
@@ -7382,7 +7454,7 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::reset()
 void AudioFlinger::RecordThread::ResamplerBufferProvider::sync(
         size_t *framesAvailable, bool *hasOverrun)
 {
-    sp<ThreadBase> threadBase = mRecordTrack->mThread.promote();
+    sp<ThreadBase> threadBase = mThread.promote();
     RecordThread *recordThread = (RecordThread *) threadBase.get();
     const int32_t rear = recordThread->mRsmpInRear;
     const int32_t front = mRsmpInFront;
@@ -7415,7 +7487,7 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::sync(
 status_t AudioFlinger::RecordThread::ResamplerBufferProvider::getNextBuffer(
         AudioBufferProvider::Buffer* buffer)
 {
-    sp<ThreadBase> threadBase = mRecordTrack->mThread.promote();
+    sp<ThreadBase> threadBase = mThread.promote();
     if (threadBase == 0) {
         buffer->frameCount = 0;
         buffer->raw = NULL;
@@ -7468,6 +7540,100 @@ void AudioFlinger::RecordThread::ResamplerBufferProvider::releaseBuffer(
     buffer->frameCount = 0;
 }
 
+AudioFlinger::RecordThread::SharedConversion::SharedConversion(RecordThread* recordThread,
+        audio_channel_mask_t channelMask, audio_format_t format, uint32_t sampleRate) :
+    // hold as much converted data as the RecordThread buffer does, so that a track
+    // overruns after the same delay as when it converts on its own
+    mConverter(new SharedRecordBufferConverter(
+            recordThread->mChannelMask, recordThread->mFormat, recordThread->mSampleRate,
+            channelMask, format, sampleRate,
+            destinationFramesPossible(
+                    recordThread->mRsmpInFrames, recordThread->mSampleRate, sampleRate))),
+    mProvider(recordThread),
+    mUsers(0)
+{
+    mProvider.reset();
+}
+
+AudioFlinger::RecordThread::SharedConversion::~SharedConversion()
+{
+    delete mConverter;
+}
+
+void AudioFlinger::RecordThread::updateSharedConversions_l(
+        const Vector< sp<RecordTrack> >& activeTracks)
+{
+    for (size_t i = 0; i < mSharedConversions.size(); i++) {
+        mSharedConversions[i]->mUsers = 0;
+    }
+
+    const size_t size = activeTracks.size();
+    for (size_t i = 0; i < size; i++) {
+        const sp<RecordTrack>& track = activeTracks[i];
+        // fast tracks are served by FastCapture, and tracks in the thread format
+        // only need a copy
+        if (track->isFastTrack() || (track->mChannelMask == mChannelMask
+                && track->mFormat == mFormat && track->mSampleRate == mSampleRate)) {
+            track->mSharedConversion.clear();
+            continue;
+        }
+        // a track keeps the conversion it was given when it started, shared or its own
+        if (!track->mMayShareConversion) {
+            if (track->mSharedConversion != 0) {
+                track->mSharedConversion->mUsers++;
+            }
+            continue;
+        }
+        track->mMayShareConversion = false;
+
+        sp<SharedConversion> conversion;
+        for (size_t j = 0; j < mSharedConversions.size(); j++) {
+            if (mSharedConversions[j]->mConverter->matches(
+                    track->mChannelMask, track->mFormat, track->mSampleRate)) {
+                conversion = mSharedConversions[j];
+                break;
+            }
+        }
+        if (conversion == 0) {
+            // only worth it if another track starting now wants the same conversion
+            bool wanted = false;
+            for (size_t j = i + 1; j < size && !wanted; j++) {
+                const sp<RecordTrack>& other = activeTracks[j];
+                wanted = !other->isFastTrack() && other->mMayShareConversion
+                        && other->mChannelMask == track->mChannelMask
+                        && other->mFormat == track->mFormat
+                        && other->mSampleRate == track->mSampleRate;
+            }
+            if (!wanted) {
+                track->mSharedConversion.clear();
+                continue;
+            }
+            conversion = new SharedConversion(
+                    this, track->mChannelMask, track->mFormat, track->mSampleRate);
+            if (conversion->mConverter->initCheck() != NO_ERROR) {
+                ALOGW("%s: cannot share conversion to %#x %#x %u", __func__,
+                        track->mChannelMask, track->mFormat, track->mSampleRate);
+                track->mSharedConversion.clear();
+                continue;
+            }
+            mSharedConversions.add(conversion);
+        }
+        // start() dropped what was buffered, so the track starts with the next converted frame
+        track->mSharedConversion = conversion;
+        track->mSharedConversionPosition = conversion->mConverter->rear();
+        conversion->mUsers++;
+    }
+
+    // A conversion is kept while anyone uses it, so tracks do not switch back and forth.
+    for (size_t i = 0; i < mSharedConversions.size(); ) {
+        if (mSharedConversions[i]->mUsers == 0) {
+            mSharedConversions.removeAt(i);
+        } else {
+            i++;
+        }
+    }
+}
+
 void AudioFlinger::RecordThread::checkBtNrec()
 {
     Mutex::Autolock _l(mLock);
@@ -7683,6 +7849,17 @@ void AudioFlinger::RecordThread::readInputParameters_l()
 
     // AudioRecord mSampleRate and mChannelCount are constant due to AudioRecord API constraints.
     // But if thread's mSampleRate or mChannelCount changes, how will that affect active tracks?
+
+    // shared conversions are rebuilt from the new input configuration, and the tracks
+    // that used them join the new ones
+    mSharedConversions.clear();
+    for (size_t i = 0; i < mActiveTracks.size(); i++) {
+        sp<RecordTrack> track = mActiveTracks[i];
+        if (track->mSharedConversion != 0) {
+            track->mSharedConversion.clear();
+            track->mMayShareConversion = true;
+        }
+    }
 }
 
 uint32_t AudioFlinger::RecordThread::getInputFramesLost()
@@ -8214,6 +8391,8 @@ bool AudioFlinger::MmapThread::threadLoop()
 
     while (!exitPending())
     {
+        mCycleStats.sampleCycle();
+
         Mutex::Autolock _l(mLock);
         Vector< sp<EffectChain> > effectChains;
 
@@ -8231,6 +8410,7 @@ bool AudioFlinger::MmapThread::threadLoop()
 
                 // wait until we have something to do...
                 ALOGV("%s going to sleep", myName.string());
+                mCycleStats.endCycle();
                 mWaitWorkCV.wait(mLock);
                 ALOGV("%s waking up", myName.string());
 
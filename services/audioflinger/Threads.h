@@ -493,6 +493,10 @@ protected:
                 sp<NBLog::Writer>       mNBLogWriter;
                 bool                    mSystemReady;
                 ExtendedTimestamp       mTimestamp;
+                // wall clock and CPU time of recent threadLoop() cycles, without the time
+                // spent sleeping or waiting for work, for dumpsys.
+                // Written only by the threadLoop.
+                CycleTimeStatistics     mCycleStats;
                 // A condition that must be evaluated by the thread loop has changed and
                 // we must not wait for async write callback in the thread loop before evaluating it
                 bool                    mSignalPending;
@@ -1332,9 +1336,7 @@ public:
     class ResamplerBufferProvider : public AudioBufferProvider
     {
     public:
-        explicit ResamplerBufferProvider(RecordTrack* recordTrack) :
-            mRecordTrack(recordTrack),
-            mRsmpInUnrel(0), mRsmpInFront(0) { }
+        explicit ResamplerBufferProvider(RecordThread* recordThread);
         virtual ~ResamplerBufferProvider() { }
 
         // called to set the ResamplerBufferProvider to head of the RecordThread data buffer,
@@ -1358,7 +1360,7 @@ public:
         virtual status_t    getNextBuffer(AudioBufferProvider::Buffer* buffer);
         virtual void        releaseBuffer(AudioBufferProvider::Buffer* buffer);
     private:
-        RecordTrack * const mRecordTrack;
+        const wp<ThreadBase> mThread;
         size_t              mRsmpInUnrel;   // unreleased frames remaining from
                                             // most recent getNextBuffer
                                             // for debug only
@@ -1366,6 +1368,23 @@ public:
                                             // rolling counter that is never cleared
     };
 
+    /* A SharedConversion converts the RecordThread data once for every active
+     * RecordTrack that asks for the same channel mask, format and sample rate.
+     * Each such track then reads the converted frames at its own position instead
+     * of running its own RecordBufferConverter; see updateSharedConversions_l().
+     */
+    class SharedConversion : public RefBase
+    {
+    public:
+        SharedConversion(RecordThread* recordThread, audio_channel_mask_t channelMask,
+                audio_format_t format, uint32_t sampleRate);
+        virtual ~SharedConversion();
+
+        SharedRecordBufferConverter * const mConverter;
+        ResamplerBufferProvider     mProvider;  // own position in the RecordThread buffer
+        size_t                      mUsers;     // active tracks reading, counted each cycle
+    };
+
 #include "RecordTracks.h"
 
             RecordThread(const sp<AudioFlinger>& audioFlinger,
@@ -1488,6 +1507,10 @@ private:
 
             void    checkBtNrec_l();
 
+            // Assigns each active track that needs a conversion also wanted by another
+            // active track to a SharedConversion, and drops those no longer used.
+            void    updateSharedConversions_l(const Vector< sp<RecordTrack> >& activeTracks);
+
             AudioStreamIn                       *mInput;
             SortedVector < sp<RecordTrack> >    mTracks;
             // mActiveTracks has dual roles:  it indicates the current active track(s), and
@@ -1505,6 +1528,9 @@ private:
             // rolling index that is never cleared
             int32_t                             mRsmpInRear;    // last filled frame + 1
 
+            // accessible only within the threadLoop() or with mLock held
+            Vector< sp<SharedConversion> >      mSharedConversions;
+
             // For dumpsys
             const sp<NBAIO_Sink>                mTeeSink;
 
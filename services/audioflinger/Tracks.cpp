@@ -1665,6 +1665,8 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
         mFramesToDrop(0),
         mResamplerBufferProvider(NULL), // initialize in case of early constructor exit
         mRecordBufferConverter(NULL),
+        mSharedConversionPosition(0),
+        mMayShareConversion(false),
         mFlags(flags),
         mSilenced(false)
 {
@@ -1689,7 +1691,7 @@ AudioFlinger::RecordThread::RecordTrack::RecordTrack(
     mServerProxy = new AudioRecordServerProxy(mCblk, mBuffer, frameCount,
             mFrameSize, !isExternalTrack());
 
-    mResamplerBufferProvider = new ResamplerBufferProvider(this);
+    mResamplerBufferProvider = new ResamplerBufferProvider(thread);
 
     if (flags & AUDIO_INPUT_FLAG_FAST) {
         ALOG_ASSERT(thread->mFastTrackAvail);
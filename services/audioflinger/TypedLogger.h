@@ -84,10 +84,9 @@ constexpr uint64_t hash(const char (&file)[n], uint32_t line) {
 //      in the case when logging is enabled at compile-time and enabled at runtime, but it might be
 //      slower than nullptr check when logging is enabled at compile-time and disabled at runtime.
 
-// Write formatted entry to log
+// Write formatted entry to log, arguments are encoded by type (see NBLog::Writer::logFormatArgs)
 #define LOGT(fmt, ...) do { NBLog::Writer *x = tlNBLogWriter; if (x != nullptr) \
-                                x->logFormat((fmt), hash(__FILE__, __LINE__), ##__VA_ARGS__); } \
-                                while (0)
+        x->logFormatArgs((fmt), hash(__FILE__, __LINE__), ##__VA_ARGS__); } while (0)
 
 // Write histogram timestamp entry
 #define LOG_HIST_TS() do { NBLog::Writer *x = tlNBLogWriter; if (x != nullptr) \